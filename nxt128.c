@@ -35,15 +35,22 @@
 #include "nxt128.h"
 #include "nxt128_tables.h"
 
+#if ((defined NXT128_INIT_TABLES) && !(defined NXT_NO_THREADS))
+#include <pthread.h>
+#endif
+
 #ifndef USE_NXT128
 #error Set USE_NXT128 in nxt_common.h to use NXT128
 #endif
 
 #if ((NXT128_TOTAL_ROUNDS <= 1) || (NXT128_TOTAL_ROUNDS > 255))
 #error NXT128_TOTAL_ROUNDS must be greater than 1 and smaller than 256
-#elif ((defined NXT128_UNROLL_LOOPS) && (NXT128_TOTAL_ROUNDS != 16) \
-       && (NXT128_TOTAL_ROUNDS != 12))
-#error NXT128_TOTAL_ROUNDS must be 12 or 16 when NXT128_UNROLL_LOOPS is set
+#endif
+
+/* Only 12 and 16 rounds have unrolled loops */
+#if ((defined NXT128_UNROLL_LOOPS) && (NXT128_TOTAL_ROUNDS != 16) \
+     && (NXT128_TOTAL_ROUNDS != 12))
+#undef NXT128_UNROLL_LOOPS
 #endif
 
 #define SIGMA_MU8_0(x, y)                 \
@@ -123,8 +130,89 @@
     x3 ^= f1;       \
 }
 
+/*
+ * Two blocks variants of the round macros used by the multi-block
+ * functions. The blocks (x0, .., x3) and (y0, .., y3) use the round
+ * keys rk and sk, which are the same for a single key, and have
+ * independent dependency chains which can be executed in parallel.
+ */
+#define F64X2                               \
+{                                           \
+    tmp0 = x0 ^ x1 ^ rk[0];                 \
+    tmp1 = x2 ^ x3 ^ rk[1];                 \
+    tmp2 = y0 ^ y1 ^ sk[0];                 \
+    tmp3 = y2 ^ y3 ^ sk[1];                 \
+                                            \
+    smu0 = rk[2] ^ SIGMA_MU8_0(tmp0, tmp1); \
+    smu1 = rk[3] ^ SIGMA_MU8_1(tmp0, tmp1); \
+    smu2 = sk[2] ^ SIGMA_MU8_0(tmp2, tmp3); \
+    smu3 = sk[3] ^ SIGMA_MU8_1(tmp2, tmp3); \
+                                            \
+    f0 = rk[0] ^ SIGMA(smu0);               \
+    f1 = rk[1] ^ SIGMA(smu1);               \
+    g0 = sk[0] ^ SIGMA(smu2);               \
+    g1 = sk[1] ^ SIGMA(smu3);               \
+}
+
+#define ELMOR128X2     \
+{                      \
+    F64X2;             \
+                       \
+    tmp0 = x0 ^ f0;    \
+    x0 = NXT_OR(tmp0); \
+    x1 ^= f0;          \
+    tmp1 = x2 ^ f1;    \
+    x2 = NXT_OR(tmp1); \
+    x3 ^= f1;          \
+                       \
+    tmp2 = y0 ^ g0;    \
+    y0 = NXT_OR(tmp2); \
+    y1 ^= g0;          \
+    tmp3 = y2 ^ g1;    \
+    y2 = NXT_OR(tmp3); \
+    y3 ^= g1;          \
+    rk += 4;           \
+    sk += 4;           \
+}
+
+#define ELMIO128X2     \
+{                      \
+    F64X2;             \
+                       \
+    tmp0 = x0 ^ f0;    \
+    x0 = NXT_IO(tmp0); \
+    x1 ^= f0;          \
+    tmp1 = x2 ^ f1;    \
+    x2 = NXT_IO(tmp1); \
+    x3 ^= f1;          \
+                       \
+    tmp2 = y0 ^ g0;    \
+    y0 = NXT_IO(tmp2); \
+    y1 ^= g0;          \
+    tmp3 = y2 ^ g1;    \
+    y2 = NXT_IO(tmp3); \
+    y3 ^= g1;          \
+    rk -= 4;           \
+    sk -= 4;           \
+}
+
+#define ELMID128X2 \
+{                  \
+    F64X2;         \
+                   \
+    x0 ^= f0;      \
+    x1 ^= f0;      \
+    x2 ^= f1;      \
+    x3 ^= f1;      \
+                   \
+    y0 ^= g0;      \
+    y1 ^= g0;      \
+    y2 ^= g1;      \
+    y3 ^= g1;      \
+}
+
 #ifdef NXT128_INIT_TABLES
-void nxt128_init_tables(void)
+static void nxt128_fill_tables(void)
 {
     int i;
     uint8 s;
@@ -233,7 +321,40 @@ void nxt128_init_tables(void)
         tbs3_128[i] =          s      ;
     }
 }
-#endif /* NXT128_INIT_TABLES */
+
+/*
+ * Fills the tables once, on the first use of NXT128. The threads racing
+ * for it wait until they are filled.
+ */
+#ifdef NXT_NO_THREADS
+static int nxt128_tables_ready = 0;
+
+void nxt128_init_tables(void)
+{
+    if (!nxt128_tables_ready) {
+        nxt128_fill_tables();
+        nxt128_tables_ready = 1;
+    }
+}
+#else /* !NXT_NO_THREADS */
+static pthread_once_t nxt128_tables_once = PTHREAD_ONCE_INIT;
+
+void nxt128_init_tables(void)
+{
+    pthread_once(&nxt128_tables_once, nxt128_fill_tables);
+}
+#endif /* !NXT_NO_THREADS */
+
+#define LAZY_INIT_TABLES() nxt128_init_tables()
+#else /* !NXT128_INIT_TABLES */
+
+/* The tables are precalculated, there is nothing to do */
+void nxt128_init_tables(void)
+{
+}
+
+#define LAZY_INIT_TABLES()
+#endif /* !NXT128_INIT_TABLES */
 
 void nxt128_encrypt(nxt128_ctx *ctx, const uint8 *in, uint8 *out)
 {
@@ -247,6 +368,8 @@ void nxt128_encrypt(nxt128_ctx *ctx, const uint8 *in, uint8 *out)
     int i;
 #endif
 
+    LAZY_INIT_TABLES();
+
     PACK32(in     , &x0);
     PACK32(in +  4, &x1);
     PACK32(in +  8, &x2);
@@ -291,6 +414,8 @@ void nxt128_decrypt(nxt128_ctx *ctx, const uint8 *in, uint8 *out)
     int i;
 #endif
 
+    LAZY_INIT_TABLES();
+
     PACK32(in     , &x0);
     PACK32(in +  4, &x1);
     PACK32(in +  8, &x2);
@@ -323,6 +448,207 @@ void nxt128_decrypt(nxt128_ctx *ctx, const uint8 *in, uint8 *out)
     UNPACK32(x3, out + 12);
 }
 
+void nxt128_encrypt_blocks(nxt128_ctx *ctx, const uint8 *in, uint8 *out,
+                           size_t blocks)
+{
+    uint32 x0, x1, x2, x3;
+    uint32 y0, y1, y2, y3;
+    uint32 tmp0, tmp1, tmp2, tmp3;
+    uint32 f0, f1, g0, g1;
+    uint32 smu0, smu1, smu2, smu3;
+    uint32 *rk, *sk;
+    int i;
+
+    LAZY_INIT_TABLES();
+
+    for (; blocks >= 2; blocks -= 2) {
+        PACK32(in     , &x0);
+        PACK32(in +  4, &x1);
+        PACK32(in +  8, &x2);
+        PACK32(in + 12, &x3);
+        PACK32(in + 16, &y0);
+        PACK32(in + 20, &y1);
+        PACK32(in + 24, &y2);
+        PACK32(in + 28, &y3);
+
+        rk = sk = ctx->rk;
+
+        for (i = 0; i < (NXT128_TOTAL_ROUNDS - 1); i++) {
+            ELMOR128X2;
+        }
+        ELMID128X2;
+
+        UNPACK32(x0, out     );
+        UNPACK32(x1, out +  4);
+        UNPACK32(x2, out +  8);
+        UNPACK32(x3, out + 12);
+        UNPACK32(y0, out + 16);
+        UNPACK32(y1, out + 20);
+        UNPACK32(y2, out + 24);
+        UNPACK32(y3, out + 28);
+
+        in  += 2 * NXT128_BLOCK_SIZE;
+        out += 2 * NXT128_BLOCK_SIZE;
+    }
+
+    if (blocks) {
+        nxt128_encrypt(ctx, in, out);
+    }
+}
+
+void nxt128_decrypt_blocks(nxt128_ctx *ctx, const uint8 *in, uint8 *out,
+                           size_t blocks)
+{
+    uint32 x0, x1, x2, x3;
+    uint32 y0, y1, y2, y3;
+    uint32 tmp0, tmp1, tmp2, tmp3;
+    uint32 f0, f1, g0, g1;
+    uint32 smu0, smu1, smu2, smu3;
+    uint32 *rk, *sk;
+    int i;
+
+    LAZY_INIT_TABLES();
+
+    for (; blocks >= 2; blocks -= 2) {
+        PACK32(in     , &x0);
+        PACK32(in +  4, &x1);
+        PACK32(in +  8, &x2);
+        PACK32(in + 12, &x3);
+        PACK32(in + 16, &y0);
+        PACK32(in + 20, &y1);
+        PACK32(in + 24, &y2);
+        PACK32(in + 28, &y3);
+
+        rk = sk = ctx->rk + 4 * (NXT128_TOTAL_ROUNDS - 1);
+
+        for (i = 0; i < (NXT128_TOTAL_ROUNDS - 1); i++) {
+            ELMIO128X2;
+        }
+        ELMID128X2;
+
+        UNPACK32(x0, out     );
+        UNPACK32(x1, out +  4);
+        UNPACK32(x2, out +  8);
+        UNPACK32(x3, out + 12);
+        UNPACK32(y0, out + 16);
+        UNPACK32(y1, out + 20);
+        UNPACK32(y2, out + 24);
+        UNPACK32(y3, out + 28);
+
+        in  += 2 * NXT128_BLOCK_SIZE;
+        out += 2 * NXT128_BLOCK_SIZE;
+    }
+
+    if (blocks) {
+        nxt128_decrypt(ctx, in, out);
+    }
+}
+
+/*
+ * Multi-key variants: block i is processed with the key schedule
+ * ctx[i]. The round keys of the two interleaved blocks are read from
+ * their own contexts.
+ */
+void nxt128_encrypt_blocks_mk(nxt128_ctx *const *ctx, const uint8 *in,
+                              uint8 *out, size_t blocks)
+{
+    uint32 x0, x1, x2, x3;
+    uint32 y0, y1, y2, y3;
+    uint32 tmp0, tmp1, tmp2, tmp3;
+    uint32 f0, f1, g0, g1;
+    uint32 smu0, smu1, smu2, smu3;
+    uint32 *rk, *sk;
+    int i;
+
+    LAZY_INIT_TABLES();
+
+    for (; blocks >= 2; blocks -= 2) {
+        PACK32(in     , &x0);
+        PACK32(in +  4, &x1);
+        PACK32(in +  8, &x2);
+        PACK32(in + 12, &x3);
+        PACK32(in + 16, &y0);
+        PACK32(in + 20, &y1);
+        PACK32(in + 24, &y2);
+        PACK32(in + 28, &y3);
+
+        rk = ctx[0]->rk;
+        sk = ctx[1]->rk;
+
+        for (i = 0; i < (NXT128_TOTAL_ROUNDS - 1); i++) {
+            ELMOR128X2;
+        }
+        ELMID128X2;
+
+        UNPACK32(x0, out     );
+        UNPACK32(x1, out +  4);
+        UNPACK32(x2, out +  8);
+        UNPACK32(x3, out + 12);
+        UNPACK32(y0, out + 16);
+        UNPACK32(y1, out + 20);
+        UNPACK32(y2, out + 24);
+        UNPACK32(y3, out + 28);
+
+        in  += 2 * NXT128_BLOCK_SIZE;
+        out += 2 * NXT128_BLOCK_SIZE;
+        ctx += 2;
+    }
+
+    if (blocks) {
+        nxt128_encrypt(ctx[0], in, out);
+    }
+}
+
+void nxt128_decrypt_blocks_mk(nxt128_ctx *const *ctx, const uint8 *in,
+                              uint8 *out, size_t blocks)
+{
+    uint32 x0, x1, x2, x3;
+    uint32 y0, y1, y2, y3;
+    uint32 tmp0, tmp1, tmp2, tmp3;
+    uint32 f0, f1, g0, g1;
+    uint32 smu0, smu1, smu2, smu3;
+    uint32 *rk, *sk;
+    int i;
+
+    LAZY_INIT_TABLES();
+
+    for (; blocks >= 2; blocks -= 2) {
+        PACK32(in     , &x0);
+        PACK32(in +  4, &x1);
+        PACK32(in +  8, &x2);
+        PACK32(in + 12, &x3);
+        PACK32(in + 16, &y0);
+        PACK32(in + 20, &y1);
+        PACK32(in + 24, &y2);
+        PACK32(in + 28, &y3);
+
+        rk = ctx[0]->rk + 4 * (NXT128_TOTAL_ROUNDS - 1);
+        sk = ctx[1]->rk + 4 * (NXT128_TOTAL_ROUNDS - 1);
+
+        for (i = 0; i < (NXT128_TOTAL_ROUNDS - 1); i++) {
+            ELMIO128X2;
+        }
+        ELMID128X2;
+
+        UNPACK32(x0, out     );
+        UNPACK32(x1, out +  4);
+        UNPACK32(x2, out +  8);
+        UNPACK32(x3, out + 12);
+        UNPACK32(y0, out + 16);
+        UNPACK32(y1, out + 20);
+        UNPACK32(y2, out + 24);
+        UNPACK32(y3, out + 28);
+
+        in  += 2 * NXT128_BLOCK_SIZE;
+        out += 2 * NXT128_BLOCK_SIZE;
+        ctx += 2;
+    }
+
+    if (blocks) {
+        nxt128_decrypt(ctx[0], in, out);
+    }
+}
+
 #define MIX128(x, y)                           \
 {                                              \
     *(y    ) = *(x + 2) ^ *(x + 4) ^ *(x + 6); \
@@ -428,6 +754,148 @@ void nxt128_dnl128(const uint8 *mkey, uint32 *reg,
     rkey[3] = x3;
 }
 
+/*
+ * Encrypts two blocks per lane, each lane under its own 256-bit key,
+ * without expanding the key schedule in a context. Round key i is
+ * derived just before round i, the LFSR sequence (which only depends
+ * on the number of rounds) is computed once for all the lanes and the
+ * lanes progress round by round so that their independent dependency
+ * chains overlap. keys holds 8 words per lane and blocks holds two
+ * blocks (8 words) per lane, in the word order of PACK32.
+ */
+void nxt128_ks256_encrypt2(const uint32 *keys, uint32 *blocks,
+                           size_t lanes)
+{
+    uint32 mask[8];
+    uint32 npad[8];
+    uint32 dkey32[8];
+    uint32 t0[8];
+    uint32 t1[8];
+    uint32 rkey[4];
+    uint32 x0, x1, x2, x3;
+    uint32 y0, y1, y2, y3;
+    uint32 tmp0, tmp1, tmp2, tmp3;
+    uint32 f0, f1, g0, g1;
+    uint32 smu0, smu1, smu2, smu3;
+    uint32 *rk, *sk;
+    uint32 reg;
+    uint32 s[11];
+    const uint32 *key;
+    uint32 *b;
+    size_t l;
+    int i, j;
+
+    LAZY_INIT_TABLES();
+
+    for (j = 0; j < 8; j++) {
+        PACK32(pad + 4 * j, npad + j);
+        npad[j] = ~npad[j];
+    }
+
+    reg = 0x006a0000 | ((NXT128_TOTAL_ROUNDS << 8) & 0x0000ff00)
+          | ((~NXT128_TOTAL_ROUNDS) & 0x000000ff);
+    if (reg & 0x1) {
+        reg ^= 0x100001b;
+    }
+    reg >>= 1;
+
+    for (i = 0; i < NXT128_TOTAL_ROUNDS; i++) {
+        /*
+         * D-part, shared by all the lanes. The 24-bit LFSR outputs are
+         * concatenated directly into words.
+         */
+        for (j = 0; j < 11; j++) {
+            LFSR(&reg, s[j]);
+            s[j] &= 0x00ffffff;
+        }
+
+        mask[0] = (s[0] <<  8) | (s[1] >> 16);
+        mask[1] = (s[1] << 16) | (s[2] >>  8);
+        mask[2] = (s[2] << 24) |  s[3];
+        mask[3] = (s[4] <<  8) | (s[5] >> 16);
+        mask[4] = (s[5] << 16) | (s[6] >>  8);
+        mask[5] = (s[6] << 24) |  s[7];
+        mask[6] = (s[8] <<  8) | (s[9] >> 16);
+        mask[7] = (s[9] << 16) | (s[10] >> 8);
+
+        for (l = 0; l < lanes; l++) {
+            key = keys + 8 * l;
+            b = blocks + 8 * l;
+
+            /* NL128-part */
+            dkey32[0] = key[0] ^ mask[0];
+            dkey32[1] = key[1] ^ mask[1];
+            dkey32[2] = key[2] ^ mask[2];
+            dkey32[3] = key[3] ^ mask[3];
+            dkey32[4] = key[4] ^ mask[4];
+            dkey32[5] = key[5] ^ mask[5];
+            dkey32[6] = key[6] ^ mask[6];
+            dkey32[7] = key[7] ^ mask[7];
+
+            t1[0] = SIGMA_MU8_0(dkey32[0], dkey32[1]);
+            t1[1] = SIGMA_MU8_1(dkey32[0], dkey32[1]);
+            t1[2] = SIGMA_MU8_0(dkey32[2], dkey32[3]);
+            t1[3] = SIGMA_MU8_1(dkey32[2], dkey32[3]);
+            t1[4] = SIGMA_MU8_0(dkey32[4], dkey32[5]);
+            t1[5] = SIGMA_MU8_1(dkey32[4], dkey32[5]);
+            t1[6] = SIGMA_MU8_0(dkey32[6], dkey32[7]);
+            t1[7] = SIGMA_MU8_1(dkey32[6], dkey32[7]);
+
+            MIX128(t1, t0);
+
+            /* 256-bit key: the padding words are complemented */
+            t0[0] ^= npad[0];
+            t0[1] ^= npad[1];
+            t0[2] ^= npad[2];
+            t0[3] ^= npad[3];
+            t0[4] ^= npad[4];
+            t0[5] ^= npad[5];
+            t0[6] ^= npad[6];
+            t0[7] ^= npad[7];
+
+            x0 = SIGMA(t0[0]) ^ SIGMA(t0[4]);
+            x1 = SIGMA(t0[1]) ^ SIGMA(t0[5]);
+            x2 = SIGMA(t0[2]) ^ SIGMA(t0[6]);
+            x3 = SIGMA(t0[3]) ^ SIGMA(t0[7]);
+
+            rk = dkey32;
+            ELMOR128(0);
+            ELMID128(0);
+
+            rkey[0] = x0;
+            rkey[1] = x1;
+            rkey[2] = x2;
+            rkey[3] = x3;
+
+            /* Round i of the two blocks */
+            x0 = b[0];
+            x1 = b[1];
+            x2 = b[2];
+            x3 = b[3];
+            y0 = b[4];
+            y1 = b[5];
+            y2 = b[6];
+            y3 = b[7];
+
+            rk = sk = rkey;
+            if (i < (NXT128_TOTAL_ROUNDS - 1)) {
+                ELMOR128X2;
+            } else {
+                ELMID128X2;
+            }
+
+            b[0] = x0;
+            b[1] = x1;
+            b[2] = x2;
+            b[3] = x3;
+            b[4] = y0;
+            b[5] = y1;
+            b[6] = y2;
+            b[7] = y3;
+        }
+    }
+}
+
 void nxt128_ks(nxt128_ctx *ctx, const uint8 *key, uint16 key_len)
 {
     const uint16 ek = 256;
@@ -439,6 +907,8 @@ void nxt128_ks(nxt128_ctx *ctx, const uint8 *key, uint16 key_len)
 
     assert((key_len % 8 == 0) && (key_len <= 256));
 
+    LAZY_INIT_TABLES();
+
     /* Initialization and LFSR Pre-clocking */
     reg = 0x006a0000 | ((NXT128_TOTAL_ROUNDS << 8) & 0x0000ff00)
           | ((~NXT128_TOTAL_ROUNDS) & 0x000000ff);
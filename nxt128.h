@@ -32,11 +32,15 @@
 #ifndef NXT128_H
 #define NXT128_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifndef NXT128_TOTAL_ROUNDS
 #define NXT128_TOTAL_ROUNDS 16
+#endif
 
 #ifndef NXT_TYPES
 #define NXT_TYPES
@@ -52,6 +56,16 @@ typedef struct {
 void nxt128_ks(nxt128_ctx *ctx, const uint8 *key, uint16 key_len);
 void nxt128_encrypt(nxt128_ctx *ctx, const uint8 *in, uint8 *out);
 void nxt128_decrypt(nxt128_ctx *ctx, const uint8 *in, uint8 *out);
+void nxt128_encrypt_blocks(nxt128_ctx *ctx, const uint8 *in, uint8 *out,
+                           size_t blocks);
+void nxt128_decrypt_blocks(nxt128_ctx *ctx, const uint8 *in, uint8 *out,
+                           size_t blocks);
+void nxt128_encrypt_blocks_mk(nxt128_ctx *const *ctx, const uint8 *in,
+                              uint8 *out, size_t blocks);
+void nxt128_decrypt_blocks_mk(nxt128_ctx *const *ctx, const uint8 *in,
+                              uint8 *out, size_t blocks);
+void nxt128_ks256_encrypt2(const uint32 *keys, uint32 *blocks,
+                           size_t lanes);
 void nxt128_init_tables(void);
 
 #define NXT128_BLOCK_SIZE 16
@@ -29,6 +29,8 @@
  * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+
+/* Generated by nxt_gentables from the S-box, do not edit */
 #ifndef NXT128_TABLES_H
 #define NXT128_TABLES_H
 
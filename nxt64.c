@@ -35,15 +35,22 @@
 #include "nxt64.h"
 #include "nxt64_tables.h"
 
+#if ((defined NXT64_INIT_TABLES) && !(defined NXT_NO_THREADS))
+#include <pthread.h>
+#endif
+
 #ifndef USE_NXT64
 #error Set USE_NXT64 in nxt_common.h to use NXT64
 #endif
 
 #if ((NXT64_TOTAL_ROUNDS <= 1) || (NXT64_TOTAL_ROUNDS > 255))
 #error NXT64_TOTAL_ROUNDS must be greater than 1 and smaller than 256
-#elif ((defined NXT64_UNROLL_LOOPS) && (NXT64_TOTAL_ROUNDS != 16) \
-       && (NXT64_TOTAL_ROUNDS != 12))
-#error NXT64_TOTAL_ROUNDS must be 12 or 16 when NXT64_UNROLL_LOOPS is set
+#endif
+
+/* Only 12 and 16 rounds have unrolled loops */
+#if ((defined NXT64_UNROLL_LOOPS) && (NXT64_TOTAL_ROUNDS != 16) \
+     && (NXT64_TOTAL_ROUNDS != 12))
+#undef NXT64_UNROLL_LOOPS
 #endif
 
 #define SIGMA_MU4(x)                   \
@@ -90,8 +97,59 @@
         x1 ^= f;  \
 }
 
+/*
+ * Two blocks variants of the round macros used by the multi-block
+ * functions. The blocks (x0, x1) and (y0, y1) use the round keys rk and
+ * sk, which are the same for a single key, and have independent
+ * dependency chains which can be executed in parallel.
+ */
+#define F32X2                       \
+{                                   \
+        f = x0 ^ x1 ^ rk[0];        \
+        g = y0 ^ y1 ^ sk[0];        \
+        f = rk[1] ^ SIGMA_MU4(f);   \
+        g = sk[1] ^ SIGMA_MU4(g);   \
+        f = rk[0] ^ SIGMA(f);       \
+        g = sk[0] ^ SIGMA(g);       \
+}
+
+#define LMOR64X2         \
+{                        \
+        F32X2;           \
+        x0 ^= f;         \
+        x0 = NXT_OR(x0); \
+        x1 ^= f;         \
+        y0 ^= g;         \
+        y0 = NXT_OR(y0); \
+        y1 ^= g;         \
+        rk += 2;         \
+        sk += 2;         \
+}
+
+#define LMIO64X2         \
+{                        \
+        F32X2;           \
+        x0 ^= f;         \
+        x0 = NXT_IO(x0); \
+        x1 ^= f;         \
+        y0 ^= g;         \
+        y0 = NXT_IO(y0); \
+        y1 ^= g;         \
+        rk -= 2;         \
+        sk -= 2;         \
+}
+
+#define LMID64X2  \
+{                 \
+        F32X2;    \
+        x0 ^= f;  \
+        x1 ^= f;  \
+        y0 ^= g;  \
+        y1 ^= g;  \
+}
+
 #ifdef NXT64_INIT_TABLES
-void nxt64_init_tables(void)
+static void nxt64_fill_tables(void)
 {
     int i;
     uint8 s;
@@ -122,7 +180,40 @@ void nxt64_init_tables(void)
         tbs3_64[i] =          s      ;
     }
 }
-#endif /* NXT64_INIT_TABLES */
+
+/*
+ * Fills the tables once, on the first use of NXT64. The threads racing
+ * for it wait until they are filled.
+ */
+#ifdef NXT_NO_THREADS
+static int nxt64_tables_ready = 0;
+
+void nxt64_init_tables(void)
+{
+    if (!nxt64_tables_ready) {
+        nxt64_fill_tables();
+        nxt64_tables_ready = 1;
+    }
+}
+#else /* !NXT_NO_THREADS */
+static pthread_once_t nxt64_tables_once = PTHREAD_ONCE_INIT;
+
+void nxt64_init_tables(void)
+{
+    pthread_once(&nxt64_tables_once, nxt64_fill_tables);
+}
+#endif /* !NXT_NO_THREADS */
+
+#define LAZY_INIT_TABLES() nxt64_init_tables()
+#else /* !NXT64_INIT_TABLES */
+
+/* The tables are precalculated, there is nothing to do */
+void nxt64_init_tables(void)
+{
+}
+
+#define LAZY_INIT_TABLES()
+#endif /* !NXT64_INIT_TABLES */
 
 void nxt64_encrypt(nxt64_ctx *ctx, const uint8 *in, uint8 *out)
 {
@@ -134,6 +225,8 @@ void nxt64_encrypt(nxt64_ctx *ctx, const uint8 *in, uint8 *out)
     int i;
 #endif
 
+    LAZY_INIT_TABLES();
+
     PACK32(in    , &x0);
     PACK32(in + 4, &x1);
 
@@ -162,6 +255,50 @@ void nxt64_encrypt(nxt64_ctx *ctx, const uint8 *in, uint8 *out)
     UNPACK32(x1, out + 4);
 }
 
+/*
+ * Same as nxt64_encrypt() on a block already loaded in two 32-bit words
+ * (block[0] holds the first four bytes in big-endian order).
+ */
+void nxt64_encrypt_words(nxt64_ctx *ctx, uint32 *block)
+{
+    uint32 x0, x1;
+    uint32 f;
+    uint32 *rk;
+
+#ifndef NXT64_UNROLL_LOOPS
+    int i;
+#endif
+
+    LAZY_INIT_TABLES();
+
+    x0 = block[0];
+    x1 = block[1];
+
+    rk = ctx->rk;
+
+#ifdef NXT64_UNROLL_LOOPS
+#if NXT64_TOTAL_ROUNDS == 16
+    LMOR64( 0); LMOR64( 2); LMOR64( 4); LMOR64( 6); LMOR64( 8); LMOR64(10);
+    LMOR64(12); LMOR64(14); LMOR64(16); LMOR64(18); LMOR64(20); LMOR64(22);
+    LMOR64(24); LMOR64(26); LMOR64(28);
+    LMID64(30);
+#endif
+#if NXT64_TOTAL_ROUNDS == 12
+    LMOR64( 0); LMOR64( 2); LMOR64( 4); LMOR64( 6); LMOR64( 8); LMOR64(10);
+    LMOR64(12); LMOR64(14); LMOR64(16); LMOR64(18); LMOR64(20);
+    LMID64(22);
+#endif
+#else /* !NXT64_UNROLL_LOOPS */
+    for (i = 0; i < (NXT64_TOTAL_ROUNDS - 1); i++) {
+        LMOR64(0);
+    }
+    LMID64(0);
+#endif /* !NXT64_UNROLL_LOOPS */
+
+    block[0] = x0;
+    block[1] = x1;
+}
+
 void nxt64_decrypt(nxt64_ctx *ctx, const uint8 *in, uint8 *out)
 {
     uint32 x0, x1;
@@ -172,6 +309,8 @@ void nxt64_decrypt(nxt64_ctx *ctx, const uint8 *in, uint8 *out)
     int i;
 #endif
 
+    LAZY_INIT_TABLES();
+
     PACK32(in    , &x0);
     PACK32(in + 4, &x1);
 
@@ -201,6 +340,163 @@ void nxt64_decrypt(nxt64_ctx *ctx, const uint8 *in, uint8 *out)
     UNPACK32(x1, out + 4);
 }
 
+void nxt64_encrypt_blocks(nxt64_ctx *ctx, const uint8 *in, uint8 *out,
+                          size_t blocks)
+{
+    uint32 x0, x1, y0, y1;
+    uint32 f, g;
+    uint32 *rk, *sk;
+    int i;
+
+    LAZY_INIT_TABLES();
+
+    for (; blocks >= 2; blocks -= 2) {
+        PACK32(in     , &x0);
+        PACK32(in +  4, &x1);
+        PACK32(in +  8, &y0);
+        PACK32(in + 12, &y1);
+
+        rk = sk = ctx->rk;
+
+        for (i = 0; i < (NXT64_TOTAL_ROUNDS - 1); i++) {
+            LMOR64X2;
+        }
+        LMID64X2;
+
+        UNPACK32(x0, out     );
+        UNPACK32(x1, out +  4);
+        UNPACK32(y0, out +  8);
+        UNPACK32(y1, out + 12);
+
+        in  += 2 * NXT64_BLOCK_SIZE;
+        out += 2 * NXT64_BLOCK_SIZE;
+    }
+
+    if (blocks) {
+        nxt64_encrypt(ctx, in, out);
+    }
+}
+
+void nxt64_decrypt_blocks(nxt64_ctx *ctx, const uint8 *in, uint8 *out,
+                          size_t blocks)
+{
+    uint32 x0, x1, y0, y1;
+    uint32 f, g;
+    uint32 *rk, *sk;
+    int i;
+
+    LAZY_INIT_TABLES();
+
+    for (; blocks >= 2; blocks -= 2) {
+        PACK32(in     , &x0);
+        PACK32(in +  4, &x1);
+        PACK32(in +  8, &y0);
+        PACK32(in + 12, &y1);
+
+        rk = sk = ctx->rk + 2 * (NXT64_TOTAL_ROUNDS - 1);
+
+        for (i = 0; i < (NXT64_TOTAL_ROUNDS - 1); i++) {
+            LMIO64X2;
+        }
+        LMID64X2;
+
+        UNPACK32(x0, out     );
+        UNPACK32(x1, out +  4);
+        UNPACK32(y0, out +  8);
+        UNPACK32(y1, out + 12);
+
+        in  += 2 * NXT64_BLOCK_SIZE;
+        out += 2 * NXT64_BLOCK_SIZE;
+    }
+
+    if (blocks) {
+        nxt64_decrypt(ctx, in, out);
+    }
+}
+
+/*
+ * Multi-key variants: block i is processed with the key schedule
+ * ctx[i]. The round keys of the two interleaved blocks are read from
+ * their own contexts.
+ */
+void nxt64_encrypt_blocks_mk(nxt64_ctx *const *ctx, const uint8 *in,
+                             uint8 *out, size_t blocks)
+{
+    uint32 x0, x1, y0, y1;
+    uint32 f, g;
+    uint32 *rk, *sk;
+    int i;
+
+    LAZY_INIT_TABLES();
+
+    for (; blocks >= 2; blocks -= 2) {
+        PACK32(in     , &x0);
+        PACK32(in +  4, &x1);
+        PACK32(in +  8, &y0);
+        PACK32(in + 12, &y1);
+
+        rk = ctx[0]->rk;
+        sk = ctx[1]->rk;
+
+        for (i = 0; i < (NXT64_TOTAL_ROUNDS - 1); i++) {
+            LMOR64X2;
+        }
+        LMID64X2;
+
+        UNPACK32(x0, out     );
+        UNPACK32(x1, out +  4);
+        UNPACK32(y0, out +  8);
+        UNPACK32(y1, out + 12);
+
+        in  += 2 * NXT64_BLOCK_SIZE;
+        out += 2 * NXT64_BLOCK_SIZE;
+        ctx += 2;
+    }
+
+    if (blocks) {
+        nxt64_encrypt(ctx[0], in, out);
+    }
+}
+
+void nxt64_decrypt_blocks_mk(nxt64_ctx *const *ctx, const uint8 *in,
+                             uint8 *out, size_t blocks)
+{
+    uint32 x0, x1, y0, y1;
+    uint32 f, g;
+    uint32 *rk, *sk;
+    int i;
+
+    LAZY_INIT_TABLES();
+
+    for (; blocks >= 2; blocks -= 2) {
+        PACK32(in     , &x0);
+        PACK32(in +  4, &x1);
+        PACK32(in +  8, &y0);
+        PACK32(in + 12, &y1);
+
+        rk = ctx[0]->rk + 2 * (NXT64_TOTAL_ROUNDS - 1);
+        sk = ctx[1]->rk + 2 * (NXT64_TOTAL_ROUNDS - 1);
+
+        for (i = 0; i < (NXT64_TOTAL_ROUNDS - 1); i++) {
+            LMIO64X2;
+        }
+        LMID64X2;
+
+        UNPACK32(x0, out     );
+        UNPACK32(x1, out +  4);
+        UNPACK32(y0, out +  8);
+        UNPACK32(y1, out + 12);
+
+        in  += 2 * NXT64_BLOCK_SIZE;
+        out += 2 * NXT64_BLOCK_SIZE;
+        ctx += 2;
+    }
+
+    if (blocks) {
+        nxt64_decrypt(ctx[0], in, out);
+    }
+}
+
 #define MIX64(x, y)                            \
 {                                              \
     *(y    ) = *(x + 1) ^ *(x + 2) ^ *(x + 3); \
@@ -446,6 +742,8 @@ void nxt64_ks(nxt64_ctx *ctx, const uint8 *key, uint16 key_len)
 {
     assert((key_len % 8 == 0) && (key_len <= 256));
 
+    LAZY_INIT_TABLES();
+
     if (key_len <= 128)
         nxt64_ks64(ctx, key, key_len);
     else
@@ -32,11 +32,15 @@
 #ifndef NXT64_H
 #define NXT64_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifndef NXT64_TOTAL_ROUNDS
 #define NXT64_TOTAL_ROUNDS 16
+#endif
 
 #ifndef NXT_TYPES
 #define NXT_TYPES
@@ -52,6 +56,15 @@ typedef struct {
 void nxt64_ks(nxt64_ctx *ctx, const uint8 *key, uint16 key_len);
 void nxt64_encrypt(nxt64_ctx *ctx, const uint8 *in, uint8 *out);
 void nxt64_decrypt(nxt64_ctx *ctx, const uint8 *in, uint8 *out);
+void nxt64_encrypt_words(nxt64_ctx *ctx, uint32 *block);
+void nxt64_encrypt_blocks(nxt64_ctx *ctx, const uint8 *in, uint8 *out,
+                          size_t blocks);
+void nxt64_decrypt_blocks(nxt64_ctx *ctx, const uint8 *in, uint8 *out,
+                          size_t blocks);
+void nxt64_encrypt_blocks_mk(nxt64_ctx *const *ctx, const uint8 *in,
+                             uint8 *out, size_t blocks);
+void nxt64_decrypt_blocks_mk(nxt64_ctx *const *ctx, const uint8 *in,
+                             uint8 *out, size_t blocks);
 void nxt64_init_tables(void);
 
 #define NXT64_BLOCK_SIZE 8
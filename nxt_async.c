@@ -0,0 +1,409 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nxt_common.h"
+#include "nxt_modes.h"
+#include "nxt_async.h"
+
+#ifndef __GNUC__
+#error nxt_async requires the __atomic builtins of GCC or Clang
+#endif
+
+#define LOAD_ACQ(p)    __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define XCHG(p, v)     __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL)
+#define LOAD_SC(p)     __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define STORE_SC(p, v) __atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+#define XCHG_SC(p, v)  __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST)
+#define ADD_SC(p, v)   __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST)
+
+/* Number of empty polls before an idle thread goes to sleep */
+#define NXT_ASYNC_SPIN 64
+
+/*
+ * Intrusive MPSC queue (D. Vyukov). Producers swap themselves in head
+ * and then link the previous head to the new request; the consumer
+ * follows the links from tail. The stub request keeps the queue
+ * non-empty.
+ */
+typedef struct {
+    nxt_async_req *head;
+    uint8 pad[64];
+    nxt_async_req *tail;
+    nxt_async_req stub;
+} nxt_async_queue;
+
+typedef struct {
+    nxt_async *as;
+    pthread_t tid;
+    nxt_async_queue queue;
+    long pending;
+    int sleeping;
+    sem_t sem;
+    nxt_mb_mgr mgr;
+    uint8 pad[64];
+} nxt_async_worker;
+
+struct nxt_async {
+    int workers;
+    nxt_async_worker *w;
+    unsigned int next;
+    int stop;
+};
+
+/*
+ * The completion ring is written by the worker only (tail) and read by
+ * the producer only (head). refs counts the workers still touching the
+ * producer after a completion.
+ */
+struct nxt_async_producer {
+    nxt_async_worker *worker;
+    nxt_async_req **ring;
+    size_t mask;
+    size_t depth;
+    size_t head;
+    size_t inflight;
+    uint8 pad0[64];
+    size_t tail;
+    int waiting;
+    int refs;
+    uint8 pad1[64];
+    sem_t sem;
+};
+
+static void nxt_async_queue_init(nxt_async_queue *q)
+{
+    q->stub.next = NULL;
+    q->head = &q->stub;
+    q->tail = &q->stub;
+}
+
+static void nxt_async_push(nxt_async_queue *q, nxt_async_req *req)
+{
+    nxt_async_req *prev;
+
+    __atomic_store_n(&req->next, NULL, __ATOMIC_RELAXED);
+    prev = XCHG(&q->head, req);
+    STORE_REL(&prev->next, req);
+}
+
+/* Returns NULL when empty or when a producer is between its two steps */
+static nxt_async_req *nxt_async_pop(nxt_async_queue *q)
+{
+    nxt_async_req *tail = q->tail;
+    nxt_async_req *next = LOAD_ACQ(&tail->next);
+
+    if (tail == &q->stub) {
+        if (next == NULL)
+            return NULL;
+        q->tail = next;
+        tail = next;
+        next = LOAD_ACQ(&next->next);
+    }
+
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+
+    if (tail != LOAD_ACQ(&q->head))
+        return NULL;
+
+    nxt_async_push(q, &q->stub);
+
+    next = LOAD_ACQ(&tail->next);
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+static void nxt_async_sem_wait(sem_t *sem)
+{
+    while (sem_wait(sem) != 0 && errno == EINTR)
+        ;
+}
+
+static void nxt_async_complete(nxt_async_req *req)
+{
+    nxt_async_producer *p = req->producer;
+
+    ADD_SC(&p->refs, 1);
+
+    p->ring[p->tail & p->mask] = req;
+    STORE_SC(&p->tail, p->tail + 1);
+
+    if (LOAD_SC(&p->waiting) && XCHG_SC(&p->waiting, 0))
+        sem_post(&p->sem);
+
+    ADD_SC(&p->refs, -1);
+}
+
+static void nxt_async_run(nxt_async_worker *w, nxt_async_req *req)
+{
+    nxt_mb_job *job = &req->job;
+
+    if (job->op != NXT_MB_CMAC && job->len >= NXT_ASYNC_DIRECT_SIZE) {
+        switch (job->op) {
+        case NXT_MB_CTR:
+            nxt128_ctr_crypt((nxt128_ctx *) job->ctx, job->iv, job->in,
+                             job->out, job->len);
+            break;
+
+        case NXT_MB_CBC_ENCRYPT:
+            nxt128_cbc_encrypt((nxt128_ctx *) job->ctx, job->iv, job->in,
+                               job->out, job->len);
+            break;
+
+        case NXT_MB_CBC_DECRYPT:
+            nxt128_cbc_decrypt((nxt128_ctx *) job->ctx, job->iv, job->in,
+                               job->out, job->len);
+            break;
+        }
+        nxt_async_complete(req);
+        return;
+    }
+
+    /* The job is the first member of the request */
+    for (job = nxt_mb_submit(&w->mgr, job, 0); job != NULL;
+         job = nxt_mb_get_completed(&w->mgr)) {
+        nxt_async_complete((nxt_async_req *) job);
+    }
+}
+
+static void *nxt_async_thread(void *arg)
+{
+    nxt_async_worker *w = (nxt_async_worker *) arg;
+    nxt_async_req *req;
+    nxt_mb_job *job;
+    int idle = 0;
+
+    for (;;) {
+        req = nxt_async_pop(&w->queue);
+        if (req != NULL) {
+            ADD_SC(&w->pending, -1);
+            nxt_async_run(w, req);
+            idle = 0;
+            continue;
+        }
+
+        /* Nothing more queued: run the partially filled lanes */
+        for (job = nxt_mb_flush(&w->mgr); job != NULL;
+             job = nxt_mb_get_completed(&w->mgr)) {
+            nxt_async_complete((nxt_async_req *) job);
+        }
+
+        if (LOAD_SC(&w->pending) > 0 || ++idle < NXT_ASYNC_SPIN) {
+            sched_yield();
+            continue;
+        }
+
+        if (LOAD_SC(&w->as->stop))
+            break;
+
+        STORE_SC(&w->sleeping, 1);
+        if (LOAD_SC(&w->pending) == 0 && !LOAD_SC(&w->as->stop))
+            nxt_async_sem_wait(&w->sem);
+        STORE_SC(&w->sleeping, 0);
+        idle = 0;
+    }
+
+    return NULL;
+}
+
+nxt_async *nxt_async_new(int workers)
+{
+    nxt_async *as;
+    long cpus;
+    int i;
+
+    if (workers <= 0) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (cpus > 0) ? (int) cpus : 1;
+    }
+
+    as = (nxt_async *) calloc(1, sizeof(nxt_async));
+    if (as == NULL)
+        return NULL;
+
+    as->w = (nxt_async_worker *) calloc((size_t) workers,
+                                        sizeof(nxt_async_worker));
+    if (as->w == NULL) {
+        free(as);
+        return NULL;
+    }
+
+    for (i = 0; i < workers; i++) {
+        as->w[i].as = as;
+        nxt_async_queue_init(&as->w[i].queue);
+        nxt_mb_init(&as->w[i].mgr, NXT128_BLOCK_SIZE, 0);
+        sem_init(&as->w[i].sem, 0, 0);
+
+        if (pthread_create(&as->w[i].tid, NULL, nxt_async_thread,
+                           &as->w[i]) != 0) {
+            sem_destroy(&as->w[i].sem);
+            nxt_async_free(as);
+            return NULL;
+        }
+        as->workers++;
+    }
+
+    return as;
+}
+
+/* The workers finish the queued requests before stopping */
+void nxt_async_free(nxt_async *as)
+{
+    int i;
+
+    if (as == NULL)
+        return;
+
+    STORE_SC(&as->stop, 1);
+    for (i = 0; i < as->workers; i++) {
+        sem_post(&as->w[i].sem);
+    }
+
+    for (i = 0; i < as->workers; i++) {
+        pthread_join(as->w[i].tid, NULL);
+        sem_destroy(&as->w[i].sem);
+    }
+
+    free(as->w);
+    free(as);
+}
+
+nxt_async_producer *nxt_async_producer_new(nxt_async *as, size_t depth)
+{
+    nxt_async_producer *p;
+    size_t size = 1;
+
+    while (size < depth) {
+        size <<= 1;
+    }
+
+    p = (nxt_async_producer *) calloc(1, sizeof(nxt_async_producer));
+    if (p == NULL)
+        return NULL;
+
+    p->ring = (nxt_async_req **) calloc(size, sizeof(nxt_async_req *));
+    if (p->ring == NULL) {
+        free(p);
+        return NULL;
+    }
+
+    p->mask = size - 1;
+    p->depth = depth;
+    p->worker = &as->w[__atomic_fetch_add(&as->next, 1, __ATOMIC_RELAXED)
+                       % (unsigned int) as->workers];
+    sem_init(&p->sem, 0, 0);
+
+    return p;
+}
+
+/* Must not have requests in flight */
+void nxt_async_producer_free(nxt_async_producer *p)
+{
+    if (p == NULL)
+        return;
+
+    while (LOAD_SC(&p->refs) != 0) {
+        sched_yield();
+    }
+
+    sem_destroy(&p->sem);
+    free(p->ring);
+    free(p);
+}
+
+int nxt_async_submit(nxt_async_producer *p, nxt_async_req *req)
+{
+    nxt_async_worker *w = p->worker;
+
+    if (p->inflight >= p->depth)
+        return -1;
+
+    p->inflight++;
+    req->producer = p;
+    nxt_async_push(&w->queue, req);
+
+    ADD_SC(&w->pending, 1);
+    if (LOAD_SC(&w->sleeping) && XCHG_SC(&w->sleeping, 0))
+        sem_post(&w->sem);
+
+    return 0;
+}
+
+nxt_async_req *nxt_async_poll(nxt_async_producer *p)
+{
+    nxt_async_req *req;
+
+    if (p->head == LOAD_ACQ(&p->tail))
+        return NULL;
+
+    req = p->ring[p->head & p->mask];
+    p->head++;
+    p->inflight--;
+
+    return req;
+}
+
+nxt_async_req *nxt_async_wait(nxt_async_producer *p)
+{
+    nxt_async_req *req;
+    int i;
+
+    for (;;) {
+        for (i = 0; i < NXT_ASYNC_SPIN; i++) {
+            req = nxt_async_poll(p);
+            if (req != NULL || p->inflight == 0)
+                return req;
+            sched_yield();
+        }
+
+        STORE_SC(&p->waiting, 1);
+        if (LOAD_SC(&p->tail) == p->head)
+            nxt_async_sem_wait(&p->sem);
+        STORE_SC(&p->waiting, 0);
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_ASYNC_H
+#define NXT_ASYNC_H
+
+#include "nxt128.h"
+#include "nxt_mb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Asynchronous NXT128 encryption served by dedicated worker threads.
+ *
+ * Each producer (a thread posting requests) is bound to one worker.
+ * Requests go through the lock-free multi-producer single-consumer
+ * queue of the worker and come back through the single-producer
+ * single-consumer completion ring of the producer, so neither side ever
+ * takes a mutex. A worker takes whatever is queued and runs the small
+ * requests together through a multi-buffer manager, the requests of at
+ * least NXT_ASYNC_DIRECT_SIZE bytes directly with the multi-block mode
+ * functions. Idle workers and producers in nxt_async_wait() sleep on a
+ * semaphore.
+ *
+ * The request is a nxt_mb_job (NXT128 only) owned by the caller until
+ * it is returned by nxt_async_poll() or nxt_async_wait(). A producer
+ * has at most depth requests in flight: nxt_async_submit() returns -1
+ * instead of blocking beyond that. The functions on a producer must be
+ * called from one thread at a time.
+ */
+#define NXT_ASYNC_DIRECT_SIZE 256
+
+typedef struct nxt_async nxt_async;
+typedef struct nxt_async_producer nxt_async_producer;
+
+typedef struct nxt_async_req {
+    nxt_mb_job job;
+    nxt_async_producer *producer;
+    struct nxt_async_req *next;
+} nxt_async_req;
+
+/* workers is the number of worker threads, 0 for one per online CPU */
+nxt_async *nxt_async_new(int workers);
+void nxt_async_free(nxt_async *as);
+
+nxt_async_producer *nxt_async_producer_new(nxt_async *as, size_t depth);
+void nxt_async_producer_free(nxt_async_producer *p);
+
+int nxt_async_submit(nxt_async_producer *p, nxt_async_req *req);
+nxt_async_req *nxt_async_poll(nxt_async_producer *p);
+nxt_async_req *nxt_async_wait(nxt_async_producer *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_ASYNC_H */
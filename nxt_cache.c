@@ -0,0 +1,570 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#define _POSIX_C_SOURCE 200112L
+#define _FILE_OFFSET_BITS 64
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "nxt_common.h"
+#include "nxt_cache.h"
+
+typedef struct nxt_cache_entry {
+    size_t chunk;
+    size_t len;
+    uint8 *data;
+    struct nxt_cache_entry *hnext;
+    struct nxt_cache_entry *prev;   /* LRU list, most recent first */
+    struct nxt_cache_entry *next;   /* also the free list */
+} nxt_cache_entry;
+
+/* The padding keeps the locks of two shards in different cache lines */
+typedef struct {
+    pthread_mutex_t lock;
+    nxt_cache_entry **table;
+    size_t buckets;
+    nxt_cache_entry *head;
+    nxt_cache_entry *tail;
+    nxt_cache_entry *free;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long prefetched;
+    uint8 pad[64];
+} nxt_cache_shard;
+
+/*
+ * The prefetch thread takes the chunks [pf_first, pf_first + pf_count)
+ * and clears pf_count; pf_end is the end of the highest range asked for
+ * so that a scan does not ask twice for the same chunks.
+ */
+struct nxt_cache {
+    nxt_chunked *c;
+    nxt_cache_shard *shards;
+    int nshards;
+    nxt_cache_entry *entries;
+    uint8 *pool;
+    size_t pool_size;
+    int locked;
+    size_t prefetch;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t tid;
+    int thread;
+    int stop;
+    int running;
+    off_t next_off;
+    size_t pf_first;
+    size_t pf_count;
+    size_t pf_end;
+};
+
+#define NXT_CACHE_SHARD(cache, chunk) \
+    (&(cache)->shards[(chunk) % (size_t) (cache)->nshards])
+#define NXT_CACHE_BUCKET(cache, shard, chunk) \
+    (&(shard)->table[(chunk) / (size_t) (cache)->nshards % (shard)->buckets])
+
+static size_t nxt_cache_len(const nxt_chunked *c, size_t chunk)
+{
+    off_t pos = (off_t) chunk * (off_t) c->chunk_size;
+
+    if (pos >= c->length)
+        return 0;
+
+    return c->length - pos < (off_t) c->chunk_size ? (size_t) (c->length - pos)
+                                                    : c->chunk_size;
+}
+
+static nxt_cache_entry *nxt_cache_lookup(nxt_cache *cache,
+                                         nxt_cache_shard *s, size_t chunk)
+{
+    nxt_cache_entry *e;
+
+    for (e = *NXT_CACHE_BUCKET(cache, s, chunk); e != NULL; e = e->hnext) {
+        if (e->chunk == chunk)
+            return e;
+    }
+
+    return NULL;
+}
+
+static void nxt_cache_lru_remove(nxt_cache_shard *s, nxt_cache_entry *e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        s->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        s->tail = e->prev;
+}
+
+static void nxt_cache_unlink(nxt_cache *cache, nxt_cache_shard *s,
+                             nxt_cache_entry *e)
+{
+    nxt_cache_entry **p;
+
+    for (p = NXT_CACHE_BUCKET(cache, s, e->chunk); *p != e;
+         p = &(*p)->hnext)
+        ;
+    *p = e->hnext;
+    nxt_cache_lru_remove(s, e);
+}
+
+static void nxt_cache_push(nxt_cache_shard *s, nxt_cache_entry *e)
+{
+    e->prev = NULL;
+    e->next = s->head;
+    if (s->head != NULL)
+        s->head->prev = e;
+    else
+        s->tail = e;
+    s->head = e;
+}
+
+/* Copies n bytes of a cached chunk from offset from, 0 if not cached */
+static int nxt_cache_get(nxt_cache *cache, size_t chunk, uint8 *dst,
+                         size_t from, size_t n)
+{
+    nxt_cache_shard *s = NXT_CACHE_SHARD(cache, chunk);
+    nxt_cache_entry *e;
+
+    pthread_mutex_lock(&s->lock);
+    e = nxt_cache_lookup(cache, s, chunk);
+    if (e != NULL) {
+        memcpy(dst, e->data + from, n);
+        if (e != s->head) {
+            nxt_cache_lru_remove(s, e);
+            nxt_cache_push(s, e);
+        }
+        s->hits++;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return e != NULL;
+}
+
+static int nxt_cache_has(nxt_cache *cache, size_t chunk)
+{
+    nxt_cache_shard *s = NXT_CACHE_SHARD(cache, chunk);
+    int found;
+
+    pthread_mutex_lock(&s->lock);
+    found = nxt_cache_lookup(cache, s, chunk) != NULL;
+    pthread_mutex_unlock(&s->lock);
+
+    return found;
+}
+
+static void nxt_cache_put(nxt_cache *cache, size_t chunk, const uint8 *data,
+                          size_t len, int prefetched)
+{
+    nxt_cache_shard *s = NXT_CACHE_SHARD(cache, chunk);
+    nxt_cache_entry **b;
+    nxt_cache_entry *e;
+
+    pthread_mutex_lock(&s->lock);
+    if (prefetched)
+        s->prefetched++;
+    else
+        s->misses++;
+
+    /* Decrypted meanwhile by another thread */
+    if (nxt_cache_lookup(cache, s, chunk) != NULL) {
+        pthread_mutex_unlock(&s->lock);
+        return;
+    }
+
+    e = s->free;
+    if (e != NULL) {
+        s->free = e->next;
+    } else {
+        e = s->tail;
+        nxt_cache_unlink(cache, s, e);
+        nxt_wipe(e->data, e->len);
+    }
+
+    e->chunk = chunk;
+    e->len = len;
+    memcpy(e->data, data, len);
+    b = NXT_CACHE_BUCKET(cache, s, chunk);
+    e->hnext = *b;
+    *b = e;
+    nxt_cache_push(s, e);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void nxt_cache_drop(nxt_cache *cache, size_t chunk)
+{
+    nxt_cache_shard *s = NXT_CACHE_SHARD(cache, chunk);
+    nxt_cache_entry *e;
+
+    pthread_mutex_lock(&s->lock);
+    e = nxt_cache_lookup(cache, s, chunk);
+    if (e != NULL) {
+        nxt_cache_unlink(cache, s, e);
+        nxt_wipe(e->data, e->len);
+        e->next = s->free;
+        s->free = e;
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* End of the run of chunks missing from first, up to end */
+static size_t nxt_cache_run(nxt_cache *cache, size_t first, size_t end)
+{
+    size_t j;
+
+    for (j = first + 1; j < end && j - first < NXT_CHUNKED_BATCH; j++) {
+        if (nxt_cache_has(cache, j))
+            break;
+    }
+
+    return j;
+}
+
+/*
+ * Decrypts the chunks of [first, end) with one call through tmp and
+ * caches them. When buf is not NULL the bytes of [off, off + len) in
+ * these chunks are copied to it.
+ */
+static int nxt_cache_fill(nxt_cache *cache, size_t first, size_t end,
+                          uint8 *tmp, int prefetched, uint8 *buf,
+                          off_t off, size_t len)
+{
+    nxt_chunked *c = cache->c;
+    size_t cs = c->chunk_size;
+    size_t k, n;
+    off_t pos, from, to;
+
+    for (k = first, n = 0; k < end; k++) {
+        n += nxt_cache_len(c, k);
+    }
+    if (nxt_chunked_pread(c, tmp, n, (off_t) first * (off_t) cs)
+        != (ssize_t) n)
+        return -1;
+
+    for (k = first; k < end; k++) {
+        nxt_cache_put(cache, k, tmp + (k - first) * cs, nxt_cache_len(c, k),
+                      prefetched);
+        if (buf == NULL)
+            continue;
+        pos = (off_t) k * (off_t) cs;
+        from = pos < off ? off : pos;
+        to = pos + (off_t) cs < off + (off_t) len ? pos + (off_t) cs
+                                                  : off + (off_t) len;
+        memcpy(buf + (from - off), tmp + (from - (off_t) first * (off_t) cs),
+               (size_t) (to - from));
+    }
+    nxt_wipe(tmp, n);
+
+    return 0;
+}
+
+static void *nxt_cache_prefetch(void *arg)
+{
+    nxt_cache *cache = (nxt_cache *) arg;
+    size_t first, end, i, j;
+    uint8 *tmp;
+
+    tmp = (uint8 *) malloc(NXT_CHUNKED_BATCH * cache->c->chunk_size);
+
+    pthread_mutex_lock(&cache->lock);
+    for (;;) {
+        while (!cache->stop && cache->pf_count == 0)
+            pthread_cond_wait(&cache->cond, &cache->lock);
+        if (cache->stop)
+            break;
+
+        first = cache->pf_first;
+        end = first + cache->pf_count;
+        cache->pf_count = 0;
+        cache->running = 1;
+        pthread_mutex_unlock(&cache->lock);
+
+        /* An error is seen again by the read of the chunk */
+        for (i = first; i < end && tmp != NULL; i = j) {
+            if (nxt_cache_has(cache, i)) {
+                j = i + 1;
+                continue;
+            }
+            j = nxt_cache_run(cache, i, end);
+            if (nxt_cache_fill(cache, i, j, tmp, 1, NULL, 0, 0) != 0)
+                break;
+        }
+
+        pthread_mutex_lock(&cache->lock);
+        cache->running = 0;
+        pthread_cond_broadcast(&cache->cond);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    free(tmp);
+
+    return NULL;
+}
+
+nxt_cache *nxt_cache_new(nxt_chunked *c, size_t max_bytes, int shards,
+                         size_t prefetch)
+{
+    nxt_cache *cache;
+    nxt_cache_shard *s;
+    size_t entries, per, i;
+    int k;
+
+    assert(shards >= 1);
+
+    entries = max_bytes / c->chunk_size;
+    if (entries == 0)
+        entries = 1;
+    if ((size_t) shards > entries)
+        shards = (int) entries;
+
+    cache = (nxt_cache *) calloc(1, sizeof(nxt_cache));
+    if (cache == NULL)
+        return NULL;
+
+    cache->c = c;
+    cache->nshards = shards;
+    cache->prefetch = prefetch;
+    cache->pool_size = entries * c->chunk_size;
+    cache->shards = (nxt_cache_shard *) calloc((size_t) shards,
+                                               sizeof(nxt_cache_shard));
+    cache->entries = (nxt_cache_entry *) calloc(entries,
+                                                sizeof(nxt_cache_entry));
+    cache->pool = (uint8 *) calloc(entries, c->chunk_size);
+    if (cache->shards == NULL || cache->entries == NULL ||
+        cache->pool == NULL)
+        goto err;
+
+    /* Keeps the plaintext out of the swap when the limits allow it */
+    cache->locked = mlock(cache->pool, cache->pool_size) == 0;
+
+    for (k = 0; k < shards; k++) {
+        s = &cache->shards[k];
+        per = entries / (size_t) shards
+              + ((size_t) k < entries % (size_t) shards);
+        s->buckets = per;
+        s->table = (nxt_cache_entry **) calloc(per,
+                                               sizeof(nxt_cache_entry *));
+        if (s->table == NULL)
+            goto err;
+        pthread_mutex_init(&s->lock, NULL);
+    }
+
+    for (i = 0; i < entries; i++) {
+        s = &cache->shards[i % (size_t) shards];
+        cache->entries[i].data = cache->pool + i * c->chunk_size;
+        cache->entries[i].next = s->free;
+        s->free = &cache->entries[i];
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->cond, NULL);
+    cache->next_off = -1;
+    if (prefetch > 0) {
+        cache->thread = pthread_create(&cache->tid, NULL, nxt_cache_prefetch,
+                                       cache) == 0;
+    }
+
+    return cache;
+
+err:
+    if (cache->shards != NULL) {
+        for (k = 0; k < shards; k++) {
+            if (cache->shards[k].table != NULL) {
+                pthread_mutex_destroy(&cache->shards[k].lock);
+                free(cache->shards[k].table);
+            }
+        }
+    }
+    free(cache->shards);
+    free(cache->entries);
+    free(cache->pool);
+    free(cache);
+    return NULL;
+}
+
+void nxt_cache_free(nxt_cache *cache)
+{
+    int k;
+
+    if (cache->thread) {
+        pthread_mutex_lock(&cache->lock);
+        cache->stop = 1;
+        pthread_cond_broadcast(&cache->cond);
+        pthread_mutex_unlock(&cache->lock);
+        pthread_join(cache->tid, NULL);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    pthread_cond_destroy(&cache->cond);
+
+    for (k = 0; k < cache->nshards; k++) {
+        pthread_mutex_destroy(&cache->shards[k].lock);
+        free(cache->shards[k].table);
+    }
+
+    nxt_wipe(cache->pool, cache->pool_size);
+    if (cache->locked)
+        munlock(cache->pool, cache->pool_size);
+    free(cache->pool);
+    free(cache->entries);
+    free(cache->shards);
+    free(cache);
+}
+
+ssize_t nxt_cache_pread(nxt_cache *cache, void *buf, size_t len, off_t off)
+{
+    nxt_chunked *c = cache->c;
+    size_t cs = c->chunk_size;
+    size_t first, last, i, j, chunks;
+    uint8 *tmp = NULL;
+    off_t pos, from, to;
+    int err = 0;
+
+    if (off < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (off >= c->length || len == 0)
+        return 0;
+    if ((off_t) len > c->length - off)
+        len = (size_t) (c->length - off);
+
+    first = (size_t) (off / (off_t) cs);
+    last = (size_t) ((off + (off_t) len - 1) / (off_t) cs);
+
+    for (i = first; i <= last && err == 0; i++) {
+        pos = (off_t) i * (off_t) cs;
+        from = pos < off ? off : pos;
+        to = pos + (off_t) cs < off + (off_t) len ? pos + (off_t) cs
+                                                  : off + (off_t) len;
+        if (nxt_cache_get(cache, i, (uint8 *) buf + (from - off),
+                          (size_t) (from - pos), (size_t) (to - from)))
+            continue;
+
+        /* The misses are decrypted by runs, up to the next hit */
+        if (tmp == NULL) {
+            tmp = (uint8 *) malloc(NXT_CHUNKED_BATCH * cs);
+            if (tmp == NULL) {
+                err = ENOMEM;
+                break;
+            }
+        }
+        j = nxt_cache_run(cache, i, last + 1);
+        if (nxt_cache_fill(cache, i, j, tmp, 0, (uint8 *) buf, off,
+                           len) != 0)
+            err = errno;
+        i = j - 1;
+    }
+    free(tmp);
+
+    if (err != 0) {
+        nxt_wipe(buf, len);
+        errno = err;
+        return -1;
+    }
+
+    /* A sequential scan asks for the next chunks */
+    chunks = (size_t) ((c->length + (off_t) cs - 1) / (off_t) cs);
+    pthread_mutex_lock(&cache->lock);
+    if (cache->thread && off == cache->next_off) {
+        i = last + 1 > cache->pf_end ? last + 1 : cache->pf_end;
+        cache->pf_end = last + 1 + cache->prefetch < chunks ?
+                        last + 1 + cache->prefetch : chunks;
+        if (i < cache->pf_end) {
+            cache->pf_first = i;
+            cache->pf_count = cache->pf_end - i;
+            pthread_cond_broadcast(&cache->cond);
+        }
+    }
+    cache->next_off = off + (off_t) len;
+    pthread_mutex_unlock(&cache->lock);
+
+    return (ssize_t) len;
+}
+
+ssize_t nxt_cache_pwrite(nxt_cache *cache, const void *buf, size_t len,
+                         off_t off)
+{
+    nxt_chunked *c = cache->c;
+    size_t cs = c->chunk_size;
+    size_t first, last, i;
+    ssize_t ret;
+
+    /* The prefetch must not decrypt chunks while they change */
+    pthread_mutex_lock(&cache->lock);
+    cache->pf_count = 0;
+    cache->pf_end = 0;
+    while (cache->running)
+        pthread_cond_wait(&cache->cond, &cache->lock);
+    pthread_mutex_unlock(&cache->lock);
+
+    if (len == 0 || off < 0)
+        return nxt_chunked_pwrite(c, buf, len, off);
+
+    first = (size_t) (off / (off_t) cs);
+    last = (size_t) ((off + (off_t) len - 1) / (off_t) cs);
+    if (off + (off_t) len > c->length &&
+        (size_t) (c->length / (off_t) cs) < first)
+        first = (size_t) (c->length / (off_t) cs);
+
+    ret = nxt_chunked_pwrite(c, buf, len, off);
+
+    /* Also after a failure, which may have changed some chunks */
+    for (i = first; i <= last; i++) {
+        nxt_cache_drop(cache, i);
+    }
+
+    return ret;
+}
+
+void nxt_cache_stats(nxt_cache *cache, unsigned long *hits,
+                     unsigned long *misses, unsigned long *prefetched)
+{
+    nxt_cache_shard *s;
+    int k;
+
+    *hits = *misses = *prefetched = 0;
+    for (k = 0; k < cache->nshards; k++) {
+        s = &cache->shards[k];
+        pthread_mutex_lock(&s->lock);
+        *hits += s->hits;
+        *misses += s->misses;
+        *prefetched += s->prefetched;
+        pthread_mutex_unlock(&s->lock);
+    }
+}
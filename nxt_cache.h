@@ -0,0 +1,80 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_CACHE_H
+#define NXT_CACHE_H
+
+#include <sys/types.h>
+
+#include "nxt_chunked.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Read-through cache of decrypted chunks over a nxt_chunked container.
+ *
+ * The pool of max_bytes / chunk_size entries is allocated once, locked
+ * in memory when the system allows it and split between shards by
+ * chunk number; each shard has its own lock, hash table and LRU list,
+ * and evicts its least recently used entry when it is full. The
+ * plaintext of an entry is wiped when it is evicted, invalidated and
+ * when the cache is freed. The missing chunks of a read are decrypted
+ * together with one nxt_chunked_pread() per run.
+ *
+ * A read which starts where the previous one ended is taken as part of
+ * a sequential scan: a prefetch thread then decrypts the next prefetch
+ * chunks in the background, unless prefetch is 0.
+ *
+ * nxt_cache_pread() behaves as nxt_chunked_pread() and may be called
+ * from several threads; nxt_cache_pwrite() writes through the container
+ * and drops the chunks it changes, and must not run concurrently with
+ * other calls. The container must not be written to without the cache.
+ */
+typedef struct nxt_cache nxt_cache;
+
+nxt_cache *nxt_cache_new(nxt_chunked *c, size_t max_bytes, int shards,
+                         size_t prefetch);
+void nxt_cache_free(nxt_cache *cache);
+ssize_t nxt_cache_pread(nxt_cache *cache, void *buf, size_t len, off_t off);
+ssize_t nxt_cache_pwrite(nxt_cache *cache, const void *buf, size_t len,
+                         off_t off);
+
+/* Chunks found in the cache, decrypted for a read and by the prefetch */
+void nxt_cache_stats(nxt_cache *cache, unsigned long *hits,
+                     unsigned long *misses, unsigned long *prefetched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_CACHE_H */
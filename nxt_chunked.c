@@ -0,0 +1,516 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nxt_common.h"
+#include "nxt_drbg.h"
+#include "nxt_chunked.h"
+
+#define NXT_CHUNKED_VERSION 1
+#define NXT_CHUNKED_AD_SIZE 32
+
+/* Chunk operations run by nxt_engine_for() */
+typedef struct {
+    nxt_chunked *c;
+    size_t first;               /* number of the first chunk */
+    uint8 *recs;                /* records of the batch */
+    uint8 *plain;               /* one chunk of plaintext per record */
+    uint8 *buf;                 /* caller's buffer */
+    const uint8 *src;
+    off_t off;                  /* range of the caller's buffer */
+    off_t end;
+    off_t old_length;
+    int *status;
+} nxt_chunked_job;
+
+static void nxt_chunked_put64(uint8 *p, off_t v)
+{
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        p[i] = (uint8) (v & 0xff);
+        v >>= 8;
+    }
+}
+
+static off_t nxt_chunked_get64(const uint8 *p)
+{
+    off_t v = 0;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+static size_t nxt_chunked_rec_size(const nxt_chunked *c)
+{
+    return NXT_CHUNKED_OVERHEAD + c->chunk_size;
+}
+
+static off_t nxt_chunked_rec_off(const nxt_chunked *c, size_t chunk)
+{
+    return NXT_CHUNKED_HEADER_SIZE
+           + (off_t) chunk * (off_t) nxt_chunked_rec_size(c);
+}
+
+/* Data length of a chunk in a container of length bytes */
+static size_t nxt_chunked_len(const nxt_chunked *c, size_t chunk,
+                              off_t length)
+{
+    off_t pos = (off_t) chunk * (off_t) c->chunk_size;
+
+    if (pos >= length)
+        return 0;
+
+    return length - pos < (off_t) c->chunk_size ? (size_t) (length - pos)
+                                                 : c->chunk_size;
+}
+
+static void nxt_chunked_ad(const nxt_chunked *c, size_t chunk, size_t len,
+                           uint8 *ad)
+{
+    memcpy(ad, c->id, 16);
+    nxt_chunked_put64(ad + 16, (off_t) chunk);
+    UNPACK32((uint32) len, ad + 24);
+    memset(ad + 28, 0, 4);
+}
+
+static int nxt_chunked_pread_full(int fd, uint8 *p, size_t len, off_t off)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = pread(fd, p, len, off);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = EIO;
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+        off += n;
+    }
+
+    return 0;
+}
+
+static int nxt_chunked_pwrite_full(int fd, const uint8 *p, size_t len,
+                                   off_t off)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = pwrite(fd, p, len, off);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+        off += n;
+    }
+
+    return 0;
+}
+
+static void nxt_chunked_for(nxt_chunked *c, size_t count,
+                            void (*fn)(void *arg, size_t i), void *arg)
+{
+    size_t i;
+
+    if (c->eng != NULL) {
+        nxt_engine_for(c->eng, count, fn, arg);
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        fn(arg, i);
+    }
+}
+
+static void nxt_chunked_header(nxt_chunked *c, uint8 *hdr)
+{
+    memset(hdr, 0, NXT_CHUNKED_HEADER_SIZE);
+    memcpy(hdr, "NXTC", 4);
+    hdr[4] = NXT_CHUNKED_VERSION;
+    UNPACK32((uint32) c->chunk_size, hdr + 8);
+    nxt_chunked_put64(hdr + 16, c->length);
+    memcpy(hdr + 24, c->id, 16);
+    nxt128_eax_encrypt(&c->eax, c->id, 16, hdr, 48, NULL, NULL, 0,
+                       hdr + 48);
+}
+
+static int nxt_chunked_write_header(nxt_chunked *c)
+{
+    uint8 hdr[NXT_CHUNKED_HEADER_SIZE];
+
+    nxt_chunked_header(c, hdr);
+
+    return nxt_chunked_pwrite_full(c->fd, hdr, sizeof(hdr), 0);
+}
+
+int nxt_chunked_create(nxt_chunked *c, int fd, const uint8 *key,
+                       uint16 key_len, size_t chunk_size, nxt_engine *eng)
+{
+    assert(chunk_size > 0 && chunk_size <= NXT_CHUNKED_MAX_CHUNK);
+
+    c->fd = fd;
+    c->eng = eng;
+    c->chunk_size = chunk_size;
+    c->length = 0;
+    nxt128_eax_init(&c->eax, key, key_len);
+
+    if (nxt_rand_bytes(c->id, sizeof(c->id)) != 0) {
+        errno = EIO;
+        return -1;
+    }
+
+    if (ftruncate(fd, NXT_CHUNKED_HEADER_SIZE) != 0)
+        return -1;
+
+    return nxt_chunked_write_header(c);
+}
+
+int nxt_chunked_open(nxt_chunked *c, int fd, const uint8 *key,
+                     uint16 key_len, nxt_engine *eng)
+{
+    uint8 hdr[NXT_CHUNKED_HEADER_SIZE];
+    uint32 chunk_size;
+
+    c->fd = fd;
+    c->eng = eng;
+    nxt128_eax_init(&c->eax, key, key_len);
+
+    if (nxt_chunked_pread_full(fd, hdr, sizeof(hdr), 0) != 0)
+        return -1;
+
+    if (memcmp(hdr, "NXTC", 4) != 0 || hdr[4] != NXT_CHUNKED_VERSION) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memcpy(c->id, hdr + 24, 16);
+    if (nxt128_eax_decrypt(&c->eax, c->id, 16, hdr, 48, NULL, NULL, 0,
+                           hdr + 48) != 0) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    PACK32(hdr + 8, &chunk_size);
+    c->chunk_size = chunk_size;
+    if (c->chunk_size == 0 || c->chunk_size > NXT_CHUNKED_MAX_CHUNK ||
+        (hdr[16] & 0x80) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    c->length = nxt_chunked_get64(hdr + 16);
+
+    return 0;
+}
+
+static void nxt_chunked_read_chunk(void *arg, size_t k)
+{
+    nxt_chunked_job *job = (nxt_chunked_job *) arg;
+    nxt_chunked *c = job->c;
+    uint8 ad[NXT_CHUNKED_AD_SIZE];
+    size_t chunk = job->first + k;
+    size_t len = nxt_chunked_len(c, chunk, c->length);
+    const uint8 *rec = job->recs + k * nxt_chunked_rec_size(c);
+    off_t pos = (off_t) chunk * (off_t) c->chunk_size;
+    off_t from, to;
+    uint8 *dst;
+    int whole;
+
+    /* Whole chunks are decrypted in place in the caller's buffer */
+    from = pos < job->off ? job->off : pos;
+    to = pos + (off_t) len > job->end ? job->end : pos + (off_t) len;
+    whole = from == pos && to == pos + (off_t) len;
+    dst = whole ? job->buf + (pos - job->off)
+                : job->plain + k * c->chunk_size;
+
+    nxt_chunked_ad(c, chunk, len, ad);
+    job->status[k] = nxt128_eax_decrypt(&c->eax, rec,
+                                        NXT_CHUNKED_NONCE_SIZE, ad,
+                                        sizeof(ad), rec + NXT_CHUNKED_OVERHEAD,
+                                        dst, len,
+                                        rec + NXT_CHUNKED_NONCE_SIZE);
+
+    if (!whole) {
+        memcpy(job->buf + (from - job->off), dst + (from - pos),
+               (size_t) (to - from));
+        nxt_wipe(dst, len);
+    }
+}
+
+ssize_t nxt_chunked_pread(nxt_chunked *c, void *buf, size_t len, off_t off)
+{
+    nxt_chunked_job job;
+    int status[NXT_CHUNKED_BATCH];
+    size_t first, last, n, k, size;
+    int err = 0;
+
+    if (off < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (off >= c->length || len == 0)
+        return 0;
+    if ((off_t) len > c->length - off)
+        len = (size_t) (c->length - off);
+
+    first = (size_t) (off / (off_t) c->chunk_size);
+    last = (size_t) ((off + (off_t) len - 1) / (off_t) c->chunk_size);
+    n = last - first + 1 < NXT_CHUNKED_BATCH ? last - first + 1
+                                             : NXT_CHUNKED_BATCH;
+
+    job.c = c;
+    job.buf = (uint8 *) buf;
+    job.off = off;
+    job.end = off + (off_t) len;
+    job.status = status;
+    job.recs = (uint8 *) malloc(n * nxt_chunked_rec_size(c));
+    job.plain = (uint8 *) malloc(n * c->chunk_size);
+    if (job.recs == NULL || job.plain == NULL) {
+        free(job.recs);
+        free(job.plain);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (job.first = first; job.first <= last && err == 0; job.first += n) {
+        if (last - job.first + 1 < n)
+            n = last - job.first + 1;
+
+        size = (n - 1) * nxt_chunked_rec_size(c) + NXT_CHUNKED_OVERHEAD
+               + nxt_chunked_len(c, job.first + n - 1, c->length);
+        if (nxt_chunked_pread_full(c->fd, job.recs, size,
+                                   nxt_chunked_rec_off(c, job.first)) != 0) {
+            err = errno;
+            break;
+        }
+
+        nxt_chunked_for(c, n, nxt_chunked_read_chunk, &job);
+
+        for (k = 0; k < n; k++) {
+            if (status[k] != 0)
+                err = EBADMSG;
+        }
+    }
+
+    free(job.recs);
+    free(job.plain);
+
+    if (err != 0) {
+        nxt_wipe(buf, len);
+        errno = err;
+        return -1;
+    }
+
+    return (ssize_t) len;
+}
+
+static void nxt_chunked_write_chunk(void *arg, size_t k)
+{
+    nxt_chunked_job *job = (nxt_chunked_job *) arg;
+    nxt_chunked *c = job->c;
+    uint8 ad[NXT_CHUNKED_AD_SIZE];
+    size_t chunk = job->first + k;
+    size_t len = nxt_chunked_len(c, chunk, c->length);
+    size_t old_len = nxt_chunked_len(c, chunk, job->old_length);
+    uint8 *rec = job->recs + k * nxt_chunked_rec_size(c);
+    off_t pos = (off_t) chunk * (off_t) c->chunk_size;
+    uint8 nonce[NXT_CHUNKED_NONCE_SIZE];
+    const uint8 *src;
+    uint8 *plain;
+    off_t from, to;
+
+    job->status[k] = 0;
+
+    from = pos < job->off ? job->off : pos;
+    to = pos + (off_t) len > job->end ? job->end : pos + (off_t) len;
+    if (from == pos && to == pos + (off_t) len) {
+        src = job->src + (pos - job->off);
+    } else {
+        /* Partial chunk: old content or zeros, then the new bytes */
+        plain = job->plain + k * c->chunk_size;
+        memset(plain, 0, len);
+        if (old_len > 0) {
+            /* The old record goes where the new nonce was drawn */
+            memcpy(nonce, rec, NXT_CHUNKED_NONCE_SIZE);
+            nxt_chunked_ad(c, chunk, old_len, ad);
+            if (nxt_chunked_pread_full(c->fd, rec,
+                                       NXT_CHUNKED_OVERHEAD + old_len,
+                                       nxt_chunked_rec_off(c, chunk)) != 0) {
+                job->status[k] = errno;
+                return;
+            }
+            if (nxt128_eax_decrypt(&c->eax, rec, NXT_CHUNKED_NONCE_SIZE,
+                                   ad, sizeof(ad),
+                                   rec + NXT_CHUNKED_OVERHEAD, plain,
+                                   old_len,
+                                   rec + NXT_CHUNKED_NONCE_SIZE) != 0) {
+                job->status[k] = EBADMSG;
+                return;
+            }
+            memcpy(rec, nonce, NXT_CHUNKED_NONCE_SIZE);
+        }
+        if (from < to) {
+            memcpy(plain + (from - pos), job->src + (from - job->off),
+                   (size_t) (to - from));
+        }
+        src = plain;
+    }
+
+    /* The new nonce was drawn by the caller */
+    nxt_chunked_ad(c, chunk, len, ad);
+    nxt128_eax_encrypt(&c->eax, rec, NXT_CHUNKED_NONCE_SIZE, ad,
+                       sizeof(ad), src, rec + NXT_CHUNKED_OVERHEAD, len,
+                       rec + NXT_CHUNKED_NONCE_SIZE);
+}
+
+ssize_t nxt_chunked_pwrite(nxt_chunked *c, const void *buf, size_t len,
+                           off_t off)
+{
+    nxt_chunked_job job;
+    int status[NXT_CHUNKED_BATCH];
+    size_t first, last, n, k, size, batch;
+    off_t old_length;
+    int err = 0;
+
+    if (off < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (len == 0)
+        return 0;
+
+    old_length = c->length;
+    first = (size_t) (off / (off_t) c->chunk_size);
+    last = (size_t) ((off + (off_t) len - 1) / (off_t) c->chunk_size);
+
+    /* Growing: the old last chunk and the gap are rewritten too */
+    if (off + (off_t) len > old_length) {
+        c->length = off + (off_t) len;
+        if ((size_t) (old_length / (off_t) c->chunk_size) < first)
+            first = (size_t) (old_length / (off_t) c->chunk_size);
+    }
+
+    n = last - first + 1 < NXT_CHUNKED_BATCH ? last - first + 1
+                                             : NXT_CHUNKED_BATCH;
+    batch = n;
+
+    job.c = c;
+    job.src = (const uint8 *) buf;
+    job.off = off;
+    job.end = off + (off_t) len;
+    job.old_length = old_length;
+    job.status = status;
+    job.recs = (uint8 *) malloc(n * nxt_chunked_rec_size(c));
+    job.plain = (uint8 *) malloc(n * c->chunk_size);
+    if (job.recs == NULL || job.plain == NULL) {
+        free(job.recs);
+        free(job.plain);
+        c->length = old_length;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (job.first = first; job.first <= last && err == 0; job.first += n) {
+        if (last - job.first + 1 < n)
+            n = last - job.first + 1;
+
+        for (k = 0; k < n && err == 0; k++) {
+            if (nxt_rand_bytes(job.recs + k * nxt_chunked_rec_size(c),
+                               NXT_CHUNKED_NONCE_SIZE) != 0)
+                err = EIO;
+        }
+        if (err != 0)
+            break;
+
+        nxt_chunked_for(c, n, nxt_chunked_write_chunk, &job);
+
+        for (k = 0; k < n; k++) {
+            if (status[k] != 0)
+                err = status[k];
+        }
+        if (err != 0)
+            break;
+
+        size = (n - 1) * nxt_chunked_rec_size(c) + NXT_CHUNKED_OVERHEAD
+               + nxt_chunked_len(c, job.first + n - 1, c->length);
+        if (nxt_chunked_pwrite_full(c->fd, job.recs, size,
+                                    nxt_chunked_rec_off(c, job.first)) != 0)
+            err = errno;
+    }
+
+    nxt_wipe(job.plain, batch * c->chunk_size);
+    free(job.recs);
+    free(job.plain);
+
+    /* The header is updated once the records are in place */
+    if (err == 0 && c->length != old_length &&
+        nxt_chunked_write_header(c) != 0)
+        err = errno;
+
+    if (err != 0) {
+        c->length = old_length;
+        errno = err;
+        return -1;
+    }
+
+    return (ssize_t) len;
+}
+
+off_t nxt_chunked_size(const nxt_chunked *c)
+{
+    return c->length;
+}
+
+void nxt_chunked_close(nxt_chunked *c)
+{
+    nxt_wipe(c, sizeof(nxt_chunked));
+}
@@ -0,0 +1,116 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_CHUNKED_H
+#define NXT_CHUNKED_H
+
+#include <sys/types.h>
+
+#include "nxt128.h"
+#include "nxt_modes.h"
+#include "nxt_engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Seekable encrypted container. The data is split in chunks of
+ * chunk_size bytes, each one sealed with NXT128-EAX under its own
+ * random nonce, so that any byte range is read or written by going
+ * through the chunks it touches only.
+ *
+ * The file starts with a NXT_CHUNKED_HEADER_SIZE byte header, numbers
+ * big-endian:
+ *
+ *    0  "NXTC"
+ *    4  version 1 and three zero bytes
+ *    8  32-bit chunk size
+ *   12  zero
+ *   16  64-bit data length
+ *   24  file id, 16 random bytes
+ *   40  zero
+ *   48  EAX tag of bytes 0 to 47, with the file id as nonce
+ *
+ * followed by one record per chunk: the 16-byte nonce, the EAX tag and
+ * the ciphertext. All the records but the last one hold chunk_size
+ * bytes of data, so the header is the index: the record of chunk i is
+ * at NXT_CHUNKED_HEADER_SIZE + i * (NXT_CHUNKED_OVERHEAD + chunk_size).
+ * The EAX header data of a chunk is the file id, the 64-bit chunk
+ * number and the 32-bit data length of the chunk: a record cannot be
+ * moved to another position or container, nor cut without changing the
+ * length in the header, which its tag prevents. A record replaced by an
+ * older version of itself is not detected.
+ *
+ * The records of a request are decrypted or encrypted in parallel with
+ * nxt_engine_for() when an engine is given, and are read or written
+ * with one system call per NXT_CHUNKED_BATCH chunks. A write rewrites
+ * the chunks it touches with new nonces, the partial ones after
+ * decrypting them, and fills a gap after the end with zeros.
+ *
+ * The functions return -1 and set errno on failure: EBADMSG when a tag
+ * is wrong (the output is then cleared), EINVAL for a file which is not
+ * a container, EIO when it is shorter than its header says. A failed
+ * write may leave the chunks it touches unreadable. Reads may run
+ * concurrently, writes must be serialized with any other call. The file
+ * offsets are off_t and need _FILE_OFFSET_BITS=64 on 32-bit systems.
+ */
+#define NXT_CHUNKED_HEADER_SIZE 64
+#define NXT_CHUNKED_NONCE_SIZE  16
+#define NXT_CHUNKED_OVERHEAD    (NXT_CHUNKED_NONCE_SIZE + NXT128_EAX_TAG_SIZE)
+#define NXT_CHUNKED_CHUNK_SIZE  (64 * 1024)
+#define NXT_CHUNKED_MAX_CHUNK   (16 * 1024 * 1024)
+#define NXT_CHUNKED_BATCH       64
+
+typedef struct {
+    int fd;
+    nxt128_eax_ctx eax;
+    nxt_engine *eng;
+    uint8 id[16];
+    size_t chunk_size;
+    off_t length;
+} nxt_chunked;
+
+int nxt_chunked_create(nxt_chunked *c, int fd, const uint8 *key,
+                       uint16 key_len, size_t chunk_size, nxt_engine *eng);
+int nxt_chunked_open(nxt_chunked *c, int fd, const uint8 *key,
+                     uint16 key_len, nxt_engine *eng);
+ssize_t nxt_chunked_pread(nxt_chunked *c, void *buf, size_t len, off_t off);
+ssize_t nxt_chunked_pwrite(nxt_chunked *c, const void *buf, size_t len,
+                           off_t off);
+off_t nxt_chunked_size(const nxt_chunked *c);
+void nxt_chunked_close(nxt_chunked *c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_CHUNKED_H */
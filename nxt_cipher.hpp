@@ -0,0 +1,600 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_CIPHER_HPP
+#define NXT_CIPHER_HPP
+
+/*
+ * Header-only C++20 interface to NXT64 and NXT128 with the number of
+ * rounds as a template parameter:
+ *
+ *     nxt::cipher<nxt::block128> c(key);        16 rounds
+ *     nxt::cipher<nxt::block64, 12> d(key);
+ *
+ *     c.encrypt(in, out);                       any number of blocks
+ *     d.decrypt_block(in, out);
+ *
+ * Every round count from 2 to 255 gets its own fully unrolled kernel,
+ * the round key offsets being constants, where nxt64.c and nxt128.c
+ * only unroll 12 and 16 rounds and fix the count at library build time.
+ * The S-box tables are computed at compile time from the S-box and
+ * alpha, the same way as nxt64_init_tables() and nxt128_init_tables(),
+ * so this header neither needs the library nor its initialization.
+ * Nothing is allocated: the round keys live in the object, which clears
+ * them on destruction.
+ *
+ * The ciphertexts are the ones of the C functions built with the same
+ * number of rounds. encrypt() and decrypt() take a whole number of
+ * blocks and may work in place; like the multi-block C functions they
+ * interleave two blocks at a time.
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <span>
+#include <utility>
+
+#include "nxt64.h"
+#include "nxt128.h"
+
+#ifndef NXT_FORCE_INLINE
+#if defined(__GNUC__)
+#define NXT_FORCE_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define NXT_FORCE_INLINE __forceinline
+#else
+#define NXT_FORCE_INLINE inline
+#endif
+#endif
+
+namespace nxt {
+
+struct block64 {
+    static constexpr std::size_t block_size = NXT64_BLOCK_SIZE;
+    static constexpr std::size_t words = 2;
+};
+
+struct block128 {
+    static constexpr std::size_t block_size = NXT128_BLOCK_SIZE;
+    static constexpr std::size_t words = 4;
+};
+
+namespace detail {
+
+inline constexpr uint8 sbox[256] = {
+    0x5d, 0xde, 0x00, 0xb7, 0xd3, 0xca, 0x3c, 0x0d, 0xc3, 0xf8, 0xcb, 0x8d,
+    0x76, 0x89, 0xaa, 0x12, 0x88, 0x22, 0x4f, 0xdb, 0x6d, 0x47, 0xe4, 0x4c,
+    0x78, 0x9a, 0x49, 0x93, 0xc4, 0xc0, 0x86, 0x13, 0xa9, 0x20, 0x53, 0x1c,
+    0x4e, 0xcf, 0x35, 0x39, 0xb4, 0xa1, 0x54, 0x64, 0x03, 0xc7, 0x85, 0x5c,
+    0x5b, 0xcd, 0xd8, 0x72, 0x96, 0x42, 0xb8, 0xe1, 0xa2, 0x60, 0xef, 0xbd,
+    0x02, 0xaf, 0x8c, 0x73, 0x7c, 0x7f, 0x5e, 0xf9, 0x65, 0xe6, 0xeb, 0xad,
+    0x5a, 0xa5, 0x79, 0x8e, 0x15, 0x30, 0xec, 0xa4, 0xc2, 0x3e, 0xe0, 0x74,
+    0x51, 0xfb, 0x2d, 0x6e, 0x94, 0x4d, 0x55, 0x34, 0xae, 0x52, 0x7e, 0x9d,
+    0x4a, 0xf7, 0x80, 0xf0, 0xd0, 0x90, 0xa7, 0xe8, 0x9f, 0x50, 0xd5, 0xd1,
+    0x98, 0xcc, 0xa0, 0x17, 0xf4, 0xb6, 0xc1, 0x28, 0x5f, 0x26, 0x01, 0xab,
+    0x25, 0x38, 0x82, 0x7d, 0x48, 0xfc, 0x1b, 0xce, 0x3f, 0x6b, 0xe2, 0x67,
+    0x66, 0x43, 0x59, 0x19, 0x84, 0x3d, 0xf5, 0x2f, 0xc9, 0xbc, 0xd9, 0x95,
+    0x29, 0x41, 0xda, 0x1a, 0xb0, 0xe9, 0x69, 0xd2, 0x7b, 0xd7, 0x11, 0x9b,
+    0x33, 0x8a, 0x23, 0x09, 0xd4, 0x71, 0x44, 0x68, 0x6f, 0xf2, 0x0e, 0xdf,
+    0x87, 0xdc, 0x83, 0x18, 0x6a, 0xee, 0x99, 0x81, 0x62, 0x36, 0x2e, 0x7a,
+    0xfe, 0x45, 0x9c, 0x75, 0x91, 0x0c, 0x0f, 0xe7, 0xf6, 0x14, 0x63, 0x1d,
+    0x0b, 0x8b, 0xb3, 0xf3, 0xb2, 0x3b, 0x08, 0x4b, 0x10, 0xa6, 0x32, 0xb9,
+    0xa8, 0x92, 0xf1, 0x56, 0xdd, 0x21, 0xbf, 0x04, 0xbe, 0xd6, 0xfd, 0x77,
+    0xea, 0x3a, 0xc8, 0x8f, 0x57, 0x1e, 0xfa, 0x2b, 0x58, 0xc5, 0x27, 0xac,
+    0xe3, 0xed, 0x97, 0xbb, 0x46, 0x05, 0x40, 0x31, 0xe5, 0x37, 0x2c, 0x9e,
+    0x0a, 0xb1, 0xb5, 0x06, 0x6c, 0x1f, 0xa3, 0x2a, 0x70, 0xff, 0xba, 0x07,
+    0x24, 0x16, 0xc6, 0x61
+};
+
+inline constexpr uint8 pad[32] = {
+    0xb7, 0xe1, 0x51, 0x62, 0x8a, 0xed, 0x2a, 0x6a, 0xbf, 0x71, 0x58, 0x80,
+    0x9c, 0xf4, 0xf3, 0xc7, 0x62, 0xe7, 0x16, 0x0f, 0x38, 0xb4, 0xda, 0x56,
+    0xa7, 0x84, 0xd9, 0x04, 0x51, 0x90, 0xcf, 0xef
+};
+
+constexpr uint8 alpha_mul(uint8 x)
+{
+    return (x & 0x80) ? static_cast<uint8>((x << 1) ^ 0x1f9)
+                      : static_cast<uint8>(x << 1);
+}
+
+constexpr uint8 alpha_div(uint8 x)
+{
+    return (x & 0x01) ? static_cast<uint8>((x ^ 0x1f9) >> 1)
+                      : static_cast<uint8>(x >> 1);
+}
+
+/* Coefficients of the mu4 and mu8 matrices applied to an S-box output */
+enum coef : uint8 { c_s, c_m, c_mm, c_d, c_dd, c_ms, c_ds, c_dds };
+
+constexpr uint8 scale(uint8 c, uint8 s)
+{
+    switch (c) {
+    case c_m:
+        return alpha_mul(s);
+    case c_mm:
+        return alpha_mul(alpha_mul(s));
+    case c_d:
+        return alpha_div(s);
+    case c_dd:
+        return alpha_div(alpha_div(s));
+    case c_ms:
+        return alpha_mul(s) ^ s;
+    case c_ds:
+        return alpha_div(s) ^ s;
+    case c_dds:
+        return alpha_div(alpha_div(s) ^ s);
+    default:
+        return s;
+    }
+}
+
+/* Byte coefficients, most significant first, of each table entry */
+inline constexpr uint8 mu4_coef[4][4] = {
+    {c_s, c_s, c_ds, c_m}, {c_s, c_ds, c_m, c_s},
+    {c_s, c_m, c_s, c_ds}, {c_m, c_s, c_s, c_s}
+};
+
+/* Entries 2 * i and 2 * i + 1 of the tbsm*_128 tables */
+inline constexpr uint8 mu8_coef[8][8] = {
+    {c_s,   c_s,   c_ms,  c_dds, c_m,   c_mm,  c_d,   c_dd },
+    {c_s,   c_ms,  c_dds, c_m,   c_mm,  c_d,   c_dd,  c_s  },
+    {c_s,   c_dds, c_m,   c_mm,  c_d,   c_dd,  c_s,   c_ms },
+    {c_s,   c_m,   c_mm,  c_d,   c_dd,  c_s,   c_ms,  c_dds},
+    {c_s,   c_mm,  c_d,   c_dd,  c_s,   c_ms,  c_dds, c_m  },
+    {c_s,   c_d,   c_dd,  c_s,   c_ms,  c_dds, c_m,   c_mm },
+    {c_s,   c_dd,  c_s,   c_ms,  c_dds, c_m,   c_mm,  c_d  },
+    {c_ms,  c_s,   c_s,   c_s,   c_s,   c_s,   c_s,   c_s  }
+};
+
+struct tables {
+    uint32 sigma[4][256];
+    uint32 mu4[4][256];
+    uint32 mu8[8][512];
+};
+
+constexpr uint32 pack(const uint8 *c, uint8 s)
+{
+    return (static_cast<uint32>(scale(c[0], s)) << 24)
+           | (static_cast<uint32>(scale(c[1], s)) << 16)
+           | (static_cast<uint32>(scale(c[2], s)) << 8)
+           | static_cast<uint32>(scale(c[3], s));
+}
+
+constexpr tables make_tables()
+{
+    tables t = {};
+    int i, j;
+
+    for (i = 0; i < 256; i++) {
+        for (j = 0; j < 4; j++) {
+            t.sigma[j][i] = static_cast<uint32>(sbox[i]) << (24 - 8 * j);
+            t.mu4[j][i] = pack(mu4_coef[j], sbox[i]);
+        }
+        for (j = 0; j < 8; j++) {
+            t.mu8[j][2 * i] = pack(mu8_coef[j], sbox[i]);
+            t.mu8[j][2 * i + 1] = pack(mu8_coef[j] + 4, sbox[i]);
+        }
+    }
+
+    return t;
+}
+
+inline constexpr tables tab = make_tables();
+
+NXT_FORCE_INLINE uint32 load32(const uint8 *p)
+{
+    return (static_cast<uint32>(p[0]) << 24)
+           | (static_cast<uint32>(p[1]) << 16)
+           | (static_cast<uint32>(p[2]) << 8) | static_cast<uint32>(p[3]);
+}
+
+NXT_FORCE_INLINE void store32(uint32 x, uint8 *p)
+{
+    p[0] = static_cast<uint8>(x >> 24);
+    p[1] = static_cast<uint8>(x >> 16);
+    p[2] = static_cast<uint8>(x >> 8);
+    p[3] = static_cast<uint8>(x);
+}
+
+NXT_FORCE_INLINE uint32 sigma(uint32 x)
+{
+    return tab.sigma[0][x >> 24] ^ tab.sigma[1][(x >> 16) & 0xff]
+           ^ tab.sigma[2][(x >> 8) & 0xff] ^ tab.sigma[3][x & 0xff];
+}
+
+NXT_FORCE_INLINE uint32 sigma_mu4(uint32 x)
+{
+    return tab.mu4[0][x >> 24] ^ tab.mu4[1][(x >> 16) & 0xff]
+           ^ tab.mu4[2][(x >> 8) & 0xff] ^ tab.mu4[3][x & 0xff];
+}
+
+/* Half H of sigma(mu8(x || y)), H = 0 for the high word */
+template<std::size_t H>
+NXT_FORCE_INLINE uint32 sigma_mu8(uint32 x, uint32 y)
+{
+    return tab.mu8[0][((x >> 23) & 0x1fe) + H]
+           ^ tab.mu8[1][((x >> 15) & 0x1fe) + H]
+           ^ tab.mu8[2][((x >> 7) & 0x1fe) + H]
+           ^ tab.mu8[3][((x << 1) & 0x1fe) + H]
+           ^ tab.mu8[4][((y >> 23) & 0x1fe) + H]
+           ^ tab.mu8[5][((y >> 15) & 0x1fe) + H]
+           ^ tab.mu8[6][((y >> 7) & 0x1fe) + H]
+           ^ tab.mu8[7][((y << 1) & 0x1fe) + H];
+}
+
+template<bool Decrypt>
+NXT_FORCE_INLINE uint32 orthomorphism(uint32 x)
+{
+    if constexpr (Decrypt)
+        return (x << 16) ^ (x >> 16) ^ (x & 0xffff0000);
+    else
+        return (x << 16) ^ (x >> 16) ^ (x & 0x0000ffff);
+}
+
+/*
+ * One Lai-Massey round on the blocks I..., step by step so that their
+ * independent dependency chains are interleaved.
+ */
+template<bool Decrypt, bool Last, std::size_t N, std::size_t... I>
+NXT_FORCE_INLINE void round64(const uint32 *k, uint32 (&x)[N][2],
+                              std::index_sequence<I...>)
+{
+    uint32 f[N];
+
+    ((f[I] = x[I][0] ^ x[I][1] ^ k[0]), ...);
+    ((f[I] = k[1] ^ sigma_mu4(f[I])), ...);
+    ((f[I] = k[0] ^ sigma(f[I])), ...);
+    ((x[I][0] ^= f[I], x[I][1] ^= f[I]), ...);
+    if constexpr (!Last)
+        ((x[I][0] = orthomorphism<Decrypt>(x[I][0])), ...);
+}
+
+template<bool Decrypt, bool Last, std::size_t N, std::size_t... I>
+NXT_FORCE_INLINE void round128(const uint32 *k, uint32 (&x)[N][4],
+                               std::index_sequence<I...>)
+{
+    uint32 t0[N], t1[N], f0[N], f1[N];
+
+    ((t0[I] = x[I][0] ^ x[I][1] ^ k[0],
+      t1[I] = x[I][2] ^ x[I][3] ^ k[1]), ...);
+    ((f0[I] = k[2] ^ sigma_mu8<0>(t0[I], t1[I]),
+      f1[I] = k[3] ^ sigma_mu8<1>(t0[I], t1[I])), ...);
+    ((f0[I] = k[0] ^ sigma(f0[I]), f1[I] = k[1] ^ sigma(f1[I])), ...);
+    ((x[I][0] ^= f0[I], x[I][1] ^= f0[I],
+      x[I][2] ^= f1[I], x[I][3] ^= f1[I]), ...);
+    if constexpr (!Last)
+        ((x[I][0] = orthomorphism<Decrypt>(x[I][0]),
+          x[I][2] = orthomorphism<Decrypt>(x[I][2])), ...);
+}
+
+/* All the rounds R..., unrolled; decryption takes the round keys backwards */
+template<bool Decrypt, std::size_t W, std::size_t N, std::size_t... R>
+NXT_FORCE_INLINE void crypt_rounds(const uint32 *rk, uint32 (&x)[N][W],
+                                   std::index_sequence<R...>)
+{
+    constexpr std::size_t rounds = sizeof...(R);
+
+    if constexpr (W == 2)
+        (round64<Decrypt, R + 1 == rounds>(
+             rk + W * (Decrypt ? rounds - 1 - R : R), x,
+             std::make_index_sequence<N>()), ...);
+    else
+        (round128<Decrypt, R + 1 == rounds>(
+             rk + W * (Decrypt ? rounds - 1 - R : R), x,
+             std::make_index_sequence<N>()), ...);
+}
+
+template<std::size_t Rounds, bool Decrypt, std::size_t W, std::size_t N>
+NXT_FORCE_INLINE void crypt(const uint32 *rk, uint32 (&x)[N][W])
+{
+    crypt_rounds<Decrypt>(rk, x, std::make_index_sequence<Rounds>());
+}
+
+inline void wipe(void *p, std::size_t len)
+{
+    volatile uint8 *v = static_cast<volatile uint8 *>(p);
+
+    while (len--) {
+        *v++ = 0;
+    }
+}
+
+/*
+ * Key schedule
+ */
+template<std::size_t Rounds>
+inline uint32 lfsr_init()
+{
+    uint32 reg = 0x006a0000 | ((Rounds << 8) & 0x0000ff00)
+                 | (~Rounds & 0x000000ff);
+
+    if (reg & 0x1)
+        reg ^= 0x100001b;
+
+    return reg >> 1;
+}
+
+inline uint32 lfsr(uint32 &reg)
+{
+    reg <<= 1;
+    if (reg & 0x1000000)
+        reg ^= 0x100001b;
+
+    return reg;
+}
+
+/* P and M parts: padding and mixing of a key shorter than Ek bytes */
+template<std::size_t Ek>
+inline bool prepare_key(std::span<const uint8> key, uint8 (&mk)[Ek])
+{
+    uint8 pk[Ek];
+    std::size_t i;
+
+    if (key.size() == Ek) {
+        for (i = 0; i < Ek; i++) {
+            mk[i] = key[i];
+        }
+        return true;
+    }
+
+    for (i = 0; i < Ek; i++) {
+        pk[i] = i < key.size() ? key[i] : pad[i - key.size()];
+    }
+
+    mk[0] = pk[0] ^ static_cast<uint8>(0x76 + 0x6a);
+    mk[1] = pk[1] ^ static_cast<uint8>(mk[0] + 0x76);
+    for (i = 2; i < Ek; i++) {
+        mk[i] = pk[i] ^ static_cast<uint8>(mk[i - 1] + mk[i - 2]);
+    }
+
+    return false;
+}
+
+/* D-part: the key masked with the LFSR output, three bytes a clock */
+template<std::size_t Ek>
+inline void d_part(const uint8 (&mk)[Ek], uint32 &reg, uint32 (&d)[Ek / 4])
+{
+    uint8 dkey[Ek];
+    uint32 v = 0;
+    std::size_t i;
+
+    for (i = 0; i < Ek; i++) {
+        if (i % 3 == 0)
+            v = lfsr(reg);
+        dkey[i] = mk[i] ^ static_cast<uint8>(v >> (16 - 8 * (i % 3)));
+    }
+    for (i = 0; i < Ek / 4; i++) {
+        d[i] = load32(dkey + 4 * i);
+    }
+}
+
+/*
+ * Last step of the NL-parts: MIX64 sums the other words, MIX64H and
+ * MIX128 the words of the same parity in the other pairs. Then the
+ * padding words and, for a key of Ek bytes, the complement.
+ */
+template<std::size_t Ek>
+inline void nl_mix(const uint32 (&t)[Ek / 4], bool eq, uint32 (&u)[Ek / 4])
+{
+    uint32 all[2] = {0, 0};
+    std::size_t i;
+
+    for (i = 0; i < Ek / 4; i++) {
+        all[i & 1] ^= t[i];
+    }
+
+    for (i = 0; i < Ek / 4; i++) {
+        if constexpr (Ek == 16)
+            u[i] = all[0] ^ all[1] ^ t[i];
+        else
+            u[i] = all[i & 1] ^ t[i];
+        u[i] ^= load32(pad + 4 * i);
+        if (eq)
+            u[i] = ~u[i];
+    }
+}
+
+template<std::size_t Rounds, std::size_t Ek>
+inline void ks64(std::span<const uint8> key, uint32 *rk)
+{
+    uint8 mk[Ek];
+    uint32 d[Ek / 4], t[Ek / 4], u[Ek / 4];
+    uint32 x[1][2];
+    uint32 reg = lfsr_init<Rounds>();
+    bool eq = prepare_key<Ek>(key, mk);
+    std::size_t i, j;
+
+    for (i = 0; i < Rounds; i++) {
+        d_part<Ek>(mk, reg, d);
+        for (j = 0; j < Ek / 4; j++) {
+            t[j] = sigma_mu4(d[j]);
+        }
+        nl_mix<Ek>(t, eq, u);
+
+        if constexpr (Ek == 16) {
+            x[0][0] = sigma(u[0]) ^ sigma(u[2]);
+            x[0][1] = sigma(u[1]) ^ sigma(u[3]);
+            crypt<2, false>(d, x);
+        } else {
+            x[0][0] = sigma(u[0]) ^ sigma(u[1]) ^ sigma(u[4]) ^ sigma(u[5]);
+            x[0][1] = sigma(u[2]) ^ sigma(u[3]) ^ sigma(u[6]) ^ sigma(u[7]);
+            crypt<4, false>(d, x);
+        }
+
+        rk[2 * i] = x[0][0];
+        rk[2 * i + 1] = x[0][1];
+    }
+
+    wipe(mk, sizeof(mk));
+    wipe(d, sizeof(d));
+}
+
+template<std::size_t Rounds>
+inline void ks128(std::span<const uint8> key, uint32 *rk)
+{
+    uint8 mk[32];
+    uint32 d[8], t[8], u[8];
+    uint32 x[1][4];
+    uint32 reg = lfsr_init<Rounds>();
+    bool eq = prepare_key<32>(key, mk);
+    std::size_t i, j;
+
+    for (i = 0; i < Rounds; i++) {
+        d_part<32>(mk, reg, d);
+        for (j = 0; j < 8; j += 2) {
+            t[j] = sigma_mu8<0>(d[j], d[j + 1]);
+            t[j + 1] = sigma_mu8<1>(d[j], d[j + 1]);
+        }
+        nl_mix<32>(t, eq, u);
+
+        for (j = 0; j < 4; j++) {
+            x[0][j] = sigma(u[j]) ^ sigma(u[j + 4]);
+        }
+        crypt<2, false>(d, x);
+
+        for (j = 0; j < 4; j++) {
+            rk[4 * i + j] = x[0][j];
+        }
+    }
+
+    wipe(mk, sizeof(mk));
+    wipe(d, sizeof(d));
+}
+
+} /* namespace detail */
+
+template<class Variant, std::size_t Rounds = 16>
+class cipher {
+    static_assert(Rounds > 1 && Rounds < 256,
+                  "the number of rounds must be between 2 and 255");
+
+public:
+    typedef Variant variant;
+
+    static constexpr std::size_t block_size = Variant::block_size;
+    static constexpr std::size_t rounds = Rounds;
+    static constexpr std::size_t max_key_size = 32;
+
+    cipher() = default;
+
+    explicit cipher(std::span<const uint8> key)
+    {
+        set_key(key);
+    }
+
+    ~cipher()
+    {
+        detail::wipe(rk_, sizeof(rk_));
+    }
+
+    /* Key of 0 to 32 bytes */
+    void set_key(std::span<const uint8> key)
+    {
+        assert(key.size() <= max_key_size);
+
+        if constexpr (words == 4)
+            detail::ks128<Rounds>(key, rk_);
+        else if (key.size() <= 16)
+            detail::ks64<Rounds, 16>(key, rk_);
+        else
+            detail::ks64<Rounds, 32>(key, rk_);
+    }
+
+    void encrypt_block(const uint8 *in, uint8 *out) const
+    {
+        process<false, 1>(in, out);
+    }
+
+    void decrypt_block(const uint8 *in, uint8 *out) const
+    {
+        process<true, 1>(in, out);
+    }
+
+    void encrypt(std::span<const uint8> in, std::span<uint8> out) const
+    {
+        process_blocks<false>(in, out);
+    }
+
+    void decrypt(std::span<const uint8> in, std::span<uint8> out) const
+    {
+        process_blocks<true>(in, out);
+    }
+
+private:
+    static constexpr std::size_t words = Variant::words;
+
+    template<bool Decrypt, std::size_t N>
+    NXT_FORCE_INLINE void process(const uint8 *in, uint8 *out) const
+    {
+        uint32 x[N][words];
+        std::size_t n, i;
+
+        for (n = 0; n < N; n++) {
+            for (i = 0; i < words; i++) {
+                x[n][i] = detail::load32(in + block_size * n + 4 * i);
+            }
+        }
+
+        detail::crypt<Rounds, Decrypt>(rk_, x);
+
+        for (n = 0; n < N; n++) {
+            for (i = 0; i < words; i++) {
+                detail::store32(x[n][i], out + block_size * n + 4 * i);
+            }
+        }
+    }
+
+    template<bool Decrypt>
+    void process_blocks(std::span<const uint8> in, std::span<uint8> out) const
+    {
+        const uint8 *p = in.data();
+        uint8 *q = out.data();
+        std::size_t blocks = in.size() / block_size;
+
+        assert(in.size() == out.size() && in.size() % block_size == 0);
+
+        for (; blocks >= 2; blocks -= 2) {
+            process<Decrypt, 2>(p, q);
+            p += 2 * block_size;
+            q += 2 * block_size;
+        }
+
+        if (blocks)
+            process<Decrypt, 1>(p, q);
+    }
+
+    uint32 rk_[Rounds * words] = {};
+};
+
+} /* namespace nxt */
+
+#endif /* !NXT_CIPHER_HPP */
@@ -113,3 +113,16 @@ void nxt_m(const uint8 *pkey, uint8 *mkey, uint16 ek)
     }
 }
 
+
+/*
+ * Clears sensitive data. The volatile access keeps the compiler from
+ * removing the stores to a buffer which is not read anymore.
+ */
+void nxt_wipe(void *p, size_t len)
+{
+    volatile uint8 *v = (volatile uint8 *) p;
+
+    while (len--) {
+        *v++ = 0;
+    }
+}
@@ -33,6 +33,7 @@
 #define NXT_COMMON_H
 
 #include <limits.h>
+#include <stddef.h>
 
 /*
  * These macros define which algorithms are used. You can comment one of the
@@ -44,21 +45,27 @@
 /*
  * For each algorithm you can set or unset two macros. If set the macros
  * NXT64_UNROLL_LOOPS and NXT128_UNROLL_LOOPS unroll the main
- * encryption / decryption loop. You need a sufficient L1 code cache size
+ * encryption / decryption loop of 12 or 16 rounds (other numbers of
+ * rounds keep the loop). You need a sufficient L1 code cache size
  * (especially for NXT128) to benefit from this option otherwise you will
  * suffer some penalty.
  *
  * This implementation of IDEA NXT uses tables in order to increase the
- * processing speed. By default the tables are precalculated. With
- * NXT64_INIT_TABLES and NXT128_INIT_TABLES macros the precalculated tables
- * will not be included in the object file and you will need to init the
- * tables with the nxt64_init_tables() and nxt128_init_tables() functions
- * before using the corresponding variant of IDEA NXT.
+ * processing speed. By default the tables are precalculated: they are
+ * generated from the S-box by nxt_gentables ("make tables" rewrites
+ * nxt64_tables.h and nxt128_tables.h). With NXT64_INIT_TABLES and
+ * NXT128_INIT_TABLES macros the precalculated tables will not be included
+ * in the object file (about 7 KB for NXT64 and 19 KB for NXT128) and are
+ * filled on the first use of the corresponding variant of IDEA NXT. The
+ * first use is made thread-safe with pthread_once(); on platforms without
+ * threads, define NXT_NO_THREADS. Calling nxt64_init_tables() and
+ * nxt128_init_tables() beforehand is still possible but not needed.
  *
  * The default number of rounds for both NXT64 and NXT128 is 16. You can
  * change the number of rounds by modifying the macros NXT64_TOTAL_ROUNDS
- * and NXT128_TOTAL_ROUNDS in nxt64.h and nxt128.h. The values can only be
- * changed at IDEA NXT compile time.
+ * and NXT128_TOTAL_ROUNDS in nxt64.h and nxt128.h, or by defining them on
+ * the compiler command line. The values can only be changed at IDEA NXT
+ * compile time.
  */
 
 /*
@@ -142,10 +149,10 @@ do {                          \
 #define NXT_IO(x) \
 (x << 16) ^ (x >> 16) ^ (x & 0xffff0000);
 
-const uint8 pad[32];
+extern const uint8 pad[32];
 
 #if ((defined NXT64_INIT_TABLES) || (defined NXT128_INIT_TABLES))
-const uint8 sbox[256];
+extern const uint8 sbox[256];
 
 uint8 nxt_alpha_mul(uint8 x);
 uint8 nxt_alpha_div(uint8 x);
@@ -153,6 +160,7 @@ uint8 nxt_alpha_div(uint8 x);
 
 void nxt_p(const uint8 *key, uint8 l, uint8 *pkey, uint16 ek);
 void nxt_m(const uint8 *pkey, uint8 *mkey, uint16 ek);
+void nxt_wipe(void *p, size_t len);
 
 #endif /* !NXT_COMMON_H */
 
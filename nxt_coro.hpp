@@ -0,0 +1,486 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_CORO_HPP
+#define NXT_CORO_HPP
+
+/*
+ * C++20 coroutine interface over the asynchronous API of nxt_async.h:
+ *
+ *     nxt::crypto_executor crypto(as, loop);
+ *
+ *     nxt::task<> handle(nxt::crypto_executor &crypto, nxt128_ctx &ctx,
+ *                        std::span<uint8> record, nxt::block &ctr)
+ *     {
+ *         co_await nxt::encrypt_async(crypto, ctx, ctr, record);
+ *         ...
+ *     }
+ *
+ * The awaiting coroutine is suspended while a worker processes the
+ * request, together with the other outstanding ones, and is resumed
+ * through the post() member of the user executor (here loop) once
+ * crypto.poll() sees the completion. poll() is meant to be called from
+ * the event loop of the thread which owns the crypto_executor; the
+ * crypto_executor, its awaitables and poll() must stay on that thread.
+ *
+ * Nothing is allocated per operation: the request lives in the
+ * awaitable, which lives in the coroutine frame, and the frames of
+ * nxt::task coroutines come from per-thread free lists. Requests beyond
+ * the depth of the producer wait in an intrusive list until completions
+ * make room.
+ */
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <span>
+#include <utility>
+
+#include "nxt128.h"
+#include "nxt_async.h"
+
+namespace nxt {
+
+typedef std::array<uint8, NXT128_BLOCK_SIZE> block;
+
+namespace detail {
+
+/*
+ * Free lists of coroutine frames by power of two size class, from 128
+ * to 4096 bytes. Larger frames use the global allocator.
+ */
+class frame_pool {
+public:
+    static constexpr std::size_t min_shift = 7;
+    static constexpr std::size_t classes = 6;
+
+    static frame_pool &local()
+    {
+        thread_local frame_pool pool;
+        return pool;
+    }
+
+    void *allocate(std::size_t size)
+    {
+        std::size_t c = size_class(size);
+        node *n;
+
+        if (c == classes)
+            return ::operator new(size);
+
+        n = free_[c];
+        if (n == nullptr)
+            return ::operator new(std::size_t(1) << (c + min_shift));
+
+        free_[c] = n->next;
+        return n;
+    }
+
+    void deallocate(void *p, std::size_t size) noexcept
+    {
+        std::size_t c = size_class(size);
+        node *n = static_cast<node *>(p);
+
+        if (c == classes) {
+            ::operator delete(p);
+            return;
+        }
+
+        n->next = free_[c];
+        free_[c] = n;
+    }
+
+    ~frame_pool()
+    {
+        node *n;
+        std::size_t c;
+
+        for (c = 0; c < classes; c++) {
+            while ((n = free_[c]) != nullptr) {
+                free_[c] = n->next;
+                ::operator delete(n);
+            }
+        }
+    }
+
+private:
+    struct node {
+        node *next;
+    };
+
+    static std::size_t size_class(std::size_t size)
+    {
+        std::size_t c = 0;
+
+        while (c < classes && (std::size_t(1) << (c + min_shift)) < size) {
+            c++;
+        }
+        return c;
+    }
+
+    node *free_[classes] = {};
+};
+
+template <class T>
+struct task_result {
+    T value_;
+
+    template <class U>
+    void return_value(U &&v)
+    {
+        value_ = std::forward<U>(v);
+    }
+
+    T take()
+    {
+        return std::move(value_);
+    }
+};
+
+template <>
+struct task_result<void> {
+    void return_void() noexcept
+    {
+    }
+
+    void take()
+    {
+    }
+};
+
+} /* namespace detail */
+
+/*
+ * Lazily started coroutine. Awaiting a task runs it and resumes the
+ * awaiting coroutine when it completes; a top-level task is started
+ * with start() and owned by the task object.
+ */
+template <class T = void>
+class task {
+public:
+    struct promise_type : detail::task_result<T> {
+        std::coroutine_handle<> continuation_;
+        std::exception_ptr exception_;
+
+        static void *operator new(std::size_t size)
+        {
+            return detail::frame_pool::local().allocate(size);
+        }
+
+        static void operator delete(void *p, std::size_t size) noexcept
+        {
+            detail::frame_pool::local().deallocate(p, size);
+        }
+
+        task get_return_object() noexcept
+        {
+            return task(std::coroutine_handle<promise_type>::from_promise(
+                *this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        struct final_awaiter {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(
+                std::coroutine_handle<promise_type> h) noexcept
+            {
+                if (h.promise().continuation_)
+                    return h.promise().continuation_;
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        final_awaiter final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void unhandled_exception() noexcept
+        {
+            exception_ = std::current_exception();
+        }
+    };
+
+    task(task &&other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr))
+    {
+    }
+
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+
+    ~task()
+    {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    void start()
+    {
+        handle_.resume();
+    }
+
+    bool done() const noexcept
+    {
+        return handle_.done();
+    }
+
+    T result()
+    {
+        if (handle_.promise().exception_)
+            std::rethrow_exception(handle_.promise().exception_);
+        return handle_.promise().take();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        handle_.promise().continuation_ = h;
+        return handle_;
+    }
+
+    T await_resume()
+    {
+        return result();
+    }
+
+private:
+    explicit task(std::coroutine_handle<promise_type> h) noexcept
+        : handle_(h)
+    {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/* Executor which resumes the coroutines immediately, inside poll() */
+struct inline_executor {
+    void post(std::coroutine_handle<> h)
+    {
+        h.resume();
+    }
+};
+
+class crypto_op;
+
+class crypto_executor {
+public:
+    /* Executor is any type with a post(std::coroutine_handle<>) member */
+    template <class Executor>
+    crypto_executor(nxt_async *as, Executor &ex, std::size_t depth = 64)
+        : producer_(nxt_async_producer_new(as, depth)), executor_(&ex),
+          post_([](void *e, std::coroutine_handle<> h) {
+              static_cast<Executor *>(e)->post(h);
+          })
+    {
+        if (producer_ == nullptr)
+            throw std::bad_alloc();
+    }
+
+    crypto_executor(const crypto_executor &) = delete;
+    crypto_executor &operator=(const crypto_executor &) = delete;
+
+    /* Outstanding operations must be complete */
+    ~crypto_executor()
+    {
+        nxt_async_producer_free(producer_);
+    }
+
+    /* Posts the coroutines of the completed operations, returns their count */
+    inline std::size_t poll();
+
+    std::size_t outstanding() const noexcept
+    {
+        return outstanding_;
+    }
+
+private:
+    friend class crypto_op;
+
+    inline void submit(crypto_op *op);
+    inline void submit_waiting();
+
+    nxt_async_producer *producer_;
+    void *executor_;
+    void (*post_)(void *, std::coroutine_handle<>);
+    crypto_op *waiting_ = nullptr;
+    crypto_op *waiting_tail_ = nullptr;
+    std::size_t outstanding_ = 0;
+};
+
+/* Awaitable for one request, created by the *_async() functions */
+class crypto_op {
+public:
+    crypto_op(crypto_executor &ex, int op, nxt128_ctx &ctx, const uint8 *in,
+              uint8 *out, std::size_t len, uint8 *iv)
+        : ex_(ex), iv_(iv)
+    {
+        std::memset(&req_, 0, sizeof(req_));
+        req_.job.op = op;
+        req_.job.ctx = &ctx;
+        req_.job.in = in;
+        req_.job.out = out;
+        req_.job.len = len;
+        req_.job.user = this;
+        if (iv != nullptr)
+            std::memcpy(req_.job.iv, iv, NXT128_BLOCK_SIZE);
+    }
+
+    crypto_op(const crypto_op &) = delete;
+    crypto_op &operator=(const crypto_op &) = delete;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        handle_ = h;
+        ex_.submit(this);
+    }
+
+    /* Chaining value (counter or IV) written back */
+    void await_resume() noexcept
+    {
+        if (iv_ != nullptr)
+            std::memcpy(iv_, req_.job.iv, NXT128_BLOCK_SIZE);
+    }
+
+private:
+    friend class crypto_executor;
+
+    crypto_executor &ex_;
+    uint8 *iv_;
+    nxt_async_req req_;
+    std::coroutine_handle<> handle_;
+    crypto_op *next_ = nullptr;
+};
+
+void crypto_executor::submit(crypto_op *op)
+{
+    outstanding_++;
+
+    if (waiting_ == nullptr && nxt_async_submit(producer_, &op->req_) == 0)
+        return;
+
+    op->next_ = nullptr;
+    if (waiting_ == nullptr)
+        waiting_ = op;
+    else
+        waiting_tail_->next_ = op;
+    waiting_tail_ = op;
+}
+
+void crypto_executor::submit_waiting()
+{
+    while (waiting_ != nullptr
+           && nxt_async_submit(producer_, &waiting_->req_) == 0) {
+        waiting_ = waiting_->next_;
+    }
+}
+
+std::size_t crypto_executor::poll()
+{
+    nxt_async_req *req;
+    crypto_op *op;
+    std::size_t n = 0;
+
+    while ((req = nxt_async_poll(producer_)) != nullptr) {
+        op = static_cast<crypto_op *>(req->job.user);
+        outstanding_--;
+        n++;
+        submit_waiting();
+        post_(executor_, op->handle_);
+    }
+
+    return n;
+}
+
+/* CTR encryption or decryption in place, ctr is advanced */
+inline crypto_op encrypt_async(crypto_executor &ex, nxt128_ctx &ctx,
+                               block &ctr, std::span<uint8> data)
+{
+    return crypto_op(ex, NXT_MB_CTR, ctx, data.data(), data.data(),
+                     data.size(), ctr.data());
+}
+
+inline crypto_op decrypt_async(crypto_executor &ex, nxt128_ctx &ctx,
+                               block &ctr, std::span<uint8> data)
+{
+    return encrypt_async(ex, ctx, ctr, data);
+}
+
+/* CBC in place, the length is a multiple of the block size */
+inline crypto_op cbc_encrypt_async(crypto_executor &ex, nxt128_ctx &ctx,
+                                   block &iv, std::span<uint8> data)
+{
+    return crypto_op(ex, NXT_MB_CBC_ENCRYPT, ctx, data.data(), data.data(),
+                     data.size(), iv.data());
+}
+
+inline crypto_op cbc_decrypt_async(crypto_executor &ex, nxt128_ctx &ctx,
+                                   block &iv, std::span<uint8> data)
+{
+    return crypto_op(ex, NXT_MB_CBC_DECRYPT, ctx, data.data(), data.data(),
+                     data.size(), iv.data());
+}
+
+/* CMAC of data */
+inline crypto_op mac_async(crypto_executor &ex, nxt128_ctx &ctx,
+                           std::span<const uint8> data, block &tag)
+{
+    return crypto_op(ex, NXT_MB_CMAC, ctx, data.data(), tag.data(),
+                     data.size(), nullptr);
+}
+
+} /* namespace nxt */
+
+#endif /* !NXT_CORO_HPP */
@@ -0,0 +1,261 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nxt_common.h"
+#include "nxt_modes.h"
+#include "nxt_drbg.h"
+
+/*
+ * Derives a new key and counter from the current ones, optionally
+ * mixed with up to NXT_DRBG_SEED_SIZE bytes of seed material.
+ */
+static void nxt_drbg_update(nxt_drbg_ctx *ctx, const uint8 *data,
+                            size_t len)
+{
+    uint8 temp[NXT_DRBG_SEED_SIZE];
+    size_t i;
+
+    nxt128_ctr_keystream(&ctx->cipher, ctx->v, temp,
+                         NXT_DRBG_SEED_SIZE / NXT128_BLOCK_SIZE);
+
+    for (i = 0; i < len; i++) {
+        temp[i] ^= data[i];
+    }
+
+    nxt128_ks(&ctx->cipher, temp, 256);
+    memcpy(ctx->v, temp + 32, NXT128_BLOCK_SIZE);
+
+    nxt_wipe(temp, sizeof(temp));
+}
+
+static void nxt_drbg_absorb(nxt_drbg_ctx *ctx, const uint8 *seed,
+                            size_t seed_len)
+{
+    size_t n;
+
+    do {
+        n = (seed_len < NXT_DRBG_SEED_SIZE) ? seed_len : NXT_DRBG_SEED_SIZE;
+        nxt_drbg_update(ctx, seed, n);
+        seed += n;
+        seed_len -= n;
+    } while (seed_len > 0);
+
+    nxt_wipe(ctx->buf, sizeof(ctx->buf));
+    ctx->pos = NXT_DRBG_BUF_SIZE;
+    ctx->generated = 0;
+}
+
+void nxt_drbg_init(nxt_drbg_ctx *ctx, const uint8 *seed, size_t seed_len)
+{
+    uint8 zero[32];
+
+    memset(zero, 0, sizeof(zero));
+    nxt128_ks(&ctx->cipher, zero, 256);
+    memset(ctx->v, 0, NXT128_BLOCK_SIZE);
+
+    nxt_drbg_absorb(ctx, seed, seed_len);
+}
+
+void nxt_drbg_reseed(nxt_drbg_ctx *ctx, const uint8 *seed, size_t seed_len)
+{
+    nxt_drbg_absorb(ctx, seed, seed_len);
+}
+
+/*
+ * Fills out with NXT_DRBG_BUF_SIZE bytes and rekeys.
+ */
+static void nxt_drbg_run(nxt_drbg_ctx *ctx, uint8 *out)
+{
+    nxt128_ctr_keystream(&ctx->cipher, ctx->v, out, NXT_DRBG_BUF_BLOCKS);
+    nxt_drbg_update(ctx, NULL, 0);
+    ctx->generated += NXT_DRBG_BUF_SIZE;
+}
+
+void nxt_drbg_generate(nxt_drbg_ctx *ctx, uint8 *out, size_t len)
+{
+    size_t n;
+
+    while (len > 0) {
+        if (ctx->pos == NXT_DRBG_BUF_SIZE) {
+            /* Bulk requests bypass the buffer */
+            if (len >= NXT_DRBG_BUF_SIZE) {
+                nxt_drbg_run(ctx, out);
+                out += NXT_DRBG_BUF_SIZE;
+                len -= NXT_DRBG_BUF_SIZE;
+                continue;
+            }
+
+            nxt_drbg_run(ctx, ctx->buf);
+            ctx->pos = 0;
+        }
+
+        n = NXT_DRBG_BUF_SIZE - ctx->pos;
+        if (n > len)
+            n = len;
+
+        memcpy(out, ctx->buf + ctx->pos, n);
+        nxt_wipe(ctx->buf + ctx->pos, n);
+
+        ctx->pos += n;
+        out += n;
+        len -= n;
+    }
+}
+
+void nxt_drbg_wipe(nxt_drbg_ctx *ctx)
+{
+    nxt_wipe(ctx, sizeof(*ctx));
+}
+
+typedef struct {
+    nxt_drbg_ctx drbg;
+    unsigned long forks;
+} nxt_rand_state;
+
+static pthread_once_t nxt_rand_once = PTHREAD_ONCE_INIT;
+static pthread_key_t nxt_rand_key;
+static int nxt_rand_ready;
+
+/*
+ * Number of fork() calls seen by this process. A thread generator
+ * seeded before the last fork() is reseeded before its next use.
+ */
+static volatile unsigned long nxt_rand_forks;
+
+static void nxt_rand_atfork_child(void)
+{
+    nxt_rand_forks++;
+}
+
+static void nxt_rand_free(void *p)
+{
+    nxt_wipe(p, sizeof(nxt_rand_state));
+    free(p);
+}
+
+static void nxt_rand_setup(void)
+{
+    if (pthread_key_create(&nxt_rand_key, nxt_rand_free) != 0)
+        return;
+
+    if (pthread_atfork(NULL, NULL, nxt_rand_atfork_child) != 0)
+        return;
+
+    nxt_rand_ready = 1;
+}
+
+static int nxt_rand_entropy(uint8 *seed, size_t len)
+{
+    ssize_t n;
+    int fd;
+
+    do {
+        fd = open("/dev/urandom", O_RDONLY);
+    } while ((fd < 0) && (errno == EINTR));
+
+    if (fd < 0)
+        return -1;
+
+    while (len > 0) {
+        n = read(fd, seed, len);
+        if (n <= 0) {
+            if ((n < 0) && (errno == EINTR))
+                continue;
+            close(fd);
+            return -1;
+        }
+        seed += n;
+        len -= n;
+    }
+
+    close(fd);
+
+    return 0;
+}
+
+static int nxt_rand_seed(nxt_rand_state *st, int init)
+{
+    uint8 seed[NXT_DRBG_SEED_SIZE];
+
+    if (nxt_rand_entropy(seed, sizeof(seed)) != 0)
+        return -1;
+
+    st->forks = nxt_rand_forks;
+
+    if (init)
+        nxt_drbg_init(&st->drbg, seed, sizeof(seed));
+    else
+        nxt_drbg_reseed(&st->drbg, seed, sizeof(seed));
+
+    nxt_wipe(seed, sizeof(seed));
+
+    return 0;
+}
+
+int nxt_rand_bytes(uint8 *out, size_t len)
+{
+    nxt_rand_state *st;
+
+    if ((pthread_once(&nxt_rand_once, nxt_rand_setup) != 0)
+        || !nxt_rand_ready)
+        return -1;
+
+    st = (nxt_rand_state *) pthread_getspecific(nxt_rand_key);
+
+    if (st == NULL) {
+        st = (nxt_rand_state *) malloc(sizeof(*st));
+        if (st == NULL)
+            return -1;
+
+        if ((nxt_rand_seed(st, 1) != 0)
+            || (pthread_setspecific(nxt_rand_key, st) != 0)) {
+            nxt_rand_free(st);
+            return -1;
+        }
+    } else if ((st->forks != nxt_rand_forks)
+               || (st->drbg.generated >= NXT_DRBG_RESEED_INTERVAL)) {
+        if (nxt_rand_seed(st, 0) != 0)
+            return -1;
+    }
+
+    nxt_drbg_generate(&st->drbg, out, len);
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_DRBG_H
+#define NXT_DRBG_H
+
+#include "nxt128.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Deterministic random bit generator based on NXT128-CTR with a 256-bit
+ * key, in the style of NIST CTR_DRBG. The keystream is produced
+ * NXT_DRBG_BUF_BLOCKS blocks at a time with the multi-block function,
+ * and the key and counter are replaced after each such run so that the
+ * output already produced cannot be recomputed from the state. The
+ * output only depends on the seeds, not on the size of the requests.
+ *
+ * nxt_rand_bytes() uses one generator per thread, seeded from
+ * /dev/urandom, reseeded every NXT_DRBG_RESEED_INTERVAL bytes and after
+ * a fork() in the child process.
+ */
+#define NXT_DRBG_SEED_SIZE       48
+#define NXT_DRBG_BUF_BLOCKS      256
+#define NXT_DRBG_BUF_SIZE        (NXT_DRBG_BUF_BLOCKS * NXT128_BLOCK_SIZE)
+#define NXT_DRBG_RESEED_INTERVAL (1UL << 30)
+
+typedef struct {
+    nxt128_ctx cipher;
+    uint8 v[NXT128_BLOCK_SIZE];
+    uint8 buf[NXT_DRBG_BUF_SIZE];
+    size_t pos;
+    unsigned long generated;
+} nxt_drbg_ctx;
+
+void nxt_drbg_init(nxt_drbg_ctx *ctx, const uint8 *seed, size_t seed_len);
+void nxt_drbg_reseed(nxt_drbg_ctx *ctx, const uint8 *seed, size_t seed_len);
+void nxt_drbg_generate(nxt_drbg_ctx *ctx, uint8 *out, size_t len);
+void nxt_drbg_wipe(nxt_drbg_ctx *ctx);
+
+int nxt_rand_bytes(uint8 *out, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_DRBG_H */
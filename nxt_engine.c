@@ -0,0 +1,1086 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifdef __linux__
+#define _GNU_SOURCE
+#else
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "nxt_common.h"
+#include "nxt_engine.h"
+
+typedef struct nxt_engine_task nxt_engine_task;
+
+/* The key schedules are indexed by node, see nxt_engine_replicate() */
+struct nxt_engine_task {
+    void (*fn)(nxt_engine *eng, nxt_engine_task *task, size_t chunk,
+               int worker);
+    size_t chunks;
+    size_t chunk_size;
+    size_t len;
+    nxt128_ctx *ctx[NXT_ENGINE_MAX_NODES];
+    nxt128_ctx *tweak_ctx[NXT_ENGINE_MAX_NODES];
+    nxt128_pmac_ctx *pmac[NXT_ENGINE_MAX_NODES];
+    const uint8 *in;
+    uint8 *out;
+    uint8 start[NXT128_BLOCK_SIZE];
+    uint8 *ivs;
+    size_t unit;
+    int decrypt;
+    void (*loop)(void *arg, size_t i);
+    void *arg;
+};
+
+/*
+ * Range [next, end) of chunks still to be processed by a worker. The
+ * padding keeps the locks of two workers in different cache lines.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+    uint8 sum[NXT128_BLOCK_SIZE];
+    nxt_engine *eng;
+    int id;
+    int node;
+    size_t local;
+    size_t remote;
+    uint8 pad[64];
+} nxt_engine_worker;
+
+#define NXT_ENGINE_NODE(eng, worker) ((eng)->workers[worker].node)
+
+/* Copies of the caller's key schedules in the memory of one node */
+typedef struct {
+    nxt128_ctx ctx;
+    nxt128_ctx tweak_ctx;
+    nxt128_pmac_ctx pmac;
+} nxt_engine_replica;
+
+/*
+ * With several nodes the chunks are processed in the order of order[],
+ * where the chunks of node n are in [node_start[n], node_end[n]).
+ */
+struct nxt_engine {
+    int threads;
+    pthread_t *tids;
+    nxt_engine_worker *workers;
+    pthread_mutex_t run_lock;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    unsigned long generation;
+    nxt_engine_task *task;
+    size_t pending;
+    int busy;
+    int stop;
+    int ready;
+    nxt_engine_topology topo;
+    nxt_engine_replica *replica[NXT_ENGINE_MAX_NODES];
+    int first[NXT_ENGINE_MAX_NODES];
+    size_t *order;
+    int *status;
+    size_t *order_buf;
+    size_t order_size;
+    size_t node_start[NXT_ENGINE_MAX_NODES];
+    size_t node_end[NXT_ENGINE_MAX_NODES];
+};
+
+static int nxt_engine_cpu_isset(const nxt_engine_topology *topo, int node,
+                                int cpu)
+{
+    return (topo->cpus[node][cpu / 8] >> (cpu % 8)) & 1;
+}
+
+static int nxt_engine_pinned(const nxt_engine_topology *topo, int node)
+{
+    int i;
+
+    for (i = 0; i < NXT_ENGINE_MAX_CPUS / 8; i++) {
+        if (topo->cpus[node][i] != 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Restricts the calling thread to the CPUs of its node */
+static void nxt_engine_pin(const nxt_engine_topology *topo, int node)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    int cpu;
+
+    if (!nxt_engine_pinned(topo, node))
+        return;
+
+    CPU_ZERO(&set);
+    for (cpu = 0; cpu < NXT_ENGINE_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+        if (nxt_engine_cpu_isset(topo, node, cpu))
+            CPU_SET(cpu, &set);
+    }
+    sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void) topo;
+    (void) node;
+#endif
+}
+
+/* Node of the calling thread, 0 when unknown */
+static int nxt_engine_current_node(const nxt_engine *eng)
+{
+#ifdef __linux__
+    int cpu;
+    int n;
+
+    if (eng->topo.nodes > 1 && eng->topo.node_of == NULL) {
+        cpu = sched_getcpu();
+        for (n = 0; cpu >= 0 && cpu < NXT_ENGINE_MAX_CPUS
+                    && n < eng->topo.nodes; n++) {
+            if (nxt_engine_cpu_isset(&eng->topo, n, cpu))
+                return n;
+        }
+    }
+#else
+    (void) eng;
+#endif
+
+    return 0;
+}
+
+/*
+ * Node of the first byte of each chunk, given by node_of for a
+ * simulated topology, else asked to the kernel. -1 when unknown.
+ */
+static void nxt_engine_nodes_of(const nxt_engine *eng, const uint8 *base,
+                                size_t chunk_size, size_t chunks,
+                                int *status)
+{
+    size_t i;
+#ifdef __linux__
+    void **pages;
+    long page;
+#endif
+
+    for (i = 0; i < chunks; i++) {
+        status[i] = -1;
+    }
+
+    if (eng->topo.node_of != NULL) {
+        for (i = 0; i < chunks; i++) {
+            status[i] = eng->topo.node_of(base + i * chunk_size,
+                                          eng->topo.arg);
+        }
+        return;
+    }
+
+#if defined(__linux__) && defined(SYS_move_pages)
+    page = sysconf(_SC_PAGESIZE);
+    pages = (void **) malloc(chunks * sizeof(void *));
+    if (page <= 0 || pages == NULL) {
+        free(pages);
+        return;
+    }
+
+    for (i = 0; i < chunks; i++) {
+        pages[i] = (void *) ((size_t) (base + i * chunk_size)
+                             & ~((size_t) page - 1));
+    }
+
+    /* Without a target node move_pages() only reports the nodes */
+    if (syscall(SYS_move_pages, 0, (unsigned long) chunks, pages, NULL,
+                status, 0) != 0) {
+        for (i = 0; i < chunks; i++) {
+            status[i] = -1;
+        }
+    }
+
+    free(pages);
+#endif
+}
+
+static int nxt_engine_pop(nxt_engine_worker *w, size_t *chunk)
+{
+    int ok = 0;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->next < w->end) {
+        *chunk = w->next++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return ok;
+}
+
+/*
+ * Moves the upper half of the largest range of the other workers to
+ * id, looking at the workers of the same node first.
+ */
+static int nxt_engine_steal(nxt_engine *eng, int id)
+{
+    nxt_engine_worker *w;
+    size_t best = 0;
+    size_t left;
+    size_t mid;
+    size_t end = 0;
+    int victim = -1;
+    int pass;
+    int t;
+
+    for (pass = 0; pass < 2 && victim < 0; pass++) {
+        for (t = 0; t < eng->threads; t++) {
+            w = &eng->workers[t];
+            if (t == id || (pass == 0 && w->node != eng->workers[id].node))
+                continue;
+            pthread_mutex_lock(&w->lock);
+            left = w->end - w->next;
+            pthread_mutex_unlock(&w->lock);
+            if (left > best) {
+                best = left;
+                victim = t;
+            }
+        }
+    }
+
+    if (victim < 0)
+        return 0;
+
+    w = &eng->workers[victim];
+    pthread_mutex_lock(&w->lock);
+    left = w->end - w->next;
+    mid = w->end - (left + 1) / 2;
+    end = w->end;
+    w->end = mid;
+    pthread_mutex_unlock(&w->lock);
+
+    w = &eng->workers[id];
+    pthread_mutex_lock(&w->lock);
+    w->next = mid;
+    w->end = end;
+    pthread_mutex_unlock(&w->lock);
+
+    /* The range may have been emptied meanwhile, the caller retries */
+    return 1;
+}
+
+static void nxt_engine_work(nxt_engine *eng, int id)
+{
+    nxt_engine_worker *w = &eng->workers[id];
+    nxt_engine_task *task;
+    size_t chunk;
+    int node;
+
+    for (;;) {
+        if (!nxt_engine_pop(w, &chunk)) {
+            if (!nxt_engine_steal(eng, id))
+                break;
+            continue;
+        }
+
+        /* Published before the ranges were filled */
+        task = eng->task;
+        node = -1;
+        if (eng->order != NULL) {
+            chunk = eng->order[chunk];
+            node = eng->status[chunk];
+        }
+
+        if (node < 0 || node >= eng->topo.nodes || node == w->node)
+            w->local++;
+        else
+            w->remote++;
+
+        task->fn(eng, task, chunk, id);
+
+        pthread_mutex_lock(&eng->lock);
+        if (--eng->pending == 0)
+            pthread_cond_broadcast(&eng->done);
+        pthread_mutex_unlock(&eng->lock);
+    }
+}
+
+static void *nxt_engine_thread(void *arg)
+{
+    nxt_engine_worker *w = (nxt_engine_worker *) arg;
+    nxt_engine *eng = w->eng;
+    unsigned long seen = 0;
+
+    /* The first thread of a node places its replica in local memory */
+    nxt_engine_pin(&eng->topo, w->node);
+    if (eng->replica[w->node] != NULL && eng->first[w->node] == w->id)
+        memset(eng->replica[w->node], 0, sizeof(nxt_engine_replica));
+
+    pthread_mutex_lock(&eng->lock);
+    eng->ready++;
+    pthread_cond_broadcast(&eng->done);
+
+    for (;;) {
+        while (!eng->stop && eng->generation == seen)
+            pthread_cond_wait(&eng->wake, &eng->lock);
+        if (eng->stop)
+            break;
+        seen = eng->generation;
+        eng->busy++;
+        pthread_mutex_unlock(&eng->lock);
+
+        nxt_engine_work(eng, w->id);
+
+        pthread_mutex_lock(&eng->lock);
+        if (--eng->busy == 0)
+            pthread_cond_broadcast(&eng->done);
+    }
+    pthread_mutex_unlock(&eng->lock);
+
+    return NULL;
+}
+
+/* Points the workers of every node to a local copy of the key schedules */
+static void nxt_engine_replicate(nxt_engine *eng, nxt_engine_task *task)
+{
+    nxt_engine_replica *r;
+    int n;
+
+    for (n = 1; n < eng->topo.nodes; n++) {
+        r = eng->replica[n];
+        if (r == NULL)
+            continue;
+
+        if (task->ctx[0] != NULL) {
+            r->ctx = *task->ctx[0];
+            task->ctx[n] = &r->ctx;
+        }
+        if (task->tweak_ctx[0] != NULL) {
+            r->tweak_ctx = *task->tweak_ctx[0];
+            task->tweak_ctx[n] = &r->tweak_ctx;
+        }
+        if (task->pmac[0] != NULL) {
+            r->pmac = *task->pmac[0];
+            task->pmac[n] = &r->pmac;
+        }
+    }
+
+    r = eng->replica[0];
+    if (r != NULL) {
+        if (task->ctx[0] != NULL) {
+            r->ctx = *task->ctx[0];
+            task->ctx[0] = &r->ctx;
+        }
+        if (task->tweak_ctx[0] != NULL) {
+            r->tweak_ctx = *task->tweak_ctx[0];
+            task->tweak_ctx[0] = &r->tweak_ctx;
+        }
+        if (task->pmac[0] != NULL) {
+            r->pmac = *task->pmac[0];
+            task->pmac[0] = &r->pmac;
+        }
+    }
+}
+
+/* Node whose workers get the chunks of node n */
+static int nxt_engine_target(const nxt_engine *eng, const int *workers, int n)
+{
+    if (n < 0 || n >= eng->topo.nodes || workers[n] == 0)
+        return eng->workers[0].node;
+
+    return n;
+}
+
+/*
+ * Sorts the chunks by the node owning their input and gives the chunks
+ * of each node to the workers of that node. The chunks of unknown
+ * nodes or of nodes without workers go to the node of the caller.
+ */
+static void nxt_engine_route(nxt_engine *eng, nxt_engine_task *task)
+{
+    size_t count[NXT_ENGINE_MAX_NODES];
+    size_t pos[NXT_ENGINE_MAX_NODES];
+    int workers[NXT_ENGINE_MAX_NODES];
+    size_t *order;
+    int *status;
+    nxt_engine_worker *w;
+    size_t i;
+    int rank[NXT_ENGINE_MAX_NODES];
+    int n, t;
+
+    eng->order = NULL;
+    memset(workers, 0, sizeof(workers));
+    for (t = 0; t < eng->threads; t++) {
+        workers[eng->workers[t].node]++;
+    }
+
+    if (task->chunks > eng->order_size) {
+        order = (size_t *) realloc(eng->order_buf, task->chunks
+                                   * (sizeof(size_t) + sizeof(int)));
+        if (order == NULL)
+            return;
+        eng->order_buf = order;
+        eng->order_size = task->chunks;
+    }
+    order = eng->order_buf;
+    status = (int *) (order + eng->order_size);
+
+    nxt_engine_nodes_of(eng, task->in, task->chunk_size, task->chunks,
+                        status);
+
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < task->chunks; i++) {
+        count[nxt_engine_target(eng, workers, status[i])]++;
+    }
+
+    for (n = 0, i = 0; n < eng->topo.nodes; n++) {
+        eng->node_start[n] = pos[n] = i;
+        i += count[n];
+        eng->node_end[n] = i;
+    }
+    for (i = 0; i < task->chunks; i++) {
+        order[pos[nxt_engine_target(eng, workers, status[i])]++] = i;
+    }
+
+    eng->order = order;
+    eng->status = status;
+
+    memset(rank, 0, sizeof(rank));
+    for (t = 0; t < eng->threads; t++) {
+        w = &eng->workers[t];
+        n = w->node;
+        pthread_mutex_lock(&w->lock);
+        w->next = eng->node_start[n] + count[n] * rank[n] / workers[n];
+        w->end = eng->node_start[n] + count[n] * (rank[n] + 1) / workers[n];
+        pthread_mutex_unlock(&w->lock);
+        rank[n]++;
+    }
+}
+
+/*
+ * Runs every chunk of task. The operation is over when all the chunks
+ * are done and no pool thread is still looking for work, so that none
+ * of them can see task after the return.
+ */
+static void nxt_engine_dispatch(nxt_engine *eng, nxt_engine_task *task)
+{
+    nxt_engine_worker *w;
+    size_t i;
+    int t;
+
+    for (t = 0; t < eng->threads; t++) {
+        memset(eng->workers[t].sum, 0, NXT128_BLOCK_SIZE);
+    }
+
+    for (t = 1; t < NXT_ENGINE_MAX_NODES; t++) {
+        task->ctx[t] = task->ctx[0];
+        task->tweak_ctx[t] = task->tweak_ctx[0];
+        task->pmac[t] = task->pmac[0];
+    }
+
+    if (eng->threads == 1 || task->chunks <= 1) {
+        for (i = 0; i < task->chunks; i++) {
+            task->fn(eng, task, i, 0);
+        }
+        return;
+    }
+
+    /* A thread woken late by the previous operation must be done */
+    pthread_mutex_lock(&eng->lock);
+    while (eng->busy > 0)
+        pthread_cond_wait(&eng->done, &eng->lock);
+    eng->workers[0].node = nxt_engine_current_node(eng);
+    pthread_mutex_unlock(&eng->lock);
+
+    if (eng->topo.nodes > 1)
+        nxt_engine_replicate(eng, task);
+
+    pthread_mutex_lock(&eng->lock);
+    eng->task = task;
+    eng->pending = task->chunks;
+    pthread_mutex_unlock(&eng->lock);
+
+    /* A generic loop has no buffer to place */
+    eng->order = NULL;
+    if (eng->topo.nodes > 1 && task->in != NULL)
+        nxt_engine_route(eng, task);
+
+    if (eng->order == NULL) {
+        for (t = 0; t < eng->topo.nodes; t++) {
+            eng->node_start[t] = 0;
+            eng->node_end[t] = task->chunks;
+        }
+        for (t = 0; t < eng->threads; t++) {
+            w = &eng->workers[t];
+            pthread_mutex_lock(&w->lock);
+            w->next = task->chunks * t / eng->threads;
+            w->end = task->chunks * (t + 1) / eng->threads;
+            pthread_mutex_unlock(&w->lock);
+        }
+    }
+
+    pthread_mutex_lock(&eng->lock);
+    eng->generation++;
+    pthread_cond_broadcast(&eng->wake);
+    pthread_mutex_unlock(&eng->lock);
+
+    nxt_engine_work(eng, 0);
+
+    pthread_mutex_lock(&eng->lock);
+    while (eng->pending > 0 || eng->busy > 0)
+        pthread_cond_wait(&eng->done, &eng->lock);
+    pthread_mutex_unlock(&eng->lock);
+
+    /* The replicas do not keep the key schedules between operations */
+    for (t = 0; t < eng->topo.nodes; t++) {
+        if (eng->replica[t] != NULL)
+            nxt_wipe(eng->replica[t], sizeof(nxt_engine_replica));
+    }
+}
+
+static void nxt_engine_run(nxt_engine *eng, nxt_engine_task *task)
+{
+    size_t i;
+    int t;
+
+    pthread_mutex_lock(&eng->run_lock);
+    nxt_engine_dispatch(eng, task);
+
+    /* PMAC: each worker sums its own chunks */
+    if (task->pmac[0] != NULL) {
+        for (t = 0; t < eng->threads; t++) {
+            for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+                task->start[i] ^= eng->workers[t].sum[i];
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&eng->run_lock);
+}
+
+/* Parses a sysfs CPU list such as "0-3,8-11" into a bitmap */
+static int nxt_engine_parse_cpus(const char *list, unsigned char *cpus)
+{
+    char *end;
+    long first, last;
+    int count = 0;
+
+    while (*list != '\0' && *list != '\n') {
+        first = strtol(list, &end, 10);
+        if (end == list)
+            break;
+        last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+
+        for (; first <= last && first < NXT_ENGINE_MAX_CPUS; first++) {
+            cpus[first / 8] |= (unsigned char) (1 << (first % 8));
+            count++;
+        }
+
+        list = (*end == ',') ? end + 1 : end;
+    }
+
+    return count;
+}
+
+int nxt_engine_topology_detect(nxt_engine_topology *topo, int threads)
+{
+    char path[64];
+    char list[1024];
+    int count[NXT_ENGINE_MAX_NODES];
+    int total = 0;
+    int sum = 0;
+    long cpus;
+    FILE *f;
+    int n;
+
+    memset(topo, 0, sizeof(nxt_engine_topology));
+
+    if (threads <= 0) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (int) cpus : 1;
+    }
+
+    for (n = 0; n < NXT_ENGINE_MAX_NODES; n++) {
+        sprintf(path, "/sys/devices/system/node/node%d/cpulist", n);
+        count[n] = 0;
+        f = fopen(path, "r");
+        if (f == NULL)
+            break;
+        if (fgets(list, sizeof(list), f) != NULL)
+            count[n] = nxt_engine_parse_cpus(list, topo->cpus[n]);
+        fclose(f);
+        total += count[n];
+    }
+    topo->nodes = n;
+
+    /* Single node: no pinning, as without NUMA */
+    if (topo->nodes <= 1 || total == 0) {
+        memset(topo, 0, sizeof(nxt_engine_topology));
+        topo->nodes = 1;
+        topo->threads[0] = threads - 1;
+        return 1;
+    }
+
+    /* Pool threads in proportion to the CPUs of each node */
+    for (n = 0; n < topo->nodes; n++) {
+        topo->threads[n] = (threads - 1) * (sum + count[n]) / total
+                           - (threads - 1) * sum / total;
+        sum += count[n];
+    }
+
+    return topo->nodes;
+}
+
+nxt_engine *nxt_engine_new(int threads)
+{
+    nxt_engine_topology topo;
+
+    nxt_engine_topology_detect(&topo, threads);
+
+    return nxt_engine_new_topology(&topo);
+}
+
+nxt_engine *nxt_engine_new_topology(const nxt_engine_topology *topo)
+{
+    nxt_engine *eng;
+    long page;
+    size_t size;
+    void *p;
+    int threads = 1;
+    int n, t, k;
+
+    assert(topo->nodes >= 1 && topo->nodes <= NXT_ENGINE_MAX_NODES);
+
+    for (n = 0; n < topo->nodes; n++) {
+        threads += topo->threads[n];
+    }
+
+    eng = (nxt_engine *) calloc(1, sizeof(nxt_engine));
+    if (eng == NULL)
+        return NULL;
+
+    eng->workers = (nxt_engine_worker *) calloc((size_t) threads,
+                                                sizeof(nxt_engine_worker));
+    eng->tids = (pthread_t *) calloc((size_t) threads, sizeof(pthread_t));
+    if (eng->workers == NULL || eng->tids == NULL) {
+        free(eng->workers);
+        free(eng->tids);
+        free(eng);
+        return NULL;
+    }
+
+    eng->topo = *topo;
+
+    pthread_mutex_init(&eng->run_lock, NULL);
+    pthread_mutex_init(&eng->lock, NULL);
+    pthread_cond_init(&eng->wake, NULL);
+    pthread_cond_init(&eng->done, NULL);
+
+    for (t = 0; t < threads; t++) {
+        pthread_mutex_init(&eng->workers[t].lock, NULL);
+        eng->workers[t].eng = eng;
+        eng->workers[t].id = t;
+    }
+
+    /* Thread 0 is the caller, the pool threads are grouped by node */
+    for (n = 0, t = 1; n < topo->nodes; n++) {
+        eng->first[n] = t;
+        for (k = 0; k < topo->threads[n]; k++, t++) {
+            eng->workers[t].node = n;
+        }
+    }
+
+    /* Untouched pages, placed by the first thread of each node */
+    if (topo->nodes > 1) {
+        page = sysconf(_SC_PAGESIZE);
+        size = sizeof(nxt_engine_replica);
+        if (page > 0)
+            size = (size + page - 1) / page * page;
+        for (n = 0; n < topo->nodes; n++) {
+            p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            eng->replica[n] = (p != MAP_FAILED) ? (nxt_engine_replica *) p
+                                                : NULL;
+        }
+    }
+
+    eng->threads = 1;
+    for (t = 1; t < threads; t++) {
+        if (pthread_create(&eng->tids[t], NULL, nxt_engine_thread,
+                           &eng->workers[t]) != 0) {
+            nxt_engine_free(eng);
+            return NULL;
+        }
+        eng->threads++;
+    }
+
+    pthread_mutex_lock(&eng->lock);
+    while (eng->ready < eng->threads - 1)
+        pthread_cond_wait(&eng->done, &eng->lock);
+    pthread_mutex_unlock(&eng->lock);
+
+    return eng;
+}
+
+void nxt_engine_free(nxt_engine *eng)
+{
+    int t;
+
+    if (eng == NULL)
+        return;
+
+    pthread_mutex_lock(&eng->lock);
+    eng->stop = 1;
+    pthread_cond_broadcast(&eng->wake);
+    pthread_mutex_unlock(&eng->lock);
+
+    for (t = 1; t < eng->threads; t++) {
+        pthread_join(eng->tids[t], NULL);
+    }
+
+    for (t = 0; t < eng->threads; t++) {
+        pthread_mutex_destroy(&eng->workers[t].lock);
+    }
+    pthread_mutex_destroy(&eng->run_lock);
+    pthread_mutex_destroy(&eng->lock);
+    pthread_cond_destroy(&eng->wake);
+    pthread_cond_destroy(&eng->done);
+
+    for (t = 0; t < NXT_ENGINE_MAX_NODES; t++) {
+        if (eng->replica[t] != NULL) {
+            nxt_wipe(eng->replica[t], sizeof(nxt_engine_replica));
+            munmap(eng->replica[t], sizeof(nxt_engine_replica));
+        }
+    }
+
+    free(eng->order_buf);
+    free(eng->workers);
+    free(eng->tids);
+    free(eng);
+}
+
+int nxt_engine_threads(const nxt_engine *eng)
+{
+    return eng->threads;
+}
+
+void nxt_engine_stats(const nxt_engine *eng, size_t *local, size_t *remote)
+{
+    int t;
+
+    *local = 0;
+    *remote = 0;
+    for (t = 0; t < eng->threads; t++) {
+        *local += eng->workers[t].local;
+        *remote += eng->workers[t].remote;
+    }
+}
+
+static void nxt_engine_task_init(nxt_engine_task *task, size_t chunk_size,
+                                 const uint8 *in, uint8 *out, size_t len)
+{
+    memset(task, 0, sizeof(nxt_engine_task));
+    task->chunk_size = chunk_size;
+    task->chunks = (len + chunk_size - 1) / chunk_size;
+    task->in = in;
+    task->out = out;
+    task->len = len;
+}
+
+/* Returns the size of the chunk and its offset in off */
+static size_t nxt_engine_span(const nxt_engine_task *task, size_t chunk,
+                              size_t *off)
+{
+    *off = chunk * task->chunk_size;
+
+    return (task->len - *off < task->chunk_size) ? task->len - *off
+                                                  : task->chunk_size;
+}
+
+/* Adds n to a big-endian (counter) or little-endian (sector) number */
+static void nxt_engine_add(uint8 *x, size_t n, int big_endian)
+{
+    int i;
+
+    for (i = 0; i < NXT128_BLOCK_SIZE && n != 0; i++) {
+        n += x[big_endian ? NXT128_BLOCK_SIZE - 1 - i : i];
+        x[big_endian ? NXT128_BLOCK_SIZE - 1 - i : i] = (uint8) n;
+        n >>= 8;
+    }
+}
+
+static void nxt_engine_ecb_chunk(nxt_engine *eng, nxt_engine_task *task,
+                                 size_t chunk, int worker)
+{
+    size_t off;
+    size_t n;
+
+    n = nxt_engine_span(task, chunk, &off);
+    if (task->decrypt)
+        nxt128_decrypt_blocks(task->ctx[NXT_ENGINE_NODE(eng, worker)],
+                              task->in + off, task->out + off,
+                              n / NXT128_BLOCK_SIZE);
+    else
+        nxt128_encrypt_blocks(task->ctx[NXT_ENGINE_NODE(eng, worker)],
+                              task->in + off, task->out + off,
+                              n / NXT128_BLOCK_SIZE);
+}
+
+static void nxt_engine_ecb(nxt_engine *eng, nxt128_ctx *ctx,
+                           const uint8 *in, uint8 *out, size_t len,
+                           int decrypt)
+{
+    nxt_engine_task task;
+
+    assert(len % NXT128_BLOCK_SIZE == 0);
+
+    nxt_engine_task_init(&task, NXT_ENGINE_CHUNK, in, out, len);
+    task.fn = nxt_engine_ecb_chunk;
+    task.ctx[0] = ctx;
+    task.decrypt = decrypt;
+    nxt_engine_run(eng, &task);
+}
+
+void nxt_engine_ecb_encrypt(nxt_engine *eng, nxt128_ctx *ctx,
+                            const uint8 *in, uint8 *out, size_t len)
+{
+    nxt_engine_ecb(eng, ctx, in, out, len, 0);
+}
+
+void nxt_engine_ecb_decrypt(nxt_engine *eng, nxt128_ctx *ctx,
+                            const uint8 *in, uint8 *out, size_t len)
+{
+    nxt_engine_ecb(eng, ctx, in, out, len, 1);
+}
+
+static void nxt_engine_ctr_chunk(nxt_engine *eng, nxt_engine_task *task,
+                                 size_t chunk, int worker)
+{
+    uint8 ctr[NXT128_BLOCK_SIZE];
+    size_t off;
+    size_t n;
+
+    n = nxt_engine_span(task, chunk, &off);
+    memcpy(ctr, task->start, NXT128_BLOCK_SIZE);
+    nxt_engine_add(ctr, off / NXT128_BLOCK_SIZE, 1);
+    nxt128_ctr_crypt(task->ctx[NXT_ENGINE_NODE(eng, worker)], ctr,
+                     task->in + off, task->out + off, n);
+}
+
+void nxt_engine_ctr_crypt(nxt_engine *eng, nxt128_ctx *ctx, uint8 *ctr,
+                          const uint8 *in, uint8 *out, size_t len)
+{
+    nxt_engine_task task;
+
+    nxt_engine_task_init(&task, NXT_ENGINE_CHUNK, in, out, len);
+    task.fn = nxt_engine_ctr_chunk;
+    task.ctx[0] = ctx;
+    memcpy(task.start, ctr, NXT128_BLOCK_SIZE);
+    nxt_engine_run(eng, &task);
+
+    nxt_engine_add(ctr, (len + NXT128_BLOCK_SIZE - 1) / NXT128_BLOCK_SIZE, 1);
+}
+
+static void nxt_engine_cbc_chunk(nxt_engine *eng, nxt_engine_task *task,
+                                 size_t chunk, int worker)
+{
+    size_t off;
+    size_t n;
+
+    n = nxt_engine_span(task, chunk, &off);
+    nxt128_cbc_decrypt(task->ctx[NXT_ENGINE_NODE(eng, worker)],
+                       task->ivs + chunk * NXT128_BLOCK_SIZE,
+                       task->in + off, task->out + off, n);
+}
+
+/*
+ * The IV of each chunk is the last ciphertext block of the previous
+ * one, copied beforehand since it may be overwritten when in == out.
+ */
+void nxt_engine_cbc_decrypt(nxt_engine *eng, nxt128_ctx *ctx, uint8 *iv,
+                            const uint8 *in, uint8 *out, size_t len)
+{
+    nxt_engine_task task;
+    size_t i;
+
+    assert(len % NXT128_BLOCK_SIZE == 0);
+
+    if (len == 0)
+        return;
+
+    nxt_engine_task_init(&task, NXT_ENGINE_CHUNK, in, out, len);
+    task.fn = nxt_engine_cbc_chunk;
+    task.ctx[0] = ctx;
+    task.ivs = (uint8 *) malloc(task.chunks * NXT128_BLOCK_SIZE);
+    if (task.ivs == NULL) {
+        nxt128_cbc_decrypt(ctx, iv, in, out, len);
+        return;
+    }
+
+    memcpy(task.ivs, iv, NXT128_BLOCK_SIZE);
+    for (i = 1; i < task.chunks; i++) {
+        memcpy(task.ivs + i * NXT128_BLOCK_SIZE,
+               in + i * task.chunk_size - NXT128_BLOCK_SIZE,
+               NXT128_BLOCK_SIZE);
+    }
+    memcpy(iv, in + len - NXT128_BLOCK_SIZE, NXT128_BLOCK_SIZE);
+
+    nxt_engine_run(eng, &task);
+
+    free(task.ivs);
+}
+
+static void nxt_engine_xts_chunk(nxt_engine *eng, nxt_engine_task *task,
+                                 size_t chunk, int worker)
+{
+    uint8 tweak[NXT128_BLOCK_SIZE];
+    size_t off;
+    size_t n;
+
+    n = nxt_engine_span(task, chunk, &off);
+    memcpy(tweak, task->start, NXT128_BLOCK_SIZE);
+    nxt_engine_add(tweak, off / task->unit, 0);
+
+    for (; n > 0; n -= task->unit, off += task->unit) {
+        if (task->decrypt)
+            nxt128_xts_decrypt(task->ctx[NXT_ENGINE_NODE(eng, worker)],
+                               task->tweak_ctx[NXT_ENGINE_NODE(eng, worker)],
+                               tweak, task->in + off, task->out + off,
+                               task->unit);
+        else
+            nxt128_xts_encrypt(task->ctx[NXT_ENGINE_NODE(eng, worker)],
+                               task->tweak_ctx[NXT_ENGINE_NODE(eng, worker)],
+                               tweak, task->in + off, task->out + off,
+                               task->unit);
+        nxt_engine_add(tweak, 1, 0);
+    }
+}
+
+static void nxt_engine_xts(nxt_engine *eng, nxt128_ctx *ctx,
+                           nxt128_ctx *tweak_ctx, const uint8 *sector,
+                           size_t unit, const uint8 *in, uint8 *out,
+                           size_t len, int decrypt)
+{
+    nxt_engine_task task;
+    size_t chunk_size;
+
+    assert(unit > 0 && unit % NXT128_BLOCK_SIZE == 0);
+    assert(len % unit == 0);
+
+    chunk_size = (unit < NXT_ENGINE_CHUNK) ? NXT_ENGINE_CHUNK / unit * unit
+                                           : unit;
+
+    nxt_engine_task_init(&task, chunk_size, in, out, len);
+    task.fn = nxt_engine_xts_chunk;
+    task.ctx[0] = ctx;
+    task.tweak_ctx[0] = tweak_ctx;
+    task.unit = unit;
+    task.decrypt = decrypt;
+    memcpy(task.start, sector, NXT128_BLOCK_SIZE);
+    nxt_engine_run(eng, &task);
+}
+
+void nxt_engine_xts_encrypt(nxt_engine *eng, nxt128_ctx *ctx,
+                            nxt128_ctx *tweak_ctx, const uint8 *sector,
+                            size_t unit, const uint8 *in, uint8 *out,
+                            size_t len)
+{
+    nxt_engine_xts(eng, ctx, tweak_ctx, sector, unit, in, out, len, 0);
+}
+
+void nxt_engine_xts_decrypt(nxt_engine *eng, nxt128_ctx *ctx,
+                            nxt128_ctx *tweak_ctx, const uint8 *sector,
+                            size_t unit, const uint8 *in, uint8 *out,
+                            size_t len)
+{
+    nxt_engine_xts(eng, ctx, tweak_ctx, sector, unit, in, out, len, 1);
+}
+
+static void nxt_engine_pmac_chunk(nxt_engine *eng, nxt_engine_task *task,
+                                  size_t chunk, int worker)
+{
+    size_t off;
+    size_t n;
+
+    n = nxt_engine_span(task, chunk, &off);
+    nxt128_pmac_sum(task->pmac[NXT_ENGINE_NODE(eng, worker)],
+                    off / NXT128_BLOCK_SIZE + 1, task->in + off,
+                    n / NXT128_BLOCK_SIZE, eng->workers[worker].sum);
+}
+
+void nxt_engine_pmac(nxt_engine *eng, nxt128_pmac_ctx *ctx, const uint8 *in,
+                     size_t len, uint8 *tag)
+{
+    nxt_engine_task task;
+    size_t blocks;
+
+    blocks = (len > 0) ? (len - 1) / NXT128_BLOCK_SIZE : 0;
+
+    nxt_engine_task_init(&task, NXT_ENGINE_CHUNK, in, NULL,
+                         blocks * NXT128_BLOCK_SIZE);
+    task.fn = nxt_engine_pmac_chunk;
+    task.pmac[0] = ctx;
+    nxt_engine_run(eng, &task);
+
+    nxt128_pmac_final(ctx, task.start, in + blocks * NXT128_BLOCK_SIZE,
+                      len - blocks * NXT128_BLOCK_SIZE, tag);
+}
+
+static void nxt_engine_for_chunk(nxt_engine *eng, nxt_engine_task *task,
+                                 size_t chunk, int worker)
+{
+    (void) eng;
+    (void) worker;
+
+    task->loop(task->arg, chunk);
+}
+
+void nxt_engine_for(nxt_engine *eng, size_t count,
+                    void (*fn)(void *arg, size_t i), void *arg)
+{
+    nxt_engine_task task;
+
+    nxt_engine_task_init(&task, 1, NULL, NULL, count);
+    task.fn = nxt_engine_for_chunk;
+    task.loop = fn;
+    task.arg = arg;
+    nxt_engine_run(eng, &task);
+}
@@ -0,0 +1,133 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_ENGINE_H
+#define NXT_ENGINE_H
+
+#include "nxt128.h"
+#include "nxt_modes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Parallel bulk encryption of one large buffer. The buffer is split in
+ * chunks of about NXT_ENGINE_CHUNK bytes which are initially spread in
+ * equal ranges over the threads of a persistent pool; a thread which
+ * runs out of chunks steals half of the largest remaining range. The
+ * calling thread takes part in the work and every function returns once
+ * the whole buffer is processed, with the same result as the serial
+ * function of nxt_modes.h, in place or not.
+ *
+ * An engine runs one operation at a time: concurrent calls on the same
+ * engine are serialized.
+ */
+#define NXT_ENGINE_CHUNK (64 * 1024)
+
+typedef struct nxt_engine nxt_engine;
+
+/*
+ * NUMA placement. The pool threads of a node are pinned to the CPUs of
+ * that node (when its CPU bitmap is not empty), each node gets its own
+ * copy of the key schedules in local memory, and the chunks are first
+ * given to the workers of the node owning the input pages, stealing
+ * within a node before stealing from another one. The caller counts as
+ * a worker of the node it runs on.
+ *
+ * nxt_engine_topology_detect() reads the nodes from sysfs and spreads
+ * threads - 1 pool threads in proportion to their CPUs; with a single
+ * node nothing is pinned. A simulated topology sets node_of, which
+ * gives the node of an address instead of asking the kernel, and may
+ * leave the CPU bitmaps empty.
+ *
+ * nxt_engine_stats() returns the number of chunks processed by a worker
+ * of their node and by a worker of another node since the creation. A
+ * chunk of unknown node counts as local.
+ */
+#define NXT_ENGINE_MAX_NODES 8
+#define NXT_ENGINE_MAX_CPUS  1024
+
+typedef struct {
+    int nodes;
+    int threads[NXT_ENGINE_MAX_NODES];
+    unsigned char cpus[NXT_ENGINE_MAX_NODES][NXT_ENGINE_MAX_CPUS / 8];
+    int (*node_of)(const void *addr, void *arg);
+    void *arg;
+} nxt_engine_topology;
+
+int nxt_engine_topology_detect(nxt_engine_topology *topo, int threads);
+
+/* threads is the total number of threads, 0 for one per online CPU */
+nxt_engine *nxt_engine_new(int threads);
+nxt_engine *nxt_engine_new_topology(const nxt_engine_topology *topo);
+void nxt_engine_free(nxt_engine *eng);
+int nxt_engine_threads(const nxt_engine *eng);
+void nxt_engine_stats(const nxt_engine *eng, size_t *local, size_t *remote);
+
+void nxt_engine_ecb_encrypt(nxt_engine *eng, nxt128_ctx *ctx,
+                            const uint8 *in, uint8 *out, size_t len);
+void nxt_engine_ecb_decrypt(nxt_engine *eng, nxt128_ctx *ctx,
+                            const uint8 *in, uint8 *out, size_t len);
+void nxt_engine_ctr_crypt(nxt_engine *eng, nxt128_ctx *ctx, uint8 *ctr,
+                          const uint8 *in, uint8 *out, size_t len);
+void nxt_engine_cbc_decrypt(nxt_engine *eng, nxt128_ctx *ctx, uint8 *iv,
+                            const uint8 *in, uint8 *out, size_t len);
+
+/*
+ * XTS on consecutive data units of unit bytes each, the first one with
+ * the little-endian data unit number sector.
+ */
+void nxt_engine_xts_encrypt(nxt_engine *eng, nxt128_ctx *ctx,
+                            nxt128_ctx *tweak_ctx, const uint8 *sector,
+                            size_t unit, const uint8 *in, uint8 *out,
+                            size_t len);
+void nxt_engine_xts_decrypt(nxt_engine *eng, nxt128_ctx *ctx,
+                            nxt128_ctx *tweak_ctx, const uint8 *sector,
+                            size_t unit, const uint8 *in, uint8 *out,
+                            size_t len);
+
+void nxt_engine_pmac(nxt_engine *eng, nxt128_pmac_ctx *ctx, const uint8 *in,
+                     size_t len, uint8 *tag);
+
+/*
+ * Generic parallel loop: fn(arg, i) is called once for every i in
+ * [0, count), concurrently and in any order, by the pool threads and
+ * the caller. The work is not placed by node.
+ */
+void nxt_engine_for(nxt_engine *eng, size_t count,
+                    void (*fn)(void *arg, size_t i), void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_ENGINE_H */
@@ -0,0 +1,279 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "nxt_common.h"
+#include "nxt_fpe.h"
+
+#define HALF_BITS(bits) (((bits) + 1) >> 1)
+
+#define LOW_MASK(n) (((n) >= 32) ? 0xffffffff : (((uint32) 1 << (n)) - 1))
+
+/*
+ * With an odd number of bits the Feistel domain has one extra bit which
+ * is the most significant bit of the left half.
+ */
+#define OUT_OF_DOMAIN(bits, h, l) (((bits) & 1) && ((l) >> ((h) - 1)))
+
+static void nxt_fpe_load(const nxt_fpe_ctx *ctx, const uint8 *in,
+                         uint32 *l, uint32 *r)
+{
+    uint8 block[8];
+    uint32 w0, w1;
+    int size;
+    int h;
+
+    size = NXT_FPE_SIZE(ctx->bits);
+    h = HALF_BITS(ctx->bits);
+
+    memset(block, 0, sizeof(block));
+    memcpy(block + 8 - size, in, size);
+
+    PACK32(block    , &w1);
+    PACK32(block + 4, &w0);
+
+    if (ctx->bits <= 32) {
+        w1 = 0;
+        w0 &= LOW_MASK(ctx->bits);
+    } else {
+        w1 &= LOW_MASK(ctx->bits - 32);
+    }
+
+    if (h == 32) {
+        *l = w1;
+        *r = w0;
+    } else {
+        *l = ((w0 >> h) | (w1 << (32 - h))) & LOW_MASK(h);
+        *r = w0 & LOW_MASK(h);
+    }
+}
+
+static void nxt_fpe_store(const nxt_fpe_ctx *ctx, uint32 l, uint32 r,
+                          uint8 *out)
+{
+    uint8 block[8];
+    uint32 w0, w1;
+    int size;
+    int h;
+
+    size = NXT_FPE_SIZE(ctx->bits);
+    h = HALF_BITS(ctx->bits);
+
+    if (h == 32) {
+        w1 = l;
+        w0 = r;
+    } else {
+        w1 = l >> (32 - h);
+        w0 = (l << h) | r;
+    }
+
+    UNPACK32(w1, block    );
+    UNPACK32(w0, block + 4);
+
+    memcpy(out, block + 8 - size, size);
+}
+
+/*
+ * Round function input: round number, domain size and the half block.
+ */
+#define ROUND_BLOCK(b, round, bits, x) \
+{                                      \
+    (b)[0] = (uint8) (round);          \
+    (b)[1] = (bits);                   \
+    (b)[2] = 0;                        \
+    (b)[3] = 0;                        \
+    UNPACK32(x, (b) + 4);              \
+}
+
+static uint32 nxt_fpe_f(nxt_fpe_ctx *ctx, int round, uint32 x)
+{
+    uint8 block[8];
+    uint32 f;
+
+    ROUND_BLOCK(block, round, ctx->bits, x);
+    nxt64_encrypt(&ctx->cipher, block, block);
+    PACK32(block + 4, &f);
+
+    return f;
+}
+
+void nxt_fpe_init(nxt_fpe_ctx *ctx, const uint8 *key, uint16 key_len,
+                  uint8 bits)
+{
+    assert((bits >= 1) && (bits <= 64));
+
+    nxt64_ks(&ctx->cipher, key, key_len);
+    ctx->bits = bits;
+}
+
+void nxt_fpe_encrypt(nxt_fpe_ctx *ctx, const uint8 *in, uint8 *out)
+{
+    uint32 l, r, t;
+    uint32 mask;
+    int h;
+    int i;
+
+    h = HALF_BITS(ctx->bits);
+    mask = LOW_MASK(h);
+
+    nxt_fpe_load(ctx, in, &l, &r);
+
+    do {
+        for (i = 0; i < NXT_FPE_ROUNDS; i++) {
+            t = l ^ (nxt_fpe_f(ctx, i, r) & mask);
+            l = r;
+            r = t;
+        }
+    } while (OUT_OF_DOMAIN(ctx->bits, h, l));
+
+    nxt_fpe_store(ctx, l, r, out);
+}
+
+void nxt_fpe_decrypt(nxt_fpe_ctx *ctx, const uint8 *in, uint8 *out)
+{
+    uint32 l, r, t;
+    uint32 mask;
+    int h;
+    int i;
+
+    h = HALF_BITS(ctx->bits);
+    mask = LOW_MASK(h);
+
+    nxt_fpe_load(ctx, in, &l, &r);
+
+    do {
+        for (i = NXT_FPE_ROUNDS - 1; i >= 0; i--) {
+            t = r ^ (nxt_fpe_f(ctx, i, l) & mask);
+            r = l;
+            l = t;
+        }
+    } while (OUT_OF_DOMAIN(ctx->bits, h, l));
+
+    nxt_fpe_store(ctx, l, r, out);
+}
+
+/*
+ * The batch functions keep up to NXT_FPE_LANES values in flight. Each
+ * Feistel round is computed for all the lanes with one call to the
+ * multi-block kernel. After a full pass, the lanes which reached the
+ * domain are retired and replaced by the next input values so that the
+ * values which need to cycle-walk do not leave the other lanes idle.
+ */
+static void nxt_fpe_batch(nxt_fpe_ctx *ctx, const uint8 *in, uint8 *out,
+                          size_t count, int decrypt)
+{
+    uint8 buf[NXT_FPE_LANES * NXT64_BLOCK_SIZE];
+    uint32 l[NXT_FPE_LANES];
+    uint32 r[NXT_FPE_LANES];
+    size_t idx[NXT_FPE_LANES];
+    size_t next;
+    uint32 mask;
+    uint32 f, t;
+    int size;
+    int active;
+    int round;
+    int h;
+    int i, j, k;
+
+    size = NXT_FPE_SIZE(ctx->bits);
+    h = HALF_BITS(ctx->bits);
+    mask = LOW_MASK(h);
+
+    next = 0;
+    active = 0;
+
+    while ((next < count) || (active > 0)) {
+        while ((active < NXT_FPE_LANES) && (next < count)) {
+            nxt_fpe_load(ctx, in + next * size, &l[active], &r[active]);
+            idx[active++] = next++;
+        }
+
+        for (k = 0; k < NXT_FPE_ROUNDS; k++) {
+            if (decrypt) {
+                round = NXT_FPE_ROUNDS - 1 - k;
+                for (j = 0; j < active; j++) {
+                    ROUND_BLOCK(buf + j * NXT64_BLOCK_SIZE, round,
+                                ctx->bits, l[j]);
+                }
+            } else {
+                round = k;
+                for (j = 0; j < active; j++) {
+                    ROUND_BLOCK(buf + j * NXT64_BLOCK_SIZE, round,
+                                ctx->bits, r[j]);
+                }
+            }
+
+            nxt64_encrypt_blocks(&ctx->cipher, buf, buf, active);
+
+            if (decrypt) {
+                for (j = 0; j < active; j++) {
+                    PACK32(buf + j * NXT64_BLOCK_SIZE + 4, &f);
+                    t = r[j] ^ (f & mask);
+                    r[j] = l[j];
+                    l[j] = t;
+                }
+            } else {
+                for (j = 0; j < active; j++) {
+                    PACK32(buf + j * NXT64_BLOCK_SIZE + 4, &f);
+                    t = l[j] ^ (f & mask);
+                    l[j] = r[j];
+                    r[j] = t;
+                }
+            }
+        }
+
+        for (i = 0, j = 0; j < active; j++) {
+            if (OUT_OF_DOMAIN(ctx->bits, h, l[j])) {
+                l[i] = l[j];
+                r[i] = r[j];
+                idx[i++] = idx[j];
+            } else {
+                nxt_fpe_store(ctx, l[j], r[j], out + idx[j] * size);
+            }
+        }
+
+        active = i;
+    }
+}
+
+void nxt_fpe_encrypt_batch(nxt_fpe_ctx *ctx, const uint8 *in, uint8 *out,
+                           size_t count)
+{
+    nxt_fpe_batch(ctx, in, out, count, 0);
+}
+
+void nxt_fpe_decrypt_batch(nxt_fpe_ctx *ctx, const uint8 *in, uint8 *out,
+                           size_t count)
+{
+    nxt_fpe_batch(ctx, in, out, count, 1);
+}
@@ -0,0 +1,75 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_FPE_H
+#define NXT_FPE_H
+
+#include "nxt64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Format-preserving permutation of the integers 0 .. 2^bits - 1 with
+ * 1 <= bits <= 64. The permutation is a balanced Feistel network over
+ * 2 * ceil(bits / 2) bits whose round function is NXT64. For an odd
+ * number of bits the Feistel domain is twice as large as the wanted
+ * domain and the permutation is iterated until the result falls into
+ * it (cycle-walking, 2 iterations on average).
+ *
+ * Values are stored in NXT_FPE_SIZE(bits) bytes, big-endian. The bits
+ * above the domain size are ignored on input and cleared on output.
+ */
+#define NXT_FPE_ROUNDS 10
+#define NXT_FPE_LANES  64
+
+#define NXT_FPE_SIZE(bits) (((bits) + 7) >> 3)
+
+typedef struct {
+    nxt64_ctx cipher;
+    uint8 bits;
+} nxt_fpe_ctx;
+
+void nxt_fpe_init(nxt_fpe_ctx *ctx, const uint8 *key, uint16 key_len,
+                  uint8 bits);
+void nxt_fpe_encrypt(nxt_fpe_ctx *ctx, const uint8 *in, uint8 *out);
+void nxt_fpe_decrypt(nxt_fpe_ctx *ctx, const uint8 *in, uint8 *out);
+void nxt_fpe_encrypt_batch(nxt_fpe_ctx *ctx, const uint8 *in, uint8 *out,
+                           size_t count);
+void nxt_fpe_decrypt_batch(nxt_fpe_ctx *ctx, const uint8 *in, uint8 *out,
+                           size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_FPE_H */
@@ -0,0 +1,270 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Table generator: prints nxt64_tables.h or nxt128_tables.h, computed
+ * from the S-box by nxt64_init_tables() and nxt128_init_tables(). The
+ * cipher sources are included with NXT64_INIT_TABLES and
+ * NXT128_INIT_TABLES set, so that the tables are the ones the library
+ * fills at run time in that configuration.
+ *
+ *     nxt_gentables 64 > nxt64_tables.h
+ *     nxt_gentables 128 > nxt128_tables.h
+ *     nxt_gentables inline > nxt_inline_tables.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NXT64_INIT_TABLES
+#define NXT128_INIT_TABLES
+#define NXT_NO_THREADS
+
+#include "nxt_common.c"
+#include "nxt64.c"
+
+#undef SIGMA
+#undef LAZY_INIT_TABLES
+
+#include "nxt128.c"
+
+static const char *license[] = {
+    "/*",
+    " * IDEA NXT encryption algorithm implementation",
+    " * Issue date: 02/25/2006",
+    " *",
+    " * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>",
+    " * All rights reserved.",
+    " *",
+    " * Redistribution and use in source and binary forms, with or without",
+    " * modification, are permitted provided that the following conditions",
+    " * are met:",
+    " * 1. Redistributions of source code must retain the above copyright",
+    " *    notice, this list of conditions and the following disclaimer.",
+    " * 2. Redistributions in binary form must reproduce the above copyright",
+    " *    notice, this list of conditions and the following disclaimer in "
+        "the",
+    " *    documentation and/or other materials provided with the "
+        "distribution.",
+    " * 3. Neither the name of the project nor the names of its contributors",
+    " *    may be used to endorse or promote products derived from this "
+        "software",
+    " *    without specific prior written permission.",
+    " *",
+    " * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' "
+        "AND",
+    " * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE",
+    " * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR "
+        "PURPOSE",
+    " * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE "
+        "LIABLE",
+    " * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR "
+        "CONSEQUENTIAL",
+    " * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE "
+        "GOODS",
+    " * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)",
+    " * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, "
+        "STRICT",
+    " * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY "
+        "WAY",
+    " * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY "
+        "OF",
+    " * SUCH DAMAGE.",
+    " */",
+    NULL
+};
+
+static void print_head(const char *guard, const char *init)
+{
+    int i;
+
+    for (i = 0; license[i] != NULL; i++) {
+        printf("%s\n", license[i]);
+    }
+
+    printf("\n/* Generated by nxt_gentables from the S-box, do not edit */\n");
+    printf("#ifndef %s\n#define %s\n\n", guard, guard);
+    printf("#include \"nxt_common.h\"\n\n");
+
+    if (init != NULL)
+        printf("#ifdef %s\n\n", init);
+}
+
+static void print_decl(const char *type, const char *name, int n)
+{
+    printf("static %-6s %s[%d];\n", type, name, n);
+}
+
+/* size is the size of an entry in bytes, the line width follows */
+static void print_table(const char *type, const char *name,
+                        const void *table, int size, int n)
+{
+    const uint32 *t32 = (const uint32 *) table;
+    const uint16 *t16 = (const uint16 *) table;
+    const uint8 *t8 = (const uint8 *) table;
+    int per_line;
+    int i;
+
+    per_line = (size == 4) ? 6 : (size == 2) ? 9 : 12;
+
+    printf("\nstatic const %s %s[%d] = {", type, name, n);
+
+    for (i = 0; i < n; i++) {
+        printf(i % per_line == 0 ? "\n    " : " ");
+
+        if (size == 4)
+            printf("0x%08lx", (unsigned long) t32[i]);
+        else if (size == 2)
+            printf("0x%04x", t16[i]);
+        else
+            printf("0x%02x", t8[i]);
+
+        printf(i == n - 1 ? "};\n" : ",");
+    }
+}
+
+static void print_tail(const char *guard, const char *init)
+{
+    if (init != NULL)
+        printf("\n#endif /* !%s */\n", init);
+    else
+        printf("\n");
+
+    printf("#endif /* !%s */\n\n", guard);
+}
+
+static void gen64(void)
+{
+    nxt64_init_tables();
+
+    print_head("NXT64_TABLES_H", "NXT64_INIT_TABLES");
+    print_decl("uint32", "tbsm0_64", 256);
+    print_decl("uint32", "tbsm1_64", 256);
+    print_decl("uint32", "tbsm2_64", 256);
+    print_decl("uint32", "tbsm3_64", 256);
+    printf("\n");
+    print_decl("uint32", "tbs0_64", 256);
+    print_decl("uint32", "tbs1_64", 256);
+    print_decl("uint16", "tbs2_64", 256);
+    print_decl("uint8", "tbs3_64", 256);
+    printf("\n#else /* !NXT64_INIT_TABLES */");
+
+    print_table("uint32", "tbsm0_64", tbsm0_64, 4, 256);
+    print_table("uint32", "tbsm1_64", tbsm1_64, 4, 256);
+    print_table("uint32", "tbsm2_64", tbsm2_64, 4, 256);
+    print_table("uint32", "tbsm3_64", tbsm3_64, 4, 256);
+    print_table("uint32", "tbs0_64", tbs0_64, 4, 256);
+    print_table("uint32", "tbs1_64", tbs1_64, 4, 256);
+    print_table("uint16", "tbs2_64", tbs2_64, 2, 256);
+    print_table("uint8", "tbs3_64", tbs3_64, 1, 256);
+
+    print_tail("NXT64_TABLES_H", "NXT64_INIT_TABLES");
+}
+
+static void gen128(void)
+{
+    nxt128_init_tables();
+
+    print_head("NXT128_TABLES_H", "NXT128_INIT_TABLES");
+    print_decl("uint32", "tbsm0_128", 512);
+    print_decl("uint32", "tbsm1_128", 512);
+    print_decl("uint32", "tbsm2_128", 512);
+    print_decl("uint32", "tbsm3_128", 512);
+    print_decl("uint32", "tbsm4_128", 512);
+    print_decl("uint32", "tbsm5_128", 512);
+    print_decl("uint32", "tbsm6_128", 512);
+    print_decl("uint32", "tbsm7_128", 512);
+    printf("\n");
+    print_decl("uint32", "tbs0_128", 256);
+    print_decl("uint32", "tbs1_128", 256);
+    print_decl("uint16", "tbs2_128", 256);
+    print_decl("uint8", "tbs3_128", 256);
+    printf("\n#else /* !NXT128_INIT_TABLES */");
+
+    print_table("uint32", "tbsm0_128", tbsm0_128, 4, 512);
+    print_table("uint32", "tbsm1_128", tbsm1_128, 4, 512);
+    print_table("uint32", "tbsm2_128", tbsm2_128, 4, 512);
+    print_table("uint32", "tbsm3_128", tbsm3_128, 4, 512);
+    print_table("uint32", "tbsm4_128", tbsm4_128, 4, 512);
+    print_table("uint32", "tbsm5_128", tbsm5_128, 4, 512);
+    print_table("uint32", "tbsm6_128", tbsm6_128, 4, 512);
+    print_table("uint32", "tbsm7_128", tbsm7_128, 4, 512);
+    print_table("uint32", "tbs0_128", tbs0_128, 4, 256);
+    print_table("uint32", "tbs1_128", tbs1_128, 4, 256);
+    print_table("uint16", "tbs2_128", tbs2_128, 2, 256);
+    print_table("uint8", "tbs3_128", tbs3_128, 1, 256);
+
+    print_tail("NXT128_TABLES_H", "NXT128_INIT_TABLES");
+}
+
+/*
+ * IO(sigma(x)) for the bytes 0 and 1 of x, used with tbs0_64 and tbs1_64
+ * for the bytes 2 and 3 by nxt_inline.h. sigma is the same for NXT64 and
+ * NXT128, and so are these tables.
+ */
+static void gen_inline(void)
+{
+    uint32 tbio0[256];
+    uint32 tbio1[256];
+    uint32 s;
+    int i;
+
+    nxt64_init_tables();
+
+    for (i = 0; i < 256; i++) {
+        s = tbs3_64[i];
+        tbio0[i] = (s << 24) | (s << 8);
+        tbio1[i] = (s << 16) | s;
+    }
+
+    print_head("NXT_INLINE_TABLES_H", NULL);
+    printf("/* IO(sigma(x)) for the bytes 0 and 1 of x */");
+    print_table("uint32", "tbio0", tbio0, 4, 256);
+    print_table("uint32", "tbio1", tbio1, 4, 256);
+    print_tail("NXT_INLINE_TABLES_H", NULL);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 2 && strcmp(argv[1], "64") == 0) {
+        gen64();
+    } else if (argc == 2 && strcmp(argv[1], "128") == 0) {
+        gen128();
+    } else if (argc == 2 && strcmp(argv[1], "inline") == 0) {
+        gen_inline();
+    } else {
+        fprintf(stderr, "usage: nxt_gentables 64|128|inline\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
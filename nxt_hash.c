@@ -0,0 +1,288 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <string.h>
+
+#include "nxt_common.h"
+#include "nxt_hash.h"
+
+/*
+ * keys holds H || M (8 words) and g holds G (4 words) for each lane.
+ * The message blocks M must already be in place.
+ */
+static void nxt_hash_compress(uint32 *keys, uint32 *g, size_t lanes)
+{
+    uint32 blocks[NXT_HASH_LANES * 8];
+    uint32 *h;
+    uint32 *x;
+    uint32 *b;
+    size_t l;
+
+    for (l = 0; l < lanes; l++) {
+        x = g + 4 * l;
+        b = blocks + 8 * l;
+
+        b[0] = x[0];
+        b[1] = x[1];
+        b[2] = x[2];
+        b[3] = x[3];
+        b[4] = x[0];
+        b[5] = x[1];
+        b[6] = x[2];
+        b[7] = x[3] ^ 1;
+    }
+
+    nxt128_ks256_encrypt2(keys, blocks, lanes);
+
+    for (l = 0; l < lanes; l++) {
+        h = keys + 8 * l;
+        x = g + 4 * l;
+        b = blocks + 8 * l;
+
+        h[0] = b[4] ^ x[0];
+        h[1] = b[5] ^ x[1];
+        h[2] = b[6] ^ x[2];
+        h[3] = b[7] ^ x[3] ^ 1;
+
+        x[0] ^= b[0];
+        x[1] ^= b[1];
+        x[2] ^= b[2];
+        x[3] ^= b[3];
+    }
+}
+
+static void nxt_hash_iv(uint32 *h, uint32 *g)
+{
+    PACK32(pad     , g    );
+    PACK32(pad +  4, g + 1);
+    PACK32(pad +  8, g + 2);
+    PACK32(pad + 12, g + 3);
+    PACK32(pad + 16, h    );
+    PACK32(pad + 20, h + 1);
+    PACK32(pad + 24, h + 2);
+    PACK32(pad + 28, h + 3);
+}
+
+static void nxt_hash_digest(const uint32 *h, const uint32 *g, uint8 *digest)
+{
+    UNPACK32(g[0], digest     );
+    UNPACK32(g[1], digest +  4);
+    UNPACK32(g[2], digest +  8);
+    UNPACK32(g[3], digest + 12);
+    UNPACK32(h[0], digest + 16);
+    UNPACK32(h[1], digest + 20);
+    UNPACK32(h[2], digest + 24);
+    UNPACK32(h[3], digest + 28);
+}
+
+void nxt_hash_init(nxt_hash_ctx *ctx)
+{
+    nxt_hash_iv(ctx->key, ctx->g);
+    ctx->buf_len = 0;
+    ctx->len_lo = 0;
+    ctx->len_hi = 0;
+}
+
+void nxt_hash_update(nxt_hash_ctx *ctx, const uint8 *msg, size_t len)
+{
+    size_t n;
+
+    /* The length is counted modulo 2^64 bytes */
+    ctx->len_lo += (uint32) len;
+    if (ctx->len_lo < (uint32) len)
+        ctx->len_hi++;
+    ctx->len_hi += (uint32) ((len >> 16) >> 16);
+
+    if (ctx->buf_len > 0) {
+        n = NXT_HASH_BLOCK_SIZE - ctx->buf_len;
+        if (n > len)
+            n = len;
+
+        memcpy(ctx->buf + ctx->buf_len, msg, n);
+        ctx->buf_len += n;
+        msg += n;
+        len -= n;
+
+        if (ctx->buf_len < NXT_HASH_BLOCK_SIZE)
+            return;
+
+        PACK32(ctx->buf     , ctx->key + 4);
+        PACK32(ctx->buf +  4, ctx->key + 5);
+        PACK32(ctx->buf +  8, ctx->key + 6);
+        PACK32(ctx->buf + 12, ctx->key + 7);
+        nxt_hash_compress(ctx->key, ctx->g, 1);
+        ctx->buf_len = 0;
+    }
+
+    for (; len >= NXT_HASH_BLOCK_SIZE; len -= NXT_HASH_BLOCK_SIZE,
+                                       msg += NXT_HASH_BLOCK_SIZE) {
+        PACK32(msg     , ctx->key + 4);
+        PACK32(msg +  4, ctx->key + 5);
+        PACK32(msg +  8, ctx->key + 6);
+        PACK32(msg + 12, ctx->key + 7);
+        nxt_hash_compress(ctx->key, ctx->g, 1);
+    }
+
+    memcpy(ctx->buf, msg, len);
+    ctx->buf_len = len;
+}
+
+void nxt_hash_final(nxt_hash_ctx *ctx, uint8 *digest)
+{
+    uint32 bits_hi, bits_lo;
+
+    bits_hi = (ctx->len_hi << 3) | (ctx->len_lo >> 29);
+    bits_lo = ctx->len_lo << 3;
+
+    ctx->buf[ctx->buf_len++] = 0x80;
+    memset(ctx->buf + ctx->buf_len, 0, NXT_HASH_BLOCK_SIZE - ctx->buf_len);
+
+    if (ctx->buf_len > NXT_HASH_BLOCK_SIZE - 8) {
+        PACK32(ctx->buf     , ctx->key + 4);
+        PACK32(ctx->buf +  4, ctx->key + 5);
+        PACK32(ctx->buf +  8, ctx->key + 6);
+        PACK32(ctx->buf + 12, ctx->key + 7);
+        nxt_hash_compress(ctx->key, ctx->g, 1);
+        memset(ctx->buf, 0, NXT_HASH_BLOCK_SIZE);
+    }
+
+    PACK32(ctx->buf    , ctx->key + 4);
+    PACK32(ctx->buf + 4, ctx->key + 5);
+    ctx->key[6] = bits_hi;
+    ctx->key[7] = bits_lo;
+    nxt_hash_compress(ctx->key, ctx->g, 1);
+
+    nxt_hash_digest(ctx->key, ctx->g, digest);
+    nxt_wipe(ctx, sizeof(*ctx));
+}
+
+void nxt_hash(const uint8 *msg, size_t len, uint8 *digest)
+{
+    nxt_hash_ctx ctx;
+
+    nxt_hash_init(&ctx);
+    nxt_hash_update(&ctx, msg, len);
+    nxt_hash_final(&ctx, digest);
+}
+
+#define HASH_BLOCKS(len) (((len) + 1 + 8 + NXT_HASH_BLOCK_SIZE - 1) \
+                          / NXT_HASH_BLOCK_SIZE)
+
+/*
+ * Loads block pos of the padded message in m.
+ */
+static void nxt_hash_block(const uint8 *msg, size_t len, size_t pos,
+                           uint32 *m)
+{
+    uint8 block[NXT_HASH_BLOCK_SIZE];
+    size_t off;
+
+    off = pos * NXT_HASH_BLOCK_SIZE;
+
+    if (off + NXT_HASH_BLOCK_SIZE <= len) {
+        PACK32(msg + off     , m    );
+        PACK32(msg + off +  4, m + 1);
+        PACK32(msg + off +  8, m + 2);
+        PACK32(msg + off + 12, m + 3);
+        return;
+    }
+
+    memset(block, 0, sizeof(block));
+    if (off <= len) {
+        memcpy(block, msg + off, len - off);
+        block[len - off] = 0x80;
+    }
+
+    PACK32(block     , m    );
+    PACK32(block +  4, m + 1);
+    PACK32(block +  8, m + 2);
+    PACK32(block + 12, m + 3);
+
+    if (pos + 1 == HASH_BLOCKS(len)) {
+        m[2] = (uint32) (len >> 29);
+        m[3] = (uint32) len << 3;
+    }
+}
+
+/*
+ * The lanes are sorted by decreasing number of blocks, the lanes still
+ * running at a given block position always form a prefix of the states.
+ */
+void nxt_hash_batch(const uint8 *const *msg, const size_t *len,
+                    uint8 *digest, size_t count)
+{
+    uint32 keys[NXT_HASH_LANES * 8];
+    uint32 g[NXT_HASH_LANES * 4];
+    size_t order[NXT_HASH_LANES];
+    size_t blocks[NXT_HASH_LANES];
+    size_t lanes;
+    size_t active;
+    size_t pos;
+    size_t n;
+    size_t i, k;
+
+    for (; count > 0; count -= lanes, msg += lanes, len += lanes,
+                      digest += lanes * NXT_HASH_SIZE) {
+        lanes = (count < NXT_HASH_LANES) ? count : NXT_HASH_LANES;
+
+        for (i = 0; i < lanes; i++) {
+            n = HASH_BLOCKS(len[i]);
+            for (k = i; (k > 0) && (blocks[k - 1] < n); k--) {
+                blocks[k] = blocks[k - 1];
+                order[k] = order[k - 1];
+            }
+            blocks[k] = n;
+            order[k] = i;
+
+            nxt_hash_iv(keys + 8 * i, g + 4 * i);
+        }
+
+        active = lanes;
+
+        for (pos = 0; pos < blocks[0]; pos++) {
+            while (blocks[active - 1] <= pos) {
+                active--;
+            }
+
+            for (k = 0; k < active; k++) {
+                nxt_hash_block(msg[order[k]], len[order[k]], pos,
+                               keys + 8 * k + 4);
+            }
+
+            nxt_hash_compress(keys, g, active);
+        }
+
+        for (k = 0; k < lanes; k++) {
+            nxt_hash_digest(keys + 8 * k, g + 4 * k,
+                            digest + order[k] * NXT_HASH_SIZE);
+        }
+    }
+}
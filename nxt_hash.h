@@ -0,0 +1,77 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_HASH_H
+#define NXT_HASH_H
+
+#include "nxt128.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 256-bit hash function built on NXT128 with 256-bit keys used in the
+ * Hirose double-block-length compression function:
+ *
+ *     G' = E(H || M, G) ^ G
+ *     H' = E(H || M, G ^ c) ^ G ^ c
+ *
+ * with the usual Merkle-Damgard padding (0x80, zeros, 64-bit length in
+ * bits). Both encryptions of a compression share one key which is never
+ * expanded: see nxt128_ks256_encrypt2(). The batch function hashes up
+ * to NXT_HASH_LANES messages together.
+ */
+#define NXT_HASH_SIZE       32
+#define NXT_HASH_BLOCK_SIZE 16
+#define NXT_HASH_LANES      8
+
+typedef struct {
+    uint32 key[8];
+    uint32 g[4];
+    uint8 buf[NXT_HASH_BLOCK_SIZE];
+    size_t buf_len;
+    uint32 len_lo;
+    uint32 len_hi;
+} nxt_hash_ctx;
+
+void nxt_hash_init(nxt_hash_ctx *ctx);
+void nxt_hash_update(nxt_hash_ctx *ctx, const uint8 *msg, size_t len);
+void nxt_hash_final(nxt_hash_ctx *ctx, uint8 *digest);
+void nxt_hash(const uint8 *msg, size_t len, uint8 *digest);
+void nxt_hash_batch(const uint8 *const *msg, const size_t *len,
+                    uint8 *digest, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_HASH_H */
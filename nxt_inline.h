@@ -0,0 +1,383 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_INLINE_H
+#define NXT_INLINE_H
+
+/*
+ * Single-block NXT64 and NXT128 for latency-bound callers (tokens, IDs,
+ * 16-byte handles), as static inline functions with the signatures of
+ * nxt64_encrypt() and friends:
+ *
+ *     nxt64_encrypt_inline(ctx, in, out);
+ *     nxt128_decrypt_inline(ctx, in, out);
+ *
+ * The results are those of the library functions. What changes is the
+ * dependency chain between two rounds. The library function computes
+ * f = k0 ^ sigma(h), then x0 = OR(x0 ^ f) and x1 ^= f, and only then the
+ * input x0 ^ x1 ^ k0' of the next round. Since the orthomorphism OR is
+ * linear and OR + I = IO, that input is also
+ *
+ *     OR(x0) ^ x1 ^ k0' ^ IO(k0) ^ IO(sigma(h))
+ *
+ * where everything but the last term is known early in the round, with
+ * the round keys of the next round loaded ahead, and IO(sigma(h)) is
+ * read from tables like sigma(h). The state x0, x1 is updated off the
+ * critical path, from sigma(h) = OR(IO(sigma(h))). Decryption is the
+ * same with OR and IO swapped. The blocks are loaded and stored as whole
+ * words where the byte order is known.
+ *
+ * The including file gets its own copy of the tables it uses (about
+ * 9 KB for NXT64 and 21 KB for NXT128). With NXT64_INIT_TABLES or
+ * NXT128_INIT_TABLES there are no precalculated tables, and the
+ * functions of the corresponding variant call the library.
+ */
+
+#include <string.h>
+
+#include "nxt_common.h"
+#include "nxt64.h"
+#include "nxt128.h"
+
+#if defined(__GNUC__)
+#define NXT_INLINE static __inline__
+#else
+#define NXT_INLINE static
+#endif
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) \
+    && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define NXT_LOAD32(p, x)                   \
+{                                          \
+    memcpy(x, p, 4);                       \
+    *(x) = __builtin_bswap32(*(x));        \
+}
+#define NXT_STORE32(x, p)                  \
+{                                          \
+    uint32 nxt_tmp = __builtin_bswap32(x); \
+    memcpy(p, &nxt_tmp, 4);                \
+}
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define NXT_LOAD32(p, x)  memcpy(x, p, 4)
+#define NXT_STORE32(x, p) \
+{                         \
+    uint32 nxt_tmp = x;   \
+    memcpy(p, &nxt_tmp, 4); \
+}
+#else
+#define NXT_LOAD32(p, x)  PACK32(p, x)
+#define NXT_STORE32(x, p) UNPACK32(x, p)
+#endif
+
+#define NXT_OR32(x) (((x) << 16) ^ ((x) >> 16) ^ ((x) & 0x0000ffff))
+#define NXT_IO32(x) (((x) << 16) ^ ((x) >> 16) ^ ((x) & 0xffff0000))
+
+#define NXT_B0(x) ((x) >> 24)
+#define NXT_B1(x) (((x) >> 16) & 0xff)
+#define NXT_B2(x) (((x) >> 8) & 0xff)
+#define NXT_B3(x) ((x) & 0xff)
+
+#if (!defined NXT64_INIT_TABLES) || (!defined NXT128_INIT_TABLES)
+#include "nxt_inline_tables.h"
+#endif
+
+/*
+ * NXT64
+ */
+#ifdef NXT64_INIT_TABLES
+
+NXT_INLINE void nxt64_encrypt_inline(const nxt64_ctx *ctx, const uint8 *in,
+                                     uint8 *out)
+{
+    nxt64_encrypt((nxt64_ctx *) ctx, in, out);
+}
+
+NXT_INLINE void nxt64_decrypt_inline(const nxt64_ctx *ctx, const uint8 *in,
+                                     uint8 *out)
+{
+    nxt64_decrypt((nxt64_ctx *) ctx, in, out);
+}
+
+#else /* !NXT64_INIT_TABLES */
+#include "nxt64_tables.h"
+
+#define NXT64_MU4(x)              \
+      tbsm0_64[NXT_B0(x)]         \
+    ^ tbsm1_64[NXT_B1(x)]         \
+    ^ tbsm2_64[NXT_B2(x)]         \
+    ^ tbsm3_64[NXT_B3(x)]
+
+#define NXT64_SIGMA(x)            \
+      tbs0_64[NXT_B0(x)]          \
+    ^ tbs1_64[NXT_B1(x)]          \
+    ^ tbs2_64[NXT_B2(x)]          \
+    ^ tbs3_64[NXT_B3(x)]
+
+/* IO(sigma(x)) and OR(sigma(x)) */
+#define NXT64_SIGMA_IO(x)         \
+      tbio0[NXT_B0(x)]            \
+    ^ tbio1[NXT_B1(x)]            \
+    ^ tbs0_64[NXT_B2(x)]          \
+    ^ tbs1_64[NXT_B3(x)]
+
+#define NXT64_SIGMA_OR(x)         \
+      tbs2_64[NXT_B0(x)]          \
+    ^ tbs3_64[NXT_B1(x)]          \
+    ^ tbio0[NXT_B2(x)]            \
+    ^ tbio1[NXT_B3(x)]
+
+NXT_INLINE void nxt64_encrypt_inline(const nxt64_ctx *ctx, const uint8 *in,
+                                     uint8 *out)
+{
+    const uint32 *rk = ctx->rk;
+    uint32 x0, x1;
+    uint32 g, h, z, f, a;
+    int i;
+
+    NXT_LOAD32(in    , &x0);
+    NXT_LOAD32(in + 4, &x1);
+
+    g = x0 ^ x1 ^ rk[0];
+
+    for (i = 0; i < NXT64_TOTAL_ROUNDS - 1; i++) {
+        a = NXT_OR32(x0) ^ x1 ^ rk[2] ^ NXT_IO32(rk[0]);
+        h = rk[1] ^ NXT64_MU4(g);
+        z = NXT64_SIGMA_IO(h);
+        g = a ^ z;
+
+        f = rk[0] ^ NXT_OR32(z);
+        x0 ^= f;
+        x0 = NXT_OR32(x0);
+        x1 ^= f;
+        rk += 2;
+    }
+
+    h = rk[1] ^ NXT64_MU4(g);
+    f = rk[0] ^ NXT64_SIGMA(h);
+    x0 ^= f;
+    x1 ^= f;
+
+    NXT_STORE32(x0, out    );
+    NXT_STORE32(x1, out + 4);
+}
+
+NXT_INLINE void nxt64_decrypt_inline(const nxt64_ctx *ctx, const uint8 *in,
+                                     uint8 *out)
+{
+    const uint32 *rk = ctx->rk + 2 * (NXT64_TOTAL_ROUNDS - 1);
+    uint32 x0, x1;
+    uint32 g, h, z, f, a;
+    int i;
+
+    NXT_LOAD32(in    , &x0);
+    NXT_LOAD32(in + 4, &x1);
+
+    g = x0 ^ x1 ^ rk[0];
+
+    for (i = 0; i < NXT64_TOTAL_ROUNDS - 1; i++) {
+        a = NXT_IO32(x0) ^ x1 ^ rk[-2] ^ NXT_OR32(rk[0]);
+        h = rk[1] ^ NXT64_MU4(g);
+        z = NXT64_SIGMA_OR(h);
+        g = a ^ z;
+
+        f = rk[0] ^ NXT_IO32(z);
+        x0 ^= f;
+        x0 = NXT_IO32(x0);
+        x1 ^= f;
+        rk -= 2;
+    }
+
+    h = rk[1] ^ NXT64_MU4(g);
+    f = rk[0] ^ NXT64_SIGMA(h);
+    x0 ^= f;
+    x1 ^= f;
+
+    NXT_STORE32(x0, out    );
+    NXT_STORE32(x1, out + 4);
+}
+
+#endif /* !NXT64_INIT_TABLES */
+
+/*
+ * NXT128: the same on the two halves (x0, x1) and (x2, x3)
+ */
+#ifdef NXT128_INIT_TABLES
+
+NXT_INLINE void nxt128_encrypt_inline(const nxt128_ctx *ctx, const uint8 *in,
+                                      uint8 *out)
+{
+    nxt128_encrypt((nxt128_ctx *) ctx, in, out);
+}
+
+NXT_INLINE void nxt128_decrypt_inline(const nxt128_ctx *ctx, const uint8 *in,
+                                      uint8 *out)
+{
+    nxt128_decrypt((nxt128_ctx *) ctx, in, out);
+}
+
+#else /* !NXT128_INIT_TABLES */
+#include "nxt128_tables.h"
+
+#define NXT128_MU8(x, y, j)                  \
+      tbsm0_128[(NXT_B0(x) << 1) + (j)]      \
+    ^ tbsm1_128[(NXT_B1(x) << 1) + (j)]      \
+    ^ tbsm2_128[(NXT_B2(x) << 1) + (j)]      \
+    ^ tbsm3_128[(NXT_B3(x) << 1) + (j)]      \
+    ^ tbsm4_128[(NXT_B0(y) << 1) + (j)]      \
+    ^ tbsm5_128[(NXT_B1(y) << 1) + (j)]      \
+    ^ tbsm6_128[(NXT_B2(y) << 1) + (j)]      \
+    ^ tbsm7_128[(NXT_B3(y) << 1) + (j)]
+
+#define NXT128_SIGMA(x)           \
+      tbs0_128[NXT_B0(x)]         \
+    ^ tbs1_128[NXT_B1(x)]         \
+    ^ tbs2_128[NXT_B2(x)]         \
+    ^ tbs3_128[NXT_B3(x)]
+
+#define NXT128_SIGMA_IO(x)        \
+      tbio0[NXT_B0(x)]            \
+    ^ tbio1[NXT_B1(x)]            \
+    ^ tbs0_128[NXT_B2(x)]         \
+    ^ tbs1_128[NXT_B3(x)]
+
+#define NXT128_SIGMA_OR(x)        \
+      tbs2_128[NXT_B0(x)]         \
+    ^ tbs3_128[NXT_B1(x)]         \
+    ^ tbio0[NXT_B2(x)]            \
+    ^ tbio1[NXT_B3(x)]
+
+NXT_INLINE void nxt128_encrypt_inline(const nxt128_ctx *ctx, const uint8 *in,
+                                      uint8 *out)
+{
+    const uint32 *rk = ctx->rk;
+    uint32 x0, x1, x2, x3;
+    uint32 g0, g1, h0, h1, z0, z1, f0, f1, a0, a1;
+    int i;
+
+    NXT_LOAD32(in     , &x0);
+    NXT_LOAD32(in +  4, &x1);
+    NXT_LOAD32(in +  8, &x2);
+    NXT_LOAD32(in + 12, &x3);
+
+    g0 = x0 ^ x1 ^ rk[0];
+    g1 = x2 ^ x3 ^ rk[1];
+
+    for (i = 0; i < NXT128_TOTAL_ROUNDS - 1; i++) {
+        a0 = NXT_OR32(x0) ^ x1 ^ rk[4] ^ NXT_IO32(rk[0]);
+        a1 = NXT_OR32(x2) ^ x3 ^ rk[5] ^ NXT_IO32(rk[1]);
+        h0 = rk[2] ^ NXT128_MU8(g0, g1, 0);
+        h1 = rk[3] ^ NXT128_MU8(g0, g1, 1);
+        z0 = NXT128_SIGMA_IO(h0);
+        z1 = NXT128_SIGMA_IO(h1);
+        g0 = a0 ^ z0;
+        g1 = a1 ^ z1;
+
+        f0 = rk[0] ^ NXT_OR32(z0);
+        f1 = rk[1] ^ NXT_OR32(z1);
+        x0 ^= f0;
+        x0 = NXT_OR32(x0);
+        x1 ^= f0;
+        x2 ^= f1;
+        x2 = NXT_OR32(x2);
+        x3 ^= f1;
+        rk += 4;
+    }
+
+    h0 = rk[2] ^ NXT128_MU8(g0, g1, 0);
+    h1 = rk[3] ^ NXT128_MU8(g0, g1, 1);
+    f0 = rk[0] ^ NXT128_SIGMA(h0);
+    f1 = rk[1] ^ NXT128_SIGMA(h1);
+    x0 ^= f0;
+    x1 ^= f0;
+    x2 ^= f1;
+    x3 ^= f1;
+
+    NXT_STORE32(x0, out     );
+    NXT_STORE32(x1, out +  4);
+    NXT_STORE32(x2, out +  8);
+    NXT_STORE32(x3, out + 12);
+}
+
+NXT_INLINE void nxt128_decrypt_inline(const nxt128_ctx *ctx, const uint8 *in,
+                                      uint8 *out)
+{
+    const uint32 *rk = ctx->rk + 4 * (NXT128_TOTAL_ROUNDS - 1);
+    uint32 x0, x1, x2, x3;
+    uint32 g0, g1, h0, h1, z0, z1, f0, f1, a0, a1;
+    int i;
+
+    NXT_LOAD32(in     , &x0);
+    NXT_LOAD32(in +  4, &x1);
+    NXT_LOAD32(in +  8, &x2);
+    NXT_LOAD32(in + 12, &x3);
+
+    g0 = x0 ^ x1 ^ rk[0];
+    g1 = x2 ^ x3 ^ rk[1];
+
+    for (i = 0; i < NXT128_TOTAL_ROUNDS - 1; i++) {
+        a0 = NXT_IO32(x0) ^ x1 ^ rk[-4] ^ NXT_OR32(rk[0]);
+        a1 = NXT_IO32(x2) ^ x3 ^ rk[-3] ^ NXT_OR32(rk[1]);
+        h0 = rk[2] ^ NXT128_MU8(g0, g1, 0);
+        h1 = rk[3] ^ NXT128_MU8(g0, g1, 1);
+        z0 = NXT128_SIGMA_OR(h0);
+        z1 = NXT128_SIGMA_OR(h1);
+        g0 = a0 ^ z0;
+        g1 = a1 ^ z1;
+
+        f0 = rk[0] ^ NXT_IO32(z0);
+        f1 = rk[1] ^ NXT_IO32(z1);
+        x0 ^= f0;
+        x0 = NXT_IO32(x0);
+        x1 ^= f0;
+        x2 ^= f1;
+        x2 = NXT_IO32(x2);
+        x3 ^= f1;
+        rk -= 4;
+    }
+
+    h0 = rk[2] ^ NXT128_MU8(g0, g1, 0);
+    h1 = rk[3] ^ NXT128_MU8(g0, g1, 1);
+    f0 = rk[0] ^ NXT128_SIGMA(h0);
+    f1 = rk[1] ^ NXT128_SIGMA(h1);
+    x0 ^= f0;
+    x1 ^= f0;
+    x2 ^= f1;
+    x3 ^= f1;
+
+    NXT_STORE32(x0, out     );
+    NXT_STORE32(x1, out +  4);
+    NXT_STORE32(x2, out +  8);
+    NXT_STORE32(x3, out + 12);
+}
+
+#endif /* !NXT128_INIT_TABLES */
+
+#endif /* !NXT_INLINE_H */
@@ -0,0 +1,131 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Generated by nxt_gentables from the S-box, do not edit */
+#ifndef NXT_INLINE_TABLES_H
+#define NXT_INLINE_TABLES_H
+
+#include "nxt_common.h"
+
+/* IO(sigma(x)) for the bytes 0 and 1 of x */
+static const uint32 tbio0[256] = {
+    0x5d005d00, 0xde00de00, 0x00000000, 0xb700b700, 0xd300d300, 0xca00ca00,
+    0x3c003c00, 0x0d000d00, 0xc300c300, 0xf800f800, 0xcb00cb00, 0x8d008d00,
+    0x76007600, 0x89008900, 0xaa00aa00, 0x12001200, 0x88008800, 0x22002200,
+    0x4f004f00, 0xdb00db00, 0x6d006d00, 0x47004700, 0xe400e400, 0x4c004c00,
+    0x78007800, 0x9a009a00, 0x49004900, 0x93009300, 0xc400c400, 0xc000c000,
+    0x86008600, 0x13001300, 0xa900a900, 0x20002000, 0x53005300, 0x1c001c00,
+    0x4e004e00, 0xcf00cf00, 0x35003500, 0x39003900, 0xb400b400, 0xa100a100,
+    0x54005400, 0x64006400, 0x03000300, 0xc700c700, 0x85008500, 0x5c005c00,
+    0x5b005b00, 0xcd00cd00, 0xd800d800, 0x72007200, 0x96009600, 0x42004200,
+    0xb800b800, 0xe100e100, 0xa200a200, 0x60006000, 0xef00ef00, 0xbd00bd00,
+    0x02000200, 0xaf00af00, 0x8c008c00, 0x73007300, 0x7c007c00, 0x7f007f00,
+    0x5e005e00, 0xf900f900, 0x65006500, 0xe600e600, 0xeb00eb00, 0xad00ad00,
+    0x5a005a00, 0xa500a500, 0x79007900, 0x8e008e00, 0x15001500, 0x30003000,
+    0xec00ec00, 0xa400a400, 0xc200c200, 0x3e003e00, 0xe000e000, 0x74007400,
+    0x51005100, 0xfb00fb00, 0x2d002d00, 0x6e006e00, 0x94009400, 0x4d004d00,
+    0x55005500, 0x34003400, 0xae00ae00, 0x52005200, 0x7e007e00, 0x9d009d00,
+    0x4a004a00, 0xf700f700, 0x80008000, 0xf000f000, 0xd000d000, 0x90009000,
+    0xa700a700, 0xe800e800, 0x9f009f00, 0x50005000, 0xd500d500, 0xd100d100,
+    0x98009800, 0xcc00cc00, 0xa000a000, 0x17001700, 0xf400f400, 0xb600b600,
+    0xc100c100, 0x28002800, 0x5f005f00, 0x26002600, 0x01000100, 0xab00ab00,
+    0x25002500, 0x38003800, 0x82008200, 0x7d007d00, 0x48004800, 0xfc00fc00,
+    0x1b001b00, 0xce00ce00, 0x3f003f00, 0x6b006b00, 0xe200e200, 0x67006700,
+    0x66006600, 0x43004300, 0x59005900, 0x19001900, 0x84008400, 0x3d003d00,
+    0xf500f500, 0x2f002f00, 0xc900c900, 0xbc00bc00, 0xd900d900, 0x95009500,
+    0x29002900, 0x41004100, 0xda00da00, 0x1a001a00, 0xb000b000, 0xe900e900,
+    0x69006900, 0xd200d200, 0x7b007b00, 0xd700d700, 0x11001100, 0x9b009b00,
+    0x33003300, 0x8a008a00, 0x23002300, 0x09000900, 0xd400d400, 0x71007100,
+    0x44004400, 0x68006800, 0x6f006f00, 0xf200f200, 0x0e000e00, 0xdf00df00,
+    0x87008700, 0xdc00dc00, 0x83008300, 0x18001800, 0x6a006a00, 0xee00ee00,
+    0x99009900, 0x81008100, 0x62006200, 0x36003600, 0x2e002e00, 0x7a007a00,
+    0xfe00fe00, 0x45004500, 0x9c009c00, 0x75007500, 0x91009100, 0x0c000c00,
+    0x0f000f00, 0xe700e700, 0xf600f600, 0x14001400, 0x63006300, 0x1d001d00,
+    0x0b000b00, 0x8b008b00, 0xb300b300, 0xf300f300, 0xb200b200, 0x3b003b00,
+    0x08000800, 0x4b004b00, 0x10001000, 0xa600a600, 0x32003200, 0xb900b900,
+    0xa800a800, 0x92009200, 0xf100f100, 0x56005600, 0xdd00dd00, 0x21002100,
+    0xbf00bf00, 0x04000400, 0xbe00be00, 0xd600d600, 0xfd00fd00, 0x77007700,
+    0xea00ea00, 0x3a003a00, 0xc800c800, 0x8f008f00, 0x57005700, 0x1e001e00,
+    0xfa00fa00, 0x2b002b00, 0x58005800, 0xc500c500, 0x27002700, 0xac00ac00,
+    0xe300e300, 0xed00ed00, 0x97009700, 0xbb00bb00, 0x46004600, 0x05000500,
+    0x40004000, 0x31003100, 0xe500e500, 0x37003700, 0x2c002c00, 0x9e009e00,
+    0x0a000a00, 0xb100b100, 0xb500b500, 0x06000600, 0x6c006c00, 0x1f001f00,
+    0xa300a300, 0x2a002a00, 0x70007000, 0xff00ff00, 0xba00ba00, 0x07000700,
+    0x24002400, 0x16001600, 0xc600c600, 0x61006100};
+
+static const uint32 tbio1[256] = {
+    0x005d005d, 0x00de00de, 0x00000000, 0x00b700b7, 0x00d300d3, 0x00ca00ca,
+    0x003c003c, 0x000d000d, 0x00c300c3, 0x00f800f8, 0x00cb00cb, 0x008d008d,
+    0x00760076, 0x00890089, 0x00aa00aa, 0x00120012, 0x00880088, 0x00220022,
+    0x004f004f, 0x00db00db, 0x006d006d, 0x00470047, 0x00e400e4, 0x004c004c,
+    0x00780078, 0x009a009a, 0x00490049, 0x00930093, 0x00c400c4, 0x00c000c0,
+    0x00860086, 0x00130013, 0x00a900a9, 0x00200020, 0x00530053, 0x001c001c,
+    0x004e004e, 0x00cf00cf, 0x00350035, 0x00390039, 0x00b400b4, 0x00a100a1,
+    0x00540054, 0x00640064, 0x00030003, 0x00c700c7, 0x00850085, 0x005c005c,
+    0x005b005b, 0x00cd00cd, 0x00d800d8, 0x00720072, 0x00960096, 0x00420042,
+    0x00b800b8, 0x00e100e1, 0x00a200a2, 0x00600060, 0x00ef00ef, 0x00bd00bd,
+    0x00020002, 0x00af00af, 0x008c008c, 0x00730073, 0x007c007c, 0x007f007f,
+    0x005e005e, 0x00f900f9, 0x00650065, 0x00e600e6, 0x00eb00eb, 0x00ad00ad,
+    0x005a005a, 0x00a500a5, 0x00790079, 0x008e008e, 0x00150015, 0x00300030,
+    0x00ec00ec, 0x00a400a4, 0x00c200c2, 0x003e003e, 0x00e000e0, 0x00740074,
+    0x00510051, 0x00fb00fb, 0x002d002d, 0x006e006e, 0x00940094, 0x004d004d,
+    0x00550055, 0x00340034, 0x00ae00ae, 0x00520052, 0x007e007e, 0x009d009d,
+    0x004a004a, 0x00f700f7, 0x00800080, 0x00f000f0, 0x00d000d0, 0x00900090,
+    0x00a700a7, 0x00e800e8, 0x009f009f, 0x00500050, 0x00d500d5, 0x00d100d1,
+    0x00980098, 0x00cc00cc, 0x00a000a0, 0x00170017, 0x00f400f4, 0x00b600b6,
+    0x00c100c1, 0x00280028, 0x005f005f, 0x00260026, 0x00010001, 0x00ab00ab,
+    0x00250025, 0x00380038, 0x00820082, 0x007d007d, 0x00480048, 0x00fc00fc,
+    0x001b001b, 0x00ce00ce, 0x003f003f, 0x006b006b, 0x00e200e2, 0x00670067,
+    0x00660066, 0x00430043, 0x00590059, 0x00190019, 0x00840084, 0x003d003d,
+    0x00f500f5, 0x002f002f, 0x00c900c9, 0x00bc00bc, 0x00d900d9, 0x00950095,
+    0x00290029, 0x00410041, 0x00da00da, 0x001a001a, 0x00b000b0, 0x00e900e9,
+    0x00690069, 0x00d200d2, 0x007b007b, 0x00d700d7, 0x00110011, 0x009b009b,
+    0x00330033, 0x008a008a, 0x00230023, 0x00090009, 0x00d400d4, 0x00710071,
+    0x00440044, 0x00680068, 0x006f006f, 0x00f200f2, 0x000e000e, 0x00df00df,
+    0x00870087, 0x00dc00dc, 0x00830083, 0x00180018, 0x006a006a, 0x00ee00ee,
+    0x00990099, 0x00810081, 0x00620062, 0x00360036, 0x002e002e, 0x007a007a,
+    0x00fe00fe, 0x00450045, 0x009c009c, 0x00750075, 0x00910091, 0x000c000c,
+    0x000f000f, 0x00e700e7, 0x00f600f6, 0x00140014, 0x00630063, 0x001d001d,
+    0x000b000b, 0x008b008b, 0x00b300b3, 0x00f300f3, 0x00b200b2, 0x003b003b,
+    0x00080008, 0x004b004b, 0x00100010, 0x00a600a6, 0x00320032, 0x00b900b9,
+    0x00a800a8, 0x00920092, 0x00f100f1, 0x00560056, 0x00dd00dd, 0x00210021,
+    0x00bf00bf, 0x00040004, 0x00be00be, 0x00d600d6, 0x00fd00fd, 0x00770077,
+    0x00ea00ea, 0x003a003a, 0x00c800c8, 0x008f008f, 0x00570057, 0x001e001e,
+    0x00fa00fa, 0x002b002b, 0x00580058, 0x00c500c5, 0x00270027, 0x00ac00ac,
+    0x00e300e3, 0x00ed00ed, 0x00970097, 0x00bb00bb, 0x00460046, 0x00050005,
+    0x00400040, 0x00310031, 0x00e500e5, 0x00370037, 0x002c002c, 0x009e009e,
+    0x000a000a, 0x00b100b1, 0x00b500b5, 0x00060006, 0x006c006c, 0x001f001f,
+    0x00a300a3, 0x002a002a, 0x00700070, 0x00ff00ff, 0x00ba00ba, 0x00070007,
+    0x00240024, 0x00160016, 0x00c600c6, 0x00610061};
+
+#endif /* !NXT_INLINE_TABLES_H */
+
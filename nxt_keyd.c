@@ -0,0 +1,928 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifdef __linux__
+#define _GNU_SOURCE
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include "nxt_common.h"
+#include "nxt_modes.h"
+#include "nxt_mb.h"
+#include "nxt_keyd.h"
+
+#ifndef __GNUC__
+#error nxt_keyd requires the __atomic builtins of GCC or Clang
+#endif
+
+#define LOAD_ACQ(p)    __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define LOAD_SC(p)     __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define STORE_SC(p, v) __atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+#define XCHG_SC(p, v)  __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST)
+
+#if defined(__linux__) && defined(SYS_futex)
+#define NXT_KEYD_FUTEX
+#endif
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC       0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define NXT_KEYD_MAGIC   0x4e58544bU   /* "NXTK" */
+#define NXT_KEYD_VERSION 1
+
+/* Number of empty polls before an idle side goes to sleep */
+#define NXT_KEYD_SPIN 64
+
+/* Longest sleep, after which a side checks the other one is still there */
+#define NXT_KEYD_NAP_NS 100000000L
+
+/*
+ * Start of the shared segment. Each group of fields is written by one
+ * side only, except the sleeping flags which the other side clears to
+ * wake the sleeper. The segment then holds the submission ring, the
+ * completion ring, the request descriptors and the data areas.
+ */
+typedef struct {
+    uint32 magic;
+    uint32 version;
+    uint32 slots;
+    uint32 slot_size;
+    uint8 pad0[48];
+    uint32 sq_tail;             /* client */
+    uint32 cq_head;
+    uint32 client_sleeping;
+    uint8 pad1[52];
+    uint32 sq_head;             /* server */
+    uint32 cq_tail;
+    uint32 server_sleeping;
+    uint8 pad2[52];
+} nxt_keyd_shm;
+
+typedef struct {
+    size_t sq;
+    size_t cq;
+    size_t reqs;
+    size_t data;
+    size_t size;
+} nxt_keyd_layout;
+
+/* Connection handshake, then the reply status and the segment */
+typedef struct {
+    uint32 magic;
+    uint32 version;
+    uint32 slots;
+    uint32 slot_size;
+} nxt_keyd_hello;
+
+typedef struct {
+    uint32 id;
+    nxt128_eax_ctx eax;
+} nxt_keyd_key;
+
+typedef struct nxt_keyd_session {
+    nxt_keyd_server *srv;
+    pthread_t tid;
+    int sock;
+    int done;
+    uint8 *base;
+    size_t size;
+    nxt_keyd_shm *shm;
+    uint32 *sq;
+    uint32 *cq;
+    nxt_keyd_req *reqs;
+    uint8 *data;
+    uint32 slots;
+    uint32 slot_size;
+    uint32 sq_head;
+    uint32 cq_tail;
+    nxt_mb_mgr mgr;
+    nxt_mb_job jobs[NXT_KEYD_BATCH];
+    uint32 job_slot[NXT_KEYD_BATCH];
+    struct nxt_keyd_session *next;
+} nxt_keyd_session;
+
+struct nxt_keyd_server {
+    int sock;
+    int stop;
+    char path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+    nxt_keyd_key *keys;
+    size_t nkeys;
+    nxt_keyd_session *sessions;
+};
+
+struct nxt_keyd {
+    int sock;
+    uint8 *base;
+    size_t size;
+    nxt_keyd_shm *shm;
+    uint32 *sq;
+    uint32 *cq;
+    nxt_keyd_req *reqs;
+    uint8 *data;
+    uint32 mask;
+    uint32 slot_size;
+    uint32 sq_tail;
+    uint32 cq_head;
+    uint32 inflight;
+    int *free;
+    int nfree;
+};
+
+static void nxt_keyd_get_layout(nxt_keyd_layout *l, size_t slots,
+                                size_t slot_size)
+{
+    l->sq = (sizeof(nxt_keyd_shm) + 63) & ~(size_t) 63;
+    l->cq = l->sq + slots * sizeof(uint32);
+    l->reqs = (l->cq + slots * sizeof(uint32) + 63) & ~(size_t) 63;
+    l->data = (l->reqs + slots * sizeof(nxt_keyd_req) + 63) & ~(size_t) 63;
+    l->size = l->data + slots * slot_size;
+}
+
+/* Sleeps while *addr is val, for NXT_KEYD_NAP_NS at most */
+static void nxt_keyd_sleep(uint32 *addr, uint32 val)
+{
+    struct timespec ts;
+
+    ts.tv_sec = 0;
+#ifdef NXT_KEYD_FUTEX
+    ts.tv_nsec = NXT_KEYD_NAP_NS;
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+#else
+    ts.tv_nsec = NXT_KEYD_NAP_NS / 100;
+    if (LOAD_SC(addr) == val)
+        nanosleep(&ts, NULL);
+#endif
+}
+
+static void nxt_keyd_wake(uint32 *addr)
+{
+    if (LOAD_SC(addr) && XCHG_SC(addr, 0)) {
+#ifdef NXT_KEYD_FUTEX
+        syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+    }
+}
+
+/* The peer closed its end of the socket */
+static int nxt_keyd_hangup(int sock)
+{
+    struct pollfd pfd;
+    char c;
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 0) <= 0)
+        return 0;
+    if (pfd.revents & (POLLHUP | POLLERR))
+        return 1;
+
+    return recv(sock, &c, 1, MSG_DONTWAIT) == 0;
+}
+
+/*
+ * Shared memory which the client cannot resize under the server: a
+ * client shrinking a mapped segment would make the server take a
+ * SIGBUS, so no segment is handed out without the seals.
+ */
+static int nxt_keyd_memfd(size_t size)
+{
+    int fd, err;
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+    fd = (int) syscall(SYS_memfd_create, "nxt_keyd",
+                       MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    char name[64];
+    static unsigned int seq;
+
+    sprintf(name, "/nxt_keyd.%ld.%u", (long) getpid(),
+            __atomic_fetch_add(&seq, 1, __ATOMIC_RELAXED));
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+        shm_unlink(name);
+#endif
+    if (fd < 0)
+        return -1;
+
+    if (ftruncate(fd, (off_t) size) != 0)
+        goto fail;
+#ifdef F_ADD_SEALS
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+        != 0)
+        goto fail;
+#else
+    errno = ENOTSUP;
+    goto fail;
+#endif
+
+    return fd;
+
+fail:
+    err = errno;
+    close(fd);
+    errno = err;
+
+    return -1;
+}
+
+static int nxt_keyd_send_fd(int sock, uint32 status, int fd)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        struct cmsghdr h;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } u;
+    struct cmsghdr *cmsg;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &status;
+    iov.iov_len = sizeof(status);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (fd >= 0) {
+        memset(&u, 0, sizeof(u));
+        msg.msg_control = u.buf;
+        msg.msg_controllen = sizeof(u.buf);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == (ssize_t) sizeof(status)
+           ? 0 : -1;
+}
+
+static int nxt_keyd_recv_fd(int sock, uint32 *status)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        struct cmsghdr h;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } u;
+    struct cmsghdr *cmsg;
+    int fd = -1;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = status;
+    iov.iov_len = sizeof(*status);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = u.buf;
+    msg.msg_controllen = sizeof(u.buf);
+
+    if (recvmsg(sock, &msg, 0) != (ssize_t) sizeof(*status))
+        return -2;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET
+        && cmsg->cmsg_type == SCM_RIGHTS)
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+    return fd;
+}
+
+static nxt_keyd_key *nxt_keyd_find(nxt_keyd_server *srv, uint32 id)
+{
+    size_t i;
+
+    for (i = 0; i < srv->nkeys; i++) {
+        if (srv->keys[i].id == id)
+            return &srv->keys[i];
+    }
+
+    return NULL;
+}
+
+/*
+ * Runs one request. The descriptor is read once: the client may change
+ * it meanwhile, but only to its own loss. A small CTR request is set up
+ * in job and 1 returned, the others are done on return.
+ */
+static int nxt_keyd_run_req(nxt_keyd_session *s, uint32 slot,
+                            nxt_mb_job *job)
+{
+    nxt_keyd_req *req = &s->reqs[slot];
+    uint8 *data = s->data + (size_t) slot * s->slot_size;
+    uint8 iv[NXT128_BLOCK_SIZE];
+    uint8 tag[NXT128_EAX_TAG_SIZE];
+    nxt_keyd_key *key;
+    uint32 op, len, ad_len;
+    int err;
+
+    op = req->op;
+    len = req->len;
+    ad_len = req->ad_len;
+    memcpy(iv, req->iv, sizeof(iv));
+
+    key = nxt_keyd_find(s->srv, req->key);
+    if (key == NULL) {
+        req->status = ENOENT;
+        return 0;
+    }
+
+    switch (op) {
+    case NXT_KEYD_CTR:
+        if (len > s->slot_size)
+            break;
+        req->status = 0;
+        if (len >= NXT_KEYD_DIRECT_SIZE) {
+            nxt128_ctr_crypt(&key->eax.cipher, iv, data, data, len);
+            return 0;
+        }
+        job->op = NXT_MB_CTR;
+        job->ctx = &key->eax.cipher;
+        job->in = data;
+        job->out = data;
+        job->len = len;
+        memcpy(job->iv, iv, sizeof(iv));
+        return 1;
+
+    case NXT_KEYD_EAX_SEAL:
+        if (ad_len > s->slot_size || len > s->slot_size - ad_len
+            || s->slot_size - ad_len - len < NXT128_EAX_TAG_SIZE)
+            break;
+        nxt128_eax_encrypt(&key->eax, iv, sizeof(iv), data, ad_len,
+                           data + ad_len, data + ad_len, len,
+                           data + ad_len + len);
+        req->status = 0;
+        return 0;
+
+    case NXT_KEYD_EAX_OPEN:
+        if (ad_len > s->slot_size || len > s->slot_size - ad_len
+            || s->slot_size - ad_len - len < NXT128_EAX_TAG_SIZE)
+            break;
+        memcpy(tag, data + ad_len + len, sizeof(tag));
+        err = nxt128_eax_decrypt(&key->eax, iv, sizeof(iv), data, ad_len,
+                                 data + ad_len, data + ad_len, len, tag);
+        req->status = (err == 0) ? 0 : EBADMSG;
+        return 0;
+    }
+
+    req->status = EINVAL;
+
+    return 0;
+}
+
+static void nxt_keyd_complete(nxt_keyd_session *s, uint32 slot)
+{
+    s->cq[s->cq_tail & (s->slots - 1)] = slot;
+    s->cq_tail++;
+}
+
+/*
+ * Runs the requests submitted so far, NXT_KEYD_BATCH at most, and
+ * returns their number, or -1 if the client broke the protocol.
+ */
+static int nxt_keyd_batch(nxt_keyd_session *s)
+{
+    nxt_mb_job *job;
+    uint32 tail;
+    uint32 slot;
+    int queued = 0;
+    int n = 0;
+
+    tail = LOAD_ACQ(&s->shm->sq_tail);
+    if (tail - s->sq_head > s->slots)
+        return -1;
+
+    while (s->sq_head != tail && n < NXT_KEYD_BATCH) {
+        slot = s->sq[s->sq_head & (s->slots - 1)];
+        s->sq_head++;
+        n++;
+        if (slot >= s->slots)
+            return -1;
+
+        if (!nxt_keyd_run_req(s, slot, &s->jobs[queued])) {
+            nxt_keyd_complete(s, slot);
+            continue;
+        }
+
+        s->job_slot[queued] = slot;
+        for (job = nxt_mb_submit(&s->mgr, &s->jobs[queued], 0); job != NULL;
+             job = nxt_mb_get_completed(&s->mgr)) {
+            nxt_keyd_complete(s, s->job_slot[job - s->jobs]);
+        }
+        queued++;
+    }
+
+    for (job = nxt_mb_flush(&s->mgr); job != NULL;
+         job = nxt_mb_get_completed(&s->mgr)) {
+        nxt_keyd_complete(s, s->job_slot[job - s->jobs]);
+    }
+
+    if (n > 0) {
+        STORE_REL(&s->shm->sq_head, s->sq_head);
+        STORE_SC(&s->shm->cq_tail, s->cq_tail);
+        nxt_keyd_wake(&s->shm->client_sleeping);
+    }
+
+    return n;
+}
+
+static int nxt_keyd_handshake(nxt_keyd_session *s)
+{
+    struct timeval tv;
+    nxt_keyd_hello h;
+    nxt_keyd_layout l;
+    uint32 status;
+    void *p;
+    int fd = -1;
+
+    /* A client which does not say hello only holds its own thread */
+    tv.tv_sec = 5;
+    tv.tv_usec = 0;
+    setsockopt(s->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    if (recv(s->sock, &h, sizeof(h), MSG_WAITALL) != (ssize_t) sizeof(h))
+        return -1;
+
+    status = EINVAL;
+    if (h.magic == NXT_KEYD_MAGIC && h.version == NXT_KEYD_VERSION
+        && h.slots > 0 && h.slots <= NXT_KEYD_MAX_SLOTS
+        && (h.slots & (h.slots - 1)) == 0 && h.slot_size > 0
+        && h.slot_size <= NXT_KEYD_MAX_SLOT_SIZE && h.slot_size % 64 == 0) {
+        nxt_keyd_get_layout(&l, h.slots, h.slot_size);
+        fd = nxt_keyd_memfd(l.size);
+        p = MAP_FAILED;
+        if (fd >= 0) {
+            p = mmap(NULL, l.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                     0);
+        }
+        if (p == MAP_FAILED) {
+            status = (uint32) errno;
+        } else {
+            s->base = (uint8 *) p;
+            s->size = l.size;
+            s->shm = (nxt_keyd_shm *) p;
+            s->sq = (uint32 *) (s->base + l.sq);
+            s->cq = (uint32 *) (s->base + l.cq);
+            s->reqs = (nxt_keyd_req *) (s->base + l.reqs);
+            s->data = s->base + l.data;
+            s->slots = h.slots;
+            s->slot_size = h.slot_size;
+            s->shm->magic = NXT_KEYD_MAGIC;
+            s->shm->version = NXT_KEYD_VERSION;
+            s->shm->slots = h.slots;
+            s->shm->slot_size = h.slot_size;
+            status = 0;
+        }
+    }
+
+    if (nxt_keyd_send_fd(s->sock, status, status == 0 ? fd : -1) != 0)
+        status = EPIPE;
+    if (fd >= 0)
+        close(fd);
+
+    return status == 0 ? 0 : -1;
+}
+
+static void *nxt_keyd_session_run(void *arg)
+{
+    nxt_keyd_session *s = (nxt_keyd_session *) arg;
+    int idle = 0;
+    int n;
+
+    if (nxt_keyd_handshake(s) != 0)
+        goto out;
+
+    for (;;) {
+        n = nxt_keyd_batch(s);
+        if (n < 0)
+            break;
+        if (n > 0) {
+            idle = 0;
+            continue;
+        }
+
+        if (LOAD_SC(&s->srv->stop))
+            break;
+        if (++idle < NXT_KEYD_SPIN) {
+            sched_yield();
+            continue;
+        }
+
+        STORE_SC(&s->shm->server_sleeping, 1);
+        if (LOAD_SC(&s->shm->sq_tail) == s->sq_head)
+            nxt_keyd_sleep(&s->shm->server_sleeping, 1);
+        STORE_SC(&s->shm->server_sleeping, 0);
+        idle = 0;
+
+        if (LOAD_SC(&s->shm->sq_tail) == s->sq_head
+            && nxt_keyd_hangup(s->sock))
+            break;
+    }
+
+out:
+    if (s->base != NULL)
+        munmap(s->base, s->size);
+    close(s->sock);
+    nxt_wipe(s->jobs, sizeof(s->jobs));
+    STORE_SC(&s->done, 1);
+
+    return NULL;
+}
+
+nxt_keyd_server *nxt_keyd_server_new(const char *path)
+{
+    nxt_keyd_server *srv;
+    struct sockaddr_un addr;
+    struct stat st;
+    mode_t mask;
+    int err;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+
+    srv = (nxt_keyd_server *) calloc(1, sizeof(nxt_keyd_server));
+    if (srv == NULL)
+        return NULL;
+    strcpy(srv->path, path);
+
+    srv->sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (srv->sock < 0) {
+        free(srv);
+        return NULL;
+    }
+
+    /* A socket left by a previous server is replaced */
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    mask = umask(077);
+    err = bind(srv->sock, (struct sockaddr *) &addr, sizeof(addr));
+    umask(mask);
+    if (err != 0 || listen(srv->sock, SOMAXCONN) != 0) {
+        err = errno;
+        close(srv->sock);
+        free(srv);
+        errno = err;
+        return NULL;
+    }
+
+    return srv;
+}
+
+int nxt_keyd_server_add_key(nxt_keyd_server *srv, uint32 id,
+                            const uint8 *key, uint16 key_len)
+{
+    nxt_keyd_key *keys;
+
+    if (nxt_keyd_find(srv, id) != NULL) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    keys = (nxt_keyd_key *) malloc((srv->nkeys + 1) * sizeof(nxt_keyd_key));
+    if (keys == NULL)
+        return -1;
+    if (srv->nkeys > 0) {
+        memcpy(keys, srv->keys, srv->nkeys * sizeof(nxt_keyd_key));
+        nxt_wipe(srv->keys, srv->nkeys * sizeof(nxt_keyd_key));
+        free(srv->keys);
+    }
+    srv->keys = keys;
+
+    keys[srv->nkeys].id = id;
+    nxt128_eax_init(&keys[srv->nkeys].eax, key, key_len);
+    srv->nkeys++;
+
+    return 0;
+}
+
+/* Joins the finished sessions, or all of them */
+static void nxt_keyd_reap(nxt_keyd_server *srv, int all)
+{
+    nxt_keyd_session **pp;
+    nxt_keyd_session *s;
+
+    pp = &srv->sessions;
+    while ((s = *pp) != NULL) {
+        if (!all && !LOAD_SC(&s->done)) {
+            pp = &s->next;
+            continue;
+        }
+        pthread_join(s->tid, NULL);
+        *pp = s->next;
+        free(s);
+    }
+}
+
+int nxt_keyd_server_run(nxt_keyd_server *srv)
+{
+    nxt_keyd_session *s;
+    struct pollfd pfd;
+    int sock;
+
+    pfd.fd = srv->sock;
+    pfd.events = POLLIN;
+
+    while (!LOAD_SC(&srv->stop)) {
+        nxt_keyd_reap(srv, 0);
+
+        if (poll(&pfd, 1, NXT_KEYD_NAP_NS / 1000000) <= 0)
+            continue;
+
+        sock = accept(srv->sock, NULL, NULL);
+        if (sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE
+                || errno == ENFILE || errno == EAGAIN)
+                continue;
+            nxt_keyd_reap(srv, 1);
+            return -1;
+        }
+
+        s = (nxt_keyd_session *) calloc(1, sizeof(nxt_keyd_session));
+        if (s == NULL) {
+            close(sock);
+            continue;
+        }
+        s->srv = srv;
+        s->sock = sock;
+        nxt_mb_init(&s->mgr, NXT128_BLOCK_SIZE, 0);
+
+        if (pthread_create(&s->tid, NULL, nxt_keyd_session_run, s) != 0) {
+            close(sock);
+            free(s);
+            continue;
+        }
+        s->next = srv->sessions;
+        srv->sessions = s;
+    }
+
+    nxt_keyd_reap(srv, 1);
+
+    return 0;
+}
+
+void nxt_keyd_server_stop(nxt_keyd_server *srv)
+{
+    STORE_SC(&srv->stop, 1);
+}
+
+/* The server must not be running */
+void nxt_keyd_server_free(nxt_keyd_server *srv)
+{
+    if (srv == NULL)
+        return;
+
+    close(srv->sock);
+    unlink(srv->path);
+    if (srv->nkeys > 0)
+        nxt_wipe(srv->keys, srv->nkeys * sizeof(nxt_keyd_key));
+    free(srv->keys);
+    free(srv);
+}
+
+nxt_keyd *nxt_keyd_connect(const char *path, size_t slots,
+                           size_t slot_size)
+{
+    struct sockaddr_un addr;
+    nxt_keyd_hello h;
+    nxt_keyd_layout l;
+    nxt_keyd *kd;
+    struct stat st;
+    uint32 status;
+    size_t n = 1;
+    void *p;
+    int fd, err;
+    int i;
+
+    while (n < slots) {
+        n <<= 1;
+    }
+    slot_size = (slot_size + 63) & ~(size_t) 63;
+    if (n > NXT_KEYD_MAX_SLOTS || slot_size == 0
+        || slot_size > NXT_KEYD_MAX_SLOT_SIZE
+        || strlen(path) >= sizeof(addr.sun_path)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    kd = (nxt_keyd *) calloc(1, sizeof(nxt_keyd));
+    if (kd == NULL)
+        return NULL;
+    kd->free = (int *) malloc(n * sizeof(int));
+    kd->sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (kd->free == NULL || kd->sock < 0)
+        goto fail;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(kd->sock, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+        goto fail;
+
+    h.magic = NXT_KEYD_MAGIC;
+    h.version = NXT_KEYD_VERSION;
+    h.slots = (uint32) n;
+    h.slot_size = (uint32) slot_size;
+    if (send(kd->sock, &h, sizeof(h), MSG_NOSIGNAL) != (ssize_t) sizeof(h))
+        goto fail;
+
+    fd = nxt_keyd_recv_fd(kd->sock, &status);
+    if (fd == -2 || (status == 0 && fd < 0)) {
+        errno = EPROTO;
+        goto fail;
+    }
+    if (status != 0) {
+        if (fd >= 0)
+            close(fd);
+        errno = (int) status;
+        goto fail;
+    }
+
+    nxt_keyd_get_layout(&l, n, slot_size);
+    p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= l.size) {
+        p = mmap(NULL, l.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    } else {
+        errno = EPROTO;
+    }
+    err = errno;
+    close(fd);
+    errno = err;
+    if (p == MAP_FAILED)
+        goto fail;
+
+    kd->base = (uint8 *) p;
+    kd->size = l.size;
+    kd->shm = (nxt_keyd_shm *) p;
+    kd->sq = (uint32 *) (kd->base + l.sq);
+    kd->cq = (uint32 *) (kd->base + l.cq);
+    kd->reqs = (nxt_keyd_req *) (kd->base + l.reqs);
+    kd->data = kd->base + l.data;
+    kd->mask = (uint32) n - 1;
+    kd->slot_size = (uint32) slot_size;
+    for (i = 0; i < (int) n; i++) {
+        kd->free[i] = (int) n - 1 - i;
+    }
+    kd->nfree = (int) n;
+
+    return kd;
+
+fail:
+    err = errno;
+    if (kd->sock >= 0)
+        close(kd->sock);
+    free(kd->free);
+    free(kd);
+    errno = err;
+
+    return NULL;
+}
+
+void nxt_keyd_close(nxt_keyd *kd)
+{
+    if (kd == NULL)
+        return;
+
+    munmap(kd->base, kd->size);
+    close(kd->sock);
+    free(kd->free);
+    free(kd);
+}
+
+int nxt_keyd_get(nxt_keyd *kd, nxt_keyd_req **req, uint8 **data)
+{
+    int slot;
+
+    if (kd->nfree == 0)
+        return -1;
+
+    slot = kd->free[--kd->nfree];
+    nxt_keyd_slot(kd, slot, req, data);
+
+    return slot;
+}
+
+void nxt_keyd_slot(nxt_keyd *kd, int slot, nxt_keyd_req **req,
+                   uint8 **data)
+{
+    *req = &kd->reqs[slot];
+    *data = kd->data + (size_t) slot * kd->slot_size;
+}
+
+void nxt_keyd_put(nxt_keyd *kd, int slot)
+{
+    kd->free[kd->nfree++] = slot;
+}
+
+void nxt_keyd_submit(nxt_keyd *kd, int slot)
+{
+    kd->sq[kd->sq_tail & kd->mask] = (uint32) slot;
+    kd->sq_tail++;
+    kd->inflight++;
+    STORE_SC(&kd->shm->sq_tail, kd->sq_tail);
+
+    nxt_keyd_wake(&kd->shm->server_sleeping);
+}
+
+int nxt_keyd_poll(nxt_keyd *kd)
+{
+    uint32 slot;
+
+    if (kd->cq_head == LOAD_ACQ(&kd->shm->cq_tail))
+        return -1;
+
+    slot = kd->cq[kd->cq_head & kd->mask];
+    kd->cq_head++;
+    kd->inflight--;
+    STORE_REL(&kd->shm->cq_head, kd->cq_head);
+
+    return (int) slot;
+}
+
+int nxt_keyd_wait(nxt_keyd *kd)
+{
+    int slot;
+    int i;
+
+    while (kd->inflight > 0) {
+        for (i = 0; i < NXT_KEYD_SPIN; i++) {
+            slot = nxt_keyd_poll(kd);
+            if (slot >= 0)
+                return slot;
+            sched_yield();
+        }
+
+        STORE_SC(&kd->shm->client_sleeping, 1);
+        if (LOAD_SC(&kd->shm->cq_tail) == kd->cq_head)
+            nxt_keyd_sleep(&kd->shm->client_sleeping, 1);
+        STORE_SC(&kd->shm->client_sleeping, 0);
+
+        if (LOAD_SC(&kd->shm->cq_tail) == kd->cq_head
+            && nxt_keyd_hangup(kd->sock)) {
+            errno = EPIPE;
+            return -1;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,145 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_KEYD_H
+#define NXT_KEYD_H
+
+#include <stddef.h>
+
+#include "nxt128.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Key daemon. A server holds NXT128 keys, known by 32-bit ids, and runs
+ * encryption requests for local client processes which never see the
+ * keys.
+ *
+ * A client connects once to the Unix socket of the server, which
+ * answers with a shared memory segment (a memfd on Linux) passed over
+ * the socket. The segment holds slots request descriptors and data
+ * areas of slot_size bytes, a submission ring and a completion ring of
+ * slot numbers. Requests and results go through the rings only: the
+ * client and the session thread the server runs for it spin for a while
+ * when they find nothing to do and then sleep on a futex in the segment,
+ * so a system call is only made to wake up a sleeping side.
+ *
+ * The session thread takes the submitted requests in batches of up to
+ * NXT_KEYD_BATCH. The CTR requests of a batch go through a multi-buffer
+ * job manager together, whatever their keys, the ones of at least
+ * NXT_KEYD_DIRECT_SIZE bytes directly through the multi-block mode
+ * functions, and the EAX requests through nxt128_eax_encrypt() and
+ * nxt128_eax_decrypt().
+ *
+ * A request is prepared in a slot obtained with nxt_keyd_get(), whose
+ * data area holds:
+ *
+ *   NXT_KEYD_CTR       the data, encrypted in place with iv as the
+ *                      initial counter
+ *   NXT_KEYD_EAX_SEAL  ad_len bytes of header then len bytes of data,
+ *                      encrypted in place with iv as the nonce, and
+ *                      room for the tag which follows them
+ *   NXT_KEYD_EAX_OPEN  the same with the tag, checked and decrypted
+ *
+ * nxt_keyd_submit() passes it to the server, and nxt_keyd_poll() or
+ * nxt_keyd_wait() return the slots of the completed requests, whose
+ * descriptor and data nxt_keyd_slot() finds, and which are given back
+ * with nxt_keyd_put(). nxt_keyd_get() returns -1 when all the slots are
+ * in use, nxt_keyd_poll() when no request has completed, and
+ * nxt_keyd_wait() when none is in flight or the server is gone. status
+ * is 0 on success, ENOENT for an unknown key, EINVAL for a request which
+ * does not fit in its slot or has an unknown op, and EBADMSG for a wrong
+ * tag (the data is then cleared). The functions on a connection must be
+ * called from one thread at a time.
+ *
+ * The server trusts the clients with the keys it holds but not with
+ * the segment: the indices and lengths it reads there are checked, the
+ * size of the memfd is sealed (a connection is refused where it cannot
+ * be), and a client breaking the protocol is disconnected. The socket
+ * is created with mode 0600, so only the user of the server may
+ * connect.
+ */
+#define NXT_KEYD_CTR       0
+#define NXT_KEYD_EAX_SEAL  1
+#define NXT_KEYD_EAX_OPEN  2
+
+#define NXT_KEYD_BATCH       64
+#define NXT_KEYD_DIRECT_SIZE 256
+#define NXT_KEYD_MAX_SLOTS   4096
+#define NXT_KEYD_MAX_SLOT_SIZE (1024 * 1024)
+
+typedef struct {
+    uint32 op;
+    uint32 key;
+    uint32 len;
+    uint32 ad_len;
+    uint8 iv[NXT128_BLOCK_SIZE];
+    uint32 status;
+    uint32 reserved[3];
+} nxt_keyd_req;
+
+typedef struct nxt_keyd nxt_keyd;
+typedef struct nxt_keyd_server nxt_keyd_server;
+
+/*
+ * Server side. The keys are added before nxt_keyd_server_run(), which
+ * serves the clients until nxt_keyd_server_stop() is called from
+ * another thread and returns 0, or -1 if it cannot wait for clients.
+ */
+nxt_keyd_server *nxt_keyd_server_new(const char *path);
+int nxt_keyd_server_add_key(nxt_keyd_server *srv, uint32 id,
+                            const uint8 *key, uint16 key_len);
+int nxt_keyd_server_run(nxt_keyd_server *srv);
+void nxt_keyd_server_stop(nxt_keyd_server *srv);
+void nxt_keyd_server_free(nxt_keyd_server *srv);
+
+/*
+ * Client side. slots is rounded up to a power of two, slot_size to a
+ * multiple of 64 bytes.
+ */
+nxt_keyd *nxt_keyd_connect(const char *path, size_t slots,
+                           size_t slot_size);
+void nxt_keyd_close(nxt_keyd *kd);
+int nxt_keyd_get(nxt_keyd *kd, nxt_keyd_req **req, uint8 **data);
+void nxt_keyd_slot(nxt_keyd *kd, int slot, nxt_keyd_req **req,
+                   uint8 **data);
+void nxt_keyd_submit(nxt_keyd *kd, int slot);
+int nxt_keyd_poll(nxt_keyd *kd);
+int nxt_keyd_wait(nxt_keyd *kd);
+void nxt_keyd_put(nxt_keyd *kd, int slot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_KEYD_H */
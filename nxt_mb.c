@@ -0,0 +1,414 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "nxt_common.h"
+#include "nxt_mb.h"
+
+/*
+ * Encrypts or decrypts count blocks, block i with the key schedule
+ * ctx[i], with the multi-key functions.
+ */
+static void nxt_mb_kernel(const nxt_mb_mgr *mgr, void *const *ctx,
+                          uint8 *blocks, int count, int decrypt)
+{
+    nxt64_ctx *ctx64[NXT_MB_LANES];
+    nxt128_ctx *ctx128[NXT_MB_LANES];
+    int i;
+
+    if (mgr->block_size == NXT64_BLOCK_SIZE) {
+        for (i = 0; i < count; i++) {
+            ctx64[i] = (nxt64_ctx *) ctx[i];
+        }
+        if (decrypt)
+            nxt64_decrypt_blocks_mk(ctx64, blocks, blocks, count);
+        else
+            nxt64_encrypt_blocks_mk(ctx64, blocks, blocks, count);
+    } else {
+        for (i = 0; i < count; i++) {
+            ctx128[i] = (nxt128_ctx *) ctx[i];
+        }
+        if (decrypt)
+            nxt128_decrypt_blocks_mk(ctx128, blocks, blocks, count);
+        else
+            nxt128_encrypt_blocks_mk(ctx128, blocks, blocks, count);
+    }
+}
+
+/* Adds n to a big-endian counter of len bytes */
+static void nxt_mb_ctr_add(uint8 *ctr, int len, size_t n)
+{
+    int i;
+
+    for (i = len - 1; i >= 0 && n != 0; i--) {
+        n += ctr[i];
+        ctr[i] = (uint8) n;
+        n >>= 8;
+    }
+}
+
+/* Multiplication by x for the CMAC subkeys */
+static void nxt_mb_dbl(uint8 *x, int len)
+{
+    uint8 carry;
+    int i;
+
+    carry = x[0] >> 7;
+    for (i = 0; i < len - 1; i++) {
+        x[i] = (uint8) ((x[i] << 1) | (x[i + 1] >> 7));
+    }
+    x[len - 1] = (uint8) ((x[len - 1] << 1)
+                          ^ ((len == NXT64_BLOCK_SIZE ? 0x1b : 0x87)
+                             & (0 - carry)));
+}
+
+/* Sequential jobs only have one block in flight */
+static int nxt_mb_parallel(const nxt_mb_job *job)
+{
+    return job->op == NXT_MB_CTR || job->op == NXT_MB_CBC_DECRYPT;
+}
+
+/*
+ * Step 0 of a CMAC job encrypts the zero block to get the subkey, step
+ * i > 0 processes the block i - 1 of the message.
+ */
+static void nxt_mb_prepare(const nxt_mb_mgr *mgr, nxt_mb_job *job,
+                           size_t step, uint8 *x)
+{
+    int b = mgr->block_size;
+    size_t off = step * b;
+    size_t r;
+    int i;
+
+    switch (job->op) {
+    case NXT_MB_CTR:
+        memcpy(x, job->iv, b);
+        nxt_mb_ctr_add(x, b, step);
+        break;
+
+    case NXT_MB_CBC_ENCRYPT:
+        for (i = 0; i < b; i++) {
+            x[i] = job->in[off + i] ^ job->chain[i];
+        }
+        break;
+
+    case NXT_MB_CBC_DECRYPT:
+        memcpy(x, job->in + off, b);
+        break;
+
+    case NXT_MB_CMAC:
+        memset(x, 0, b);
+        if (step == 0)
+            break;
+        off -= b;
+        r = job->len - off;
+        if (r > (size_t) b)
+            r = b;
+        memcpy(x, job->in + off, r);
+        if (step == job->steps - 1) {
+            if (r < (size_t) b)
+                x[r] = 0x80;
+            for (i = 0; i < b; i++) {
+                x[i] ^= job->subkey[i];
+            }
+        }
+        for (i = 0; i < b; i++) {
+            x[i] ^= job->chain[i];
+        }
+        break;
+    }
+}
+
+/* Steps of a job are finished in order */
+static void nxt_mb_finish(const nxt_mb_mgr *mgr, nxt_mb_job *job,
+                          size_t step, const uint8 *x)
+{
+    uint8 c[NXT128_BLOCK_SIZE];
+    int b = mgr->block_size;
+    size_t off = step * b;
+    size_t r;
+    size_t i;
+
+    switch (job->op) {
+    case NXT_MB_CTR:
+        r = job->len - off;
+        if (r > (size_t) b)
+            r = b;
+        for (i = 0; i < r; i++) {
+            job->out[off + i] = job->in[off + i] ^ x[i];
+        }
+        break;
+
+    case NXT_MB_CBC_ENCRYPT:
+        memcpy(job->out + off, x, b);
+        memcpy(job->chain, x, b);
+        break;
+
+    case NXT_MB_CBC_DECRYPT:
+        /* The input block may be overwritten when in == out */
+        memcpy(c, job->in + off, b);
+        for (i = 0; i < (size_t) b; i++) {
+            job->out[off + i] = x[i] ^ job->chain[i];
+        }
+        memcpy(job->chain, c, b);
+        break;
+
+    case NXT_MB_CMAC:
+        if (step == 0) {
+            memcpy(job->subkey, x, b);
+            nxt_mb_dbl(job->subkey, b);
+            if (job->len == 0 || job->len % b != 0)
+                nxt_mb_dbl(job->subkey, b);
+        } else {
+            memcpy(job->chain, x, b);
+        }
+        break;
+    }
+}
+
+static void nxt_mb_complete(nxt_mb_mgr *mgr, nxt_mb_job *job)
+{
+    int b = mgr->block_size;
+
+    switch (job->op) {
+    case NXT_MB_CTR:
+        nxt_mb_ctr_add(job->iv, b, job->steps);
+        break;
+
+    case NXT_MB_CBC_ENCRYPT:
+    case NXT_MB_CBC_DECRYPT:
+        memcpy(job->iv, job->chain, b);
+        break;
+
+    case NXT_MB_CMAC:
+        memcpy(job->out, job->chain, b);
+        break;
+    }
+
+    nxt_wipe(job->chain, sizeof(job->chain));
+    nxt_wipe(job->subkey, sizeof(job->subkey));
+
+    job->next = NULL;
+    if (mgr->done == NULL)
+        mgr->done = job;
+    else
+        mgr->done_tail->next = job;
+    mgr->done_tail = job;
+}
+
+/* Moves queued jobs to the free lanes, in submission order */
+static void nxt_mb_admit(nxt_mb_mgr *mgr)
+{
+    nxt_mb_job *job;
+
+    while (mgr->queue != NULL && mgr->active_cnt < NXT_MB_LANES) {
+        job = mgr->queue;
+        mgr->queue = job->next;
+        mgr->active[mgr->active_cnt++] = job;
+    }
+}
+
+/* Number of blocks the active jobs can provide to the next round */
+static int nxt_mb_available(const nxt_mb_mgr *mgr)
+{
+    const nxt_mb_job *job;
+    size_t n = 0;
+    int i;
+
+    for (i = 0; i < mgr->active_cnt && n < NXT_MB_LANES; i++) {
+        job = mgr->active[i];
+        n += nxt_mb_parallel(job) ? job->steps - job->issued : 1;
+    }
+
+    return (n < NXT_MB_LANES) ? (int) n : NXT_MB_LANES;
+}
+
+/*
+ * One round: every active job gets a lane, then the remaining lanes go
+ * to the next blocks of the parallel jobs. Encryptions fill the lanes
+ * from the start and decryptions from the end.
+ */
+static void nxt_mb_round(nxt_mb_mgr *mgr)
+{
+    uint8 blocks[NXT_MB_LANES * NXT128_BLOCK_SIZE];
+    void *ctx[NXT_MB_LANES];
+    nxt_mb_job *job[NXT_MB_LANES];
+    size_t step[NXT_MB_LANES];
+    int slot[NXT_MB_LANES];
+    int b = mgr->block_size;
+    int enc = 0;
+    int dec = 0;
+    int n = 0;
+    int pass;
+    int i, j, s;
+    nxt_mb_job *p;
+
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < mgr->active_cnt && n < NXT_MB_LANES; i++) {
+            p = mgr->active[i];
+            if (pass == 1 && !nxt_mb_parallel(p))
+                continue;
+
+            while (p->issued < p->steps && n < NXT_MB_LANES) {
+                s = (p->op == NXT_MB_CBC_DECRYPT) ? NXT_MB_LANES - 1 - dec++
+                                                  : enc++;
+                job[n] = p;
+                step[n] = p->issued++;
+                slot[n] = s;
+                ctx[s] = p->ctx;
+                nxt_mb_prepare(mgr, p, step[n], blocks + s * b);
+                n++;
+                if (pass == 0)
+                    break;
+            }
+        }
+    }
+
+    nxt_mb_kernel(mgr, ctx, blocks, enc, 0);
+    nxt_mb_kernel(mgr, ctx + NXT_MB_LANES - dec,
+                  blocks + (NXT_MB_LANES - dec) * b, dec, 1);
+
+    for (i = 0; i < n; i++) {
+        nxt_mb_finish(mgr, job[i], step[i], blocks + slot[i] * b);
+    }
+
+    /* Retire the finished jobs, keeping the others in order */
+    for (i = 0, j = 0; i < mgr->active_cnt; i++) {
+        p = mgr->active[i];
+        if (p->issued == p->steps)
+            nxt_mb_complete(mgr, p);
+        else
+            mgr->active[j++] = p;
+    }
+    mgr->active_cnt = j;
+
+    nxt_wipe(blocks, sizeof(blocks));
+}
+
+static void nxt_mb_run(nxt_mb_mgr *mgr, int flush)
+{
+    for (;;) {
+        nxt_mb_admit(mgr);
+        if (mgr->active_cnt == 0)
+            break;
+        if (!flush && nxt_mb_available(mgr) < NXT_MB_LANES)
+            break;
+        nxt_mb_round(mgr);
+    }
+}
+
+void nxt_mb_init(nxt_mb_mgr *mgr, int block_size, unsigned long timeout)
+{
+    assert(block_size == NXT64_BLOCK_SIZE || block_size == NXT128_BLOCK_SIZE);
+
+    memset(mgr, 0, sizeof(nxt_mb_mgr));
+    mgr->block_size = block_size;
+    mgr->timeout = timeout;
+}
+
+nxt_mb_job *nxt_mb_submit(nxt_mb_mgr *mgr, nxt_mb_job *job,
+                          unsigned long now)
+{
+    size_t b = mgr->block_size;
+
+    job->submitted = now;
+    job->issued = 0;
+    memset(job->chain, 0, sizeof(job->chain));
+    memcpy(job->chain, job->iv, b);
+
+    switch (job->op) {
+    case NXT_MB_CTR:
+        job->steps = (job->len + b - 1) / b;
+        break;
+
+    case NXT_MB_CBC_ENCRYPT:
+    case NXT_MB_CBC_DECRYPT:
+        assert(job->len % b == 0);
+        job->steps = job->len / b;
+        break;
+
+    case NXT_MB_CMAC:
+        memset(job->chain, 0, sizeof(job->chain));
+        job->steps = ((job->len == 0) ? 1 : (job->len + b - 1) / b) + 1;
+        break;
+
+    default:
+        assert(0);
+    }
+
+    if (job->steps == 0) {
+        nxt_mb_complete(mgr, job);
+    } else {
+        job->next = NULL;
+        if (mgr->queue == NULL)
+            mgr->queue = job;
+        else
+            mgr->queue_tail->next = job;
+        mgr->queue_tail = job;
+    }
+
+    nxt_mb_run(mgr, 0);
+
+    return nxt_mb_get_completed(mgr);
+}
+
+/* The active jobs were all submitted before the queued ones */
+nxt_mb_job *nxt_mb_poll(nxt_mb_mgr *mgr, unsigned long now)
+{
+    nxt_mb_job *oldest;
+
+    oldest = (mgr->active_cnt > 0) ? mgr->active[0] : mgr->queue;
+    if (oldest != NULL && now - oldest->submitted >= mgr->timeout)
+        nxt_mb_run(mgr, 1);
+
+    return nxt_mb_get_completed(mgr);
+}
+
+nxt_mb_job *nxt_mb_flush(nxt_mb_mgr *mgr)
+{
+    nxt_mb_run(mgr, 1);
+
+    return nxt_mb_get_completed(mgr);
+}
+
+nxt_mb_job *nxt_mb_get_completed(nxt_mb_mgr *mgr)
+{
+    nxt_mb_job *job = mgr->done;
+
+    if (job != NULL) {
+        mgr->done = job->next;
+        job->next = NULL;
+    }
+
+    return job;
+}
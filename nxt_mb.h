@@ -0,0 +1,109 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_MB_H
+#define NXT_MB_H
+
+#include "nxt64.h"
+#include "nxt128.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Multi-buffer job manager. Jobs are small independent requests, each
+ * with its own key schedule; the manager holds them until there are
+ * enough blocks to fill the NXT_MB_LANES lanes of the kernel, then runs
+ * them together, one block per lane. The blocks of CTR and CBC
+ * decryption jobs are independent and may take several lanes, CBC
+ * encryption and CMAC jobs take at most one lane per round.
+ *
+ * nxt_mb_submit() queues a job and runs full rounds only,
+ * nxt_mb_poll() also runs the pending jobs when the oldest one was
+ * submitted at least timeout units before now and nxt_mb_flush() runs
+ * them all. The three functions return the first completed job not yet
+ * returned, or NULL, and nxt_mb_get_completed() returns the next ones.
+ * Jobs complete in any order. The time unit is the caller's choice.
+ *
+ * A manager works on NXT64 or NXT128 blocks, chosen by block_size; ctx
+ * points to a nxt64_ctx or a nxt128_ctx accordingly. iv is the counter
+ * of CTR jobs and the IV of CBC jobs, updated for chaining on
+ * completion; CMAC jobs write the block_size bytes tag to out.
+ */
+#define NXT_MB_LANES 8
+
+#define NXT_MB_CTR         0
+#define NXT_MB_CBC_ENCRYPT 1
+#define NXT_MB_CBC_DECRYPT 2
+#define NXT_MB_CMAC        3
+
+typedef struct nxt_mb_job {
+    int op;
+    void *ctx;
+    const uint8 *in;
+    uint8 *out;
+    size_t len;
+    uint8 iv[NXT128_BLOCK_SIZE];
+    void *user;
+
+    /* Private to the manager */
+    unsigned long submitted;
+    size_t steps;
+    size_t issued;
+    uint8 chain[NXT128_BLOCK_SIZE];
+    uint8 subkey[NXT128_BLOCK_SIZE];
+    struct nxt_mb_job *next;
+} nxt_mb_job;
+
+typedef struct {
+    int block_size;
+    unsigned long timeout;
+    nxt_mb_job *active[NXT_MB_LANES];
+    int active_cnt;
+    nxt_mb_job *queue;
+    nxt_mb_job *queue_tail;
+    nxt_mb_job *done;
+    nxt_mb_job *done_tail;
+} nxt_mb_mgr;
+
+void nxt_mb_init(nxt_mb_mgr *mgr, int block_size, unsigned long timeout);
+nxt_mb_job *nxt_mb_submit(nxt_mb_mgr *mgr, nxt_mb_job *job,
+                          unsigned long now);
+nxt_mb_job *nxt_mb_poll(nxt_mb_mgr *mgr, unsigned long now);
+nxt_mb_job *nxt_mb_flush(nxt_mb_mgr *mgr);
+nxt_mb_job *nxt_mb_get_completed(nxt_mb_mgr *mgr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_MB_H */
@@ -0,0 +1,821 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "nxt_common.h"
+#include "nxt_modes.h"
+
+static void nxt128_ctr_inc(uint8 *ctr)
+{
+    int i;
+
+    for (i = NXT128_BLOCK_SIZE - 1; i >= 0; i--) {
+        if (++ctr[i] != 0)
+            break;
+    }
+}
+
+void nxt128_ctr_keystream(nxt128_ctx *ctx, uint8 *ctr, uint8 *out,
+                          size_t blocks)
+{
+    size_t n;
+    size_t i;
+
+    for (; blocks > 0; blocks -= n) {
+        n = (blocks < NXT128_MODES_BATCH) ? blocks : NXT128_MODES_BATCH;
+
+        for (i = 0; i < n; i++) {
+            memcpy(out + i * NXT128_BLOCK_SIZE, ctr, NXT128_BLOCK_SIZE);
+            nxt128_ctr_inc(ctr);
+        }
+
+        nxt128_encrypt_blocks(ctx, out, out, n);
+        out += n * NXT128_BLOCK_SIZE;
+    }
+}
+
+void nxt128_ctr_crypt(nxt128_ctx *ctx, uint8 *ctr, const uint8 *in,
+                      uint8 *out, size_t len)
+{
+    uint8 ks[NXT128_MODES_BATCH * NXT128_BLOCK_SIZE];
+    size_t blocks;
+    size_t n;
+    size_t i;
+
+    for (; len > 0; len -= n, in += n, out += n) {
+        blocks = (len + NXT128_BLOCK_SIZE - 1) / NXT128_BLOCK_SIZE;
+        if (blocks > NXT128_MODES_BATCH)
+            blocks = NXT128_MODES_BATCH;
+
+        nxt128_ctr_keystream(ctx, ctr, ks, blocks);
+
+        n = blocks * NXT128_BLOCK_SIZE;
+        if (n > len)
+            n = len;
+
+        for (i = 0; i < n; i++) {
+            out[i] = in[i] ^ ks[i];
+        }
+    }
+}
+
+void nxt128_cbc_encrypt(nxt128_ctx *ctx, uint8 *iv, const uint8 *in,
+                        uint8 *out, size_t len)
+{
+    uint8 x[NXT128_BLOCK_SIZE];
+    int i;
+
+    assert(len % NXT128_BLOCK_SIZE == 0);
+
+    for (; len > 0; len -= NXT128_BLOCK_SIZE, in += NXT128_BLOCK_SIZE,
+                    out += NXT128_BLOCK_SIZE) {
+        for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+            x[i] = in[i] ^ iv[i];
+        }
+
+        nxt128_encrypt(ctx, x, out);
+        memcpy(iv, out, NXT128_BLOCK_SIZE);
+    }
+}
+
+/*
+ * The blocks are decrypted NXT128_MODES_BATCH at a time and chained
+ * from the last one to the first one so that in and out can be the
+ * same buffer.
+ */
+void nxt128_cbc_decrypt(nxt128_ctx *ctx, uint8 *iv, const uint8 *in,
+                        uint8 *out, size_t len)
+{
+    uint8 buf[NXT128_MODES_BATCH * NXT128_BLOCK_SIZE];
+    uint8 next_iv[NXT128_BLOCK_SIZE];
+    size_t n;
+    size_t i;
+
+    assert(len % NXT128_BLOCK_SIZE == 0);
+
+    for (; len > 0; len -= n, in += n, out += n) {
+        n = (len < sizeof(buf)) ? len : sizeof(buf);
+
+        nxt128_decrypt_blocks(ctx, in, buf, n / NXT128_BLOCK_SIZE);
+        memcpy(next_iv, in + n - NXT128_BLOCK_SIZE, NXT128_BLOCK_SIZE);
+
+        for (i = n; i-- > NXT128_BLOCK_SIZE; ) {
+            out[i] = buf[i] ^ in[i - NXT128_BLOCK_SIZE];
+        }
+        for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+            out[i] = buf[i] ^ iv[i];
+        }
+
+        memcpy(iv, next_iv, NXT128_BLOCK_SIZE);
+    }
+}
+
+static void nxt128_xor_bytes(uint8 *a, const uint8 *b, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        a[i] ^= b[i];
+    }
+}
+
+/* Multiplication by x in GF(2^128) = GF(2)[x] / (x^128 + x^7 + x^2 + x + 1) */
+static void nxt128_dbl(uint8 *b)
+{
+    uint8 carry;
+    int i;
+
+    carry = b[0] >> 7;
+    for (i = 0; i < NXT128_BLOCK_SIZE - 1; i++) {
+        b[i] = (uint8) ((b[i] << 1) | (b[i + 1] >> 7));
+    }
+    b[NXT128_BLOCK_SIZE - 1] = (uint8) ((b[NXT128_BLOCK_SIZE - 1] << 1)
+                                        ^ (0x87 & (0 - carry)));
+}
+
+void nxt128_eax_init(nxt128_eax_ctx *ctx, const uint8 *key, uint16 key_len)
+{
+    uint8 x[NXT128_BLOCK_SIZE];
+    int t;
+    int i;
+
+    nxt128_ks(&ctx->cipher, key, key_len);
+
+    memset(ctx->k1, 0, NXT128_BLOCK_SIZE);
+    nxt128_encrypt(&ctx->cipher, ctx->k1, ctx->k1);
+    nxt128_dbl(ctx->k1);
+    memcpy(ctx->k2, ctx->k1, NXT128_BLOCK_SIZE);
+    nxt128_dbl(ctx->k2);
+
+    /* OMAC^t(M) = OMAC([t] || M) with [t] the block encoding t */
+    for (t = 0; t < 3; t++) {
+        memset(x, 0, NXT128_BLOCK_SIZE);
+        x[NXT128_BLOCK_SIZE - 1] = (uint8) t;
+        nxt128_encrypt(&ctx->cipher, x, ctx->first[t]);
+
+        for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+            x[i] ^= ctx->k1[i];
+        }
+        nxt128_encrypt(&ctx->cipher, x, ctx->empty[t]);
+    }
+}
+
+static void nxt128_xor(uint8 *a, const uint8 *b)
+{
+    nxt128_xor_bytes(a, b, NXT128_BLOCK_SIZE);
+}
+
+/* Multiplication by x of a little-endian element of GF(2^128) */
+static void nxt128_xts_mul(uint8 *t)
+{
+    uint8 carry;
+    int i;
+
+    carry = t[NXT128_BLOCK_SIZE - 1] >> 7;
+    for (i = NXT128_BLOCK_SIZE - 1; i > 0; i--) {
+        t[i] = (uint8) ((t[i] << 1) | (t[i - 1] >> 7));
+    }
+    t[0] = (uint8) ((t[0] << 1) ^ (0x87 & (0 - carry)));
+}
+
+static void nxt128_xts(nxt128_ctx *ctx, nxt128_ctx *tweak_ctx,
+                       const uint8 *tweak, const uint8 *in, uint8 *out,
+                       size_t len, int decrypt)
+{
+    uint8 buf[NXT128_MODES_BATCH * NXT128_BLOCK_SIZE];
+    uint8 tw[NXT128_MODES_BATCH * NXT128_BLOCK_SIZE];
+    uint8 t[NXT128_BLOCK_SIZE];
+    size_t blocks;
+    size_t n;
+    size_t i;
+
+    assert(len % NXT128_BLOCK_SIZE == 0);
+
+    nxt128_encrypt(tweak_ctx, tweak, t);
+
+    for (; len > 0; len -= n, in += n, out += n) {
+        n = (len < sizeof(buf)) ? len : sizeof(buf);
+        blocks = n / NXT128_BLOCK_SIZE;
+
+        for (i = 0; i < blocks; i++) {
+            memcpy(tw + i * NXT128_BLOCK_SIZE, t, NXT128_BLOCK_SIZE);
+            nxt128_xts_mul(t);
+        }
+
+        for (i = 0; i < n; i++) {
+            buf[i] = in[i] ^ tw[i];
+        }
+
+        if (decrypt)
+            nxt128_decrypt_blocks(ctx, buf, buf, blocks);
+        else
+            nxt128_encrypt_blocks(ctx, buf, buf, blocks);
+
+        for (i = 0; i < n; i++) {
+            out[i] = buf[i] ^ tw[i];
+        }
+    }
+}
+
+void nxt128_xts_encrypt(nxt128_ctx *ctx, nxt128_ctx *tweak_ctx,
+                        const uint8 *tweak, const uint8 *in, uint8 *out,
+                        size_t len)
+{
+    nxt128_xts(ctx, tweak_ctx, tweak, in, out, len, 0);
+}
+
+void nxt128_xts_decrypt(nxt128_ctx *ctx, nxt128_ctx *tweak_ctx,
+                        const uint8 *tweak, const uint8 *in, uint8 *out,
+                        size_t len)
+{
+    nxt128_xts(ctx, tweak_ctx, tweak, in, out, len, 1);
+}
+
+void nxt128_pmac_init(nxt128_pmac_ctx *ctx, const uint8 *key,
+                      uint16 key_len)
+{
+    uint8 carry;
+    int i;
+
+    nxt128_ks(&ctx->cipher, key, key_len);
+
+    memset(ctx->l[0], 0, NXT128_BLOCK_SIZE);
+    nxt128_encrypt(&ctx->cipher, ctx->l[0], ctx->l[0]);
+
+    for (i = 1; i < NXT128_PMAC_LEVELS; i++) {
+        memcpy(ctx->l[i], ctx->l[i - 1], NXT128_BLOCK_SIZE);
+        nxt128_dbl(ctx->l[i]);
+    }
+
+    /* L(-1) = L / x */
+    carry = ctx->l[0][NXT128_BLOCK_SIZE - 1] & 1;
+    for (i = NXT128_BLOCK_SIZE - 1; i > 0; i--) {
+        ctx->l_inv[i] = (uint8) ((ctx->l[0][i] >> 1)
+                                 | (ctx->l[0][i - 1] << 7));
+    }
+    ctx->l_inv[0] = ctx->l[0][0] >> 1;
+    if (carry) {
+        ctx->l_inv[0] ^= 0x80;
+        ctx->l_inv[NXT128_BLOCK_SIZE - 1] ^= 0x43;
+    }
+}
+
+/*
+ * The offset of block i is the sum of the L(j) for the bits j set in
+ * the Gray code i ^ (i >> 1), which gives the offset at any position
+ * without going through the previous blocks.
+ */
+void nxt128_pmac_sum(nxt128_pmac_ctx *ctx, size_t first, const uint8 *in,
+                     size_t blocks, uint8 *sum)
+{
+    uint8 buf[NXT128_MODES_BATCH * NXT128_BLOCK_SIZE];
+    uint8 offset[NXT128_BLOCK_SIZE];
+    size_t gray;
+    size_t idx;
+    size_t n;
+    size_t i;
+    int j;
+
+    memset(offset, 0, NXT128_BLOCK_SIZE);
+    gray = (first - 1) ^ ((first - 1) >> 1);
+    for (j = 0; gray != 0; j++, gray >>= 1) {
+        if (gray & 1) {
+            nxt128_xor(offset, ctx->l[j]);
+        }
+    }
+
+    for (idx = first; blocks > 0; blocks -= n) {
+        n = (blocks < NXT128_MODES_BATCH) ? blocks : NXT128_MODES_BATCH;
+
+        for (i = 0; i < n; i++, idx++) {
+            for (j = 0; !((idx >> j) & 1); j++)
+                ;
+            nxt128_xor(offset, ctx->l[j]);
+            memcpy(buf + i * NXT128_BLOCK_SIZE, in, NXT128_BLOCK_SIZE);
+            nxt128_xor(buf + i * NXT128_BLOCK_SIZE, offset);
+            in += NXT128_BLOCK_SIZE;
+        }
+
+        nxt128_encrypt_blocks(&ctx->cipher, buf, buf, n);
+
+        for (i = 0; i < n; i++) {
+            nxt128_xor(sum, buf + i * NXT128_BLOCK_SIZE);
+        }
+    }
+}
+
+void nxt128_pmac_final(nxt128_pmac_ctx *ctx, const uint8 *sum,
+                       const uint8 *last, size_t last_len, uint8 *tag)
+{
+    uint8 x[NXT128_BLOCK_SIZE];
+
+    assert(last_len <= NXT128_BLOCK_SIZE);
+
+    memcpy(x, sum, NXT128_BLOCK_SIZE);
+    nxt128_xor_bytes(x, last, last_len);
+    if (last_len == NXT128_BLOCK_SIZE) {
+        nxt128_xor(x, ctx->l_inv);
+    } else {
+        x[last_len] ^= 0x80;
+    }
+
+    nxt128_encrypt(&ctx->cipher, x, tag);
+}
+
+void nxt128_pmac(nxt128_pmac_ctx *ctx, const uint8 *in, size_t len,
+                 uint8 *tag)
+{
+    uint8 sum[NXT128_BLOCK_SIZE];
+    size_t blocks;
+
+    blocks = (len > 0) ? (len - 1) / NXT128_BLOCK_SIZE : 0;
+
+    memset(sum, 0, NXT128_BLOCK_SIZE);
+    nxt128_pmac_sum(ctx, 1, in, blocks, sum);
+    nxt128_pmac_final(ctx, sum, in + blocks * NXT128_BLOCK_SIZE,
+                      len - blocks * NXT128_BLOCK_SIZE, tag);
+}
+
+/*
+ * Streaming OMAC^t. The last block seen is kept in buf until the next
+ * update or the final call since it is processed with a subkey.
+ */
+typedef struct {
+    nxt128_eax_ctx *ctx;
+    uint8 x[NXT128_BLOCK_SIZE];
+    uint8 buf[NXT128_BLOCK_SIZE];
+    size_t n;
+    int t;
+    int empty;
+} nxt128_omac_state;
+
+static void nxt128_omac_start(nxt128_omac_state *st, nxt128_eax_ctx *ctx,
+                              int t)
+{
+    st->ctx = ctx;
+    memcpy(st->x, ctx->first[t], NXT128_BLOCK_SIZE);
+    st->n = 0;
+    st->t = t;
+    st->empty = 1;
+}
+
+static void nxt128_omac_update(nxt128_omac_state *st, const uint8 *in,
+                               size_t len)
+{
+    size_t n;
+    size_t i;
+
+    if (len > 0)
+        st->empty = 0;
+
+    while (len > 0) {
+        if (st->n == NXT128_BLOCK_SIZE) {
+            for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+                st->x[i] ^= st->buf[i];
+            }
+            nxt128_encrypt(&st->ctx->cipher, st->x, st->x);
+            st->n = 0;
+        }
+
+        if (st->n == 0) {
+            for (; len > NXT128_BLOCK_SIZE; len -= NXT128_BLOCK_SIZE,
+                                            in += NXT128_BLOCK_SIZE) {
+                for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+                    st->x[i] ^= in[i];
+                }
+                nxt128_encrypt(&st->ctx->cipher, st->x, st->x);
+            }
+        }
+
+        n = NXT128_BLOCK_SIZE - st->n;
+        if (n > len)
+            n = len;
+
+        memcpy(st->buf + st->n, in, n);
+        st->n += n;
+        in += n;
+        len -= n;
+    }
+}
+
+static void nxt128_omac_final(nxt128_omac_state *st, uint8 *out)
+{
+    const uint8 *k;
+    size_t i;
+
+    if (st->empty) {
+        memcpy(out, st->ctx->empty[st->t], NXT128_BLOCK_SIZE);
+        return;
+    }
+
+    if (st->n == NXT128_BLOCK_SIZE) {
+        k = st->ctx->k1;
+    } else {
+        k = st->ctx->k2;
+        st->buf[st->n] = 0x80;
+        memset(st->buf + st->n + 1, 0, NXT128_BLOCK_SIZE - st->n - 1);
+    }
+
+    for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+        st->x[i] ^= st->buf[i] ^ k[i];
+    }
+    nxt128_encrypt(&st->ctx->cipher, st->x, out);
+}
+
+/*
+ * Streaming CTR mode: the unused end of the last keystream block is
+ * kept for the next piece of data.
+ */
+typedef struct {
+    nxt128_ctx *cipher;
+    uint8 *ctr;
+    uint8 ks[NXT128_BLOCK_SIZE];
+    size_t used;
+} nxt128_ctr_stream;
+
+static void nxt128_ctr_stream_start(nxt128_ctr_stream *st,
+                                    nxt128_ctx *cipher, uint8 *ctr)
+{
+    st->cipher = cipher;
+    st->ctr = ctr;
+    st->used = NXT128_BLOCK_SIZE;
+}
+
+static void nxt128_ctr_piece(void *p, const uint8 *in, uint8 *out,
+                             size_t len)
+{
+    nxt128_ctr_stream *st = (nxt128_ctr_stream *) p;
+    size_t n;
+
+    for (; (len > 0) && (st->used < NXT128_BLOCK_SIZE); len--) {
+        *out++ = *in++ ^ st->ks[st->used++];
+    }
+
+    n = len - len % NXT128_BLOCK_SIZE;
+    if (n > 0) {
+        nxt128_ctr_crypt(st->cipher, st->ctr, in, out, n);
+        in += n;
+        out += n;
+        len -= n;
+    }
+
+    if (len > 0) {
+        nxt128_ctr_keystream(st->cipher, st->ctr, st->ks, 1);
+        for (st->used = 0; st->used < len; st->used++) {
+            out[st->used] = in[st->used] ^ st->ks[st->used];
+        }
+    }
+}
+
+/*
+ * Streaming CBC mode: the bytes of a block split across pieces are
+ * gathered in buf along with their destination addresses until the
+ * block is complete.
+ */
+typedef struct {
+    nxt128_ctx *cipher;
+    uint8 *iv;
+    uint8 buf[NXT128_BLOCK_SIZE];
+    uint8 *dst[NXT128_BLOCK_SIZE];
+    size_t n;
+} nxt128_cbc_stream;
+
+static void nxt128_cbc_stream_block(nxt128_cbc_stream *st, int decrypt)
+{
+    uint8 c[NXT128_BLOCK_SIZE];
+    int i;
+
+    if (decrypt) {
+        memcpy(c, st->buf, NXT128_BLOCK_SIZE);
+        nxt128_decrypt(st->cipher, st->buf, st->buf);
+        for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+            st->buf[i] ^= st->iv[i];
+        }
+        memcpy(st->iv, c, NXT128_BLOCK_SIZE);
+    } else {
+        for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+            st->buf[i] ^= st->iv[i];
+        }
+        nxt128_encrypt(st->cipher, st->buf, st->buf);
+        memcpy(st->iv, st->buf, NXT128_BLOCK_SIZE);
+    }
+
+    for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+        *st->dst[i] = st->buf[i];
+    }
+
+    st->n = 0;
+}
+
+static void nxt128_cbc_piece(nxt128_cbc_stream *st, const uint8 *in,
+                             uint8 *out, size_t len, int decrypt)
+{
+    size_t n;
+
+    for (; (len > 0) && (st->n > 0); len--) {
+        st->buf[st->n] = *in++;
+        st->dst[st->n++] = out++;
+        if (st->n == NXT128_BLOCK_SIZE)
+            nxt128_cbc_stream_block(st, decrypt);
+    }
+
+    n = len - len % NXT128_BLOCK_SIZE;
+    if (n > 0) {
+        if (decrypt)
+            nxt128_cbc_decrypt(st->cipher, st->iv, in, out, n);
+        else
+            nxt128_cbc_encrypt(st->cipher, st->iv, in, out, n);
+        in += n;
+        out += n;
+        len -= n;
+    }
+
+    for (; len > 0; len--) {
+        st->buf[st->n] = *in++;
+        st->dst[st->n++] = out++;
+    }
+}
+
+static void nxt128_cbc_encrypt_piece(void *p, const uint8 *in, uint8 *out,
+                                     size_t len)
+{
+    nxt128_cbc_piece((nxt128_cbc_stream *) p, in, out, len, 0);
+}
+
+static void nxt128_cbc_decrypt_piece(void *p, const uint8 *in, uint8 *out,
+                                     size_t len)
+{
+    nxt128_cbc_piece((nxt128_cbc_stream *) p, in, out, len, 1);
+}
+
+/*
+ * Streaming EAX mode.
+ */
+typedef struct {
+    nxt128_ctr_stream ctr;
+    nxt128_omac_state mac;
+    uint8 counter[NXT128_BLOCK_SIZE];
+    uint8 tag[NXT128_BLOCK_SIZE];
+} nxt128_eax_stream;
+
+static void nxt128_eax_start(nxt128_eax_stream *st, nxt128_eax_ctx *ctx,
+                             const uint8 *nonce, size_t nonce_len,
+                             const uint8 *hdr, size_t hdr_len)
+{
+    uint8 h[NXT128_BLOCK_SIZE];
+    int i;
+
+    nxt128_omac_start(&st->mac, ctx, 0);
+    nxt128_omac_update(&st->mac, nonce, nonce_len);
+    nxt128_omac_final(&st->mac, st->counter);
+
+    nxt128_omac_start(&st->mac, ctx, 1);
+    nxt128_omac_update(&st->mac, hdr, hdr_len);
+    nxt128_omac_final(&st->mac, h);
+
+    for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+        st->tag[i] = st->counter[i] ^ h[i];
+    }
+
+    nxt128_omac_start(&st->mac, ctx, 2);
+    nxt128_ctr_stream_start(&st->ctr, &ctx->cipher, st->counter);
+}
+
+static void nxt128_eax_encrypt_piece(void *p, const uint8 *in, uint8 *out,
+                                     size_t len)
+{
+    nxt128_eax_stream *st = (nxt128_eax_stream *) p;
+
+    nxt128_ctr_piece(&st->ctr, in, out, len);
+    nxt128_omac_update(&st->mac, out, len);
+}
+
+static void nxt128_eax_decrypt_piece(void *p, const uint8 *in, uint8 *out,
+                                     size_t len)
+{
+    nxt128_eax_stream *st = (nxt128_eax_stream *) p;
+
+    nxt128_omac_update(&st->mac, in, len);
+    nxt128_ctr_piece(&st->ctr, in, out, len);
+}
+
+static void nxt128_eax_tag(nxt128_eax_stream *st)
+{
+    uint8 c[NXT128_BLOCK_SIZE];
+    int i;
+
+    nxt128_omac_final(&st->mac, c);
+    for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+        st->tag[i] ^= c[i];
+    }
+}
+
+static int nxt128_eax_check(nxt128_eax_stream *st, const uint8 *tag)
+{
+    uint8 diff;
+    int i;
+
+    nxt128_eax_tag(st);
+
+    diff = 0;
+    for (i = 0; i < NXT128_BLOCK_SIZE; i++) {
+        diff |= st->tag[i] ^ tag[i];
+    }
+
+    return (diff == 0) ? 0 : -1;
+}
+
+void nxt128_eax_encrypt(nxt128_eax_ctx *ctx, const uint8 *nonce,
+                        size_t nonce_len, const uint8 *hdr, size_t hdr_len,
+                        const uint8 *in, uint8 *out, size_t len,
+                        uint8 *tag)
+{
+    nxt128_eax_stream st;
+
+    nxt128_eax_start(&st, ctx, nonce, nonce_len, hdr, hdr_len);
+    nxt128_eax_encrypt_piece(&st, in, out, len);
+    nxt128_eax_tag(&st);
+
+    memcpy(tag, st.tag, NXT128_EAX_TAG_SIZE);
+}
+
+int nxt128_eax_decrypt(nxt128_eax_ctx *ctx, const uint8 *nonce,
+                       size_t nonce_len, const uint8 *hdr, size_t hdr_len,
+                       const uint8 *in, uint8 *out, size_t len,
+                       const uint8 *tag)
+{
+    nxt128_eax_stream st;
+
+    nxt128_eax_start(&st, ctx, nonce, nonce_len, hdr, hdr_len);
+    nxt128_eax_decrypt_piece(&st, in, out, len);
+
+    if (nxt128_eax_check(&st, tag) != 0) {
+        nxt_wipe(out, len);
+        return -1;
+    }
+
+    return 0;
+}
+
+typedef void (*nxt_piece_fn)(void *st, const uint8 *in, uint8 *out,
+                             size_t len);
+
+static size_t nxt_iov_len(const nxt_iovec *iov, int cnt)
+{
+    size_t len;
+    int i;
+
+    for (len = 0, i = 0; i < cnt; i++) {
+        len += iov[i].len;
+    }
+
+    return len;
+}
+
+/*
+ * Calls fn on the largest pieces which are contiguous both in the
+ * source and in the destination lists.
+ */
+static void nxt_iov_walk(const nxt_iovec *src, int src_cnt,
+                         const nxt_iovec *dst, int dst_cnt,
+                         nxt_piece_fn fn, void *st)
+{
+    size_t src_off, dst_off;
+    size_t n;
+    int i, j;
+
+    assert(nxt_iov_len(src, src_cnt) == nxt_iov_len(dst, dst_cnt));
+
+    i = 0;
+    j = 0;
+    src_off = 0;
+    dst_off = 0;
+
+    while ((i < src_cnt) && (j < dst_cnt)) {
+        if (src_off == src[i].len) {
+            i++;
+            src_off = 0;
+            continue;
+        }
+        if (dst_off == dst[j].len) {
+            j++;
+            dst_off = 0;
+            continue;
+        }
+
+        n = src[i].len - src_off;
+        if (n > dst[j].len - dst_off)
+            n = dst[j].len - dst_off;
+
+        fn(st, (const uint8 *) src[i].base + src_off,
+           (uint8 *) dst[j].base + dst_off, n);
+
+        src_off += n;
+        dst_off += n;
+    }
+}
+
+void nxt128_ctr_crypt_iov(nxt128_ctx *ctx, uint8 *ctr,
+                          const nxt_iovec *src, int src_cnt,
+                          const nxt_iovec *dst, int dst_cnt)
+{
+    nxt128_ctr_stream st;
+
+    nxt128_ctr_stream_start(&st, ctx, ctr);
+    nxt_iov_walk(src, src_cnt, dst, dst_cnt, nxt128_ctr_piece, &st);
+}
+
+void nxt128_cbc_encrypt_iov(nxt128_ctx *ctx, uint8 *iv,
+                            const nxt_iovec *src, int src_cnt,
+                            const nxt_iovec *dst, int dst_cnt)
+{
+    nxt128_cbc_stream st;
+
+    st.cipher = ctx;
+    st.iv = iv;
+    st.n = 0;
+
+    nxt_iov_walk(src, src_cnt, dst, dst_cnt, nxt128_cbc_encrypt_piece, &st);
+    assert(st.n == 0);
+}
+
+void nxt128_cbc_decrypt_iov(nxt128_ctx *ctx, uint8 *iv,
+                            const nxt_iovec *src, int src_cnt,
+                            const nxt_iovec *dst, int dst_cnt)
+{
+    nxt128_cbc_stream st;
+
+    st.cipher = ctx;
+    st.iv = iv;
+    st.n = 0;
+
+    nxt_iov_walk(src, src_cnt, dst, dst_cnt, nxt128_cbc_decrypt_piece, &st);
+    assert(st.n == 0);
+}
+
+void nxt128_eax_encrypt_iov(nxt128_eax_ctx *ctx, const uint8 *nonce,
+                            size_t nonce_len, const uint8 *hdr,
+                            size_t hdr_len, const nxt_iovec *src,
+                            int src_cnt, const nxt_iovec *dst, int dst_cnt,
+                            uint8 *tag)
+{
+    nxt128_eax_stream st;
+
+    nxt128_eax_start(&st, ctx, nonce, nonce_len, hdr, hdr_len);
+    nxt_iov_walk(src, src_cnt, dst, dst_cnt, nxt128_eax_encrypt_piece, &st);
+    nxt128_eax_tag(&st);
+
+    memcpy(tag, st.tag, NXT128_EAX_TAG_SIZE);
+}
+
+int nxt128_eax_decrypt_iov(nxt128_eax_ctx *ctx, const uint8 *nonce,
+                           size_t nonce_len, const uint8 *hdr,
+                           size_t hdr_len, const nxt_iovec *src,
+                           int src_cnt, const nxt_iovec *dst, int dst_cnt,
+                           const uint8 *tag)
+{
+    nxt128_eax_stream st;
+    int i;
+
+    nxt128_eax_start(&st, ctx, nonce, nonce_len, hdr, hdr_len);
+    nxt_iov_walk(src, src_cnt, dst, dst_cnt, nxt128_eax_decrypt_piece, &st);
+
+    if (nxt128_eax_check(&st, tag) != 0) {
+        for (i = 0; i < dst_cnt; i++) {
+            nxt_wipe(dst[i].base, dst[i].len);
+        }
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_MODES_H
+#define NXT_MODES_H
+
+#include "nxt128.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Number of blocks handed to the multi-block functions at once by the
+ * modes which need a temporary buffer.
+ */
+#define NXT128_MODES_BATCH 16
+
+/*
+ * CTR mode. The counter block is incremented as a 128-bit big-endian
+ * integer and is updated to the next unused value on return. A partial
+ * last block consumes a whole counter value.
+ */
+void nxt128_ctr_keystream(nxt128_ctx *ctx, uint8 *ctr, uint8 *out,
+                          size_t blocks);
+void nxt128_ctr_crypt(nxt128_ctx *ctx, uint8 *ctr, const uint8 *in,
+                      uint8 *out, size_t len);
+
+/*
+ * CBC mode. The length must be a multiple of the block size and the
+ * iv is updated to the last ciphertext block on return.
+ */
+void nxt128_cbc_encrypt(nxt128_ctx *ctx, uint8 *iv, const uint8 *in,
+                        uint8 *out, size_t len);
+void nxt128_cbc_decrypt(nxt128_ctx *ctx, uint8 *iv, const uint8 *in,
+                        uint8 *out, size_t len);
+
+/*
+ * EAX authenticated encryption (CTR mode and OMAC). The context keeps
+ * the OMAC subkeys and the first OMAC block of the nonce, header and
+ * ciphertext chains, which only depend on the key.
+ * nxt128_eax_decrypt() returns -1 and clears the output if the tag is
+ * wrong, 0 otherwise.
+ */
+#define NXT128_EAX_TAG_SIZE 16
+
+typedef struct {
+    nxt128_ctx cipher;
+    uint8 k1[NXT128_BLOCK_SIZE];
+    uint8 k2[NXT128_BLOCK_SIZE];
+    uint8 first[3][NXT128_BLOCK_SIZE];
+    uint8 empty[3][NXT128_BLOCK_SIZE];
+} nxt128_eax_ctx;
+
+void nxt128_eax_init(nxt128_eax_ctx *ctx, const uint8 *key, uint16 key_len);
+void nxt128_eax_encrypt(nxt128_eax_ctx *ctx, const uint8 *nonce,
+                        size_t nonce_len, const uint8 *hdr, size_t hdr_len,
+                        const uint8 *in, uint8 *out, size_t len,
+                        uint8 *tag);
+int nxt128_eax_decrypt(nxt128_eax_ctx *ctx, const uint8 *nonce,
+                       size_t nonce_len, const uint8 *hdr, size_t hdr_len,
+                       const uint8 *in, uint8 *out, size_t len,
+                       const uint8 *tag);
+
+/*
+ * XTS mode (IEEE P1619) on one data unit, without ciphertext stealing:
+ * the length must be a multiple of the block size. The tweak is the
+ * 16-byte little-endian data unit number, encrypted with tweak_ctx.
+ */
+void nxt128_xts_encrypt(nxt128_ctx *ctx, nxt128_ctx *tweak_ctx,
+                        const uint8 *tweak, const uint8 *in, uint8 *out,
+                        size_t len);
+void nxt128_xts_decrypt(nxt128_ctx *ctx, nxt128_ctx *tweak_ctx,
+                        const uint8 *tweak, const uint8 *in, uint8 *out,
+                        size_t len);
+
+/*
+ * PMAC1. Every block but the last one is processed independently:
+ * nxt128_pmac_sum() accumulates in sum the contribution of the blocks
+ * first, first + 1, .. (numbered from 1) and nxt128_pmac_final()
+ * computes the tag from the sum of all the blocks but the last one and
+ * the last (possibly partial or empty) block.
+ */
+#define NXT128_PMAC_LEVELS 64
+
+typedef struct {
+    nxt128_ctx cipher;
+    uint8 l[NXT128_PMAC_LEVELS][NXT128_BLOCK_SIZE];
+    uint8 l_inv[NXT128_BLOCK_SIZE];
+} nxt128_pmac_ctx;
+
+void nxt128_pmac_init(nxt128_pmac_ctx *ctx, const uint8 *key,
+                      uint16 key_len);
+void nxt128_pmac_sum(nxt128_pmac_ctx *ctx, size_t first, const uint8 *in,
+                     size_t blocks, uint8 *sum);
+void nxt128_pmac_final(nxt128_pmac_ctx *ctx, const uint8 *sum,
+                       const uint8 *last, size_t last_len, uint8 *tag);
+void nxt128_pmac(nxt128_pmac_ctx *ctx, const uint8 *in, size_t len,
+                 uint8 *tag);
+
+/*
+ * Scatter-gather variants. The source and destination lists describe
+ * byte streams of the same total length which may be split differently;
+ * a destination segment may be the same memory as its source segment
+ * but must not overlap it otherwise. The data is processed as if it
+ * was contiguous: blocks split across segments are carried internally
+ * and the runs of whole blocks go directly to the multi-block functions.
+ * nxt_iovec has the layout of the POSIX struct iovec.
+ */
+typedef struct {
+    void *base;
+    size_t len;
+} nxt_iovec;
+
+void nxt128_ctr_crypt_iov(nxt128_ctx *ctx, uint8 *ctr,
+                          const nxt_iovec *src, int src_cnt,
+                          const nxt_iovec *dst, int dst_cnt);
+void nxt128_cbc_encrypt_iov(nxt128_ctx *ctx, uint8 *iv,
+                            const nxt_iovec *src, int src_cnt,
+                            const nxt_iovec *dst, int dst_cnt);
+void nxt128_cbc_decrypt_iov(nxt128_ctx *ctx, uint8 *iv,
+                            const nxt_iovec *src, int src_cnt,
+                            const nxt_iovec *dst, int dst_cnt);
+void nxt128_eax_encrypt_iov(nxt128_eax_ctx *ctx, const uint8 *nonce,
+                            size_t nonce_len, const uint8 *hdr,
+                            size_t hdr_len, const nxt_iovec *src,
+                            int src_cnt, const nxt_iovec *dst, int dst_cnt,
+                            uint8 *tag);
+int nxt128_eax_decrypt_iov(nxt128_eax_ctx *ctx, const uint8 *nonce,
+                           size_t nonce_len, const uint8 *hdr,
+                           size_t hdr_len, const nxt_iovec *src,
+                           int src_cnt, const nxt_iovec *dst, int dst_cnt,
+                           const uint8 *tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_MODES_H */
@@ -0,0 +1,363 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifdef __linux__
+#define _GNU_SOURCE
+#else
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "nxt_common.h"
+#include "nxt_pool.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define NXT_POOL_MOVE (NXT_POOL_CACHE / 2)
+
+/* Free objects are linked through their first word */
+typedef struct nxt_pool_obj {
+    struct nxt_pool_obj *next;
+} nxt_pool_obj;
+
+typedef struct nxt_pool_slab {
+    uint8 *base;
+    size_t len;                 /* of the mapping */
+    struct nxt_pool_slab *next;
+} nxt_pool_slab;
+
+typedef struct nxt_pool_cache {
+    nxt_pool *pool;
+    size_t count;
+    void *objs[NXT_POOL_CACHE];
+    struct nxt_pool_cache *next;
+} nxt_pool_cache;
+
+struct nxt_pool {
+    size_t size;
+    pthread_key_t key;
+    pthread_mutex_t lock;
+    nxt_pool_obj *free;
+    nxt_pool_slab *slabs;
+    nxt_pool_cache *caches;
+    size_t nslabs;
+    size_t nhuge;
+    size_t objects;
+};
+
+/*
+ * Maps a slab: huge pages if some are reserved, otherwise twice the
+ * size to cut an aligned slab out of it for transparent huge pages.
+ */
+static uint8 *nxt_pool_map(size_t *len, int *huge)
+{
+    uint8 *p;
+    size_t lead;
+    void *m;
+
+#ifdef MAP_HUGETLB
+    m = mmap(NULL, NXT_POOL_SLAB_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (m != MAP_FAILED) {
+        *len = NXT_POOL_SLAB_SIZE;
+        *huge = 1;
+        return (uint8 *) m;
+    }
+#endif
+
+    m = mmap(NULL, 2 * NXT_POOL_SLAB_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED)
+        return NULL;
+
+    p = (uint8 *) m;
+    lead = (NXT_POOL_SLAB_SIZE - (size_t) p % NXT_POOL_SLAB_SIZE)
+           % NXT_POOL_SLAB_SIZE;
+    if (lead > 0)
+        munmap(p, lead);
+    munmap(p + lead + NXT_POOL_SLAB_SIZE, NXT_POOL_SLAB_SIZE - lead);
+    p += lead;
+
+#ifdef MADV_HUGEPAGE
+    madvise(p, NXT_POOL_SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+    *len = NXT_POOL_SLAB_SIZE;
+    *huge = 0;
+
+    return p;
+}
+
+/* Adds a slab to the free list, with the lock held */
+static int nxt_pool_grow(nxt_pool *pool)
+{
+    nxt_pool_slab *slab;
+    nxt_pool_obj *obj;
+    size_t n;
+    int huge;
+
+    slab = (nxt_pool_slab *) malloc(sizeof(nxt_pool_slab));
+    if (slab == NULL)
+        return -1;
+
+    slab->base = nxt_pool_map(&slab->len, &huge);
+    if (slab->base == NULL) {
+        free(slab);
+        return -1;
+    }
+#ifdef MADV_DONTDUMP
+    madvise(slab->base, slab->len, MADV_DONTDUMP);
+#endif
+
+    /* Linked from the end so that the first objects go out first */
+    for (n = NXT_POOL_SLAB_SIZE / pool->size; n > 0; n--) {
+        obj = (nxt_pool_obj *) (slab->base + (n - 1) * pool->size);
+        obj->next = pool->free;
+        pool->free = obj;
+        pool->objects++;
+    }
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->nslabs++;
+    pool->nhuge += (size_t) huge;
+
+    return 0;
+}
+
+/* Takes up to count objects from the shared list, zeroed */
+static size_t nxt_pool_take(nxt_pool *pool, void **objs, size_t count)
+{
+    nxt_pool_obj *obj;
+    size_t n;
+
+    pthread_mutex_lock(&pool->lock);
+    for (n = 0; n < count; n++) {
+        if (pool->free == NULL && nxt_pool_grow(pool) != 0)
+            break;
+        obj = pool->free;
+        pool->free = obj->next;
+        obj->next = NULL;
+        objs[n] = obj;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return n;
+}
+
+/* Gives wiped objects back to the shared list */
+static void nxt_pool_give(nxt_pool *pool, void **objs, size_t count)
+{
+    nxt_pool_obj *obj;
+    size_t i;
+
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < count; i++) {
+        obj = (nxt_pool_obj *) objs[i];
+        obj->next = pool->free;
+        pool->free = obj;
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Thread exit: the cached objects go back to the pool */
+static void nxt_pool_cache_free(void *arg)
+{
+    nxt_pool_cache *cache = (nxt_pool_cache *) arg;
+    nxt_pool *pool = cache->pool;
+    nxt_pool_cache **pp;
+
+    nxt_pool_give(pool, cache->objs, cache->count);
+
+    pthread_mutex_lock(&pool->lock);
+    for (pp = &pool->caches; *pp != cache; pp = &(*pp)->next)
+        ;
+    *pp = cache->next;
+    pthread_mutex_unlock(&pool->lock);
+
+    free(cache);
+}
+
+static nxt_pool_cache *nxt_pool_cache_get(nxt_pool *pool)
+{
+    nxt_pool_cache *cache;
+
+    cache = (nxt_pool_cache *) pthread_getspecific(pool->key);
+    if (cache != NULL)
+        return cache;
+
+    cache = (nxt_pool_cache *) calloc(1, sizeof(nxt_pool_cache));
+    if (cache == NULL)
+        return NULL;
+    cache->pool = pool;
+
+    if (pthread_setspecific(pool->key, cache) != 0) {
+        free(cache);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    cache->next = pool->caches;
+    pool->caches = cache;
+    pthread_mutex_unlock(&pool->lock);
+
+    return cache;
+}
+
+nxt_pool *nxt_pool_new(size_t size)
+{
+    nxt_pool *pool;
+
+    size = (size + NXT_POOL_ALIGN - 1) / NXT_POOL_ALIGN * NXT_POOL_ALIGN;
+    assert(size > 0 && size <= NXT_POOL_SLAB_SIZE);
+
+    pool = (nxt_pool *) calloc(1, sizeof(nxt_pool));
+    if (pool == NULL)
+        return NULL;
+
+    if (pthread_key_create(&pool->key, nxt_pool_cache_free) != 0) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->size = size;
+
+    return pool;
+}
+
+void nxt_pool_free(nxt_pool *pool)
+{
+    nxt_pool_cache *cache;
+    nxt_pool_slab *slab;
+
+    if (pool == NULL)
+        return;
+
+    /* No thread exit may touch the pool from now on */
+    pthread_key_delete(pool->key);
+
+    while ((cache = pool->caches) != NULL) {
+        pool->caches = cache->next;
+        free(cache);
+    }
+
+    while ((slab = pool->slabs) != NULL) {
+        pool->slabs = slab->next;
+        nxt_wipe(slab->base, slab->len);
+        munmap(slab->base, slab->len);
+        free(slab);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+void *nxt_pool_alloc(nxt_pool *pool)
+{
+    nxt_pool_cache *cache;
+    void *obj;
+
+    cache = nxt_pool_cache_get(pool);
+    if (cache == NULL)
+        return nxt_pool_take(pool, &obj, 1) == 1 ? obj : NULL;
+
+    if (cache->count == 0)
+        cache->count = nxt_pool_take(pool, cache->objs, NXT_POOL_MOVE);
+    if (cache->count == 0)
+        return NULL;
+
+    obj = cache->objs[--cache->count];
+    ((nxt_pool_obj *) obj)->next = NULL;
+
+    return obj;
+}
+
+size_t nxt_pool_alloc_bulk(nxt_pool *pool, void **objs, size_t count)
+{
+    nxt_pool_cache *cache;
+    size_t n = 0;
+
+    cache = nxt_pool_cache_get(pool);
+    if (cache != NULL) {
+        while (n < count && cache->count > 0) {
+            objs[n] = cache->objs[--cache->count];
+            ((nxt_pool_obj *) objs[n])->next = NULL;
+            n++;
+        }
+    }
+
+    return n + nxt_pool_take(pool, objs + n, count - n);
+}
+
+void nxt_pool_release(nxt_pool *pool, void *obj)
+{
+    nxt_pool_release_bulk(pool, &obj, 1);
+}
+
+void nxt_pool_release_bulk(nxt_pool *pool, void **objs, size_t count)
+{
+    nxt_pool_cache *cache;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        nxt_wipe(objs[i], pool->size);
+    }
+
+    cache = nxt_pool_cache_get(pool);
+    if (cache == NULL) {
+        nxt_pool_give(pool, objs, count);
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (cache->count == NXT_POOL_CACHE) {
+            cache->count -= NXT_POOL_MOVE;
+            nxt_pool_give(pool, cache->objs + cache->count, NXT_POOL_MOVE);
+        }
+        cache->objs[cache->count++] = objs[i];
+    }
+}
+
+void nxt_pool_stats(nxt_pool *pool, size_t *slabs, size_t *huge,
+                    size_t *objects)
+{
+    pthread_mutex_lock(&pool->lock);
+    *slabs = pool->nslabs;
+    *huge = pool->nhuge;
+    *objects = pool->objects;
+    pthread_mutex_unlock(&pool->lock);
+}
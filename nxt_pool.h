@@ -0,0 +1,94 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_POOL_H
+#define NXT_POOL_H
+
+#include <stddef.h>
+
+#include "nxt64.h"
+#include "nxt128.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pool of fixed size objects, meant for large numbers of nxt64_ctx or
+ * nxt128_ctx key schedules.
+ *
+ * The objects are carved out of slabs of NXT_POOL_SLAB_SIZE bytes,
+ * mapped with explicit huge pages when the system has some reserved,
+ * aligned to their size and marked for transparent huge pages
+ * otherwise, so that the key schedules in use share few TLB entries.
+ * The object size is rounded up to a multiple of NXT_POOL_ALIGN, the
+ * cache line size, and the objects are aligned on it: no two objects
+ * share a cache line. The slabs are kept out of core dumps where the
+ * system allows it and are only unmapped by nxt_pool_free().
+ *
+ * Each thread keeps up to NXT_POOL_CACHE free objects of its own and
+ * moves them to or from the shared free list NXT_POOL_CACHE / 2 at a
+ * time, so that most calls take no lock. The objects left in the cache
+ * of a thread go back to the shared list when it exits.
+ *
+ * nxt_pool_alloc() returns a zeroed object, or NULL when no slab can be
+ * mapped; nxt_pool_alloc_bulk() allocates count objects into objs and
+ * returns how many it got. nxt_pool_release() wipes an object with
+ * nxt_wipe() before putting it back. The objects still allocated when
+ * the pool is freed are wiped with their slabs. The functions are
+ * thread-safe but for nxt_pool_free(), which must be called when no
+ * other thread uses the pool.
+ */
+#define NXT_POOL_ALIGN     64
+#define NXT_POOL_SLAB_SIZE (2 * 1024 * 1024)
+#define NXT_POOL_CACHE     64
+
+typedef struct nxt_pool nxt_pool;
+
+nxt_pool *nxt_pool_new(size_t size);
+void nxt_pool_free(nxt_pool *pool);
+void *nxt_pool_alloc(nxt_pool *pool);
+size_t nxt_pool_alloc_bulk(nxt_pool *pool, void **objs, size_t count);
+void nxt_pool_release(nxt_pool *pool, void *obj);
+void nxt_pool_release_bulk(nxt_pool *pool, void **objs, size_t count);
+
+/* Number of slabs, of those with huge pages and of objects they hold */
+void nxt_pool_stats(nxt_pool *pool, size_t *slabs, size_t *huge,
+                    size_t *objects);
+
+#define nxt64_pool_new()  nxt_pool_new(sizeof(nxt64_ctx))
+#define nxt128_pool_new() nxt_pool_new(sizeof(nxt128_ctx))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_POOL_H */
@@ -0,0 +1,222 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <string.h>
+
+#include "nxt_common.h"
+#include "nxt_prf.h"
+
+/* Multiplication by x in GF(2^64) = GF(2)[x] / (x^64 + x^4 + x^3 + x + 1) */
+#define DBL64(w)                                           \
+{                                                          \
+    uint32 carry = (w)[0] >> 31;                           \
+    (w)[0] = ((w)[0] << 1) | ((w)[1] >> 31);               \
+    (w)[1] = ((w)[1] << 1) ^ ((uint32) 0x1b & (0 - carry)); \
+}
+
+/*
+ * Loads the r < 8 remaining bytes of the input followed by the 10*
+ * padding directly in two big-endian words.
+ */
+#define LOAD_PARTIAL(in, r, w)                                  \
+{                                                               \
+    size_t j;                                                   \
+    (w)[0] = 0;                                                 \
+    (w)[1] = 0;                                                 \
+    for (j = 0; j < (r); j++) {                                 \
+        (w)[j >> 2] |= (uint32) (in)[j] << (24 - 8 * (j & 3));  \
+    }                                                           \
+    (w)[(r) >> 2] |= (uint32) 0x80 << (24 - 8 * ((r) & 3));     \
+}
+
+void nxt_prf_init(nxt_prf_ctx *ctx, const uint8 *key, uint16 key_len)
+{
+    nxt64_ks(&ctx->cipher, key, key_len);
+
+    ctx->k1[0] = 0;
+    ctx->k1[1] = 0;
+    nxt64_encrypt_words(&ctx->cipher, ctx->k1);
+    DBL64(ctx->k1);
+
+    ctx->k2[0] = ctx->k1[0];
+    ctx->k2[1] = ctx->k1[1];
+    DBL64(ctx->k2);
+}
+
+void nxt_prf(nxt_prf_ctx *ctx, const uint8 *in, size_t len, uint8 *out)
+{
+    uint32 x[2];
+    uint32 m[2];
+    size_t r;
+
+    /* Inputs of 8 to 16 bytes: one or two blocks, no loop */
+    if ((len >= 8) && (len <= 16)) {
+        PACK32(in    , x    );
+        PACK32(in + 4, x + 1);
+
+        if (len == 8) {
+            x[0] ^= ctx->k1[0];
+            x[1] ^= ctx->k1[1];
+        } else {
+            nxt64_encrypt_words(&ctx->cipher, x);
+
+            if (len == 16) {
+                PACK32(in +  8, m    );
+                PACK32(in + 12, m + 1);
+                x[0] ^= m[0] ^ ctx->k1[0];
+                x[1] ^= m[1] ^ ctx->k1[1];
+            } else {
+                r = len - 8;
+                LOAD_PARTIAL(in + 8, r, m);
+                x[0] ^= m[0] ^ ctx->k2[0];
+                x[1] ^= m[1] ^ ctx->k2[1];
+            }
+        }
+
+        nxt64_encrypt_words(&ctx->cipher, x);
+
+        UNPACK32(x[0], out    );
+        UNPACK32(x[1], out + 4);
+        return;
+    }
+
+    x[0] = 0;
+    x[1] = 0;
+
+    for (; len > 8; len -= 8, in += 8) {
+        PACK32(in    , m    );
+        PACK32(in + 4, m + 1);
+        x[0] ^= m[0];
+        x[1] ^= m[1];
+        nxt64_encrypt_words(&ctx->cipher, x);
+    }
+
+    if (len == 8) {
+        PACK32(in    , m    );
+        PACK32(in + 4, m + 1);
+        x[0] ^= m[0] ^ ctx->k1[0];
+        x[1] ^= m[1] ^ ctx->k1[1];
+    } else {
+        LOAD_PARTIAL(in, len, m);
+        x[0] ^= m[0] ^ ctx->k2[0];
+        x[1] ^= m[1] ^ ctx->k2[1];
+    }
+
+    nxt64_encrypt_words(&ctx->cipher, x);
+
+    UNPACK32(x[0], out    );
+    UNPACK32(x[1], out + 4);
+}
+
+/*
+ * The batch function computes the CBC chains of NXT_PRF_LANES inputs
+ * together, one multi-block call per block position. The lanes are
+ * sorted by decreasing number of blocks so that the lanes still running
+ * at a given position always form a prefix of the state buffer.
+ */
+void nxt_prf_batch(nxt_prf_ctx *ctx, const uint8 *const *in,
+                   const size_t *len, uint8 *out, size_t count)
+{
+    uint8 buf[NXT_PRF_LANES * NXT64_BLOCK_SIZE];
+    uint8 k1[8];
+    uint8 k2[8];
+    size_t order[NXT_PRF_LANES];
+    size_t blocks[NXT_PRF_LANES];
+    size_t lanes;
+    size_t active;
+    size_t pos;
+    size_t r;
+    size_t i, j, k;
+    const uint8 *p;
+    uint8 *x;
+
+    UNPACK32(ctx->k1[0], k1    );
+    UNPACK32(ctx->k1[1], k1 + 4);
+    UNPACK32(ctx->k2[0], k2    );
+    UNPACK32(ctx->k2[1], k2 + 4);
+
+    for (; count > 0; count -= lanes, in += lanes, len += lanes,
+                      out += lanes * NXT_PRF_SIZE) {
+        lanes = (count < NXT_PRF_LANES) ? count : NXT_PRF_LANES;
+
+        for (i = 0; i < lanes; i++) {
+            r = (len[i] == 0) ? 1 : (len[i] + 7) >> 3;
+            for (k = i; (k > 0) && (blocks[k - 1] < r); k--) {
+                blocks[k] = blocks[k - 1];
+                order[k] = order[k - 1];
+            }
+            blocks[k] = r;
+            order[k] = i;
+        }
+
+        memset(buf, 0, lanes * NXT64_BLOCK_SIZE);
+        active = lanes;
+
+        for (pos = 0; pos < blocks[0]; pos++) {
+            while (blocks[active - 1] <= pos) {
+                active--;
+            }
+
+            for (k = 0; k < active; k++) {
+                p = in[order[k]] + pos * 8;
+                x = buf + k * NXT64_BLOCK_SIZE;
+
+                if (pos + 1 < blocks[k]) {
+                    for (j = 0; j < 8; j++) {
+                        x[j] ^= p[j];
+                    }
+                } else {
+                    r = len[order[k]] - pos * 8;
+                    if (r == 8) {
+                        for (j = 0; j < 8; j++) {
+                            x[j] ^= p[j] ^ k1[j];
+                        }
+                    } else {
+                        for (j = 0; j < r; j++) {
+                            x[j] ^= p[j];
+                        }
+                        x[r] ^= 0x80;
+                        for (j = 0; j < 8; j++) {
+                            x[j] ^= k2[j];
+                        }
+                    }
+                }
+            }
+
+            nxt64_encrypt_blocks(&ctx->cipher, buf, buf, active);
+        }
+
+        for (k = 0; k < lanes; k++) {
+            memcpy(out + order[k] * NXT_PRF_SIZE, buf + k * NXT64_BLOCK_SIZE,
+                   NXT_PRF_SIZE);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_PRF_H
+#define NXT_PRF_H
+
+#include "nxt64.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Keyed pseudo-random function mapping a byte string of any length to a
+ * 64-bit value, intended for hashing short untrusted keys (hash tables,
+ * sharding). The construction is OMAC1 (CMAC) with NXT64 as the block
+ * cipher: inputs from 8 to 16 bytes cost one or two block encryptions.
+ */
+#define NXT_PRF_SIZE  8
+#define NXT_PRF_LANES 32
+
+typedef struct {
+    nxt64_ctx cipher;
+    uint32 k1[2];
+    uint32 k2[2];
+} nxt_prf_ctx;
+
+void nxt_prf_init(nxt_prf_ctx *ctx, const uint8 *key, uint16 key_len);
+void nxt_prf(nxt_prf_ctx *ctx, const uint8 *in, size_t len, uint8 *out);
+void nxt_prf_batch(nxt_prf_ctx *ctx, const uint8 *const *in,
+                   const size_t *len, uint8 *out, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_PRF_H */
@@ -0,0 +1,1103 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <string.h>
+
+#include <openssl/core_dispatch.h>
+#include <openssl/core_names.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+
+#include "nxt_common.h"
+#include "nxt64.h"
+#include "nxt128.h"
+#include "nxt_modes.h"
+#include "nxt_provider.h"
+
+#define NXT_PROV_ECB 0
+#define NXT_PROV_CBC 1
+#define NXT_PROV_CTR 2
+#define NXT_PROV_EAX 3
+
+/* EAX progress: nonce not processed yet, header, message, tag done */
+#define NXT_PROV_EAX_INIT 0
+#define NXT_PROV_EAX_HDR  1
+#define NXT_PROV_EAX_MSG  2
+#define NXT_PROV_EAX_DONE 3
+
+#define NXT_PROV_MAX_BLOCK NXT128_BLOCK_SIZE
+
+/* Blocks of NXT64 keystream or plaintext computed at once */
+#define NXT_PROV_BATCH 32
+
+/*
+ * OMAC^t(M), computed as OMAC([t] || M): the last block seen is kept in
+ * buf since it is processed with a subkey.
+ */
+typedef struct {
+    uint8 x[NXT_PROV_MAX_BLOCK];
+    uint8 buf[NXT_PROV_MAX_BLOCK];
+    size_t n;
+} nxt_prov_omac;
+
+/*
+ * Cipher context. It holds no pointer so that duplicating it is a copy.
+ * buf is the partial block of ECB and CBC, n its length, and the last
+ * keystream block of CTR and EAX, n the number of bytes used.
+ */
+typedef struct {
+    size_t block;
+    int mode;
+    size_t key_len;
+    int enc;
+    int key_set;
+    int iv_set;
+    unsigned int pad;
+    union {
+        nxt64_ctx c64;
+        nxt128_ctx c128;
+    } ks;
+
+    uint8 iv[NXT_PROV_MAX_BLOCK];
+    uint8 ctr[NXT_PROV_MAX_BLOCK];
+    uint8 buf[NXT_PROV_MAX_BLOCK];
+    size_t n;
+
+    uint8 nonce[NXT_PROVIDER_MAX_NONCE];
+    size_t nonce_len;
+    uint8 k1[NXT_PROV_MAX_BLOCK];
+    uint8 k2[NXT_PROV_MAX_BLOCK];
+    int eax;
+    nxt_prov_omac hdr;
+    nxt_prov_omac msg;
+    uint8 tag[NXT_PROV_MAX_BLOCK];
+    uint8 expected[NXT_PROV_MAX_BLOCK];
+    size_t tag_len;
+    int tag_set;
+} nxt_prov_ctx;
+
+static void nxt_prov_encrypt(nxt_prov_ctx *ctx, const uint8 *in, uint8 *out,
+                             size_t blocks)
+{
+    if (ctx->block == NXT64_BLOCK_SIZE)
+        nxt64_encrypt_blocks(&ctx->ks.c64, in, out, blocks);
+    else
+        nxt128_encrypt_blocks(&ctx->ks.c128, in, out, blocks);
+}
+
+static void nxt_prov_decrypt(nxt_prov_ctx *ctx, const uint8 *in, uint8 *out,
+                             size_t blocks)
+{
+    if (ctx->block == NXT64_BLOCK_SIZE)
+        nxt64_decrypt_blocks(&ctx->ks.c64, in, out, blocks);
+    else
+        nxt128_decrypt_blocks(&ctx->ks.c128, in, out, blocks);
+}
+
+static void nxt_prov_xor(uint8 *a, const uint8 *b, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        a[i] ^= b[i];
+    }
+}
+
+/* Increments a big-endian counter of len bytes */
+static void nxt_prov_inc(uint8 *ctr, size_t len)
+{
+    while (len > 0 && ++ctr[--len] == 0)
+        ;
+}
+
+/* Multiplication by x for the OMAC subkeys */
+static void nxt_prov_dbl(uint8 *b, size_t len)
+{
+    uint8 carry;
+    size_t i;
+
+    carry = b[0] >> 7;
+    for (i = 0; i < len - 1; i++) {
+        b[i] = (uint8) ((b[i] << 1) | (b[i + 1] >> 7));
+    }
+    b[len - 1] = (uint8) ((b[len - 1] << 1)
+                          ^ ((len == NXT64_BLOCK_SIZE ? 0x1b : 0x87)
+                             & (0 - carry)));
+}
+
+static void nxt_prov_keystream(nxt_prov_ctx *ctx, uint8 *ctr, uint8 *out,
+                               size_t blocks)
+{
+    size_t i;
+
+    if (ctx->block == NXT128_BLOCK_SIZE) {
+        nxt128_ctr_keystream(&ctx->ks.c128, ctr, out, blocks);
+        return;
+    }
+
+    for (i = 0; i < blocks; i++) {
+        memcpy(out + i * NXT64_BLOCK_SIZE, ctr, NXT64_BLOCK_SIZE);
+        nxt_prov_inc(ctr, NXT64_BLOCK_SIZE);
+    }
+    nxt64_encrypt_blocks(&ctx->ks.c64, out, out, blocks);
+}
+
+/* CTR mode on whole blocks */
+static void nxt_prov_ctr_blocks(nxt_prov_ctx *ctx, uint8 *ctr,
+                                const uint8 *in, uint8 *out, size_t len)
+{
+    uint8 ks[NXT_PROV_BATCH * NXT64_BLOCK_SIZE];
+    size_t n;
+
+    if (ctx->block == NXT128_BLOCK_SIZE) {
+        nxt128_ctr_crypt(&ctx->ks.c128, ctr, in, out, len);
+        return;
+    }
+
+    for (; len > 0; len -= n, in += n, out += n) {
+        n = (len < sizeof(ks)) ? len : sizeof(ks);
+        nxt_prov_keystream(ctx, ctr, ks, n / NXT64_BLOCK_SIZE);
+        if (out != in)
+            memcpy(out, in, n);
+        nxt_prov_xor(out, ks, n);
+    }
+
+    nxt_wipe(ks, sizeof(ks));
+}
+
+/* Streaming CTR mode, also used by EAX */
+static void nxt_prov_ctr(nxt_prov_ctx *ctx, const uint8 *in, uint8 *out,
+                         size_t len)
+{
+    size_t b = ctx->block;
+    size_t n;
+
+    for (; (len > 0) && (ctx->n < b); len--) {
+        *out++ = *in++ ^ ctx->buf[ctx->n++];
+    }
+
+    n = len - len % b;
+    if (n > 0) {
+        nxt_prov_ctr_blocks(ctx, ctx->ctr, in, out, n);
+        in += n;
+        out += n;
+        len -= n;
+    }
+
+    if (len > 0) {
+        nxt_prov_keystream(ctx, ctx->ctr, ctx->buf, 1);
+        for (ctx->n = 0; ctx->n < len; ctx->n++) {
+            out[ctx->n] = in[ctx->n] ^ ctx->buf[ctx->n];
+        }
+    }
+}
+
+static void nxt_prov_cbc64_decrypt(nxt_prov_ctx *ctx, const uint8 *in,
+                                   uint8 *out, size_t len)
+{
+    uint8 c[NXT_PROV_BATCH * NXT64_BLOCK_SIZE];
+    size_t n, i;
+
+    for (; len > 0; len -= n, in += n, out += n) {
+        n = (len < sizeof(c)) ? len : sizeof(c);
+        memcpy(c, in, n);
+        nxt64_decrypt_blocks(&ctx->ks.c64, c, out, n / NXT64_BLOCK_SIZE);
+        nxt_prov_xor(out, ctx->ctr, NXT64_BLOCK_SIZE);
+        for (i = NXT64_BLOCK_SIZE; i < n; i += NXT64_BLOCK_SIZE) {
+            nxt_prov_xor(out + i, c + i - NXT64_BLOCK_SIZE,
+                         NXT64_BLOCK_SIZE);
+        }
+        memcpy(ctx->ctr, c + n - NXT64_BLOCK_SIZE, NXT64_BLOCK_SIZE);
+    }
+}
+
+/* ECB or CBC mode on whole blocks */
+static void nxt_prov_blocks(nxt_prov_ctx *ctx, const uint8 *in, uint8 *out,
+                            size_t len)
+{
+    size_t b = ctx->block;
+
+    if (ctx->mode == NXT_PROV_ECB) {
+        if (ctx->enc)
+            nxt_prov_encrypt(ctx, in, out, len / b);
+        else
+            nxt_prov_decrypt(ctx, in, out, len / b);
+    } else if (b == NXT128_BLOCK_SIZE) {
+        if (ctx->enc)
+            nxt128_cbc_encrypt(&ctx->ks.c128, ctx->ctr, in, out, len);
+        else
+            nxt128_cbc_decrypt(&ctx->ks.c128, ctx->ctr, in, out, len);
+    } else if (ctx->enc) {
+        for (; len > 0; len -= b, in += b, out += b) {
+            nxt_prov_xor(ctx->ctr, in, b);
+            nxt64_encrypt(&ctx->ks.c64, ctx->ctr, ctx->ctr);
+            memcpy(out, ctx->ctr, b);
+        }
+    } else {
+        nxt_prov_cbc64_decrypt(ctx, in, out, len);
+    }
+}
+
+static void nxt_prov_omac_start(nxt_prov_ctx *ctx, nxt_prov_omac *st, int t)
+{
+    memset(st->x, 0, sizeof(st->x));
+    memset(st->buf, 0, sizeof(st->buf));
+    st->buf[ctx->block - 1] = (uint8) t;
+    st->n = ctx->block;
+}
+
+static void nxt_prov_omac_update(nxt_prov_ctx *ctx, nxt_prov_omac *st,
+                                 const uint8 *in, size_t len)
+{
+    size_t b = ctx->block;
+    size_t n;
+
+    while (len > 0) {
+        if (st->n == b) {
+            nxt_prov_xor(st->x, st->buf, b);
+            nxt_prov_encrypt(ctx, st->x, st->x, 1);
+            st->n = 0;
+
+            for (; len > b; len -= b, in += b) {
+                nxt_prov_xor(st->x, in, b);
+                nxt_prov_encrypt(ctx, st->x, st->x, 1);
+            }
+        }
+
+        n = b - st->n;
+        if (n > len)
+            n = len;
+
+        memcpy(st->buf + st->n, in, n);
+        st->n += n;
+        in += n;
+        len -= n;
+    }
+}
+
+static void nxt_prov_omac_final(nxt_prov_ctx *ctx, nxt_prov_omac *st,
+                                uint8 *out)
+{
+    size_t b = ctx->block;
+
+    if (st->n == b) {
+        nxt_prov_xor(st->x, ctx->k1, b);
+    } else {
+        st->buf[st->n] = 0x80;
+        memset(st->buf + st->n + 1, 0, b - st->n - 1);
+        nxt_prov_xor(st->x, ctx->k2, b);
+    }
+
+    nxt_prov_xor(st->x, st->buf, b);
+    nxt_prov_encrypt(ctx, st->x, out, 1);
+}
+
+/* Processes the nonce once the key and the nonce are both known */
+static void nxt_prov_eax_start(nxt_prov_ctx *ctx)
+{
+    nxt_prov_omac st;
+
+    nxt_prov_omac_start(ctx, &st, 0);
+    nxt_prov_omac_update(ctx, &st, ctx->nonce, ctx->nonce_len);
+    nxt_prov_omac_final(ctx, &st, ctx->ctr);
+    memcpy(ctx->tag, ctx->ctr, ctx->block);
+
+    nxt_prov_omac_start(ctx, &ctx->hdr, 1);
+    nxt_prov_omac_start(ctx, &ctx->msg, 2);
+    ctx->n = ctx->block;
+    ctx->eax = NXT_PROV_EAX_HDR;
+}
+
+static void nxt_prov_eax_hdr_done(nxt_prov_ctx *ctx)
+{
+    uint8 h[NXT_PROV_MAX_BLOCK];
+
+    nxt_prov_omac_final(ctx, &ctx->hdr, h);
+    nxt_prov_xor(ctx->tag, h, ctx->block);
+    ctx->eax = NXT_PROV_EAX_MSG;
+}
+
+static int nxt_prov_eax_update(nxt_prov_ctx *ctx, uint8 *out, size_t *outl,
+                               size_t outsize, const uint8 *in, size_t inl)
+{
+    if (!ctx->iv_set || ctx->eax == NXT_PROV_EAX_DONE)
+        return 0;
+
+    if (ctx->eax == NXT_PROV_EAX_INIT)
+        nxt_prov_eax_start(ctx);
+
+    /* Header */
+    if (out == NULL) {
+        if (ctx->eax != NXT_PROV_EAX_HDR)
+            return 0;
+        nxt_prov_omac_update(ctx, &ctx->hdr, in, inl);
+        *outl = inl;
+        return 1;
+    }
+
+    if (outsize < inl)
+        return 0;
+
+    if (ctx->eax == NXT_PROV_EAX_HDR)
+        nxt_prov_eax_hdr_done(ctx);
+
+    if (ctx->enc) {
+        nxt_prov_ctr(ctx, in, out, inl);
+        nxt_prov_omac_update(ctx, &ctx->msg, out, inl);
+    } else {
+        nxt_prov_omac_update(ctx, &ctx->msg, in, inl);
+        nxt_prov_ctr(ctx, in, out, inl);
+    }
+
+    *outl = inl;
+    return 1;
+}
+
+static int nxt_prov_eax_final(nxt_prov_ctx *ctx, size_t *outl)
+{
+    uint8 c[NXT_PROV_MAX_BLOCK];
+
+    if (!ctx->iv_set || ctx->eax == NXT_PROV_EAX_DONE)
+        return 0;
+
+    if (ctx->eax == NXT_PROV_EAX_INIT)
+        nxt_prov_eax_start(ctx);
+    if (ctx->eax == NXT_PROV_EAX_HDR)
+        nxt_prov_eax_hdr_done(ctx);
+
+    nxt_prov_omac_final(ctx, &ctx->msg, c);
+    nxt_prov_xor(ctx->tag, c, ctx->block);
+    ctx->eax = NXT_PROV_EAX_DONE;
+
+    *outl = 0;
+
+    if (!ctx->enc) {
+        if (!ctx->tag_set)
+            return 0;
+        ctx->tag_set = 0;
+        if (CRYPTO_memcmp(ctx->tag, ctx->expected, ctx->tag_len) != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * ECB and CBC. When decrypting with padding, the last whole block is
+ * kept in buf until the final call.
+ */
+static int nxt_prov_block_update(nxt_prov_ctx *ctx, uint8 *out,
+                                 size_t *outl, size_t outsize,
+                                 const uint8 *in, size_t inl)
+{
+    size_t b = ctx->block;
+    size_t total, n;
+    int hold;
+
+    hold = (!ctx->enc && ctx->pad);
+
+    total = ctx->n + inl;
+    total -= total % b;
+    if (hold && (total > 0) && (total == ctx->n + inl))
+        total -= b;
+
+    if (outsize < total)
+        return 0;
+    *outl = total;
+
+    if (ctx->n > 0) {
+        n = b - ctx->n;
+        if (n > inl)
+            n = inl;
+        memcpy(ctx->buf + ctx->n, in, n);
+        ctx->n += n;
+        in += n;
+        inl -= n;
+
+        if ((ctx->n < b) || (hold && inl == 0))
+            return 1;
+
+        nxt_prov_blocks(ctx, ctx->buf, out, b);
+        out += b;
+        ctx->n = 0;
+    }
+
+    n = inl - inl % b;
+    if (hold && (n > 0) && (n == inl))
+        n -= b;
+
+    if (n > 0)
+        nxt_prov_blocks(ctx, in, out, n);
+
+    memcpy(ctx->buf, in + n, inl - n);
+    ctx->n = inl - n;
+
+    return 1;
+}
+
+static int nxt_prov_block_final(nxt_prov_ctx *ctx, uint8 *out, size_t *outl,
+                                size_t outsize)
+{
+    size_t b = ctx->block;
+    size_t i;
+    uint8 p, diff;
+
+    *outl = 0;
+
+    if (!ctx->pad)
+        return (ctx->n == 0);
+
+    if (ctx->enc) {
+        if (outsize < b)
+            return 0;
+        p = (uint8) (b - ctx->n);
+        memset(ctx->buf + ctx->n, p, p);
+        nxt_prov_blocks(ctx, ctx->buf, out, b);
+        ctx->n = 0;
+        *outl = b;
+        return 1;
+    }
+
+    if (ctx->n != b)
+        return 0;
+
+    nxt_prov_blocks(ctx, ctx->buf, ctx->buf, b);
+    ctx->n = 0;
+
+    p = ctx->buf[b - 1];
+    if ((p == 0) || (p > b))
+        return 0;
+
+    diff = 0;
+    for (i = b - p; i < b; i++) {
+        diff |= ctx->buf[i] ^ p;
+    }
+    if ((diff != 0) || (outsize < b - p))
+        return 0;
+
+    memcpy(out, ctx->buf, b - p);
+    nxt_wipe(ctx->buf, b);
+    *outl = b - p;
+
+    return 1;
+}
+
+static size_t nxt_prov_iv_len(const nxt_prov_ctx *ctx)
+{
+    if (ctx->mode == NXT_PROV_ECB)
+        return 0;
+    if (ctx->mode == NXT_PROV_EAX)
+        return ctx->nonce_len;
+    return ctx->block;
+}
+
+static void *nxt_prov_newctx(void *provctx, size_t block, int mode,
+                             size_t bits)
+{
+    nxt_prov_ctx *ctx;
+
+    (void) provctx;
+
+    ctx = (nxt_prov_ctx *) OPENSSL_zalloc(sizeof(nxt_prov_ctx));
+    if (ctx == NULL)
+        return NULL;
+
+    ctx->block = block;
+    ctx->mode = mode;
+    ctx->key_len = bits / 8;
+    ctx->pad = 1;
+    ctx->nonce_len = block;
+    ctx->tag_len = block;
+
+    return ctx;
+}
+
+static void nxt_prov_freectx(void *vctx)
+{
+    OPENSSL_clear_free(vctx, sizeof(nxt_prov_ctx));
+}
+
+static void *nxt_prov_dupctx(void *vctx)
+{
+    nxt_prov_ctx *ctx;
+
+    ctx = (nxt_prov_ctx *) OPENSSL_malloc(sizeof(nxt_prov_ctx));
+    if (ctx != NULL)
+        memcpy(ctx, vctx, sizeof(nxt_prov_ctx));
+
+    return ctx;
+}
+
+static const OSSL_PARAM nxt_prov_ctx_gettable[] = {
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_KEYLEN, NULL),
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_IVLEN, NULL),
+    OSSL_PARAM_uint(OSSL_CIPHER_PARAM_PADDING, NULL),
+    OSSL_PARAM_uint(OSSL_CIPHER_PARAM_NUM, NULL),
+    OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_IV, NULL, 0),
+    OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_UPDATED_IV, NULL, 0),
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_AEAD_TAGLEN, NULL),
+    OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG, NULL, 0),
+    OSSL_PARAM_END
+};
+
+static const OSSL_PARAM nxt_prov_ctx_settable[] = {
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_KEYLEN, NULL),
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_AEAD_IVLEN, NULL),
+    OSSL_PARAM_uint(OSSL_CIPHER_PARAM_PADDING, NULL),
+    OSSL_PARAM_octet_string(OSSL_CIPHER_PARAM_AEAD_TAG, NULL, 0),
+    OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *nxt_prov_gettable_ctx_params(void *vctx,
+                                                      void *provctx)
+{
+    (void) vctx;
+    (void) provctx;
+
+    return nxt_prov_ctx_gettable;
+}
+
+static const OSSL_PARAM *nxt_prov_settable_ctx_params(void *vctx,
+                                                      void *provctx)
+{
+    (void) vctx;
+    (void) provctx;
+
+    return nxt_prov_ctx_settable;
+}
+
+static int nxt_prov_set_octets(OSSL_PARAM *p, const uint8 *data, size_t len)
+{
+    return OSSL_PARAM_set_octet_ptr(p, data, len)
+           || OSSL_PARAM_set_octet_string(p, data, len);
+}
+
+static int nxt_prov_get_ctx_params(void *vctx, OSSL_PARAM params[])
+{
+    nxt_prov_ctx *ctx = (nxt_prov_ctx *) vctx;
+    const uint8 *iv, *updated;
+    OSSL_PARAM *p;
+    unsigned int num;
+
+    if (ctx->mode == NXT_PROV_EAX) {
+        iv = updated = ctx->nonce;
+        num = (unsigned int) (ctx->n % ctx->block);
+    } else {
+        iv = ctx->iv;
+        updated = ctx->ctr;
+        num = (ctx->mode == NXT_PROV_CTR)
+              ? (unsigned int) (ctx->n % ctx->block) : 0;
+    }
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL && !OSSL_PARAM_set_size_t(p, ctx->key_len))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_IVLEN);
+    if (p != NULL && !OSSL_PARAM_set_size_t(p, nxt_prov_iv_len(ctx)))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_PADDING);
+    if (p != NULL && !OSSL_PARAM_set_uint(p, ctx->pad))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_NUM);
+    if (p != NULL && !OSSL_PARAM_set_uint(p, num))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_IV);
+    if (p != NULL && !nxt_prov_set_octets(p, iv, nxt_prov_iv_len(ctx)))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_UPDATED_IV);
+    if (p != NULL && !nxt_prov_set_octets(p, updated, nxt_prov_iv_len(ctx)))
+        return 0;
+
+    if (ctx->mode != NXT_PROV_EAX)
+        return 1;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TAGLEN);
+    if (p != NULL && !OSSL_PARAM_set_size_t(p, ctx->tag_len))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        if (!ctx->enc || ctx->eax != NXT_PROV_EAX_DONE
+            || p->data_size == 0 || p->data_size > ctx->block
+            || !OSSL_PARAM_set_octet_string(p, ctx->tag, p->data_size))
+            return 0;
+    }
+
+    return 1;
+}
+
+static int nxt_prov_set_ctx_params(void *vctx, const OSSL_PARAM params[])
+{
+    nxt_prov_ctx *ctx = (nxt_prov_ctx *) vctx;
+    const OSSL_PARAM *p;
+    size_t len;
+
+    if (params == NULL)
+        return 1;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_PADDING);
+    if (p != NULL && !OSSL_PARAM_get_uint(p, &ctx->pad))
+        return 0;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL) {
+        if (!OSSL_PARAM_get_size_t(p, &len) || len != ctx->key_len)
+            return 0;
+    }
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_IVLEN);
+    if (p != NULL) {
+        if (!OSSL_PARAM_get_size_t(p, &len))
+            return 0;
+        if (ctx->mode != NXT_PROV_EAX)
+            return (len == nxt_prov_iv_len(ctx));
+        if (len == 0 || len > NXT_PROVIDER_MAX_NONCE)
+            return 0;
+        if (len != ctx->nonce_len) {
+            ctx->nonce_len = len;
+            ctx->iv_set = 0;
+        }
+    }
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        if (ctx->mode != NXT_PROV_EAX
+            || p->data_type != OSSL_PARAM_OCTET_STRING
+            || p->data_size == 0 || p->data_size > ctx->block)
+            return 0;
+        if (p->data != NULL) {
+            if (ctx->enc)
+                return 0;
+            memcpy(ctx->expected, p->data, p->data_size);
+            ctx->tag_set = 1;
+        }
+        ctx->tag_len = p->data_size;
+    }
+
+    return 1;
+}
+
+static int nxt_prov_init(nxt_prov_ctx *ctx, const unsigned char *key,
+                         size_t keylen, const unsigned char *iv,
+                         size_t ivlen, const OSSL_PARAM params[], int enc)
+{
+    ctx->enc = enc;
+
+    if (key != NULL) {
+        if (keylen != ctx->key_len)
+            return 0;
+
+        if (ctx->block == NXT64_BLOCK_SIZE)
+            nxt64_ks(&ctx->ks.c64, key, (uint16) (keylen * 8));
+        else
+            nxt128_ks(&ctx->ks.c128, key, (uint16) (keylen * 8));
+
+        if (ctx->mode == NXT_PROV_EAX) {
+            memset(ctx->k1, 0, ctx->block);
+            nxt_prov_encrypt(ctx, ctx->k1, ctx->k1, 1);
+            nxt_prov_dbl(ctx->k1, ctx->block);
+            memcpy(ctx->k2, ctx->k1, ctx->block);
+            nxt_prov_dbl(ctx->k2, ctx->block);
+        }
+        ctx->key_set = 1;
+    }
+
+    if (iv != NULL && ctx->mode != NXT_PROV_ECB) {
+        if (ctx->mode == NXT_PROV_EAX) {
+            if (ivlen == 0 || ivlen > NXT_PROVIDER_MAX_NONCE)
+                return 0;
+            memcpy(ctx->nonce, iv, ivlen);
+            ctx->nonce_len = ivlen;
+        } else {
+            if (ivlen != ctx->block)
+                return 0;
+            memcpy(ctx->iv, iv, ivlen);
+            memcpy(ctx->ctr, iv, ivlen);
+        }
+        ctx->iv_set = 1;
+    }
+
+    /* A new message starts */
+    ctx->n = (ctx->mode == NXT_PROV_CTR) ? ctx->block : 0;
+    ctx->eax = NXT_PROV_EAX_INIT;
+
+    return nxt_prov_set_ctx_params(ctx, params);
+}
+
+static int nxt_prov_einit(void *vctx, const unsigned char *key,
+                          size_t keylen, const unsigned char *iv,
+                          size_t ivlen, const OSSL_PARAM params[])
+{
+    return nxt_prov_init((nxt_prov_ctx *) vctx, key, keylen, iv, ivlen,
+                         params, 1);
+}
+
+static int nxt_prov_dinit(void *vctx, const unsigned char *key,
+                          size_t keylen, const unsigned char *iv,
+                          size_t ivlen, const OSSL_PARAM params[])
+{
+    return nxt_prov_init((nxt_prov_ctx *) vctx, key, keylen, iv, ivlen,
+                         params, 0);
+}
+
+static int nxt_prov_update(void *vctx, unsigned char *out, size_t *outl,
+                           size_t outsize, const unsigned char *in,
+                           size_t inl)
+{
+    nxt_prov_ctx *ctx = (nxt_prov_ctx *) vctx;
+
+    if (!ctx->key_set || (ctx->mode != NXT_PROV_ECB && !ctx->iv_set))
+        return 0;
+
+    switch (ctx->mode) {
+    case NXT_PROV_CTR:
+        if (outsize < inl)
+            return 0;
+        nxt_prov_ctr(ctx, in, out, inl);
+        *outl = inl;
+        return 1;
+
+    case NXT_PROV_EAX:
+        return nxt_prov_eax_update(ctx, out, outl, outsize, in, inl);
+
+    default:
+        return nxt_prov_block_update(ctx, out, outl, outsize, in, inl);
+    }
+}
+
+static int nxt_prov_final(void *vctx, unsigned char *out, size_t *outl,
+                          size_t outsize)
+{
+    nxt_prov_ctx *ctx = (nxt_prov_ctx *) vctx;
+
+    if (!ctx->key_set || (ctx->mode != NXT_PROV_ECB && !ctx->iv_set))
+        return 0;
+
+    switch (ctx->mode) {
+    case NXT_PROV_CTR:
+        *outl = 0;
+        return 1;
+
+    case NXT_PROV_EAX:
+        return nxt_prov_eax_final(ctx, outl);
+
+    default:
+        return nxt_prov_block_final(ctx, out, outl, outsize);
+    }
+}
+
+/* One-shot call of EVP_Cipher(): whole blocks only for ECB and CBC */
+static int nxt_prov_cipher(void *vctx, unsigned char *out, size_t *outl,
+                           size_t outsize, const unsigned char *in,
+                           size_t inl)
+{
+    nxt_prov_ctx *ctx = (nxt_prov_ctx *) vctx;
+
+    if (ctx->mode == NXT_PROV_EAX && in == NULL)
+        return nxt_prov_final(vctx, out, outl, outsize);
+
+    if (ctx->mode == NXT_PROV_ECB || ctx->mode == NXT_PROV_CBC) {
+        if (!ctx->key_set || (ctx->mode == NXT_PROV_CBC && !ctx->iv_set)
+            || ctx->n != 0 || inl % ctx->block != 0 || outsize < inl)
+            return 0;
+        nxt_prov_blocks(ctx, in, out, inl);
+        *outl = inl;
+        return 1;
+    }
+
+    return nxt_prov_update(vctx, out, outl, outsize, in, inl);
+}
+
+static const OSSL_PARAM nxt_prov_gettable[] = {
+    OSSL_PARAM_uint(OSSL_CIPHER_PARAM_MODE, NULL),
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_KEYLEN, NULL),
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_IVLEN, NULL),
+    OSSL_PARAM_size_t(OSSL_CIPHER_PARAM_BLOCK_SIZE, NULL),
+    OSSL_PARAM_int(OSSL_CIPHER_PARAM_AEAD, NULL),
+    OSSL_PARAM_int(OSSL_CIPHER_PARAM_CUSTOM_IV, NULL),
+    OSSL_PARAM_int(OSSL_CIPHER_PARAM_CTS, NULL),
+    OSSL_PARAM_int(OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK, NULL),
+    OSSL_PARAM_int(OSSL_CIPHER_PARAM_HAS_RAND_KEY, NULL),
+    OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *nxt_prov_gettable_params(void *provctx)
+{
+    (void) provctx;
+
+    return nxt_prov_gettable;
+}
+
+static int nxt_prov_get_params(OSSL_PARAM params[], size_t block, int mode,
+                               size_t bits)
+{
+    static const unsigned int modes[] = {
+        EVP_CIPH_ECB_MODE, EVP_CIPH_CBC_MODE, EVP_CIPH_CTR_MODE,
+        EVP_CIPH_STREAM_CIPHER
+    };
+    OSSL_PARAM *p;
+    size_t iv_len;
+    int aead;
+
+    aead = (mode == NXT_PROV_EAX);
+    iv_len = (mode == NXT_PROV_ECB) ? 0 : block;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_MODE);
+    if (p != NULL && !OSSL_PARAM_set_uint(p, modes[mode]))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL && !OSSL_PARAM_set_size_t(p, bits / 8))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_IVLEN);
+    if (p != NULL && !OSSL_PARAM_set_size_t(p, iv_len))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_BLOCK_SIZE);
+    if (p != NULL
+        && !OSSL_PARAM_set_size_t(p, (mode <= NXT_PROV_CBC) ? block : 1))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD);
+    if (p != NULL && !OSSL_PARAM_set_int(p, aead))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_CUSTOM_IV);
+    if (p != NULL && !OSSL_PARAM_set_int(p, aead))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_CTS);
+    if (p != NULL && !OSSL_PARAM_set_int(p, 0))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_TLS1_MULTIBLOCK);
+    if (p != NULL && !OSSL_PARAM_set_int(p, 0))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_HAS_RAND_KEY);
+    if (p != NULL && !OSSL_PARAM_set_int(p, 0))
+        return 0;
+
+    return 1;
+}
+
+/*
+ * The dispatch table of one cipher. The block size, mode and key length
+ * are given to the shared functions by the two which differ per cipher.
+ */
+#define NXT_PROV_CIPHER(name, block, mode, bits)                           \
+static void *name##_newctx(void *provctx)                                  \
+{                                                                          \
+    return nxt_prov_newctx(provctx, block, mode, bits);                    \
+}                                                                          \
+                                                                           \
+static int name##_get_params(OSSL_PARAM params[])                          \
+{                                                                          \
+    return nxt_prov_get_params(params, block, mode, bits);                 \
+}                                                                          \
+                                                                           \
+static const OSSL_DISPATCH name##_functions[] = {                          \
+    { OSSL_FUNC_CIPHER_NEWCTX, (void (*)(void)) name##_newctx },           \
+    { OSSL_FUNC_CIPHER_FREECTX, (void (*)(void)) nxt_prov_freectx },       \
+    { OSSL_FUNC_CIPHER_DUPCTX, (void (*)(void)) nxt_prov_dupctx },         \
+    { OSSL_FUNC_CIPHER_ENCRYPT_INIT, (void (*)(void)) nxt_prov_einit },    \
+    { OSSL_FUNC_CIPHER_DECRYPT_INIT, (void (*)(void)) nxt_prov_dinit },    \
+    { OSSL_FUNC_CIPHER_UPDATE, (void (*)(void)) nxt_prov_update },         \
+    { OSSL_FUNC_CIPHER_FINAL, (void (*)(void)) nxt_prov_final },           \
+    { OSSL_FUNC_CIPHER_CIPHER, (void (*)(void)) nxt_prov_cipher },         \
+    { OSSL_FUNC_CIPHER_GET_PARAMS, (void (*)(void)) name##_get_params },   \
+    { OSSL_FUNC_CIPHER_GETTABLE_PARAMS,                                    \
+      (void (*)(void)) nxt_prov_gettable_params },                         \
+    { OSSL_FUNC_CIPHER_GET_CTX_PARAMS,                                     \
+      (void (*)(void)) nxt_prov_get_ctx_params },                          \
+    { OSSL_FUNC_CIPHER_GETTABLE_CTX_PARAMS,                                \
+      (void (*)(void)) nxt_prov_gettable_ctx_params },                     \
+    { OSSL_FUNC_CIPHER_SET_CTX_PARAMS,                                     \
+      (void (*)(void)) nxt_prov_set_ctx_params },                          \
+    { OSSL_FUNC_CIPHER_SETTABLE_CTX_PARAMS,                                \
+      (void (*)(void)) nxt_prov_settable_ctx_params },                     \
+    { 0, NULL }                                                            \
+};
+
+NXT_PROV_CIPHER(nxt64_128_ecb, NXT64_BLOCK_SIZE, NXT_PROV_ECB, 128)
+NXT_PROV_CIPHER(nxt64_192_ecb, NXT64_BLOCK_SIZE, NXT_PROV_ECB, 192)
+NXT_PROV_CIPHER(nxt64_256_ecb, NXT64_BLOCK_SIZE, NXT_PROV_ECB, 256)
+NXT_PROV_CIPHER(nxt64_128_cbc, NXT64_BLOCK_SIZE, NXT_PROV_CBC, 128)
+NXT_PROV_CIPHER(nxt64_192_cbc, NXT64_BLOCK_SIZE, NXT_PROV_CBC, 192)
+NXT_PROV_CIPHER(nxt64_256_cbc, NXT64_BLOCK_SIZE, NXT_PROV_CBC, 256)
+NXT_PROV_CIPHER(nxt64_128_ctr, NXT64_BLOCK_SIZE, NXT_PROV_CTR, 128)
+NXT_PROV_CIPHER(nxt64_192_ctr, NXT64_BLOCK_SIZE, NXT_PROV_CTR, 192)
+NXT_PROV_CIPHER(nxt64_256_ctr, NXT64_BLOCK_SIZE, NXT_PROV_CTR, 256)
+NXT_PROV_CIPHER(nxt64_128_eax, NXT64_BLOCK_SIZE, NXT_PROV_EAX, 128)
+NXT_PROV_CIPHER(nxt64_192_eax, NXT64_BLOCK_SIZE, NXT_PROV_EAX, 192)
+NXT_PROV_CIPHER(nxt64_256_eax, NXT64_BLOCK_SIZE, NXT_PROV_EAX, 256)
+NXT_PROV_CIPHER(nxt128_128_ecb, NXT128_BLOCK_SIZE, NXT_PROV_ECB, 128)
+NXT_PROV_CIPHER(nxt128_192_ecb, NXT128_BLOCK_SIZE, NXT_PROV_ECB, 192)
+NXT_PROV_CIPHER(nxt128_256_ecb, NXT128_BLOCK_SIZE, NXT_PROV_ECB, 256)
+NXT_PROV_CIPHER(nxt128_128_cbc, NXT128_BLOCK_SIZE, NXT_PROV_CBC, 128)
+NXT_PROV_CIPHER(nxt128_192_cbc, NXT128_BLOCK_SIZE, NXT_PROV_CBC, 192)
+NXT_PROV_CIPHER(nxt128_256_cbc, NXT128_BLOCK_SIZE, NXT_PROV_CBC, 256)
+NXT_PROV_CIPHER(nxt128_128_ctr, NXT128_BLOCK_SIZE, NXT_PROV_CTR, 128)
+NXT_PROV_CIPHER(nxt128_192_ctr, NXT128_BLOCK_SIZE, NXT_PROV_CTR, 192)
+NXT_PROV_CIPHER(nxt128_256_ctr, NXT128_BLOCK_SIZE, NXT_PROV_CTR, 256)
+NXT_PROV_CIPHER(nxt128_128_eax, NXT128_BLOCK_SIZE, NXT_PROV_EAX, 128)
+NXT_PROV_CIPHER(nxt128_192_eax, NXT128_BLOCK_SIZE, NXT_PROV_EAX, 192)
+NXT_PROV_CIPHER(nxt128_256_eax, NXT128_BLOCK_SIZE, NXT_PROV_EAX, 256)
+
+#define NXT_PROV_PROPS "provider=" NXT_PROVIDER_NAME
+
+static const OSSL_ALGORITHM nxt_prov_ciphers[] = {
+    { "NXT64-128-ECB:NXT64-ECB", NXT_PROV_PROPS, nxt64_128_ecb_functions,
+      NULL },
+    { "NXT64-192-ECB", NXT_PROV_PROPS, nxt64_192_ecb_functions, NULL },
+    { "NXT64-256-ECB", NXT_PROV_PROPS, nxt64_256_ecb_functions, NULL },
+    { "NXT64-128-CBC:NXT64-CBC", NXT_PROV_PROPS, nxt64_128_cbc_functions,
+      NULL },
+    { "NXT64-192-CBC", NXT_PROV_PROPS, nxt64_192_cbc_functions, NULL },
+    { "NXT64-256-CBC", NXT_PROV_PROPS, nxt64_256_cbc_functions, NULL },
+    { "NXT64-128-CTR:NXT64-CTR", NXT_PROV_PROPS, nxt64_128_ctr_functions,
+      NULL },
+    { "NXT64-192-CTR", NXT_PROV_PROPS, nxt64_192_ctr_functions, NULL },
+    { "NXT64-256-CTR", NXT_PROV_PROPS, nxt64_256_ctr_functions, NULL },
+    { "NXT64-128-EAX:NXT64-EAX", NXT_PROV_PROPS, nxt64_128_eax_functions,
+      NULL },
+    { "NXT64-192-EAX", NXT_PROV_PROPS, nxt64_192_eax_functions, NULL },
+    { "NXT64-256-EAX", NXT_PROV_PROPS, nxt64_256_eax_functions, NULL },
+    { "NXT128-128-ECB:NXT128-ECB", NXT_PROV_PROPS,
+      nxt128_128_ecb_functions, NULL },
+    { "NXT128-192-ECB", NXT_PROV_PROPS, nxt128_192_ecb_functions, NULL },
+    { "NXT128-256-ECB", NXT_PROV_PROPS, nxt128_256_ecb_functions, NULL },
+    { "NXT128-128-CBC:NXT128-CBC", NXT_PROV_PROPS,
+      nxt128_128_cbc_functions, NULL },
+    { "NXT128-192-CBC", NXT_PROV_PROPS, nxt128_192_cbc_functions, NULL },
+    { "NXT128-256-CBC", NXT_PROV_PROPS, nxt128_256_cbc_functions, NULL },
+    { "NXT128-128-CTR:NXT128-CTR", NXT_PROV_PROPS,
+      nxt128_128_ctr_functions, NULL },
+    { "NXT128-192-CTR", NXT_PROV_PROPS, nxt128_192_ctr_functions, NULL },
+    { "NXT128-256-CTR", NXT_PROV_PROPS, nxt128_256_ctr_functions, NULL },
+    { "NXT128-128-EAX:NXT128-EAX", NXT_PROV_PROPS,
+      nxt128_128_eax_functions, NULL },
+    { "NXT128-192-EAX", NXT_PROV_PROPS, nxt128_192_eax_functions, NULL },
+    { "NXT128-256-EAX", NXT_PROV_PROPS, nxt128_256_eax_functions, NULL },
+    { NULL, NULL, NULL, NULL }
+};
+
+static const OSSL_ALGORITHM *nxt_prov_query(void *provctx, int operation,
+                                            int *no_cache)
+{
+    (void) provctx;
+
+    *no_cache = 0;
+
+    return (operation == OSSL_OP_CIPHER) ? nxt_prov_ciphers : NULL;
+}
+
+static const OSSL_PARAM nxt_prov_param_types[] = {
+    OSSL_PARAM_utf8_ptr(OSSL_PROV_PARAM_NAME, NULL, 0),
+    OSSL_PARAM_utf8_ptr(OSSL_PROV_PARAM_VERSION, NULL, 0),
+    OSSL_PARAM_utf8_ptr(OSSL_PROV_PARAM_BUILDINFO, NULL, 0),
+    OSSL_PARAM_int(OSSL_PROV_PARAM_STATUS, NULL),
+    OSSL_PARAM_END
+};
+
+static const OSSL_PARAM *nxt_prov_provider_gettable(void *provctx)
+{
+    (void) provctx;
+
+    return nxt_prov_param_types;
+}
+
+static int nxt_prov_provider_get_params(void *provctx, OSSL_PARAM params[])
+{
+    OSSL_PARAM *p;
+
+    (void) provctx;
+
+    p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_NAME);
+    if (p != NULL && !OSSL_PARAM_set_utf8_ptr(p, "IDEA NXT provider"))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_VERSION);
+    if (p != NULL && !OSSL_PARAM_set_utf8_ptr(p, NXT_PROVIDER_VERSION))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_BUILDINFO);
+    if (p != NULL && !OSSL_PARAM_set_utf8_ptr(p, NXT_PROVIDER_VERSION))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_STATUS);
+    if (p != NULL && !OSSL_PARAM_set_int(p, 1))
+        return 0;
+
+    return 1;
+}
+
+static void nxt_prov_teardown(void *provctx)
+{
+    (void) provctx;
+}
+
+static const OSSL_DISPATCH nxt_prov_dispatch[] = {
+    { OSSL_FUNC_PROVIDER_TEARDOWN, (void (*)(void)) nxt_prov_teardown },
+    { OSSL_FUNC_PROVIDER_GETTABLE_PARAMS,
+      (void (*)(void)) nxt_prov_provider_gettable },
+    { OSSL_FUNC_PROVIDER_GET_PARAMS,
+      (void (*)(void)) nxt_prov_provider_get_params },
+    { OSSL_FUNC_PROVIDER_QUERY_OPERATION, (void (*)(void)) nxt_prov_query },
+    { 0, NULL }
+};
+
+int nxt_provider_init(const OSSL_CORE_HANDLE *handle,
+                      const OSSL_DISPATCH *in, const OSSL_DISPATCH **out,
+                      void **provctx)
+{
+    (void) in;
+
+    *out = nxt_prov_dispatch;
+    *provctx = (void *) handle;
+
+    return 1;
+}
+
+/* Entry point of the module */
+int OSSL_provider_init(const OSSL_CORE_HANDLE *handle,
+                       const OSSL_DISPATCH *in, const OSSL_DISPATCH **out,
+                       void **provctx)
+{
+    return nxt_provider_init(handle, in, out, provctx);
+}
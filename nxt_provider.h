@@ -0,0 +1,74 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_PROVIDER_H
+#define NXT_PROVIDER_H
+
+#include <openssl/core.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * OpenSSL 3 provider. Built as the nxtprov module, it is loaded with
+ * OSSL_PROVIDER_load() or from the configuration file; linked in an
+ * application, nxt_provider_init() is given to OSSL_PROVIDER_add_builtin()
+ * instead.
+ *
+ * The ciphers are named NXT64-<bits>-<mode> and NXT128-<bits>-<mode>
+ * with a key of 128, 192 or 256 bits and the modes ECB, CBC, CTR and
+ * EAX; the 128-bit key versions are also known as NXT64-<mode> and
+ * NXT128-<mode>. ECB and CBC pad with PKCS#7 unless padding is turned
+ * off, CTR increments the whole IV as a big-endian counter and EAX is
+ * used through the usual AEAD parameters, with a nonce of up to
+ * NXT_PROVIDER_MAX_NONCE bytes (the block size by default) and a tag of
+ * up to the block size. NXT128-EAX gives the same results as
+ * nxt128_eax_encrypt().
+ *
+ * Every update hands all the whole blocks it receives to the
+ * multi-block functions.
+ */
+#define NXT_PROVIDER_NAME    "nxtprov"
+#define NXT_PROVIDER_VERSION "1.0"
+
+/* Largest EAX nonce */
+#define NXT_PROVIDER_MAX_NONCE 64
+
+int nxt_provider_init(const OSSL_CORE_HANDLE *handle,
+                      const OSSL_DISPATCH *in, const OSSL_DISPATCH **out,
+                      void **provctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_PROVIDER_H */
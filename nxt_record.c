@@ -0,0 +1,383 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "nxt_common.h"
+#include "nxt_record.h"
+
+#define NXT_RECORD_VERSION 1
+#define NXT_RECORD_KS      64   /* keystream blocks per call */
+
+/* Records of a group, as seen by the interleaved EAX passes */
+typedef struct {
+    uint8 ctr[NXT_RECORD_BATCH][NXT128_BLOCK_SIZE];
+    uint8 tag[NXT_RECORD_BATCH][NXT128_BLOCK_SIZE];
+    const uint8 *hdr[NXT_RECORD_BATCH];         /* header and sequence */
+    const uint8 *in[NXT_RECORD_BATCH];
+    uint8 *out[NXT_RECORD_BATCH];
+    size_t len[NXT_RECORD_BATCH];
+    size_t count;
+} nxt_record_group;
+
+/* Big-endian increment of the sequence numbers and counters */
+static void nxt_record_inc(uint8 *b, int len)
+{
+    int i;
+
+    for (i = len - 1; i >= 0; i--) {
+        if (++b[i] != 0)
+            break;
+    }
+}
+
+static void nxt_record_xor(uint8 *a, const uint8 *b, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        a[i] ^= b[i];
+    }
+}
+
+/*
+ * OMAC^0 of the nonces and OMAC^1 of the headers, one block each: the
+ * nonce salt || seq is a whole block, the header is padded.
+ */
+static void nxt_record_start(nxt_record_ctx *ctx, nxt_record_group *g)
+{
+    uint8 blk[2 * NXT_RECORD_BATCH][NXT128_BLOCK_SIZE];
+    nxt128_eax_ctx *eax;
+    size_t r;
+
+    eax = &ctx->eax;
+
+    for (r = 0; r < g->count; r++) {
+        memcpy(blk[2 * r], ctx->salt, NXT_RECORD_SALT_SIZE);
+        memcpy(blk[2 * r] + NXT_RECORD_SALT_SIZE,
+               g->hdr[r] + NXT_RECORD_HEADER_SIZE, NXT_RECORD_SEQ_SIZE);
+        nxt_record_xor(blk[2 * r], eax->first[0], NXT128_BLOCK_SIZE);
+        nxt_record_xor(blk[2 * r], eax->k1, NXT128_BLOCK_SIZE);
+
+        memcpy(blk[2 * r + 1], eax->first[1], NXT128_BLOCK_SIZE);
+        nxt_record_xor(blk[2 * r + 1], g->hdr[r], NXT_RECORD_HEADER_SIZE);
+        blk[2 * r + 1][NXT_RECORD_HEADER_SIZE] ^= 0x80;
+        nxt_record_xor(blk[2 * r + 1], eax->k2, NXT128_BLOCK_SIZE);
+    }
+
+    nxt128_encrypt_blocks(&eax->cipher, blk[0], blk[0], 2 * g->count);
+
+    for (r = 0; r < g->count; r++) {
+        memcpy(g->ctr[r], blk[2 * r], NXT128_BLOCK_SIZE);
+        memcpy(g->tag[r], blk[2 * r], NXT128_BLOCK_SIZE);
+        nxt_record_xor(g->tag[r], blk[2 * r + 1], NXT128_BLOCK_SIZE);
+    }
+
+    nxt_wipe(blk, sizeof(blk));
+}
+
+/*
+ * OMAC^2 of the ciphertexts, the chains of all the records advanced
+ * together one block per call, and added to the tags.
+ */
+static void nxt_record_omac(nxt_record_ctx *ctx, nxt_record_group *g,
+                            int decrypt)
+{
+    const uint8 *ct;
+    uint8 x[NXT_RECORD_BATCH][NXT128_BLOCK_SIZE];
+    uint8 lane[NXT_RECORD_BATCH][NXT128_BLOCK_SIZE];
+    size_t idx[NXT_RECORD_BATCH];
+    nxt128_eax_ctx *eax;
+    size_t pos;
+    size_t n;
+    size_t m;
+    size_t r;
+    size_t i;
+
+    eax = &ctx->eax;
+
+    for (r = 0; r < g->count; r++) {
+        memcpy(x[r], eax->first[2], NXT128_BLOCK_SIZE);
+    }
+
+    for (pos = 0; ; pos += NXT128_BLOCK_SIZE) {
+        for (n = 0, r = 0; r < g->count; r++) {
+            if (pos >= g->len[r])
+                continue;
+
+            m = g->len[r] - pos;
+            if (m > NXT128_BLOCK_SIZE)
+                m = NXT128_BLOCK_SIZE;
+            ct = decrypt ? g->in[r] : g->out[r];
+            nxt_record_xor(x[r], ct + pos, m);
+
+            if (pos + NXT128_BLOCK_SIZE >= g->len[r]) {
+                if (m == NXT128_BLOCK_SIZE) {
+                    nxt_record_xor(x[r], eax->k1, NXT128_BLOCK_SIZE);
+                } else {
+                    x[r][m] ^= 0x80;
+                    nxt_record_xor(x[r], eax->k2, NXT128_BLOCK_SIZE);
+                }
+            }
+
+            memcpy(lane[n], x[r], NXT128_BLOCK_SIZE);
+            idx[n++] = r;
+        }
+
+        if (n == 0)
+            break;
+
+        nxt128_encrypt_blocks(&eax->cipher, lane[0], lane[0], n);
+
+        for (i = 0; i < n; i++) {
+            memcpy(x[idx[i]], lane[i], NXT128_BLOCK_SIZE);
+        }
+    }
+
+    for (r = 0; r < g->count; r++) {
+        if (g->len[r] == 0)
+            nxt_record_xor(g->tag[r], eax->empty[2], NXT128_BLOCK_SIZE);
+        else
+            nxt_record_xor(g->tag[r], x[r], NXT128_BLOCK_SIZE);
+    }
+
+    nxt_wipe(x, sizeof(x));
+    nxt_wipe(lane, sizeof(lane));
+}
+
+static void nxt_record_ks_xor(nxt_record_ctx *ctx,
+                              uint8 (*ks)[NXT128_BLOCK_SIZE],
+                              const uint8 **src, uint8 **dst,
+                              const size_t *len, size_t n)
+{
+    size_t i;
+    size_t j;
+
+    nxt128_encrypt_blocks(&ctx->eax.cipher, ks[0], ks[0], n);
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < len[i]; j++) {
+            dst[i][j] = src[i][j] ^ ks[i][j];
+        }
+    }
+}
+
+/*
+ * CTR mode on all the records, with the keystream blocks of several of
+ * them generated per call. The data may move to a lower address.
+ */
+static void nxt_record_ctr(nxt_record_ctx *ctx, nxt_record_group *g)
+{
+    uint8 ks[NXT_RECORD_KS][NXT128_BLOCK_SIZE];
+    const uint8 *src[NXT_RECORD_KS];
+    uint8 *dst[NXT_RECORD_KS];
+    size_t len[NXT_RECORD_KS];
+    size_t pos;
+    size_t n;
+    size_t r;
+
+    n = 0;
+    for (r = 0; r < g->count; r++) {
+        for (pos = 0; pos < g->len[r]; pos += len[n++]) {
+            if (n == NXT_RECORD_KS) {
+                nxt_record_ks_xor(ctx, ks, src, dst, len, n);
+                n = 0;
+            }
+
+            memcpy(ks[n], g->ctr[r], NXT128_BLOCK_SIZE);
+            nxt_record_inc(g->ctr[r], NXT128_BLOCK_SIZE);
+            src[n] = g->in[r] + pos;
+            dst[n] = g->out[r] + pos;
+            len[n] = g->len[r] - pos;
+            if (len[n] > NXT128_BLOCK_SIZE)
+                len[n] = NXT128_BLOCK_SIZE;
+        }
+    }
+
+    if (n > 0)
+        nxt_record_ks_xor(ctx, ks, src, dst, len, n);
+
+    nxt_wipe(ks, sizeof(ks));
+}
+
+void nxt_record_init(nxt_record_ctx *ctx, const uint8 *key, uint16 key_len,
+                     const uint8 *salt)
+{
+    nxt128_eax_init(&ctx->eax, key, key_len);
+    memcpy(ctx->salt, salt, NXT_RECORD_SALT_SIZE);
+    memset(ctx->seq, 0, NXT_RECORD_SEQ_SIZE);
+}
+
+size_t nxt_record_seal(nxt_record_ctx *ctx, int type, const nxt_iovec *msgs,
+                       size_t count, uint8 *out)
+{
+    nxt_record_group g;
+    uint8 *p;
+    size_t len;
+    size_t r;
+    size_t i;
+
+    assert(type >= 0 && type <= 0xff);
+
+    p = out;
+    for (i = 0; i < count; i += g.count) {
+        g.count = count - i;
+        if (g.count > NXT_RECORD_BATCH)
+            g.count = NXT_RECORD_BATCH;
+
+        for (r = 0; r < g.count; r++) {
+            len = msgs[i + r].len;
+            assert(len <= NXT_RECORD_MAX);
+
+            p[0] = (uint8) type;
+            p[1] = NXT_RECORD_VERSION;
+            p[2] = (uint8) ((NXT_RECORD_SIZE(len) - NXT_RECORD_HEADER_SIZE)
+                            >> 8);
+            p[3] = (uint8) (NXT_RECORD_SIZE(len) - NXT_RECORD_HEADER_SIZE);
+            memcpy(p + NXT_RECORD_HEADER_SIZE, ctx->seq, NXT_RECORD_SEQ_SIZE);
+            nxt_record_inc(ctx->seq, NXT_RECORD_SEQ_SIZE);
+
+            g.hdr[r] = p;
+            g.in[r] = (const uint8 *) msgs[i + r].base;
+            g.out[r] = p + NXT_RECORD_HEADER_SIZE + NXT_RECORD_SEQ_SIZE;
+            g.len[r] = len;
+            p += NXT_RECORD_SIZE(len);
+        }
+
+        nxt_record_start(ctx, &g);
+        nxt_record_ctr(ctx, &g);
+        nxt_record_omac(ctx, &g, 0);
+
+        for (r = 0; r < g.count; r++) {
+            memcpy(g.out[r] + g.len[r], g.tag[r], NXT128_EAX_TAG_SIZE);
+        }
+    }
+
+    nxt_wipe(&g, sizeof(g));
+
+    return (size_t) (p - out);
+}
+
+long nxt_record_open(nxt_record_ctx *ctx, const uint8 *in, size_t len,
+                     size_t *used, uint8 *out, nxt_record_msg *msgs,
+                     size_t max)
+{
+    nxt_record_group g;
+    uint8 seq[NXT_RECORD_SEQ_SIZE];
+    const uint8 *p;
+    size_t written;
+    size_t total;
+    size_t rlen;
+    size_t pos;
+    size_t n;
+    size_t r;
+    uint8 diff;
+    int i;
+
+    memcpy(seq, ctx->seq, NXT_RECORD_SEQ_SIZE);
+    g.count = 0;
+    written = total = pos = n = 0;
+
+    for (;;) {
+        rlen = 0;
+        p = in + pos;
+
+        if (n + g.count < max && len - pos >= NXT_RECORD_HEADER_SIZE) {
+            rlen = ((size_t) p[2] << 8) | p[3];
+            if (p[1] != NXT_RECORD_VERSION
+                || rlen < NXT_RECORD_SIZE(0) - NXT_RECORD_HEADER_SIZE
+                || rlen > NXT_RECORD_SIZE(NXT_RECORD_MAX)
+                          - NXT_RECORD_HEADER_SIZE)
+                goto fail;
+            if (len - pos - NXT_RECORD_HEADER_SIZE < rlen)
+                rlen = 0;
+        }
+
+        if (rlen != 0) {
+            if (memcmp(p + NXT_RECORD_HEADER_SIZE, seq,
+                       NXT_RECORD_SEQ_SIZE) != 0)
+                goto fail;
+            nxt_record_inc(seq, NXT_RECORD_SEQ_SIZE);
+
+            r = g.count++;
+            g.hdr[r] = p;
+            g.in[r] = p + NXT_RECORD_HEADER_SIZE + NXT_RECORD_SEQ_SIZE;
+            g.out[r] = out + total;
+            g.len[r] = rlen - (NXT_RECORD_SIZE(0) - NXT_RECORD_HEADER_SIZE);
+
+            msgs[n + r].type = p[0];
+            msgs[n + r].data = g.out[r];
+            msgs[n + r].len = g.len[r];
+            total += g.len[r];
+            pos += NXT_RECORD_HEADER_SIZE + rlen;
+        }
+
+        if (g.count == NXT_RECORD_BATCH || (rlen == 0 && g.count > 0)) {
+            nxt_record_start(ctx, &g);
+            nxt_record_omac(ctx, &g, 1);
+
+            diff = 0;
+            for (r = 0; r < g.count; r++) {
+                for (i = 0; i < NXT128_EAX_TAG_SIZE; i++) {
+                    diff |= g.tag[r][i] ^ g.in[r][g.len[r] + i];
+                }
+            }
+            if (diff != 0)
+                goto fail;
+
+            nxt_record_ctr(ctx, &g);
+            written = total;
+            n += g.count;
+            g.count = 0;
+        }
+
+        if (rlen == 0)
+            break;
+    }
+
+    memcpy(ctx->seq, seq, NXT_RECORD_SEQ_SIZE);
+    *used = pos;
+    nxt_wipe(&g, sizeof(g));
+
+    return (long) n;
+
+fail:
+    nxt_wipe(out, written);
+    nxt_wipe(&g, sizeof(g));
+
+    return -1;
+}
+
+void nxt_record_wipe(nxt_record_ctx *ctx)
+{
+    nxt_wipe(ctx, sizeof(*ctx));
+}
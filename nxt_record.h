@@ -0,0 +1,109 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_RECORD_H
+#define NXT_RECORD_H
+
+#include <stddef.h>
+
+#include "nxt128.h"
+#include "nxt_modes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Record layer. Application messages are sealed with NXT128-EAX into
+ * framed records:
+ *
+ *    0  type
+ *    1  version 1
+ *    2  16-bit length of the rest of the record, big-endian
+ *    4  64-bit sequence number, big-endian
+ *   12  ciphertext
+ *  end  EAX tag
+ *
+ * The EAX nonce is the 8-byte salt given at initialization followed by
+ * the sequence number, and the header data is the first 4 bytes of the
+ * record. Each direction of a connection needs its own key or salt.
+ *
+ * nxt_record_seal() seals count messages into consecutive records in
+ * out, which needs NXT_RECORD_SIZE(len) bytes per message, and returns
+ * the total size: the batch goes out with a single write() or send().
+ * nxt_record_open() opens the complete records at the start of in, up
+ * to max of them, stores their length in *used and returns their
+ * number. The plaintexts are stored one after the other in out, which
+ * needs len bytes and may be in, and msgs[i] points to the i-th one.
+ * The records must come in sequence: nxt_record_open() returns -1 and
+ * clears what it wrote to out if a record is malformed, out of sequence
+ * or has a wrong tag, and the connection should then be dropped.
+ *
+ * The records of a batch are processed NXT_RECORD_BATCH at a time, with
+ * their OMAC chains and keystream blocks interleaved into the calls to
+ * nxt128_encrypt_blocks(), so that small messages are encrypted at the
+ * speed of the multi-block functions rather than one block at a time.
+ */
+#define NXT_RECORD_HEADER_SIZE 4
+#define NXT_RECORD_SEQ_SIZE    8
+#define NXT_RECORD_SALT_SIZE   8
+#define NXT_RECORD_OVERHEAD    (NXT_RECORD_HEADER_SIZE + NXT_RECORD_SEQ_SIZE \
+                                + NXT128_EAX_TAG_SIZE)
+#define NXT_RECORD_MAX         16384
+#define NXT_RECORD_BATCH       32
+#define NXT_RECORD_SIZE(len)   ((len) + NXT_RECORD_OVERHEAD)
+
+typedef struct {
+    nxt128_eax_ctx eax;
+    uint8 salt[NXT_RECORD_SALT_SIZE];
+    uint8 seq[NXT_RECORD_SEQ_SIZE];     /* next sequence number */
+} nxt_record_ctx;
+
+typedef struct {
+    int type;
+    uint8 *data;
+    size_t len;
+} nxt_record_msg;
+
+void nxt_record_init(nxt_record_ctx *ctx, const uint8 *key, uint16 key_len,
+                     const uint8 *salt);
+size_t nxt_record_seal(nxt_record_ctx *ctx, int type, const nxt_iovec *msgs,
+                       size_t count, uint8 *out);
+long nxt_record_open(nxt_record_ctx *ctx, const uint8 *in, size_t len,
+                     size_t *used, uint8 *out, nxt_record_msg *msgs,
+                     size_t max);
+void nxt_record_wipe(nxt_record_ctx *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_RECORD_H */
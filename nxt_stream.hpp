@@ -0,0 +1,520 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_STREAM_HPP
+#define NXT_STREAM_HPP
+
+/*
+ * Encrypting std::streambuf filters. Each one sits in front of another
+ * stream buffer (a file, a socket or memory) and works in one
+ * direction: with std::ios_base::out it encrypts what is written to it
+ * and passes the result on, with std::ios_base::in it decrypts what it
+ * reads from the next buffer:
+ *
+ *     std::ofstream file("data.enc", std::ios::binary);
+ *     nxt::ctr_streambuf enc(*file.rdbuf(), ctx, iv, std::ios::out);
+ *     std::ostream out(&enc);
+ *
+ *     out << ...;
+ *
+ * The data goes through an internal buffer of default_buffer bytes
+ * (64 KB), processed at once by the multi-block functions, and
+ * xsputn()/xsgetn() move whole ranges: a write or read at least as
+ * large as the buffer goes straight between the caller's memory and the
+ * next buffer, without going through the internal one.
+ *
+ * ctr_streambuf is plain NXT128-CTR from the given counter block, with
+ * no integrity and no framing: the encrypted stream has the length of
+ * the plain one. The key schedule is borrowed and must outlive the
+ * filter.
+ *
+ * eax_streambuf cuts the stream in records of at most chunk bytes, each
+ * one sealed with NXT128-EAX:
+ *
+ *     32-bit big-endian length, with bit 31 set on the last record
+ *     ciphertext
+ *     16-byte tag
+ *
+ * The nonce of record i is the stream nonce followed by i as a 64-bit
+ * big-endian number, and the length field is the EAX header, so that
+ * records cannot be reordered, dropped, or the stream cut, without the
+ * reader noticing. A record is written when the buffer is full, on
+ * sync() (flush) with what is buffered, and on close(), called by the
+ * destructor if needed, which writes the last record. The stream nonce
+ * must never be used twice with the same key. The reader hands out
+ * data only once its record checks; a wrong tag, a record longer than
+ * chunk bytes or a stream ending before its last record throws
+ * std::ios_base::failure, which an istream turns into badbit.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <ios>
+#include <span>
+#include <streambuf>
+#include <vector>
+
+#include "nxt128.h"
+#include "nxt_modes.h"
+
+namespace nxt {
+
+typedef std::array<uint8, NXT128_BLOCK_SIZE> block;
+
+class ctr_streambuf : public std::streambuf {
+public:
+    static constexpr std::size_t default_buffer = 64 * 1024;
+
+    ctr_streambuf(std::streambuf &next, nxt128_ctx &ctx,
+                  const block &iv,
+                  std::ios_base::openmode mode,
+                  std::size_t size = default_buffer)
+        : next_(&next), ctx_(&ctx), ctr_(iv),
+          out_((mode & std::ios_base::out) != 0),
+          buf_(std::max(size, std::size_t(NXT128_BLOCK_SIZE)))
+    {
+        if (out_)
+            setp(buf_.data(), buf_.data() + buf_.size());
+        else
+            setg(buf_.data(), buf_.data(), buf_.data());
+    }
+
+    ctr_streambuf(const ctr_streambuf &) = delete;
+    ctr_streambuf &operator=(const ctr_streambuf &) = delete;
+
+    ~ctr_streambuf() override
+    {
+        if (out_)
+            flush();
+        std::fill(buf_.begin(), buf_.end(), 0);
+        ks_.fill(0);
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (!out_ || !flush())
+            return traits_type::eof();
+
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char_type *s, std::streamsize n) override
+    {
+        std::streamsize done = 0;
+        std::size_t k;
+
+        if (!out_)
+            return 0;
+
+        while (done < n) {
+            k = static_cast<std::size_t>(n - done);
+
+            if (pptr() == pbase() && k >= buf_.size()) {
+                /* Encrypted from the caller's memory */
+                k = buf_.size();
+                crypt(s + done, buf_.data(), k);
+                if (!write(buf_.data(), k))
+                    break;
+            } else {
+                k = std::min(k, static_cast<std::size_t>(epptr() - pptr()));
+                std::memcpy(pptr(), s + done, k);
+                pbump(static_cast<int>(k));
+                if (pptr() == epptr() && !flush()) {
+                    done += static_cast<std::streamsize>(k);
+                    break;
+                }
+            }
+            done += static_cast<std::streamsize>(k);
+        }
+
+        return done;
+    }
+
+    int sync() override
+    {
+        if (!out_)
+            return 0;
+        if (!flush())
+            return -1;
+        return next_->pubsync();
+    }
+
+    int_type underflow() override
+    {
+        std::streamsize n;
+
+        if (out_)
+            return traits_type::eof();
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+
+        n = next_->sgetn(buf_.data(),
+                         static_cast<std::streamsize>(buf_.size()));
+        if (n <= 0)
+            return traits_type::eof();
+
+        crypt(buf_.data(), buf_.data(), static_cast<std::size_t>(n));
+        setg(buf_.data(), buf_.data(), buf_.data() + n);
+
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::streamsize xsgetn(char_type *s, std::streamsize n) override
+    {
+        std::streamsize done = 0, k;
+
+        while (done < n) {
+            k = egptr() - gptr();
+            if (k > 0) {
+                k = std::min(k, n - done);
+                std::memcpy(s + done, gptr(), static_cast<std::size_t>(k));
+                gbump(static_cast<int>(k));
+            } else if (!out_
+                       && n - done >= static_cast<std::streamsize>(
+                              buf_.size())) {
+                /* Decrypted in the caller's memory */
+                k = next_->sgetn(s + done, n - done);
+                if (k <= 0)
+                    break;
+                crypt(s + done, s + done, static_cast<std::size_t>(k));
+            } else if (traits_type::eq_int_type(underflow(),
+                                                traits_type::eof())) {
+                break;
+            } else {
+                continue;
+            }
+            done += k;
+        }
+
+        return done;
+    }
+
+private:
+    /* CTR mode, the unused end of the last keystream block kept */
+    void crypt(const char *in, char *out, std::size_t len)
+    {
+        const uint8 *src = reinterpret_cast<const uint8 *>(in);
+        uint8 *dst = reinterpret_cast<uint8 *>(out);
+        std::size_t n;
+
+        for (; len > 0 && used_ < NXT128_BLOCK_SIZE; len--) {
+            *dst++ = *src++ ^ ks_[used_++];
+        }
+
+        n = len - len % NXT128_BLOCK_SIZE;
+        if (n > 0) {
+            nxt128_ctr_crypt(ctx_, ctr_.data(), src, dst, n);
+            src += n;
+            dst += n;
+            len -= n;
+        }
+
+        if (len > 0) {
+            nxt128_ctr_keystream(ctx_, ctr_.data(), ks_.data(), 1);
+            for (used_ = 0; used_ < len; used_++) {
+                dst[used_] = src[used_] ^ ks_[used_];
+            }
+        }
+    }
+
+    bool write(const char *p, std::size_t len)
+    {
+        return next_->sputn(p, static_cast<std::streamsize>(len))
+               == static_cast<std::streamsize>(len);
+    }
+
+    bool flush()
+    {
+        std::size_t n = static_cast<std::size_t>(pptr() - pbase());
+
+        crypt(pbase(), pbase(), n);
+        setp(buf_.data(), buf_.data() + buf_.size());
+
+        return write(buf_.data(), n);
+    }
+
+    std::streambuf *next_;
+    nxt128_ctx *ctx_;
+    block ctr_;
+    block ks_ = {};
+    std::size_t used_ = NXT128_BLOCK_SIZE;
+    bool out_;
+    std::vector<char> buf_;
+};
+
+class eax_streambuf : public std::streambuf {
+public:
+    static constexpr std::size_t default_chunk = 64 * 1024;
+    static constexpr std::size_t header_size = 4;
+    static constexpr std::size_t overhead = header_size
+                                            + NXT128_EAX_TAG_SIZE;
+
+    eax_streambuf(std::streambuf &next, nxt128_eax_ctx &ctx,
+                  std::span<const uint8> nonce, std::ios_base::openmode mode,
+                  std::size_t chunk = default_chunk)
+        : next_(&next), ctx_(&ctx), nonce_(nonce.begin(), nonce.end()),
+          out_((mode & std::ios_base::out) != 0),
+          buf_(std::clamp(chunk, std::size_t(1), std::size_t(0x7fffffff))),
+          rec_(buf_.size() + overhead)
+    {
+        nonce_.resize(nonce_.size() + 8);
+        if (out_)
+            setp(buf_.data(), buf_.data() + buf_.size());
+        else
+            setg(buf_.data(), buf_.data(), buf_.data());
+    }
+
+    eax_streambuf(const eax_streambuf &) = delete;
+    eax_streambuf &operator=(const eax_streambuf &) = delete;
+
+    ~eax_streambuf() override
+    {
+        if (out_ && !closed_)
+            close();
+        std::fill(buf_.begin(), buf_.end(), 0);
+    }
+
+    /* Writes the last record; nothing can be written afterwards */
+    bool close()
+    {
+        bool ok;
+
+        if (!out_ || closed_)
+            return false;
+
+        ok = seal(pbase(), static_cast<std::size_t>(pptr() - pbase()), true);
+        closed_ = true;
+        setp(nullptr, nullptr);
+
+        return ok && next_->pubsync() == 0;
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (!out_ || closed_)
+            return traits_type::eof();
+
+        if (pptr() == epptr()) {
+            if (!seal(pbase(), buf_.size(), false))
+                return traits_type::eof();
+            setp(buf_.data(), buf_.data() + buf_.size());
+        }
+
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char_type *s, std::streamsize n) override
+    {
+        std::streamsize done = 0;
+        std::size_t k;
+
+        if (!out_ || closed_)
+            return 0;
+
+        while (done < n) {
+            k = static_cast<std::size_t>(n - done);
+
+            if (pptr() == pbase() && k >= buf_.size()) {
+                /* Sealed from the caller's memory */
+                k = buf_.size();
+                if (!seal(s + done, k, false))
+                    break;
+            } else {
+                if (pptr() == epptr()
+                    && traits_type::eq_int_type(overflow(traits_type::eof()),
+                                                traits_type::eof()))
+                    break;
+                k = std::min(k, static_cast<std::size_t>(epptr() - pptr()));
+                std::memcpy(pptr(), s + done, k);
+                pbump(static_cast<int>(k));
+            }
+            done += static_cast<std::streamsize>(k);
+        }
+
+        return done;
+    }
+
+    /* Buffered data goes out as a record of its own */
+    int sync() override
+    {
+        if (!out_ || closed_)
+            return 0;
+
+        if (pptr() > pbase()) {
+            if (!seal(pbase(), static_cast<std::size_t>(pptr() - pbase()),
+                      false))
+                return -1;
+            setp(buf_.data(), buf_.data() + buf_.size());
+        }
+
+        return next_->pubsync();
+    }
+
+    int_type underflow() override
+    {
+        std::size_t n;
+
+        if (out_)
+            return traits_type::eof();
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+
+        do {
+            if (last_)
+                return traits_type::eof();
+            n = open(buf_.data());
+        } while (n == 0);
+
+        setg(buf_.data(), buf_.data(), buf_.data() + n);
+
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::streamsize xsgetn(char_type *s, std::streamsize n) override
+    {
+        std::streamsize done = 0, k;
+
+        while (done < n) {
+            k = egptr() - gptr();
+            if (k > 0) {
+                k = std::min(k, n - done);
+                std::memcpy(s + done, gptr(), static_cast<std::size_t>(k));
+                gbump(static_cast<int>(k));
+            } else if (!out_ && !last_
+                       && n - done >= static_cast<std::streamsize>(
+                              buf_.size())) {
+                /* Opened in the caller's memory */
+                k = static_cast<std::streamsize>(open(s + done));
+            } else if (traits_type::eq_int_type(underflow(),
+                                                traits_type::eof())) {
+                break;
+            } else {
+                continue;
+            }
+            done += k;
+        }
+
+        return done;
+    }
+
+private:
+    void next_nonce()
+    {
+        std::size_t i, n = nonce_.size();
+
+        for (i = 0; i < 8; i++) {
+            nonce_[n - 1 - i] = static_cast<uint8>(index_ >> (8 * i));
+        }
+        index_++;
+    }
+
+    bool seal(const char *p, std::size_t len, bool last)
+    {
+        uint8 *rec = reinterpret_cast<uint8 *>(rec_.data());
+        std::size_t n = overhead + len;
+        unsigned long field = len | (last ? 0x80000000UL : 0);
+
+        rec[0] = static_cast<uint8>(field >> 24);
+        rec[1] = static_cast<uint8>(field >> 16);
+        rec[2] = static_cast<uint8>(field >> 8);
+        rec[3] = static_cast<uint8>(field);
+
+        next_nonce();
+        nxt128_eax_encrypt(ctx_, nonce_.data(), nonce_.size(), rec,
+                           header_size, reinterpret_cast<const uint8 *>(p),
+                           rec + header_size, len, rec + header_size + len);
+
+        return next_->sputn(rec_.data(), static_cast<std::streamsize>(n))
+               == static_cast<std::streamsize>(n);
+    }
+
+    void read(char *p, std::size_t len)
+    {
+        if (next_->sgetn(p, static_cast<std::streamsize>(len))
+            != static_cast<std::streamsize>(len))
+            throw std::ios_base::failure("nxt::eax_streambuf: truncated");
+    }
+
+    /* Reads and opens the next record into out, returns its length */
+    std::size_t open(char *out)
+    {
+        const uint8 *rec = reinterpret_cast<const uint8 *>(rec_.data());
+        unsigned long field;
+        std::size_t len;
+
+        read(rec_.data(), header_size);
+        field = (static_cast<unsigned long>(rec[0]) << 24)
+                | (static_cast<unsigned long>(rec[1]) << 16)
+                | (static_cast<unsigned long>(rec[2]) << 8) | rec[3];
+        len = field & 0x7fffffff;
+        if (len > buf_.size())
+            throw std::ios_base::failure("nxt::eax_streambuf: bad record");
+
+        read(rec_.data() + header_size, len + NXT128_EAX_TAG_SIZE);
+
+        next_nonce();
+        if (nxt128_eax_decrypt(ctx_, nonce_.data(), nonce_.size(), rec,
+                               header_size, rec + header_size,
+                               reinterpret_cast<uint8 *>(out), len,
+                               rec + header_size + len) != 0)
+            throw std::ios_base::failure("nxt::eax_streambuf: bad tag");
+
+        last_ = (field & 0x80000000UL) != 0;
+
+        return len;
+    }
+
+    std::streambuf *next_;
+    nxt128_eax_ctx *ctx_;
+    std::vector<uint8> nonce_;
+    unsigned long long index_ = 0;
+    bool out_;
+    bool closed_ = false;
+    bool last_ = false;
+    std::vector<char> buf_;
+    std::vector<char> rec_;
+};
+
+} /* namespace nxt */
+
+#endif /* !NXT_STREAM_HPP */
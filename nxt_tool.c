@@ -0,0 +1,79 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "nxt_common.h"
+#include "nxt_tool.h"
+
+int nxt_hex_decode(const char *s, uint8 *out, size_t max)
+{
+    size_t i, n;
+    int hi, lo;
+
+    n = strlen(s);
+    if (n % 2 != 0 || n / 2 > max)
+        return -1;
+
+    for (i = 0; i < n / 2; i++) {
+        hi = s[2 * i];
+        lo = s[2 * i + 1];
+        hi = hi >= '0' && hi <= '9' ? hi - '0' :
+             hi >= 'a' && hi <= 'f' ? hi - 'a' + 10 :
+             hi >= 'A' && hi <= 'F' ? hi - 'A' + 10 : -1;
+        lo = lo >= '0' && lo <= '9' ? lo - '0' :
+             lo >= 'a' && lo <= 'f' ? lo - 'a' + 10 :
+             lo >= 'A' && lo <= 'F' ? lo - 'A' + 10 : -1;
+        if (hi < 0 || lo < 0)
+            return -1;
+        out[i] = (uint8) (hi << 4 | lo);
+    }
+
+    return (int) (n / 2);
+}
+
+int nxt_read_key_file(const char *path, uint8 *key, size_t max)
+{
+    FILE *f;
+    size_t n;
+    int c;
+
+    f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+
+    n = fread(key, 1, max, f);
+    c = fgetc(f);
+    fclose(f);
+
+    return c == EOF ? (int) n : -1;
+}
@@ -0,0 +1,329 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "nxt_common.h"
+#include "nxt_tunnel.h"
+
+#define NXT_TUNNEL_WORDS (NXT_TUNNEL_WINDOW / 32 + 1)
+
+/*
+ * Key derivation: block i of the key material, numbered from 0, is the
+ * encryption of "NXTT" || SPI || 0 || i + 1 under the master key.
+ */
+void nxt_tunnel_sa_init(nxt_tunnel_sa *sa, uint32 spi, const uint8 *key,
+                        uint16 key_len)
+{
+    uint8 km[5 * NXT128_BLOCK_SIZE];
+    nxt128_ctx master;
+    int i;
+
+    nxt128_ks(&master, key, key_len);
+
+    memset(km, 0, sizeof(km));
+    for (i = 0; i < 5; i++) {
+        memcpy(km + i * NXT128_BLOCK_SIZE, "NXTT", 4);
+        UNPACK32(spi, km + i * NXT128_BLOCK_SIZE + 4);
+        km[i * NXT128_BLOCK_SIZE + NXT128_BLOCK_SIZE - 1] = (uint8) (i + 1);
+    }
+    nxt128_encrypt_blocks(&master, km, km, 5);
+
+    memset(sa, 0, sizeof(nxt_tunnel_sa));
+    sa->spi = spi;
+    nxt128_ks(&sa->enc, km, 256);
+    nxt128_ks(&sa->mac, km + 32, 256);
+    memcpy(sa->salt, km + 64, NXT_TUNNEL_SALT_SIZE);
+
+    nxt_wipe(km, sizeof(km));
+    nxt_wipe(&master, sizeof(master));
+}
+
+void nxt_tunnel_sa_wipe(nxt_tunnel_sa *sa)
+{
+    nxt_wipe(sa, sizeof(nxt_tunnel_sa));
+}
+
+void nxt_tunnel_init(nxt_tunnel *t)
+{
+    memset(t, 0, sizeof(nxt_tunnel));
+    nxt_mb_init(&t->mgr, NXT128_BLOCK_SIZE, 0);
+}
+
+/* Linear probing from the slot of the SPI */
+static size_t nxt_tunnel_slot(uint32 spi)
+{
+    return (size_t) ((spi ^ (spi >> 8) ^ (spi >> 16)) % NXT_TUNNEL_SLOTS);
+}
+
+static nxt_tunnel_sa *nxt_tunnel_find(const nxt_tunnel *t, uint32 spi)
+{
+    size_t s;
+    size_t i;
+
+    s = nxt_tunnel_slot(spi);
+    for (i = 0; i < NXT_TUNNEL_SLOTS && t->sa[s] != NULL; i++) {
+        if (t->sa[s]->spi == spi)
+            return t->sa[s];
+        s = (s + 1) % NXT_TUNNEL_SLOTS;
+    }
+
+    return NULL;
+}
+
+int nxt_tunnel_add_sa(nxt_tunnel *t, nxt_tunnel_sa *sa)
+{
+    size_t s;
+    size_t i;
+
+    s = nxt_tunnel_slot(sa->spi);
+    for (i = 0; i < NXT_TUNNEL_SLOTS; i++) {
+        if (t->sa[s] == NULL) {
+            t->sa[s] = sa;
+            return 0;
+        }
+        if (t->sa[s]->spi == sa->spi)
+            return -1;
+        s = (s + 1) % NXT_TUNNEL_SLOTS;
+    }
+
+    return -1;
+}
+
+void nxt_tunnel_remove_sa(nxt_tunnel *t, uint32 spi)
+{
+    nxt_tunnel_sa *sa;
+    size_t s;
+    size_t i;
+
+    s = nxt_tunnel_slot(spi);
+    for (i = 0; t->sa[s] != NULL && t->sa[s]->spi != spi; i++) {
+        if (i == NXT_TUNNEL_SLOTS)
+            return;
+        s = (s + 1) % NXT_TUNNEL_SLOTS;
+    }
+    if (t->sa[s] == NULL)
+        return;
+
+    /* Reinserts the rest of the cluster so that no lookup stops early */
+    t->sa[s] = NULL;
+    for (s = (s + 1) % NXT_TUNNEL_SLOTS; t->sa[s] != NULL;
+         s = (s + 1) % NXT_TUNNEL_SLOTS) {
+        sa = t->sa[s];
+        t->sa[s] = NULL;
+        nxt_tunnel_add_sa(t, sa);
+    }
+}
+
+/* Replay check (RFC 6479), the window is a ring of 32-bit words */
+static int nxt_tunnel_replayed(const nxt_tunnel_sa *sa, uint32 seq)
+{
+    if (seq == 0)
+        return 1;
+    if (seq > sa->top)
+        return 0;
+    if (sa->top - seq >= NXT_TUNNEL_WINDOW)
+        return 1;
+
+    return (sa->window[(seq / 32) % NXT_TUNNEL_WORDS] >> (seq % 32)) & 1;
+}
+
+/* Marks seq as received, returns -1 if it already was */
+static int nxt_tunnel_update(nxt_tunnel_sa *sa, uint32 seq)
+{
+    uint32 w;
+    uint32 i;
+
+    if (nxt_tunnel_replayed(sa, seq))
+        return -1;
+
+    if (seq > sa->top) {
+        w = seq / 32 - sa->top / 32;
+        if (w > NXT_TUNNEL_WORDS)
+            w = NXT_TUNNEL_WORDS;
+        for (i = 1; i <= w; i++) {
+            sa->window[(sa->top / 32 + i) % NXT_TUNNEL_WORDS] = 0;
+        }
+        sa->top = seq;
+    }
+    sa->window[(seq / 32) % NXT_TUNNEL_WORDS] |= (uint32) 1 << (seq % 32);
+
+    return 0;
+}
+
+/* Runs the submitted jobs to completion */
+static void nxt_tunnel_run(nxt_tunnel *t)
+{
+    nxt_mb_job *job;
+
+    for (job = nxt_mb_flush(&t->mgr); job != NULL;
+         job = nxt_mb_get_completed(&t->mgr)) {
+    }
+}
+
+static void nxt_tunnel_ctr_job(nxt_tunnel *t, size_t i, nxt_tunnel_pkt *pkt,
+                               uint32 seq)
+{
+    nxt_mb_job *job = &t->jobs[i];
+
+    job->op = NXT_MB_CTR;
+    job->ctx = &pkt->sa->enc;
+    job->in = pkt->data + NXT_TUNNEL_HEADER_SIZE;
+    job->out = pkt->data + NXT_TUNNEL_HEADER_SIZE;
+    job->len = pkt->len;
+    memcpy(job->iv, pkt->sa->salt, NXT_TUNNEL_SALT_SIZE);
+    UNPACK32(seq, job->iv + 8);
+    UNPACK32(1, job->iv + 12);
+    nxt_mb_submit(&t->mgr, job, 0);
+}
+
+static void nxt_tunnel_cmac_job(nxt_tunnel *t, size_t i, nxt_tunnel_pkt *pkt,
+                                uint8 *icv)
+{
+    nxt_mb_job *job = &t->jobs[i];
+
+    job->op = NXT_MB_CMAC;
+    job->ctx = &pkt->sa->mac;
+    job->in = pkt->data;
+    job->out = icv;
+    job->len = NXT_TUNNEL_HEADER_SIZE + pkt->len;
+    nxt_mb_submit(&t->mgr, job, 0);
+}
+
+static void nxt_tunnel_encap_batch(nxt_tunnel *t, nxt_tunnel_pkt *pkts,
+                                   size_t count)
+{
+    nxt_tunnel_pkt *pkt;
+    uint32 seq;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        pkt = &pkts[i];
+        pkt->status = -1;
+        if (pkt->sa->seq == 0xffffffff)
+            continue;
+
+        pkt->status = 0;
+        seq = ++pkt->sa->seq;
+        UNPACK32(pkt->sa->spi, pkt->data);
+        UNPACK32(seq, pkt->data + 4);
+        nxt_tunnel_ctr_job(t, i, pkt, seq);
+    }
+    nxt_tunnel_run(t);
+
+    for (i = 0; i < count; i++) {
+        pkt = &pkts[i];
+        if (pkt->status == 0) {
+            nxt_tunnel_cmac_job(t, i, pkt,
+                                pkt->data + NXT_TUNNEL_HEADER_SIZE
+                                + pkt->len);
+        }
+    }
+    nxt_tunnel_run(t);
+
+    for (i = 0; i < count; i++) {
+        if (pkts[i].status == 0)
+            pkts[i].len += NXT_TUNNEL_OVERHEAD;
+    }
+}
+
+static void nxt_tunnel_decap_batch(nxt_tunnel *t, nxt_tunnel_pkt *pkts,
+                                   size_t count)
+{
+    nxt_tunnel_pkt *pkt;
+    uint32 spi;
+    uint32 seq;
+    uint8 diff;
+    size_t i;
+    int j;
+
+    for (i = 0; i < count; i++) {
+        pkt = &pkts[i];
+        pkt->status = -1;
+        pkt->sa = NULL;
+        if (pkt->len < NXT_TUNNEL_OVERHEAD)
+            continue;
+
+        PACK32(pkt->data, &spi);
+        PACK32(pkt->data + 4, &seq);
+        pkt->sa = nxt_tunnel_find(t, spi);
+        if (pkt->sa == NULL || nxt_tunnel_replayed(pkt->sa, seq))
+            continue;
+
+        pkt->status = 0;
+        pkt->len -= NXT_TUNNEL_OVERHEAD;
+        nxt_tunnel_cmac_job(t, i, pkt, t->icv[i]);
+    }
+    nxt_tunnel_run(t);
+
+    /* The window is only updated by authentic packets, in order */
+    for (i = 0; i < count; i++) {
+        pkt = &pkts[i];
+        if (pkt->status != 0)
+            continue;
+
+        diff = 0;
+        for (j = 0; j < NXT_TUNNEL_ICV_SIZE; j++) {
+            diff |= t->icv[i][j]
+                    ^ pkt->data[NXT_TUNNEL_HEADER_SIZE + pkt->len + j];
+        }
+        PACK32(pkt->data + 4, &seq);
+        if (diff != 0 || nxt_tunnel_update(pkt->sa, seq) != 0) {
+            pkt->status = -1;
+            pkt->len += NXT_TUNNEL_OVERHEAD;
+            continue;
+        }
+
+        nxt_tunnel_ctr_job(t, i, pkt, seq);
+    }
+    nxt_tunnel_run(t);
+}
+
+void nxt_tunnel_encap(nxt_tunnel *t, nxt_tunnel_pkt *pkts, size_t count)
+{
+    size_t n;
+
+    for (; count > 0; count -= n, pkts += n) {
+        n = (count < NXT_TUNNEL_BATCH) ? count : NXT_TUNNEL_BATCH;
+        nxt_tunnel_encap_batch(t, pkts, n);
+    }
+}
+
+void nxt_tunnel_decap(nxt_tunnel *t, nxt_tunnel_pkt *pkts, size_t count)
+{
+    size_t n;
+
+    for (; count > 0; count -= n, pkts += n) {
+        n = (count < NXT_TUNNEL_BATCH) ? count : NXT_TUNNEL_BATCH;
+        nxt_tunnel_decap_batch(t, pkts, n);
+    }
+}
@@ -0,0 +1,124 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NXT_TUNNEL_H
+#define NXT_TUNNEL_H
+
+#include <stddef.h>
+
+#include "nxt128.h"
+#include "nxt_mb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Packet protection in the manner of ESP (RFC 4303) with NXT128 in CTR
+ * mode (as in RFC 3686) and an NXT128-CMAC integrity check value:
+ *
+ *    0  32-bit SPI, big-endian
+ *    4  32-bit sequence number, big-endian
+ *    8  payload encrypted in CTR mode
+ *  end  CMAC of the SPI, sequence number and encrypted payload
+ *
+ * The counter blocks are the 8-byte salt of the SA, the sequence number
+ * and a 32-bit block counter starting at 1. nxt_tunnel_sa_init()
+ * derives the encryption key, the CMAC key and the salt of an SA from
+ * a master key and the SPI, so both directions of a link may share the
+ * master key as long as their SPIs differ.
+ *
+ * An outbound SA numbers its packets from 1 and refuses to protect more
+ * than 2^32 - 1 of them: it must be replaced before. An inbound SA drops
+ * the packets older than the last NXT_TUNNEL_WINDOW sequence numbers and
+ * those already received, after checking their ICV.
+ *
+ * nxt_tunnel_encap() and nxt_tunnel_decap() work in place on batches of
+ * packets. The payload of a packet to protect is given at offset
+ * NXT_TUNNEL_HEADER_SIZE of its buffer, which must have room for the
+ * NXT_TUNNEL_OVERHEAD bytes of the header and ICV; the packet replaces
+ * it. A received packet is replaced by its payload, at the same offset.
+ * len is updated in both cases, and status set to 0, or to -1 when the
+ * packet is dropped (sa is then left as it was for encap, set to the SA
+ * found or NULL for decap). The CTR and CMAC jobs of each batch of
+ * NXT_TUNNEL_BATCH packets go through the multi-buffer job manager, so
+ * that the packets of all the SAs are processed together.
+ *
+ * The inbound SAs are found by SPI in a table of NXT_TUNNEL_SLOTS
+ * entries; the SAs must stay valid while they are in the table.
+ */
+#define NXT_TUNNEL_HEADER_SIZE 8
+#define NXT_TUNNEL_ICV_SIZE    16
+#define NXT_TUNNEL_OVERHEAD    (NXT_TUNNEL_HEADER_SIZE + NXT_TUNNEL_ICV_SIZE)
+#define NXT_TUNNEL_SALT_SIZE   8
+#define NXT_TUNNEL_WINDOW      1024
+#define NXT_TUNNEL_BATCH       64
+#define NXT_TUNNEL_SLOTS       256
+
+typedef struct {
+    uint32 spi;
+    nxt128_ctx enc;
+    nxt128_ctx mac;
+    uint8 salt[NXT_TUNNEL_SALT_SIZE];
+    uint32 seq;                 /* last sequence number sent */
+    uint32 top;                 /* highest sequence number received */
+    uint32 window[NXT_TUNNEL_WINDOW / 32 + 1];
+} nxt_tunnel_sa;
+
+typedef struct {
+    uint8 *data;
+    size_t len;
+    nxt_tunnel_sa *sa;
+    int status;
+} nxt_tunnel_pkt;
+
+typedef struct {
+    nxt_mb_mgr mgr;
+    nxt_mb_job jobs[NXT_TUNNEL_BATCH];
+    uint8 icv[NXT_TUNNEL_BATCH][NXT_TUNNEL_ICV_SIZE];
+    nxt_tunnel_sa *sa[NXT_TUNNEL_SLOTS];
+} nxt_tunnel;
+
+void nxt_tunnel_sa_init(nxt_tunnel_sa *sa, uint32 spi, const uint8 *key,
+                        uint16 key_len);
+void nxt_tunnel_sa_wipe(nxt_tunnel_sa *sa);
+
+void nxt_tunnel_init(nxt_tunnel *t);
+int nxt_tunnel_add_sa(nxt_tunnel *t, nxt_tunnel_sa *sa);
+void nxt_tunnel_remove_sa(nxt_tunnel *t, uint32 spi);
+void nxt_tunnel_encap(nxt_tunnel *t, nxt_tunnel_pkt *pkts, size_t count);
+void nxt_tunnel_decap(nxt_tunnel *t, nxt_tunnel_pkt *pkts, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !NXT_TUNNEL_H */
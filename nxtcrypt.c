@@ -0,0 +1,1152 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * nxtcrypt - NXT128 encryption of large files
+ *
+ *   nxtcrypt [-DTq] [-b size] [-n depth] [-t threads] (-k hex | -K file)
+ *            -i hex [in out]
+ *   nxtcrypt -c [-q] [-s size] [-t threads] (-k hex | -K file) in out
+ *   nxtcrypt -x [-q] [-r off[:len]] [-t threads] (-k hex | -K file)
+ *            in [out]
+ *   nxtcrypt -w off [-q] [-t threads] (-k hex | -K file) in
+ *
+ * The file is encrypted in CTR mode with the key given in hexadecimal
+ * (-k) or read from a file (-K) and the 16-byte initial counter -i. CTR
+ * mode is its own inverse: the same command decrypts.
+ *
+ * The work goes through a pipeline of depth buffers of size bytes (-n
+ * and -b, the size is rounded to a multiple of NXTCRYPT_ALIGN): while a
+ * buffer is encrypted by the threads of an nxt_engine (-t, 0 for one per
+ * CPU) the others are being read or written. The reads and writes go
+ * through io_uring with the buffers registered to the ring when the
+ * kernel allows it, or through a pool of pread()/pwrite() threads with
+ * -T or when io_uring is not available. -D opens both files with
+ * O_DIRECT. The throughput is reported on stderr unless -q is given.
+ *
+ * Without file arguments nxtcrypt is a filter from the standard input
+ * to the standard output, see nxtcrypt_filter().
+ *
+ * -c, -x and -w work on the seekable container of nxt_chunked.h with
+ * chunks of size bytes (-s), see nxtcrypt_container().
+ */
+#ifdef __linux__
+#define _GNU_SOURCE
+#else
+#define _POSIX_C_SOURCE 200112L
+#endif
+#define _FILE_OFFSET_BITS 64
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "nxt_common.h"
+#include "nxt128.h"
+#include "nxt_modes.h"
+#include "nxt_engine.h"
+#include "nxt_chunked.h"
+#include "nxt_tool.h"
+
+#if defined(__linux__) && defined(SYS_io_uring_setup)
+#define NXTCRYPT_URING
+#endif
+
+#ifndef O_DIRECT
+#define O_DIRECT 0
+#endif
+
+/* Alignment of the buffers, offsets and lengths for O_DIRECT */
+#define NXTCRYPT_ALIGN 4096
+
+#define NXTCRYPT_BUF_SIZE (1024 * 1024)
+#define NXTCRYPT_DEPTH    8
+#define NXTCRYPT_MAX_DEPTH 256
+
+/* Number of pread()/pwrite() threads of the fallback */
+#define NXTCRYPT_IO_THREADS 4
+
+#define NXTCRYPT_READ  0
+#define NXTCRYPT_WRITE 1
+
+typedef struct nxtcrypt_slot {
+    int op;
+    int index;
+    uint8 *buf;
+    off_t off;                  /* file offset of buf[0] */
+    size_t len;                 /* bytes of data in buf */
+    size_t io_len;              /* len rounded up for O_DIRECT */
+    size_t done;                /* bytes transferred by the current op */
+    long res;                   /* result of the last request */
+    struct nxtcrypt_slot *next;
+} nxtcrypt_slot;
+
+typedef struct {
+    int in;
+    int out;
+    int uring;
+#ifdef NXTCRYPT_URING
+    int ring;
+    int fixed;
+    unsigned pending;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    void *cq_map;
+    size_t sq_map_len;
+    size_t cq_map_len;
+    size_t sqes_len;
+    struct iovec *iov;
+#endif
+    pthread_t tids[NXTCRYPT_IO_THREADS];
+    int threads;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t req_cond;
+    pthread_cond_t done_cond;
+    nxtcrypt_slot *req, *req_tail;
+    nxtcrypt_slot *cpl, *cpl_tail;
+} nxtcrypt_io;
+
+static const char *prog = "nxtcrypt";
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: %s [-DTq] [-b size] [-n depth] [-t threads] "
+            "(-k hex | -K file)\n"
+            "           -i hex [in out]\n"
+            "       %s -c [-q] [-s size] [-t threads] (-k hex | -K file) "
+            "in out\n"
+            "       %s -x [-q] [-r off[:len]] [-t threads] "
+            "(-k hex | -K file) in [out]\n"
+            "       %s -w off [-q] [-t threads] (-k hex | -K file) in\n",
+            prog, prog, prog, prog);
+    exit(2);
+}
+
+static size_t parse_size(const char *s)
+{
+    char *end;
+    unsigned long v;
+
+    v = strtoul(s, &end, 10);
+    if (end == s)
+        return 0;
+    if (*end == 'k' || *end == 'K') {
+        if (v > ULONG_MAX / 1024)
+            return 0;
+        v *= 1024;
+        end++;
+    } else if (*end == 'm' || *end == 'M') {
+        if (v > ULONG_MAX / (1024 * 1024))
+            return 0;
+        v *= 1024 * 1024;
+        end++;
+    }
+
+    return *end == '\0' ? (size_t) v : 0;
+}
+
+/* off[:len], the length is -1 without it */
+static int parse_range(const char *s, off_t *off, off_t *len)
+{
+    char *end;
+
+    *off = (off_t) strtoul(s, &end, 10);
+    *len = -1;
+    if (end != s && *end == ':')
+        *len = (off_t) strtoul(end + 1, &end, 10);
+
+    return end != s && *end == '\0' ? 0 : -1;
+}
+
+/* 128-bit big-endian addition of a block count to a counter */
+static void ctr_add(uint8 *ctr, const uint8 *iv, off_t blocks)
+{
+    unsigned long carry;
+    int i;
+
+    for (i = 15; i >= 0; i--) {
+        carry = (unsigned long) iv[i] + (unsigned long) (blocks & 0xff);
+        ctr[i] = (uint8) carry;
+        blocks = (blocks >> 8) + (off_t) (carry >> 8);
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/*
+ * pread()/pwrite() threads. Each request is one system call; the result
+ * is handed back in the completion list like an io_uring completion.
+ */
+static void *nxtcrypt_io_thread(void *arg)
+{
+    nxtcrypt_io *io = (nxtcrypt_io *) arg;
+    nxtcrypt_slot *slot;
+    ssize_t res;
+
+    for (;;) {
+        pthread_mutex_lock(&io->lock);
+        while (io->req == NULL && !io->stop)
+            pthread_cond_wait(&io->req_cond, &io->lock);
+        if (io->req == NULL) {
+            pthread_mutex_unlock(&io->lock);
+            return NULL;
+        }
+        slot = io->req;
+        io->req = slot->next;
+        pthread_mutex_unlock(&io->lock);
+
+        if (slot->op == NXTCRYPT_READ) {
+            res = pread(io->in, slot->buf + slot->done,
+                        slot->io_len - slot->done,
+                        slot->off + (off_t) slot->done);
+        } else {
+            res = pwrite(io->out, slot->buf + slot->done,
+                         slot->io_len - slot->done,
+                         slot->off + (off_t) slot->done);
+        }
+        slot->res = res < 0 ? -(long) errno : (long) res;
+
+        pthread_mutex_lock(&io->lock);
+        slot->next = NULL;
+        if (io->cpl == NULL)
+            io->cpl = slot;
+        else
+            io->cpl_tail->next = slot;
+        io->cpl_tail = slot;
+        pthread_cond_signal(&io->done_cond);
+        pthread_mutex_unlock(&io->lock);
+    }
+}
+
+static int nxtcrypt_threads_init(nxtcrypt_io *io)
+{
+    int i;
+
+    pthread_mutex_init(&io->lock, NULL);
+    pthread_cond_init(&io->req_cond, NULL);
+    pthread_cond_init(&io->done_cond, NULL);
+    io->req = io->cpl = NULL;
+    io->stop = 0;
+
+    for (i = 0; i < NXTCRYPT_IO_THREADS; i++) {
+        if (pthread_create(&io->tids[i], NULL, nxtcrypt_io_thread, io))
+            break;
+    }
+    io->threads = i;
+
+    return i > 0 ? 0 : -1;
+}
+
+#ifdef NXTCRYPT_URING
+static int nxtcrypt_uring_init(nxtcrypt_io *io, nxtcrypt_slot *slots,
+                               int depth, size_t buf_size)
+{
+    struct io_uring_params p;
+    uint8 *sq, *cq;
+    int i;
+
+    memset(&p, 0, sizeof(p));
+    io->ring = (int) syscall(SYS_io_uring_setup, (unsigned) depth, &p);
+    if (io->ring < 0)
+        return -1;
+
+    io->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    io->cq_map_len = p.cq_off.cqes
+                     + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (io->cq_map_len > io->sq_map_len)
+            io->sq_map_len = io->cq_map_len;
+        io->cq_map_len = 0;
+    }
+
+    io->sq_map = mmap(NULL, io->sq_map_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, io->ring,
+                      IORING_OFF_SQ_RING);
+    if (io->sq_map == MAP_FAILED)
+        goto err_ring;
+    io->cq_map = io->sq_map;
+    if (io->cq_map_len != 0) {
+        io->cq_map = mmap(NULL, io->cq_map_len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, io->ring,
+                          IORING_OFF_CQ_RING);
+        if (io->cq_map == MAP_FAILED)
+            goto err_sq;
+    }
+    io->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    io->sqes = (struct io_uring_sqe *) mmap(NULL, io->sqes_len,
+                                            PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE,
+                                            io->ring, IORING_OFF_SQES);
+    if (io->sqes == MAP_FAILED)
+        goto err_cq;
+
+    sq = (uint8 *) io->sq_map;
+    cq = (uint8 *) io->cq_map;
+    io->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    io->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    io->sq_array = (unsigned *) (sq + p.sq_off.array);
+    io->cq_head = (unsigned *) (cq + p.cq_off.head);
+    io->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    io->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    io->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    io->pending = 0;
+
+    /* Registered buffers need RLIMIT_MEMLOCK, use readv() without them */
+    io->iov = (struct iovec *) malloc((size_t) depth * sizeof(struct iovec));
+    if (io->iov == NULL)
+        goto err_sqes;
+    for (i = 0; i < depth; i++) {
+        io->iov[i].iov_base = slots[i].buf;
+        io->iov[i].iov_len = buf_size;
+    }
+    io->fixed = syscall(SYS_io_uring_register, io->ring,
+                        IORING_REGISTER_BUFFERS, io->iov,
+                        (unsigned) depth) == 0;
+
+    return 0;
+
+err_sqes:
+    munmap(io->sqes, io->sqes_len);
+err_cq:
+    if (io->cq_map != io->sq_map)
+        munmap(io->cq_map, io->cq_map_len);
+err_sq:
+    munmap(io->sq_map, io->sq_map_len);
+err_ring:
+    close(io->ring);
+    return -1;
+}
+
+static void nxtcrypt_uring_queue(nxtcrypt_io *io, nxtcrypt_slot *slot)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail, idx;
+
+    tail = *io->sq_tail;
+    idx = tail & *io->sq_mask;
+    sqe = &io->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+
+    sqe->fd = slot->op == NXTCRYPT_READ ? io->in : io->out;
+    sqe->off = (__u64) (slot->off + (off_t) slot->done);
+    sqe->user_data = (__u64) (unsigned long) slot;
+    if (io->fixed) {
+        sqe->opcode = slot->op == NXTCRYPT_READ ? IORING_OP_READ_FIXED
+                                                : IORING_OP_WRITE_FIXED;
+        sqe->addr = (__u64) (unsigned long) (slot->buf + slot->done);
+        sqe->len = (__u32) (slot->io_len - slot->done);
+        sqe->buf_index = (__u16) slot->index;
+    } else {
+        io->iov[slot->index].iov_base = slot->buf + slot->done;
+        io->iov[slot->index].iov_len = slot->io_len - slot->done;
+        sqe->opcode = slot->op == NXTCRYPT_READ ? IORING_OP_READV
+                                                : IORING_OP_WRITEV;
+        sqe->addr = (__u64) (unsigned long) &io->iov[slot->index];
+        sqe->len = 1;
+    }
+
+    io->sq_array[idx] = idx;
+    __atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    io->pending++;
+}
+
+static nxtcrypt_slot *nxtcrypt_uring_wait(nxtcrypt_io *io)
+{
+    struct io_uring_cqe *cqe;
+    nxtcrypt_slot *slot;
+    unsigned head, ready;
+    long ret;
+
+    for (;;) {
+        head = *io->cq_head;
+        ready = head != __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE);
+        if (ready && io->pending == 0)
+            break;
+
+        /* Submit the queued requests and wait for one completion */
+        ret = syscall(SYS_io_uring_enter, io->ring, io->pending,
+                      ready ? 0u : 1u, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+            return NULL;
+        }
+        io->pending -= (unsigned) ret;
+    }
+
+    cqe = &io->cqes[head & *io->cq_mask];
+    slot = (nxtcrypt_slot *) (unsigned long) cqe->user_data;
+    slot->res = cqe->res;
+    __atomic_store_n(io->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    return slot;
+}
+
+static void nxtcrypt_uring_free(nxtcrypt_io *io)
+{
+    free(io->iov);
+    munmap(io->sqes, io->sqes_len);
+    if (io->cq_map != io->sq_map)
+        munmap(io->cq_map, io->cq_map_len);
+    munmap(io->sq_map, io->sq_map_len);
+    close(io->ring);
+}
+#endif /* NXTCRYPT_URING */
+
+static void nxtcrypt_queue(nxtcrypt_io *io, nxtcrypt_slot *slot)
+{
+#ifdef NXTCRYPT_URING
+    if (io->uring) {
+        nxtcrypt_uring_queue(io, slot);
+        return;
+    }
+#endif
+    pthread_mutex_lock(&io->lock);
+    slot->next = NULL;
+    if (io->req == NULL)
+        io->req = slot;
+    else
+        io->req_tail->next = slot;
+    io->req_tail = slot;
+    pthread_cond_signal(&io->req_cond);
+    pthread_mutex_unlock(&io->lock);
+}
+
+/* Returns a slot whose request completed, with its result in res */
+static nxtcrypt_slot *nxtcrypt_wait(nxtcrypt_io *io)
+{
+    nxtcrypt_slot *slot;
+
+#ifdef NXTCRYPT_URING
+    if (io->uring)
+        return nxtcrypt_uring_wait(io);
+#endif
+    pthread_mutex_lock(&io->lock);
+    while (io->cpl == NULL)
+        pthread_cond_wait(&io->done_cond, &io->lock);
+    slot = io->cpl;
+    io->cpl = slot->next;
+    pthread_mutex_unlock(&io->lock);
+
+    return slot;
+}
+
+static void nxtcrypt_io_free(nxtcrypt_io *io)
+{
+    int i;
+
+#ifdef NXTCRYPT_URING
+    if (io->uring) {
+        nxtcrypt_uring_free(io);
+        return;
+    }
+#endif
+    pthread_mutex_lock(&io->lock);
+    io->stop = 1;
+    pthread_cond_broadcast(&io->req_cond);
+    pthread_mutex_unlock(&io->lock);
+    for (i = 0; i < io->threads; i++)
+        pthread_join(io->tids[i], NULL);
+    pthread_mutex_destroy(&io->lock);
+    pthread_cond_destroy(&io->req_cond);
+    pthread_cond_destroy(&io->done_cond);
+}
+
+static void nxtcrypt_read(nxtcrypt_io *io, nxtcrypt_slot *slot, off_t off,
+                          size_t len, size_t align)
+{
+    slot->op = NXTCRYPT_READ;
+    slot->off = off;
+    slot->len = len;
+    slot->io_len = (len + align - 1) / align * align;
+    slot->done = 0;
+    nxtcrypt_queue(io, slot);
+}
+
+/*
+ * The pipeline: every slot cycles through read, encryption and write.
+ * The encryption runs in this thread as soon as a read completes while
+ * the requests of the other slots are in flight. Short transfers are
+ * resumed where they stopped.
+ */
+static int nxtcrypt_run(nxtcrypt_io *io, nxt_engine *eng, nxt128_ctx *ctx,
+                        const uint8 *iv, nxtcrypt_slot *slots, int depth,
+                        size_t buf_size, off_t size, size_t align)
+{
+    nxtcrypt_slot *slot;
+    uint8 ctr[16];
+    off_t next = 0;
+    int inflight = 0;
+    int i, err = 0;
+
+    for (i = 0; i < depth && next < size; i++) {
+        nxtcrypt_read(io, &slots[i], next,
+                      (size_t) (size - next < (off_t) buf_size ?
+                                size - next : (off_t) buf_size), align);
+        next += (off_t) slots[i].len;
+        inflight++;
+    }
+
+    while (inflight > 0) {
+        slot = nxtcrypt_wait(io);
+        if (slot == NULL) {
+            err = errno;
+            break;
+        }
+        inflight--;
+
+        if (slot->res < 0 && slot->res != -EINTR && slot->res != -EAGAIN) {
+            if (err == 0)
+                err = (int) -slot->res;
+            continue;
+        }
+        if (slot->res > 0)
+            slot->done += (size_t) slot->res;
+        if (err != 0)
+            continue;
+
+        if (slot->op == NXTCRYPT_READ) {
+            if (slot->done < slot->len) {
+                if (slot->res == 0) {
+                    err = EIO;          /* the input shrank */
+                    continue;
+                }
+                nxtcrypt_queue(io, slot);
+                inflight++;
+                continue;
+            }
+
+            ctr_add(ctr, iv, slot->off / NXT128_BLOCK_SIZE);
+            nxt_engine_ctr_crypt(eng, ctx, ctr, slot->buf, slot->buf,
+                                 slot->len);
+            memset(slot->buf + slot->len, 0, slot->io_len - slot->len);
+
+            slot->op = NXTCRYPT_WRITE;
+            slot->done = 0;
+            nxtcrypt_queue(io, slot);
+            inflight++;
+        } else {
+            if (slot->done < slot->io_len) {
+                nxtcrypt_queue(io, slot);
+                inflight++;
+                continue;
+            }
+
+            if (next < size) {
+                nxtcrypt_read(io, slot, next,
+                              (size_t) (size - next < (off_t) buf_size ?
+                                        size - next : (off_t) buf_size),
+                              align);
+                next += (off_t) slot->len;
+                inflight++;
+            }
+        }
+    }
+
+    nxt_wipe(ctr, sizeof(ctr));
+
+    return err;
+}
+
+static void report(off_t bytes, double secs, const char *mode)
+{
+    fprintf(stderr, "%lu bytes in %.3f s, %.1f MB/s (%s)\n",
+            (unsigned long) bytes, secs,
+            secs > 0 ? (double) bytes / secs / 1e6 : 0.0, mode);
+}
+
+/*
+ * Filter mode, standard input to standard output.
+ *
+ * A regular file on the input is mapped in windows of NXTCRYPT_WINDOW
+ * bytes and encrypted straight from the page cache; anything else is
+ * read() in the output buffer and encrypted in place. The chunks are
+ * processed in multiples of the block size so that the counter runs
+ * over the stream as a whole, a partial block only at the end.
+ *
+ * A pipe on the output gets the encrypted buffers with vmsplice(): the
+ * pipe references the pages instead of copying them. splice() cannot
+ * be used there since the ciphertext only exists in user memory. A page
+ * must then not be rewritten while it may still be in the pipe, so the
+ * chunks are placed one after the other, page aligned, in a ring larger
+ * than the pipe capacity plus two buffers: a pipe holds at most one
+ * page per slot, and when the ring comes back to a page at least as
+ * many pages as the pipe has slots were spliced after it. This assumes
+ * the reader consumes the pipe with read() and does not splice() the
+ * pages elsewhere or grow the pipe. Other outputs, or a kernel without
+ * vmsplice(), get plain write() calls.
+ */
+#define NXTCRYPT_WINDOW (64 * 1024 * 1024)
+
+typedef struct {
+    int splice;
+    uint8 *ring;
+    size_t ring_size;
+    size_t pos;
+    size_t page;
+} nxtcrypt_out;
+
+static int write_all(int fd, const uint8 *p, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return 0;
+}
+
+static uint8 *nxtcrypt_out_buf(nxtcrypt_out *out, size_t buf_size)
+{
+    if (out->pos + buf_size > out->ring_size)
+        out->pos = 0;
+
+    return out->ring + out->pos;
+}
+
+static int nxtcrypt_out_emit(nxtcrypt_out *out, const uint8 *p, size_t len)
+{
+#if defined(__linux__) && defined(SPLICE_F_MORE)
+    struct iovec iov;
+    ssize_t n;
+
+    out->pos += (len + out->page - 1) / out->page * out->page;
+
+    while (out->splice && len > 0) {
+        iov.iov_base = (void *) p;
+        iov.iov_len = len;
+        n = vmsplice(STDOUT_FILENO, &iov, 1, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EINVAL && errno != ENOSYS)
+                return errno;
+            out->splice = 0;
+            break;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+#endif
+
+    return write_all(STDOUT_FILENO, p, len);
+}
+
+static int nxtcrypt_filter(nxt_engine *eng, nxt128_ctx *ctx, uint8 *ctr,
+                           size_t buf_size, off_t *total, const char **mode)
+{
+    nxtcrypt_out out;
+    struct stat st;
+    uint8 carry[NXT128_BLOCK_SIZE];
+    uint8 *map, *dst;
+    off_t off, map_off, map_end;
+    size_t n, r;
+    ssize_t got;
+    int err = 0;
+
+    *total = 0;
+    *mode = "";
+    out.page = (size_t) sysconf(_SC_PAGESIZE);
+    out.splice = 0;
+    out.ring_size = buf_size;
+    out.pos = 0;
+#if defined(__linux__) && defined(F_GETPIPE_SZ)
+    if (fstat(STDOUT_FILENO, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        long cap;
+
+        fcntl(STDOUT_FILENO, F_SETPIPE_SZ, (int) buf_size);
+        cap = fcntl(STDOUT_FILENO, F_GETPIPE_SZ);
+        if (cap > 0) {
+            out.splice = 1;
+            out.ring_size = ((size_t) cap + 2 * buf_size + out.page - 1)
+                            / out.page * out.page;
+        }
+    }
+#endif
+    out.ring = (uint8 *) mmap(NULL, out.ring_size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (out.ring == MAP_FAILED)
+        return errno;
+
+    off = fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode) ?
+          lseek(STDIN_FILENO, 0, SEEK_CUR) : -1;
+
+    if (off >= 0) {
+        *mode = out.splice ? "mmap, vmsplice" : "mmap, write";
+        while (err == 0 && off < st.st_size) {
+            map_off = off - off % (off_t) out.page;
+            map_end = st.st_size - map_off > NXTCRYPT_WINDOW ?
+                      map_off + NXTCRYPT_WINDOW : st.st_size;
+            map = (uint8 *) mmap(NULL, (size_t) (map_end - map_off),
+                                 PROT_READ, MAP_SHARED, STDIN_FILENO,
+                                 map_off);
+            if (map == MAP_FAILED) {
+                err = errno;
+                break;
+            }
+            posix_madvise(map, (size_t) (map_end - map_off),
+                          POSIX_MADV_SEQUENTIAL);
+
+            for (;;) {
+                n = map_end - off > (off_t) buf_size ?
+                    buf_size : (size_t) (map_end - off);
+                if (map_end != st.st_size)
+                    n -= n % NXT128_BLOCK_SIZE;
+                if (n == 0)
+                    break;
+                dst = nxtcrypt_out_buf(&out, buf_size);
+                nxt_engine_ctr_crypt(eng, ctx, ctr, map + (off - map_off),
+                                     dst, n);
+                err = nxtcrypt_out_emit(&out, dst, n);
+                if (err != 0)
+                    break;
+                off += (off_t) n;
+                *total += (off_t) n;
+            }
+            munmap(map, (size_t) (map_end - map_off));
+        }
+        lseek(STDIN_FILENO, off, SEEK_SET);
+    } else {
+        *mode = out.splice ? "read, vmsplice" : "read, write";
+        r = 0;
+        while (err == 0) {
+            dst = nxtcrypt_out_buf(&out, buf_size);
+            memcpy(dst, carry, r);
+            got = read(STDIN_FILENO, dst + r, buf_size - r);
+            if (got < 0) {
+                if (errno != EINTR)
+                    err = errno;
+                continue;
+            }
+            n = r + (size_t) got;
+            if (got != 0)
+                n -= n % NXT128_BLOCK_SIZE;
+            r = r + (size_t) got - n;
+            memcpy(carry, dst + n, r);
+            memset(dst + n, 0, r);
+            if (n == 0) {
+                if (got == 0)
+                    break;
+                continue;
+            }
+            nxt_engine_ctr_crypt(eng, ctx, ctr, dst, dst, n);
+            err = nxtcrypt_out_emit(&out, dst, n);
+            *total += (off_t) n;
+            if (got == 0)
+                break;
+        }
+    }
+
+    /* The pipe may still reference the ring, it holds ciphertext only */
+    munmap(out.ring, out.ring_size);
+    nxt_wipe(carry, sizeof(carry));
+
+    return err;
+}
+
+/*
+ * Container mode, see nxt_chunked.h. -c stores a file, or the standard
+ * input for "-", in a new container; -x extracts the bytes of the range
+ * -r (everything by default) to a file or to the standard output; -w
+ * writes the standard input into an existing container from an offset.
+ * The data goes through a buffer of NXT_CHUNKED_BATCH chunks, cut on
+ * the chunk boundaries of the container, so that each call works on a
+ * whole batch of chunks in parallel.
+ */
+static ssize_t read_full(int fd, uint8 *p, size_t len)
+{
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < len) {
+        n = read(fd, p + done, len - done);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0)
+            break;
+        done += (size_t) n;
+    }
+
+    return (ssize_t) done;
+}
+
+static int nxtcrypt_container(int op, char **files, int nfiles,
+                              const uint8 *key, int key_len,
+                              size_t chunk_size, off_t off, off_t count,
+                              nxt_engine *eng, off_t *total)
+{
+    nxt_chunked ch;
+    uint8 *buf;
+    size_t size, want;
+    ssize_t n;
+    int fd, data, err = 0;
+
+    *total = 0;
+    if (op == 'c')
+        fd = open(files[1], O_RDWR | O_CREAT | O_TRUNC, 0666);
+    else
+        fd = open(files[0], op == 'x' ? O_RDONLY : O_RDWR);
+    if (fd < 0)
+        return errno;
+
+    if (op == 'c')
+        n = nxt_chunked_create(&ch, fd, key, (uint16) (key_len * 8),
+                               chunk_size, eng);
+    else
+        n = nxt_chunked_open(&ch, fd, key, (uint16) (key_len * 8), eng);
+    if (n != 0) {
+        err = errno;
+        close(fd);
+        return err;
+    }
+
+    if (op == 'c' && strcmp(files[0], "-") != 0)
+        data = open(files[0], O_RDONLY);
+    else if (op == 'x' && nfiles == 2)
+        data = open(files[1], O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    else
+        data = op == 'x' ? STDOUT_FILENO : STDIN_FILENO;
+    size = NXT_CHUNKED_BATCH * ch.chunk_size;
+    buf = (uint8 *) malloc(size);
+    if (data < 0 || buf == NULL)
+        err = data < 0 ? errno : ENOMEM;
+
+    if (op == 'x') {
+        if (count < 0 || count > nxt_chunked_size(&ch) - off)
+            count = off < nxt_chunked_size(&ch) ?
+                    nxt_chunked_size(&ch) - off : 0;
+        while (err == 0 && *total < count) {
+            want = size - (size_t) ((off + *total) % (off_t) ch.chunk_size);
+            if ((off_t) want > count - *total)
+                want = (size_t) (count - *total);
+            n = nxt_chunked_pread(&ch, buf, want, off + *total);
+            if (n <= 0) {
+                err = n < 0 ? errno : EIO;
+                break;
+            }
+            err = write_all(data, buf, (size_t) n);
+            *total += n;
+        }
+    } else {
+        if (op == 'c')
+            off = 0;
+        while (err == 0) {
+            want = size - (size_t) ((off + *total) % (off_t) ch.chunk_size);
+            n = read_full(data, buf, want);
+            if (n < 0) {
+                err = errno;
+                break;
+            }
+            if (n == 0)
+                break;
+            if (nxt_chunked_pwrite(&ch, buf, (size_t) n, off + *total) < 0)
+                err = errno;
+            *total += n;
+        }
+    }
+
+    if (buf != NULL) {
+        nxt_wipe(buf, size);
+        free(buf);
+    }
+    if (data > STDERR_FILENO)
+        close(data);
+    nxt_chunked_close(&ch);
+    if (close(fd) != 0 && err == 0)
+        err = errno;
+
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    nxtcrypt_io io;
+    nxtcrypt_slot slots[NXTCRYPT_MAX_DEPTH];
+    nxt128_ctx ctx;
+    nxt_engine *eng;
+    struct stat st;
+    uint8 key[32], iv[16], ctr[16];
+    uint8 *bufs;
+    char desc[64];
+    const char *mode;
+    off_t total;
+    size_t buf_size = NXTCRYPT_BUF_SIZE;
+    size_t align = 1;
+    double t0, t1;
+    int depth = NXTCRYPT_DEPTH;
+    int threads = 0;
+    int key_len = -1, iv_len = -1;
+    int direct = 0, no_uring = 0, quiet = 0;
+    int op = 0, nfiles;
+    size_t chunk_size = NXT_CHUNKED_CHUNK_SIZE;
+    off_t off = 0, count = -1;
+    int flags, c, i, err;
+
+    if (argv[0] != NULL && *argv[0] != '\0')
+        prog = argv[0];
+
+    while ((c = getopt(argc, argv, "DTqcxb:n:t:k:K:i:r:s:w:")) != -1) {
+        switch (c) {
+        case 'D':
+            direct = 1;
+            break;
+        case 'T':
+            no_uring = 1;
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        case 'c':
+        case 'x':
+            op = c;
+            break;
+        case 'w':
+            op = c;
+            if (parse_range(optarg, &off, &count) != 0 || count != -1)
+                usage();
+            break;
+        case 'r':
+            if (parse_range(optarg, &off, &count) != 0)
+                usage();
+            break;
+        case 's':
+            chunk_size = parse_size(optarg);
+            if (chunk_size == 0 || chunk_size > NXT_CHUNKED_MAX_CHUNK)
+                usage();
+            break;
+        case 'b':
+            buf_size = parse_size(optarg);
+            if (buf_size == 0)
+                usage();
+            break;
+        case 'n':
+            depth = atoi(optarg);
+            if (depth < 1 || depth > NXTCRYPT_MAX_DEPTH)
+                usage();
+            break;
+        case 't':
+            threads = atoi(optarg);
+            if (threads < 0)
+                usage();
+            break;
+        case 'k':
+            key_len = nxt_hex_decode(optarg, key, sizeof(key));
+            break;
+        case 'K':
+            key_len = nxt_read_key_file(optarg, key, sizeof(key));
+            break;
+        case 'i':
+            iv_len = nxt_hex_decode(optarg, iv, sizeof(iv));
+            break;
+        default:
+            usage();
+        }
+    }
+
+    nfiles = argc - optind;
+    if (key_len < 0 ||
+        (op == 0 && ((nfiles != 2 && nfiles != 0) || iv_len != 16)) ||
+        (op == 'c' && nfiles != 2) ||
+        (op == 'x' && nfiles != 1 && nfiles != 2) ||
+        (op == 'w' && nfiles != 1))
+        usage();
+
+    /* depth buffers of the rounded size must fit in a size_t */
+    if (buf_size > ((size_t) -1 - NXTCRYPT_ALIGN + 1) / (size_t) depth)
+        usage();
+    buf_size = (buf_size + NXTCRYPT_ALIGN - 1) / NXTCRYPT_ALIGN
+               * NXTCRYPT_ALIGN;
+
+    eng = nxt_engine_new(threads);
+    if (eng == NULL) {
+        fprintf(stderr, "%s: cannot start the engine\n", prog);
+        return 1;
+    }
+
+    if (op != 0) {
+        t0 = now();
+        err = nxtcrypt_container(op, argv + optind, nfiles, key, key_len,
+                                 chunk_size, off, count, eng, &total);
+        t1 = now();
+        nxt_engine_free(eng);
+        nxt_wipe(key, sizeof(key));
+        if (err != 0) {
+            fprintf(stderr, "%s: %s\n", prog, strerror(err));
+            return 1;
+        }
+        if (!quiet)
+            report(total, t1 - t0, "container");
+        return 0;
+    }
+
+    nxt128_ks(&ctx, key, (uint16) (key_len * 8));
+    nxt_wipe(key, sizeof(key));
+
+    if (nfiles == 0) {
+        memcpy(ctr, iv, sizeof(ctr));
+        t0 = now();
+        err = nxtcrypt_filter(eng, &ctx, ctr, buf_size, &total, &mode);
+        t1 = now();
+        nxt_engine_free(eng);
+        nxt_wipe(&ctx, sizeof(ctx));
+        if (err != 0) {
+            fprintf(stderr, "%s: %s\n", prog, strerror(err));
+            return 1;
+        }
+        if (!quiet)
+            report(total, t1 - t0, mode);
+        return 0;
+    }
+    if (direct) {
+        if (O_DIRECT == 0) {
+            fprintf(stderr, "%s: O_DIRECT is not supported\n", prog);
+            return 1;
+        }
+        align = NXTCRYPT_ALIGN;
+    }
+
+    /* allocate before the output is created, so a failure leaves none */
+    bufs = (uint8 *) mmap(NULL, (size_t) depth * buf_size,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufs == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", prog, strerror(errno));
+        return 1;
+    }
+    for (i = 0; i < depth; i++) {
+        slots[i].index = i;
+        slots[i].buf = bufs + (size_t) i * buf_size;
+    }
+
+    flags = direct ? O_DIRECT : 0;
+    io.in = open(argv[optind], O_RDONLY | flags);
+    if (io.in < 0) {
+        fprintf(stderr, "%s: %s: %s\n", prog, argv[optind], strerror(errno));
+        return 1;
+    }
+    if (fstat(io.in, &st) != 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "%s: %s: not a regular file\n", prog, argv[optind]);
+        return 1;
+    }
+    io.out = open(argv[optind + 1], O_WRONLY | O_CREAT | O_TRUNC | flags,
+                  0666);
+    if (io.out < 0) {
+        fprintf(stderr, "%s: %s: %s\n", prog, argv[optind + 1],
+                strerror(errno));
+        return 1;
+    }
+
+    io.uring = 0;
+#ifdef NXTCRYPT_URING
+    if (!no_uring)
+        io.uring = nxtcrypt_uring_init(&io, slots, depth, buf_size) == 0;
+#endif
+    if (!io.uring && nxtcrypt_threads_init(&io) != 0) {
+        fprintf(stderr, "%s: cannot start the I/O threads\n", prog);
+        return 1;
+    }
+
+    t0 = now();
+    err = nxtcrypt_run(&io, eng, &ctx, iv, slots, depth, buf_size,
+                       st.st_size, align);
+    if (err == 0 && direct && ftruncate(io.out, st.st_size) != 0)
+        err = errno;
+    t1 = now();
+
+    nxtcrypt_io_free(&io);
+    nxt_engine_free(eng);
+    nxt_wipe(&ctx, sizeof(ctx));
+    nxt_wipe(bufs, (size_t) depth * buf_size);
+    munmap(bufs, (size_t) depth * buf_size);
+
+    if (close(io.out) != 0 && err == 0)
+        err = errno;
+    close(io.in);
+
+    if (err != 0) {
+        fprintf(stderr, "%s: %s\n", prog, strerror(err));
+        return 1;
+    }
+
+    if (!quiet) {
+        mode = "threads";
+#ifdef NXTCRYPT_URING
+        if (io.uring)
+            mode = io.fixed ? "io_uring, fixed buffers" : "io_uring";
+#endif
+        sprintf(desc, "%s, %d x %lu", mode, depth, (unsigned long) buf_size);
+        report(st.st_size, t1 - t0, desc);
+    }
+
+    return 0;
+}
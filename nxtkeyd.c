@@ -0,0 +1,171 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * nxtkeyd - NXT128 key daemon
+ *
+ *   nxtkeyd -s path (-k id:hex | -K id:file)...
+ *
+ * Serves the requests of the clients of nxt_keyd.h on the Unix socket
+ * path with the keys given in hexadecimal (-k) or read from files (-K),
+ * each one under a numeric id, until it receives SIGINT, SIGTERM or
+ * SIGHUP.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nxt_common.h"
+#include "nxt128.h"
+#include "nxt_keyd.h"
+#include "nxt_tool.h"
+
+static const char *prog = "nxtkeyd";
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: %s -s path (-k id:hex | -K id:file)...\n", prog);
+    exit(2);
+}
+
+/* id:hex or id:file */
+static int add_key(nxt_keyd_server *srv, const char *arg, int file)
+{
+    uint8 key[32];
+    unsigned long id;
+    char *end;
+    int len;
+
+    id = strtoul(arg, &end, 0);
+    if (*end != ':' || id > 0xffffffffUL)
+        usage();
+
+    len = file ? nxt_read_key_file(end + 1, key, sizeof(key))
+               : nxt_hex_decode(end + 1, key, sizeof(key));
+    if (len != 8 && len != 16 && len != 24 && len != 32) {
+        nxt_wipe(key, sizeof(key));
+        errno = EINVAL;
+        return -1;
+    }
+
+    len = nxt_keyd_server_add_key(srv, (uint32) id, key,
+                                  (uint16) (len * 8));
+    nxt_wipe(key, sizeof(key));
+
+    return len;
+}
+
+static void *serve(void *arg)
+{
+    nxt_keyd_server *srv = (nxt_keyd_server *) arg;
+
+    if (nxt_keyd_server_run(srv) != 0) {
+        fprintf(stderr, "%s: %s\n", prog, strerror(errno));
+        kill(getpid(), SIGTERM);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    nxt_keyd_server *srv;
+    const char *path = NULL;
+    pthread_t tid;
+    sigset_t set;
+    int keys = 0;
+    int sig;
+    int c;
+
+    if (argv[0] != NULL && *argv[0] != '\0')
+        prog = argv[0];
+
+    /* The first pass only finds the path */
+    while ((c = getopt(argc, argv, "s:k:K:")) != -1) {
+        if (c == 's')
+            path = optarg;
+        else if (c != 'k' && c != 'K')
+            usage();
+    }
+    if (path == NULL || optind != argc)
+        usage();
+
+    /* The signals are taken by sigwait(), in this thread only */
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    srv = nxt_keyd_server_new(path);
+    if (srv == NULL) {
+        fprintf(stderr, "%s: %s: %s\n", prog, path, strerror(errno));
+        return 1;
+    }
+
+    optind = 1;
+    while ((c = getopt(argc, argv, "s:k:K:")) != -1) {
+        if (c == 's')
+            continue;
+        if (add_key(srv, optarg, c == 'K') != 0) {
+            fprintf(stderr, "%s: key %lu: %s\n", prog,
+                    strtoul(optarg, NULL, 0), strerror(errno));
+            nxt_keyd_server_free(srv);
+            return 1;
+        }
+        keys++;
+    }
+    if (keys == 0) {
+        nxt_keyd_server_free(srv);
+        usage();
+    }
+
+    if (pthread_create(&tid, NULL, serve, srv) != 0) {
+        fprintf(stderr, "%s: cannot start\n", prog);
+        nxt_keyd_server_free(srv);
+        return 1;
+    }
+
+    sigwait(&set, &sig);
+    nxt_keyd_server_stop(srv);
+    pthread_join(tid, NULL);
+    nxt_keyd_server_free(srv);
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * nxtlat - latency of one block, library against nxt_inline.h
+ *
+ *   nxtlat [samples]
+ *
+ * Each sample times a single call of nxt64_encrypt(),
+ * nxt64_encrypt_inline(), nxt128_encrypt() or nxt128_encrypt_inline(),
+ * and the median and 99th percentile of the samples are printed in
+ * nanoseconds. Every call encrypts the output of the previous one.
+ *
+ * The calls are timed with the time stamp counter on x86, fenced so
+ * that the call is complete when the counter is read, and with
+ * clock_gettime() elsewhere. The cost of reading the timer, the median
+ * of empty measurements, is subtracted from every sample, and the
+ * counter is converted to nanoseconds against clock_gettime().
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nxt_common.h"
+#include "nxt64.h"
+#include "nxt128.h"
+#include "nxt_inline.h"
+
+#define NXTLAT_SAMPLES 100000
+
+#define NXTLAT_NXT64         0
+#define NXTLAT_NXT64_INLINE  1
+#define NXTLAT_NXT128        2
+#define NXTLAT_NXT128_INLINE 3
+#define NXTLAT_EMPTY         4
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NXTLAT_TSC
+#endif
+
+static const char *nxtlat_names[] = {
+    "nxt64_encrypt", "nxt64_encrypt_inline",
+    "nxt128_encrypt", "nxt128_encrypt_inline"
+};
+
+#ifdef NXTLAT_TSC
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+#endif
+
+/*
+ * Timer ticks, read once the preceding instructions have completed. A
+ * double holds them exactly for years of uptime.
+ */
+static double ticks(void)
+{
+#ifdef NXTLAT_TSC
+    unsigned int lo, hi;
+
+    __asm__ __volatile__ ("lfence\n\trdtsc" : "=a" (lo), "=d" (hi)
+                          : : "memory");
+
+    return (double) hi * 4294967296.0 + (double) lo;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+#endif
+}
+
+/* Ticks per nanosecond */
+static double ticks_per_ns(void)
+{
+#ifdef NXTLAT_TSC
+    double t0, s0, s1;
+
+    s0 = now();
+    t0 = ticks();
+    do {
+        s1 = now();
+    } while (s1 - s0 < 0.1);
+
+    return (ticks() - t0) / ((s1 - s0) * 1e9);
+#else
+    return 1.0;
+#endif
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* One call, in ticks */
+static double nxtlat_sample(int which, nxt64_ctx *c64, nxt128_ctx *c128,
+                            uint8 *block)
+{
+    double t;
+
+    t = ticks();
+
+    switch (which) {
+    case NXTLAT_NXT64:
+        nxt64_encrypt(c64, block, block);
+        break;
+    case NXTLAT_NXT64_INLINE:
+        nxt64_encrypt_inline(c64, block, block);
+        break;
+    case NXTLAT_NXT128:
+        nxt128_encrypt(c128, block, block);
+        break;
+    case NXTLAT_NXT128_INLINE:
+        nxt128_encrypt_inline(c128, block, block);
+        break;
+    default:
+        break;
+    }
+
+    return ticks() - t;
+}
+
+/* Sorted samples of which */
+static void nxtlat_run(int which, nxt64_ctx *c64, nxt128_ctx *c128,
+                       uint8 *block, double *t, long samples)
+{
+    long i;
+
+    /* Warm the caches and the branch predictors */
+    for (i = 0; i < samples / 10 + 1; i++)
+        nxtlat_sample(which, c64, c128, block);
+
+    for (i = 0; i < samples; i++)
+        t[i] = nxtlat_sample(which, c64, c128, block);
+
+    qsort(t, samples, sizeof(double), cmp_double);
+}
+
+int main(int argc, char **argv)
+{
+    static const uint8 key[16] = {0x00, 0x11, 0x22, 0x33,
+                                  0x44, 0x55, 0x66, 0x77,
+                                  0x88, 0x99, 0xaa, 0xbb,
+                                  0xcc, 0xdd, 0xee, 0xff};
+    uint8 block[16] = {0};
+    nxt64_ctx c64;
+    nxt128_ctx c128;
+    double *t;
+    double overhead, scale;
+    long samples = NXTLAT_SAMPLES;
+    int which;
+
+    if (argc > 2 || (argc == 2 && (samples = atol(argv[1])) <= 0)) {
+        fprintf(stderr, "usage: nxtlat [samples]\n");
+        return EXIT_FAILURE;
+    }
+
+    t = (double *) malloc(samples * sizeof(double));
+    if (t == NULL) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+
+    nxt64_ks(&c64, key, 128);
+    nxt128_ks(&c128, key, 128);
+
+    scale = ticks_per_ns();
+    nxtlat_run(NXTLAT_EMPTY, &c64, &c128, block, t, samples);
+    overhead = t[samples / 2];
+
+    printf("timer overhead %.1f ns, subtracted\n", overhead / scale);
+    printf("%-22s %8s %8s\n", "ns per call", "p50", "p99");
+
+    for (which = NXTLAT_NXT64; which <= NXTLAT_NXT128_INLINE; which++) {
+        nxtlat_run(which, &c64, &c128, block, t, samples);
+        printf("%-22s %8.1f %8.1f\n", nxtlat_names[which],
+               (t[samples / 2] - overhead) / scale,
+               (t[samples * 99 / 100] - overhead) / scale);
+    }
+
+    /* Keeps the calls from being optimized away */
+    if (block[0] == 0 && block[1] == 0 && block[2] == 0 && block[3] == 0)
+        printf("\n");
+
+    free(t);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,625 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*
+ * CPython extension module "nxt". NXT64(key) and NXT128(key) hold a key
+ * schedule and work on any contiguous buffer: bytes, bytearray,
+ * memoryview, array.array or numpy arrays. The input is read in place
+ * and the result is written to the buffer given as out, which may be
+ * the input itself, or to a new bytes object. Calls on at least
+ * NXT_PY_GIL_MIN bytes run without the GIL: a key schedule is never
+ * modified once built, so any number of threads may share one object.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <string.h>
+
+#include "nxt_common.h"
+#include "nxt64.h"
+#include "nxt128.h"
+#include "nxt_modes.h"
+
+/* Smaller calls keep the GIL, releasing it costs more than the work */
+#define NXT_PY_GIL_MIN 4096
+
+/* Blocks of NXT64 keystream or plaintext computed at once */
+#define NXT_PY_BATCH 32
+
+typedef struct {
+    PyObject_HEAD
+    int block_size;
+    int key_size;
+    union {
+        nxt64_ctx c64;
+        nxt128_eax_ctx eax;
+    } u;
+} nxt_py_cipher;
+
+typedef void (*nxt_py_fn)(nxt_py_cipher *self, uint8 *iv, const uint8 *in,
+                          uint8 *out, size_t len);
+
+static PyObject *nxt_py_auth_error;
+
+static void nxt_py_xor(uint8 *a, const uint8 *b, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        a[i] ^= b[i];
+    }
+}
+
+static void nxt_py_ecb_encrypt(nxt_py_cipher *self, uint8 *iv,
+                               const uint8 *in, uint8 *out, size_t len)
+{
+    (void) iv;
+
+    if (self->block_size == NXT64_BLOCK_SIZE)
+        nxt64_encrypt_blocks(&self->u.c64, in, out, len / NXT64_BLOCK_SIZE);
+    else
+        nxt128_encrypt_blocks(&self->u.eax.cipher, in, out,
+                              len / NXT128_BLOCK_SIZE);
+}
+
+static void nxt_py_ecb_decrypt(nxt_py_cipher *self, uint8 *iv,
+                               const uint8 *in, uint8 *out, size_t len)
+{
+    (void) iv;
+
+    if (self->block_size == NXT64_BLOCK_SIZE)
+        nxt64_decrypt_blocks(&self->u.c64, in, out, len / NXT64_BLOCK_SIZE);
+    else
+        nxt128_decrypt_blocks(&self->u.eax.cipher, in, out,
+                              len / NXT128_BLOCK_SIZE);
+}
+
+static void nxt_py_cbc_encrypt(nxt_py_cipher *self, uint8 *iv,
+                               const uint8 *in, uint8 *out, size_t len)
+{
+    if (self->block_size == NXT128_BLOCK_SIZE) {
+        nxt128_cbc_encrypt(&self->u.eax.cipher, iv, in, out, len);
+        return;
+    }
+
+    for (; len > 0; len -= NXT64_BLOCK_SIZE) {
+        nxt_py_xor(iv, in, NXT64_BLOCK_SIZE);
+        nxt64_encrypt(&self->u.c64, iv, iv);
+        memcpy(out, iv, NXT64_BLOCK_SIZE);
+        in += NXT64_BLOCK_SIZE;
+        out += NXT64_BLOCK_SIZE;
+    }
+}
+
+static void nxt_py_cbc_decrypt(nxt_py_cipher *self, uint8 *iv,
+                               const uint8 *in, uint8 *out, size_t len)
+{
+    uint8 c[NXT_PY_BATCH * NXT64_BLOCK_SIZE];
+    size_t n, i;
+
+    if (self->block_size == NXT128_BLOCK_SIZE) {
+        nxt128_cbc_decrypt(&self->u.eax.cipher, iv, in, out, len);
+        return;
+    }
+
+    for (; len > 0; len -= n, in += n, out += n) {
+        n = (len < sizeof(c)) ? len : sizeof(c);
+        memcpy(c, in, n);
+        nxt64_decrypt_blocks(&self->u.c64, c, out, n / NXT64_BLOCK_SIZE);
+        nxt_py_xor(out, iv, NXT64_BLOCK_SIZE);
+        for (i = NXT64_BLOCK_SIZE; i < n; i += NXT64_BLOCK_SIZE) {
+            nxt_py_xor(out + i, c + i - NXT64_BLOCK_SIZE, NXT64_BLOCK_SIZE);
+        }
+        memcpy(iv, c + n - NXT64_BLOCK_SIZE, NXT64_BLOCK_SIZE);
+    }
+}
+
+/* CTR mode, the whole block being a big-endian counter */
+static void nxt_py_ctr(nxt_py_cipher *self, uint8 *iv, const uint8 *in,
+                       uint8 *out, size_t len)
+{
+    uint8 ks[NXT_PY_BATCH * NXT64_BLOCK_SIZE];
+    size_t n, i, j;
+
+    if (self->block_size == NXT128_BLOCK_SIZE) {
+        nxt128_ctr_crypt(&self->u.eax.cipher, iv, in, out, len);
+        return;
+    }
+
+    for (; len > 0; len -= n, in += n, out += n) {
+        n = (len < sizeof(ks)) ? len : sizeof(ks);
+        for (i = 0; i < n; i += NXT64_BLOCK_SIZE) {
+            memcpy(ks + i, iv, NXT64_BLOCK_SIZE);
+            for (j = NXT64_BLOCK_SIZE; j > 0 && ++iv[j - 1] == 0; j--)
+                ;
+        }
+        nxt64_encrypt_blocks(&self->u.c64, ks, ks,
+                             (n + NXT64_BLOCK_SIZE - 1) / NXT64_BLOCK_SIZE);
+        for (i = 0; i < n; i++) {
+            out[i] = in[i] ^ ks[i];
+        }
+    }
+
+    nxt_wipe(ks, sizeof(ks));
+}
+
+/* The output may be the input itself but may not overlap it otherwise */
+static int nxt_py_overlap(const char *a, const char *b, Py_ssize_t len)
+{
+    return (a != b) && (a < b + len) && (b < a + len);
+}
+
+/*
+ * Gets the output buffer: out when given, a new bytes object otherwise.
+ * Returns a new reference to the result object.
+ */
+static PyObject *nxt_py_output(PyObject *out, Py_buffer *view,
+                               const Py_buffer *in, char **dst)
+{
+    PyObject *res;
+
+    view->obj = NULL;
+
+    if (out == NULL || out == Py_None) {
+        res = PyBytes_FromStringAndSize(NULL, in->len);
+        if (res != NULL)
+            *dst = PyBytes_AS_STRING(res);
+        return res;
+    }
+
+    if (PyObject_GetBuffer(out, view, PyBUF_WRITABLE) < 0)
+        return NULL;
+
+    if (view->len < in->len) {
+        PyErr_SetString(PyExc_ValueError, "output buffer too small");
+    } else if (nxt_py_overlap((const char *) view->buf,
+                              (const char *) in->buf, in->len)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "output buffer partially overlaps the input");
+    } else {
+        *dst = (char *) view->buf;
+        Py_INCREF(out);
+        return out;
+    }
+
+    PyBuffer_Release(view);
+    return NULL;
+}
+
+static int nxt_py_get_iv(nxt_py_cipher *self, PyObject *obj, uint8 *iv)
+{
+    Py_buffer view;
+
+    if (PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) < 0)
+        return -1;
+
+    if (view.len != self->block_size) {
+        PyErr_Format(PyExc_ValueError, "iv must be %d bytes long",
+                     self->block_size);
+        PyBuffer_Release(&view);
+        return -1;
+    }
+
+    memcpy(iv, view.buf, (size_t) view.len);
+    PyBuffer_Release(&view);
+
+    return 0;
+}
+
+static PyObject *nxt_py_run(nxt_py_cipher *self, nxt_py_fn fn, int whole,
+                            PyObject *iv_obj, PyObject *data, PyObject *out)
+{
+    uint8 iv[NXT128_BLOCK_SIZE];
+    Py_buffer in, view;
+    PyObject *res;
+    char *dst;
+
+    if (iv_obj != NULL && nxt_py_get_iv(self, iv_obj, iv) < 0)
+        return NULL;
+
+    if (PyObject_GetBuffer(data, &in, PyBUF_SIMPLE) < 0)
+        return NULL;
+
+    if (whole && (in.len % self->block_size != 0)) {
+        PyErr_Format(PyExc_ValueError,
+                     "data length must be a multiple of %d",
+                     self->block_size);
+        PyBuffer_Release(&in);
+        return NULL;
+    }
+
+    res = nxt_py_output(out, &view, &in, &dst);
+    if (res == NULL) {
+        PyBuffer_Release(&in);
+        return NULL;
+    }
+
+    if (in.len >= NXT_PY_GIL_MIN) {
+        Py_BEGIN_ALLOW_THREADS
+        fn(self, iv, (const uint8 *) in.buf, (uint8 *) dst, (size_t) in.len);
+        Py_END_ALLOW_THREADS
+    } else {
+        fn(self, iv, (const uint8 *) in.buf, (uint8 *) dst, (size_t) in.len);
+    }
+
+    if (view.obj != NULL)
+        PyBuffer_Release(&view);
+    PyBuffer_Release(&in);
+
+    return res;
+}
+
+static PyObject *nxt_py_ecb_encrypt_meth(nxt_py_cipher *self, PyObject *args,
+                                         PyObject *kwds)
+{
+    static char *kwlist[] = { "data", "out", NULL };
+    PyObject *data, *out = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|$O:ecb_encrypt", kwlist,
+                                     &data, &out))
+        return NULL;
+
+    return nxt_py_run(self, nxt_py_ecb_encrypt, 1, NULL, data, out);
+}
+
+static PyObject *nxt_py_ecb_decrypt_meth(nxt_py_cipher *self, PyObject *args,
+                                         PyObject *kwds)
+{
+    static char *kwlist[] = { "data", "out", NULL };
+    PyObject *data, *out = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|$O:ecb_decrypt", kwlist,
+                                     &data, &out))
+        return NULL;
+
+    return nxt_py_run(self, nxt_py_ecb_decrypt, 1, NULL, data, out);
+}
+
+static PyObject *nxt_py_cbc_encrypt_meth(nxt_py_cipher *self, PyObject *args,
+                                         PyObject *kwds)
+{
+    static char *kwlist[] = { "iv", "data", "out", NULL };
+    PyObject *iv, *data, *out = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|$O:cbc_encrypt", kwlist,
+                                     &iv, &data, &out))
+        return NULL;
+
+    return nxt_py_run(self, nxt_py_cbc_encrypt, 1, iv, data, out);
+}
+
+static PyObject *nxt_py_cbc_decrypt_meth(nxt_py_cipher *self, PyObject *args,
+                                         PyObject *kwds)
+{
+    static char *kwlist[] = { "iv", "data", "out", NULL };
+    PyObject *iv, *data, *out = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|$O:cbc_decrypt", kwlist,
+                                     &iv, &data, &out))
+        return NULL;
+
+    return nxt_py_run(self, nxt_py_cbc_decrypt, 1, iv, data, out);
+}
+
+static PyObject *nxt_py_ctr_meth(nxt_py_cipher *self, PyObject *args,
+                                 PyObject *kwds)
+{
+    static char *kwlist[] = { "iv", "data", "out", NULL };
+    PyObject *iv, *data, *out = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|$O:ctr", kwlist,
+                                     &iv, &data, &out))
+        return NULL;
+
+    return nxt_py_run(self, nxt_py_ctr, 0, iv, data, out);
+}
+
+/*
+ * EAX: the nonce and the header have any length, the tag is 16 bytes.
+ */
+static PyObject *nxt_py_eax(nxt_py_cipher *self, PyObject *args,
+                            PyObject *kwds, int decrypt)
+{
+    static char *enc_kwlist[] = { "nonce", "data", "header", "out", NULL };
+    static char *dec_kwlist[] = { "nonce", "data", "tag", "header", "out",
+                                  NULL };
+    Py_buffer nonce, in, tag, hdr, view;
+    uint8 tag_out[NXT128_EAX_TAG_SIZE];
+    PyObject *data, *out = NULL, *res;
+    char *dst;
+    int ok;
+
+    hdr.buf = NULL;
+    hdr.len = 0;
+    hdr.obj = NULL;
+
+    if (decrypt) {
+        if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*Oy*|y*$O:eax_decrypt",
+                                         dec_kwlist, &nonce, &data, &tag,
+                                         &hdr, &out))
+            return NULL;
+    } else {
+        tag.obj = NULL;
+        if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*O|y*$O:eax_encrypt",
+                                         enc_kwlist, &nonce, &data, &hdr,
+                                         &out))
+            return NULL;
+    }
+
+    res = NULL;
+    in.obj = NULL;
+
+    if (decrypt && tag.len != NXT128_EAX_TAG_SIZE) {
+        PyErr_Format(PyExc_ValueError, "tag must be %d bytes long",
+                     NXT128_EAX_TAG_SIZE);
+        goto end;
+    }
+
+    if (PyObject_GetBuffer(data, &in, PyBUF_SIMPLE) < 0) {
+        in.obj = NULL;
+        goto end;
+    }
+
+    res = nxt_py_output(out, &view, &in, &dst);
+    if (res == NULL)
+        goto end;
+
+    ok = 0;
+    Py_BEGIN_ALLOW_THREADS
+    if (decrypt) {
+        ok = nxt128_eax_decrypt(&self->u.eax, (const uint8 *) nonce.buf,
+                                (size_t) nonce.len, (const uint8 *) hdr.buf,
+                                (size_t) hdr.len, (const uint8 *) in.buf,
+                                (uint8 *) dst, (size_t) in.len,
+                                (const uint8 *) tag.buf);
+    } else {
+        nxt128_eax_encrypt(&self->u.eax, (const uint8 *) nonce.buf,
+                           (size_t) nonce.len, (const uint8 *) hdr.buf,
+                           (size_t) hdr.len, (const uint8 *) in.buf,
+                           (uint8 *) dst, (size_t) in.len, tag_out);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (view.obj != NULL)
+        PyBuffer_Release(&view);
+
+    if (ok != 0) {
+        Py_DECREF(res);
+        res = NULL;
+        PyErr_SetString(nxt_py_auth_error, "EAX tag mismatch");
+    } else if (!decrypt) {
+        data = res;
+        res = Py_BuildValue("(Ny#)", data, (const char *) tag_out,
+                            (Py_ssize_t) NXT128_EAX_TAG_SIZE);
+    }
+
+end:
+    if (in.obj != NULL)
+        PyBuffer_Release(&in);
+    if (hdr.obj != NULL)
+        PyBuffer_Release(&hdr);
+    if (tag.obj != NULL)
+        PyBuffer_Release(&tag);
+    PyBuffer_Release(&nonce);
+
+    return res;
+}
+
+static PyObject *nxt_py_eax_encrypt_meth(nxt_py_cipher *self, PyObject *args,
+                                         PyObject *kwds)
+{
+    return nxt_py_eax(self, args, kwds, 0);
+}
+
+static PyObject *nxt_py_eax_decrypt_meth(nxt_py_cipher *self, PyObject *args,
+                                         PyObject *kwds)
+{
+    return nxt_py_eax(self, args, kwds, 1);
+}
+
+static PyObject *nxt_py_new(PyTypeObject *type, PyObject *args,
+                            PyObject *kwds, int block_size)
+{
+    static char *kwlist[] = { "key", NULL };
+    nxt_py_cipher *self;
+    Py_buffer key;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*", kwlist, &key))
+        return NULL;
+
+    if (key.len > 32) {
+        PyErr_SetString(PyExc_ValueError, "key must be at most 32 bytes");
+        PyBuffer_Release(&key);
+        return NULL;
+    }
+
+    self = (nxt_py_cipher *) type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->block_size = block_size;
+        self->key_size = (int) key.len;
+        if (block_size == NXT64_BLOCK_SIZE)
+            nxt64_ks(&self->u.c64, (const uint8 *) key.buf,
+                     (uint16) (key.len * 8));
+        else
+            nxt128_eax_init(&self->u.eax, (const uint8 *) key.buf,
+                            (uint16) (key.len * 8));
+    }
+
+    PyBuffer_Release(&key);
+
+    return (PyObject *) self;
+}
+
+static PyObject *nxt_py_nxt64_new(PyTypeObject *type, PyObject *args,
+                                  PyObject *kwds)
+{
+    return nxt_py_new(type, args, kwds, NXT64_BLOCK_SIZE);
+}
+
+static PyObject *nxt_py_nxt128_new(PyTypeObject *type, PyObject *args,
+                                   PyObject *kwds)
+{
+    return nxt_py_new(type, args, kwds, NXT128_BLOCK_SIZE);
+}
+
+static void nxt_py_dealloc(PyObject *obj)
+{
+    PyTypeObject *type = Py_TYPE(obj);
+
+    nxt_wipe(&((nxt_py_cipher *) obj)->u, sizeof(((nxt_py_cipher *) obj)->u));
+    type->tp_free(obj);
+    Py_DECREF(type);
+}
+
+#define NXT_PY_MODES_METHODS                                                \
+    { "ecb_encrypt", (PyCFunction) (void (*)(void)) nxt_py_ecb_encrypt_meth,\
+      METH_VARARGS | METH_KEYWORDS,                                         \
+      "ecb_encrypt(data, *, out=None)\n\nECB encryption of whole blocks." },\
+    { "ecb_decrypt", (PyCFunction) (void (*)(void)) nxt_py_ecb_decrypt_meth,\
+      METH_VARARGS | METH_KEYWORDS,                                         \
+      "ecb_decrypt(data, *, out=None)\n\nECB decryption of whole blocks." },\
+    { "cbc_encrypt", (PyCFunction) (void (*)(void)) nxt_py_cbc_encrypt_meth,\
+      METH_VARARGS | METH_KEYWORDS,                                         \
+      "cbc_encrypt(iv, data, *, out=None)\n\n"                              \
+      "CBC encryption of whole blocks, without padding." },                 \
+    { "cbc_decrypt", (PyCFunction) (void (*)(void)) nxt_py_cbc_decrypt_meth,\
+      METH_VARARGS | METH_KEYWORDS,                                         \
+      "cbc_decrypt(iv, data, *, out=None)\n\n"                              \
+      "CBC decryption of whole blocks, without padding." },                 \
+    { "ctr", (PyCFunction) (void (*)(void)) nxt_py_ctr_meth,                \
+      METH_VARARGS | METH_KEYWORDS,                                         \
+      "ctr(iv, data, *, out=None)\n\n"                                      \
+      "CTR encryption or decryption, iv being the first counter block." }
+
+static PyMethodDef nxt_py_nxt64_methods[] = {
+    NXT_PY_MODES_METHODS,
+    { NULL, NULL, 0, NULL }
+};
+
+static PyMethodDef nxt_py_nxt128_methods[] = {
+    NXT_PY_MODES_METHODS,
+    { "eax_encrypt", (PyCFunction) (void (*)(void)) nxt_py_eax_encrypt_meth,
+      METH_VARARGS | METH_KEYWORDS,
+      "eax_encrypt(nonce, data, header=b'', *, out=None)\n\n"
+      "EAX encryption, returns (ciphertext, tag)." },
+    { "eax_decrypt", (PyCFunction) (void (*)(void)) nxt_py_eax_decrypt_meth,
+      METH_VARARGS | METH_KEYWORDS,
+      "eax_decrypt(nonce, data, tag, header=b'', *, out=None)\n\n"
+      "EAX decryption, raises AuthenticationError if the tag is wrong." },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyMemberDef nxt_py_members[] = {
+    { "block_size", T_INT, offsetof(nxt_py_cipher, block_size), READONLY,
+      "Block size in bytes" },
+    { "key_size", T_INT, offsetof(nxt_py_cipher, key_size), READONLY,
+      "Key size in bytes" },
+    { NULL, 0, 0, 0, NULL }
+};
+
+static PyType_Slot nxt_py_nxt64_slots[] = {
+    { Py_tp_doc, "NXT64(key)\n\nIDEA NXT with 64-bit blocks, key of up "
+                 "to 32 bytes." },
+    { Py_tp_new, (void *) nxt_py_nxt64_new },
+    { Py_tp_dealloc, (void *) nxt_py_dealloc },
+    { Py_tp_methods, nxt_py_nxt64_methods },
+    { Py_tp_members, nxt_py_members },
+    { 0, NULL }
+};
+
+static PyType_Slot nxt_py_nxt128_slots[] = {
+    { Py_tp_doc, "NXT128(key)\n\nIDEA NXT with 128-bit blocks, key of up "
+                 "to 32 bytes." },
+    { Py_tp_new, (void *) nxt_py_nxt128_new },
+    { Py_tp_dealloc, (void *) nxt_py_dealloc },
+    { Py_tp_methods, nxt_py_nxt128_methods },
+    { Py_tp_members, nxt_py_members },
+    { 0, NULL }
+};
+
+static PyType_Spec nxt_py_nxt64_spec = {
+    "nxt.NXT64", sizeof(nxt_py_cipher), 0, Py_TPFLAGS_DEFAULT,
+    nxt_py_nxt64_slots
+};
+
+static PyType_Spec nxt_py_nxt128_spec = {
+    "nxt.NXT128", sizeof(nxt_py_cipher), 0, Py_TPFLAGS_DEFAULT,
+    nxt_py_nxt128_slots
+};
+
+static struct PyModuleDef nxt_py_module = {
+    PyModuleDef_HEAD_INIT, "nxt", "IDEA NXT block ciphers and modes.", -1,
+    NULL, NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit_nxt(void)
+{
+    PyObject *mod, *type;
+
+    mod = PyModule_Create(&nxt_py_module);
+    if (mod == NULL)
+        return NULL;
+
+    type = PyType_FromSpec(&nxt_py_nxt64_spec);
+    if (type == NULL)
+        goto fail;
+    if (PyModule_AddObject(mod, "NXT64", type) < 0) {
+        Py_DECREF(type);
+        goto fail;
+    }
+
+    type = PyType_FromSpec(&nxt_py_nxt128_spec);
+    if (type == NULL)
+        goto fail;
+    if (PyModule_AddObject(mod, "NXT128", type) < 0) {
+        Py_DECREF(type);
+        goto fail;
+    }
+
+    if (nxt_py_auth_error == NULL) {
+        nxt_py_auth_error = PyErr_NewException("nxt.AuthenticationError",
+                                               PyExc_ValueError, NULL);
+        if (nxt_py_auth_error == NULL)
+            goto fail;
+    }
+    Py_INCREF(nxt_py_auth_error);
+    if (PyModule_AddObject(mod, "AuthenticationError",
+                           nxt_py_auth_error) < 0) {
+        Py_DECREF(nxt_py_auth_error);
+        goto fail;
+    }
+
+    return mod;
+
+fail:
+    Py_DECREF(mod);
+    return NULL;
+}
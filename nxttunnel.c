@@ -0,0 +1,706 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * nxttunnel - encrypted UDP tunnel
+ *
+ *   nxttunnel (-k hex | -K file) -s out:in -i addr -d addr -o addr
+ *             -p addr
+ *   nxttunnel -B [-n count] [-z size] (-k hex | -K file)
+ *
+ * The datagrams received on the inner socket (bound to -i) are
+ * protected with the outbound SA and sent from the outer socket (bound
+ * to -o) to the peer gateway (-p); the packets received on the outer
+ * socket are checked and decrypted with the inbound SA and their payload
+ * is sent from the inner socket to -d. The SAs are derived from the key
+ * given in hexadecimal (-k) or read from a file (-K) and from their SPIs
+ * (-s): the two gateways of a link use the same key and swapped SPIs.
+ * The addresses are host:port, with the host of an IPv6 address in
+ * brackets.
+ *
+ * The datagrams are received and sent NXTTUNNEL_BATCH at a time with
+ * recvmmsg() and sendmmsg() where available, and every batch is
+ * protected or checked as a whole by nxt_tunnel_encap() or
+ * nxt_tunnel_decap(). Inner datagrams longer than NXTTUNNEL_MAX_PAYLOAD
+ * bytes are dropped.
+ *
+ * -B runs two gateways connected over the loopback interface in one
+ * process, sends count datagrams of size bytes (-n and -z) through them
+ * and reports the throughput on stderr.
+ */
+#ifdef __linux__
+#define _GNU_SOURCE
+#else
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "nxt_common.h"
+#include "nxt128.h"
+#include "nxt_tunnel.h"
+#include "nxt_tool.h"
+
+#define NXTTUNNEL_BATCH       NXT_TUNNEL_BATCH
+#define NXTTUNNEL_BUF_SIZE    2048
+#define NXTTUNNEL_MAX_PAYLOAD (NXTTUNNEL_BUF_SIZE - NXT_TUNNEL_OVERHEAD)
+#define NXTTUNNEL_SOCK_BUF    (4 * 1024 * 1024)
+
+/* Datagrams in flight in the benchmark, and how long a loss may take */
+#define NXTTUNNEL_INFLIGHT    1024
+#define NXTTUNNEL_IDLE        0.2
+
+#ifdef __linux__
+typedef struct mmsghdr nxttunnel_msg;
+#else
+typedef struct {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+} nxttunnel_msg;
+#endif
+
+typedef struct {
+    struct sockaddr_storage ss;
+    socklen_t len;
+} nxttunnel_addr;
+
+/* One gateway: an inner and an outer socket and a pair of SAs */
+typedef struct {
+    int inner;
+    int outer;
+    nxttunnel_addr deliver;
+    nxttunnel_addr peer;
+    nxt_tunnel t;
+    nxt_tunnel_sa out;
+    nxt_tunnel_sa in;
+    uint8 *bufs;
+    nxttunnel_msg msgs[NXTTUNNEL_BATCH];
+    struct iovec iov[NXTTUNNEL_BATCH];
+    nxt_tunnel_pkt pkts[NXTTUNNEL_BATCH];
+    pthread_mutex_t *lock;      /* protects *stop, NULL when alone */
+    int *stop;
+} nxttunnel_gw;
+
+static const char *prog = "nxttunnel";
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: %s (-k hex | -K file) -s out:in -i addr -d addr "
+            "-o addr -p addr\n"
+            "       %s -B [-n count] [-z size] (-k hex | -K file)\n",
+            prog, prog);
+    exit(2);
+}
+
+/* host:port or [host]:port */
+static int parse_addr(const char *s, nxttunnel_addr *addr)
+{
+    struct addrinfo hints, *res;
+    char host[256];
+    const char *port;
+    size_t n;
+
+    port = strrchr(s, ':');
+    if (port == NULL)
+        return -1;
+    n = (size_t) (port - s);
+    if (n > 1 && s[0] == '[' && s[n - 1] == ']') {
+        s++;
+        n -= 2;
+    }
+    if (n >= sizeof(host))
+        return -1;
+    memcpy(host, s, n);
+    host[n] = '\0';
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, port + 1, &hints, &res) != 0)
+        return -1;
+
+    memcpy(&addr->ss, res->ai_addr, res->ai_addrlen);
+    addr->len = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    return 0;
+}
+
+static int open_socket(const nxttunnel_addr *addr)
+{
+    int size = NXTTUNNEL_SOCK_BUF;
+    int fd;
+
+    fd = socket(addr->ss.ss_family, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+
+    /* Room for the bursts, best effort */
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    if (bind(fd, (const struct sockaddr *) &addr->ss, addr->len) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Batched receive and send, one call per datagram without *mmsg() */
+static int nxttunnel_recv(int fd, nxttunnel_msg *msgs, int n)
+{
+#ifdef __linux__
+    return recvmmsg(fd, msgs, (unsigned int) n, MSG_DONTWAIT, NULL);
+#else
+    ssize_t r;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        r = recvmsg(fd, &msgs[i].msg_hdr, MSG_DONTWAIT);
+        if (r < 0)
+            return i > 0 ? i : -1;
+        msgs[i].msg_len = (unsigned int) r;
+    }
+
+    return n;
+#endif
+}
+
+static int nxttunnel_send(int fd, nxttunnel_msg *msgs, int n)
+{
+#ifdef __linux__
+    return sendmmsg(fd, msgs, (unsigned int) n, 0);
+#else
+    ssize_t r;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        r = sendmsg(fd, &msgs[i].msg_hdr, 0);
+        if (r < 0)
+            return i > 0 ? i : -1;
+        msgs[i].msg_len = (unsigned int) r;
+    }
+
+    return n;
+#endif
+}
+
+/*
+ * Sends the n datagrams of msgs. A datagram that cannot be sent is
+ * dropped, as the network would.
+ */
+static void nxttunnel_send_all(int fd, nxttunnel_msg *msgs, int n)
+{
+    int r;
+
+    while (n > 0) {
+        r = nxttunnel_send(fd, msgs, n);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            r = 1;
+        }
+        msgs += r;
+        n -= r;
+    }
+}
+
+/* Points the message headers of the batch to the buffers */
+static void nxttunnel_prepare(nxttunnel_gw *gw, size_t off, size_t len,
+                              int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        gw->iov[i].iov_base = gw->bufs + i * NXTTUNNEL_BUF_SIZE + off;
+        gw->iov[i].iov_len = len;
+        memset(&gw->msgs[i], 0, sizeof(gw->msgs[i]));
+        gw->msgs[i].msg_hdr.msg_iov = &gw->iov[i];
+        gw->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+/* Inner datagrams to the peer */
+static void nxttunnel_outbound(nxttunnel_gw *gw)
+{
+    int n, i, j;
+
+    nxttunnel_prepare(gw, NXT_TUNNEL_HEADER_SIZE, NXTTUNNEL_MAX_PAYLOAD + 1,
+                      NXTTUNNEL_BATCH);
+    n = nxttunnel_recv(gw->inner, gw->msgs, NXTTUNNEL_BATCH);
+    if (n <= 0)
+        return;
+
+    for (i = 0, j = 0; i < n; i++) {
+        if (gw->msgs[i].msg_len > NXTTUNNEL_MAX_PAYLOAD)
+            continue;
+        gw->pkts[j].data = gw->bufs + i * NXTTUNNEL_BUF_SIZE;
+        gw->pkts[j].len = gw->msgs[i].msg_len;
+        gw->pkts[j].sa = &gw->out;
+        j++;
+    }
+    nxt_tunnel_encap(&gw->t, gw->pkts, (size_t) j);
+
+    for (i = 0, n = 0; i < j; i++) {
+        if (gw->pkts[i].status != 0)
+            continue;
+        gw->iov[n].iov_base = gw->pkts[i].data;
+        gw->iov[n].iov_len = gw->pkts[i].len;
+        gw->msgs[n].msg_hdr.msg_iov = &gw->iov[n];
+        gw->msgs[n].msg_hdr.msg_name = &gw->peer.ss;
+        gw->msgs[n].msg_hdr.msg_namelen = gw->peer.len;
+        n++;
+    }
+    nxttunnel_send_all(gw->outer, gw->msgs, n);
+}
+
+/* Packets from the peer to the inner destination */
+static void nxttunnel_inbound(nxttunnel_gw *gw)
+{
+    int n, i, j;
+
+    nxttunnel_prepare(gw, 0, NXTTUNNEL_BUF_SIZE, NXTTUNNEL_BATCH);
+    n = nxttunnel_recv(gw->outer, gw->msgs, NXTTUNNEL_BATCH);
+    if (n <= 0)
+        return;
+
+    for (i = 0; i < n; i++) {
+        gw->pkts[i].data = gw->bufs + i * NXTTUNNEL_BUF_SIZE;
+        gw->pkts[i].len = gw->msgs[i].msg_len;
+    }
+    nxt_tunnel_decap(&gw->t, gw->pkts, (size_t) n);
+
+    for (i = 0, j = 0; i < n; i++) {
+        if (gw->pkts[i].status != 0 || gw->pkts[i].sa != &gw->in)
+            continue;
+        gw->iov[j].iov_base = gw->pkts[i].data + NXT_TUNNEL_HEADER_SIZE;
+        gw->iov[j].iov_len = gw->pkts[i].len;
+        gw->msgs[j].msg_hdr.msg_iov = &gw->iov[j];
+        gw->msgs[j].msg_hdr.msg_name = &gw->deliver.ss;
+        gw->msgs[j].msg_hdr.msg_namelen = gw->deliver.len;
+        j++;
+    }
+    nxttunnel_send_all(gw->inner, gw->msgs, j);
+}
+
+static int nxttunnel_stopped(nxttunnel_gw *gw)
+{
+    int stop;
+
+    if (gw->lock == NULL)
+        return 0;
+
+    pthread_mutex_lock(gw->lock);
+    stop = *gw->stop;
+    pthread_mutex_unlock(gw->lock);
+
+    return stop;
+}
+
+static void *nxttunnel_run(void *arg)
+{
+    nxttunnel_gw *gw = (nxttunnel_gw *) arg;
+    struct pollfd fds[2];
+
+    fds[0].fd = gw->inner;
+    fds[1].fd = gw->outer;
+    fds[0].events = fds[1].events = POLLIN;
+
+    while (!nxttunnel_stopped(gw)) {
+        if (poll(fds, 2, 100) <= 0)
+            continue;
+        if (fds[0].revents & POLLIN)
+            nxttunnel_outbound(gw);
+        if (fds[1].revents & POLLIN)
+            nxttunnel_inbound(gw);
+    }
+
+    return NULL;
+}
+
+static int nxttunnel_gw_init(nxttunnel_gw *gw, const uint8 *key,
+                             int key_len, uint32 spi_out, uint32 spi_in,
+                             const nxttunnel_addr *inner,
+                             const nxttunnel_addr *outer)
+{
+    memset(gw, 0, sizeof(nxttunnel_gw));
+
+    gw->bufs = (uint8 *) malloc(NXTTUNNEL_BATCH * NXTTUNNEL_BUF_SIZE);
+    gw->inner = open_socket(inner);
+    gw->outer = open_socket(outer);
+    if (gw->bufs == NULL || gw->inner < 0 || gw->outer < 0) {
+        free(gw->bufs);
+        if (gw->inner >= 0)
+            close(gw->inner);
+        if (gw->outer >= 0)
+            close(gw->outer);
+        return -1;
+    }
+
+    nxt_tunnel_init(&gw->t);
+    nxt_tunnel_sa_init(&gw->out, spi_out, key, (uint16) (key_len * 8));
+    nxt_tunnel_sa_init(&gw->in, spi_in, key, (uint16) (key_len * 8));
+    nxt_tunnel_add_sa(&gw->t, &gw->in);
+
+    return 0;
+}
+
+static void nxttunnel_gw_free(nxttunnel_gw *gw)
+{
+    close(gw->inner);
+    close(gw->outer);
+    free(gw->bufs);
+    nxt_tunnel_sa_wipe(&gw->out);
+    nxt_tunnel_sa_wipe(&gw->in);
+}
+
+/* Address a socket is bound to */
+static void local_addr(int fd, nxttunnel_addr *addr)
+{
+    addr->len = sizeof(addr->ss);
+    getsockname(fd, (struct sockaddr *) &addr->ss, &addr->len);
+}
+
+/* Benchmark sink, counts the datagrams delivered by the second gateway */
+typedef struct {
+    int fd;
+    unsigned long received;
+    pthread_mutex_t *lock;
+    int *stop;
+} nxttunnel_sink;
+
+static void *nxttunnel_sink_run(void *arg)
+{
+    nxttunnel_sink *sink = (nxttunnel_sink *) arg;
+    nxttunnel_msg msgs[NXTTUNNEL_BATCH];
+    struct iovec iov[NXTTUNNEL_BATCH];
+    struct pollfd pfd;
+    uint8 *buf;
+    int stop = 0;
+    int n, i;
+
+    buf = (uint8 *) malloc(NXTTUNNEL_BATCH * NXTTUNNEL_BUF_SIZE);
+    if (buf == NULL)
+        return NULL;
+
+    pfd.fd = sink->fd;
+    pfd.events = POLLIN;
+
+    while (!stop) {
+        n = 0;
+        if (poll(&pfd, 1, 100) > 0) {
+            for (i = 0; i < NXTTUNNEL_BATCH; i++) {
+                iov[i].iov_base = buf + i * NXTTUNNEL_BUF_SIZE;
+                iov[i].iov_len = NXTTUNNEL_BUF_SIZE;
+                memset(&msgs[i], 0, sizeof(msgs[i]));
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            n = nxttunnel_recv(sink->fd, msgs, NXTTUNNEL_BATCH);
+        }
+
+        pthread_mutex_lock(sink->lock);
+        if (n > 0)
+            sink->received += (unsigned long) n;
+        stop = *sink->stop;
+        pthread_mutex_unlock(sink->lock);
+    }
+
+    free(buf);
+
+    return NULL;
+}
+
+static unsigned long sink_received(nxttunnel_sink *sink)
+{
+    unsigned long n;
+
+    pthread_mutex_lock(sink->lock);
+    n = sink->received;
+    pthread_mutex_unlock(sink->lock);
+
+    return n;
+}
+
+/*
+ * Loopback benchmark: source -> gateway a -> gateway b -> sink. The
+ * source keeps at most NXTTUNNEL_INFLIGHT datagrams in flight, and
+ * writes off the ones still missing after NXTTUNNEL_IDLE seconds
+ * without progress as lost.
+ */
+static int nxttunnel_bench(const uint8 *key, int key_len,
+                           unsigned long count, size_t size)
+{
+    static nxttunnel_gw a, b;
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_t ta, tb, ts;
+    nxttunnel_msg msgs[NXTTUNNEL_BATCH];
+    struct iovec iov;
+    struct timespec pause = {0, 20000};
+    nxttunnel_addr any, entry, sink_addr;
+    nxttunnel_sink sink;
+    unsigned long sent, got, last, lost;
+    double t0, t1, idle;
+    uint8 *payload;
+    int src, stop = 0;
+    int n, i;
+
+    if (parse_addr("127.0.0.1:0", &any) != 0)
+        return -1;
+
+    payload = (uint8 *) calloc(1, size > 0 ? size : 1);
+    if (payload == NULL)
+        return -1;
+    if (nxttunnel_gw_init(&a, key, key_len, 1, 2, &any, &any) != 0) {
+        free(payload);
+        return -1;
+    }
+    if (nxttunnel_gw_init(&b, key, key_len, 2, 1, &any, &any) != 0) {
+        nxttunnel_gw_free(&a);
+        free(payload);
+        return -1;
+    }
+    src = open_socket(&any);
+    sink.fd = open_socket(&any);
+    if (src < 0 || sink.fd < 0) {
+        nxttunnel_gw_free(&a);
+        nxttunnel_gw_free(&b);
+        free(payload);
+        return -1;
+    }
+
+    local_addr(b.outer, &a.peer);
+    local_addr(a.outer, &b.peer);
+    local_addr(sink.fd, &sink_addr);
+    a.deliver = b.deliver = sink_addr;
+    a.lock = b.lock = sink.lock = &lock;
+    a.stop = b.stop = sink.stop = &stop;
+    sink.received = 0;
+    local_addr(a.inner, &entry);
+
+    pthread_create(&ta, NULL, nxttunnel_run, &a);
+    pthread_create(&tb, NULL, nxttunnel_run, &b);
+    pthread_create(&ts, NULL, nxttunnel_sink_run, &sink);
+
+    iov.iov_base = payload;
+    iov.iov_len = size;
+    for (i = 0; i < NXTTUNNEL_BATCH; i++) {
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov;
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &entry.ss;
+        msgs[i].msg_hdr.msg_namelen = entry.len;
+    }
+
+    t0 = now();
+    idle = t0;
+    sent = last = lost = 0;
+    while (sent < count) {
+        got = sink_received(&sink);
+        if (got != last) {
+            last = got;
+            idle = now();
+        }
+        n = (int) (NXTTUNNEL_INFLIGHT - (sent - got - lost));
+        if (n <= 0) {
+            if (now() - idle > NXTTUNNEL_IDLE) {
+                lost = sent - got;
+                idle = now();
+            }
+            nanosleep(&pause, NULL);
+            continue;
+        }
+        if (n > NXTTUNNEL_BATCH)
+            n = NXTTUNNEL_BATCH;
+        if ((unsigned long) n > count - sent)
+            n = (int) (count - sent);
+        nxttunnel_send_all(src, msgs, n);
+        sent += (unsigned long) n;
+    }
+
+    /* Waits for the stragglers */
+    while ((got = sink_received(&sink)) < count) {
+        if (got != last) {
+            last = got;
+            idle = now();
+        } else if (now() - idle > NXTTUNNEL_IDLE) {
+            break;
+        }
+        nanosleep(&pause, NULL);
+    }
+    t1 = now();
+
+    pthread_mutex_lock(&lock);
+    stop = 1;
+    pthread_mutex_unlock(&lock);
+    pthread_join(ta, NULL);
+    pthread_join(tb, NULL);
+    pthread_join(ts, NULL);
+
+    fprintf(stderr, "%lu datagrams of %lu bytes in %.3f s, %.0f datagrams/s, "
+            "%.1f MB/s, %lu lost\n",
+            got, (unsigned long) size, t1 - t0,
+            t1 > t0 ? (double) got / (t1 - t0) : 0.0,
+            t1 > t0 ? (double) got * (double) size / (t1 - t0) / 1e6 : 0.0,
+            count - got);
+
+    close(src);
+    close(sink.fd);
+    nxttunnel_gw_free(&a);
+    nxttunnel_gw_free(&b);
+    free(payload);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static nxttunnel_gw gw;
+    nxttunnel_addr inner, outer, deliver, peer;
+    unsigned long count = 200000;
+    unsigned long spi_out = 0, spi_in = 0;
+    size_t size = 200;
+    uint8 key[32];
+    char *end;
+    int key_len = -1;
+    int bench = 0;
+    int have = 0;
+    int c;
+
+    if (argv[0] != NULL && *argv[0] != '\0')
+        prog = argv[0];
+
+    while ((c = getopt(argc, argv, "Bn:z:k:K:s:i:d:o:p:")) != -1) {
+        switch (c) {
+        case 'B':
+            bench = 1;
+            break;
+        case 'n':
+            count = strtoul(optarg, &end, 10);
+            if (*end != '\0' || count == 0)
+                usage();
+            break;
+        case 'z':
+            size = (size_t) strtoul(optarg, &end, 10);
+            if (*end != '\0' || size > NXTTUNNEL_MAX_PAYLOAD)
+                usage();
+            break;
+        case 'k':
+            key_len = nxt_hex_decode(optarg, key, sizeof(key));
+            break;
+        case 'K':
+            key_len = nxt_read_key_file(optarg, key, sizeof(key));
+            break;
+        case 's':
+            spi_out = strtoul(optarg, &end, 0);
+            if (*end != ':')
+                usage();
+            spi_in = strtoul(end + 1, &end, 0);
+            if (*end != '\0' || spi_out == spi_in)
+                usage();
+            have |= 1;
+            break;
+        case 'i':
+            if (parse_addr(optarg, &inner) != 0)
+                usage();
+            have |= 2;
+            break;
+        case 'd':
+            if (parse_addr(optarg, &deliver) != 0)
+                usage();
+            have |= 4;
+            break;
+        case 'o':
+            if (parse_addr(optarg, &outer) != 0)
+                usage();
+            have |= 8;
+            break;
+        case 'p':
+            if (parse_addr(optarg, &peer) != 0)
+                usage();
+            have |= 16;
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (key_len < 0 || optind != argc || (!bench && have != 31))
+        usage();
+
+    if (bench) {
+        c = nxttunnel_bench(key, key_len, count, size);
+        nxt_wipe(key, sizeof(key));
+        if (c != 0) {
+            fprintf(stderr, "%s: %s\n", prog, strerror(errno));
+            return 1;
+        }
+        return 0;
+    }
+
+    if (nxttunnel_gw_init(&gw, key, key_len, (uint32) spi_out,
+                          (uint32) spi_in, &inner, &outer) != 0) {
+        fprintf(stderr, "%s: %s\n", prog, strerror(errno));
+        nxt_wipe(key, sizeof(key));
+        return 1;
+    }
+    gw.deliver = deliver;
+    gw.peer = peer;
+    nxt_wipe(key, sizeof(key));
+
+    nxttunnel_run(&gw);
+    nxttunnel_gw_free(&gw);
+
+    return 0;
+}
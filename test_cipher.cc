@@ -0,0 +1,124 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "nxt64.h"
+#include "nxt128.h"
+#include "nxt_cipher.hpp"
+
+static void fail_if(bool cond)
+{
+    if (cond) {
+        std::fprintf(stderr, "Test failed\n");
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+/* Encryption and decryption of 1 to 7 blocks, in place and not */
+template<class Cipher>
+static void round_trip(const Cipher &c, const uint8 *msg)
+{
+    uint8 ct[7 * Cipher::block_size], pt[7 * Cipher::block_size];
+    std::size_t n, len;
+
+    for (n = 1; n <= 7; n++) {
+        len = n * Cipher::block_size;
+        c.encrypt(std::span<const uint8>(msg, len), std::span<uint8>(ct, len));
+        fail_if(std::memcmp(ct, msg, len) == 0);
+        std::memcpy(pt, ct, len);
+        c.decrypt(std::span<const uint8>(pt, len), std::span<uint8>(pt, len));
+        fail_if(std::memcmp(pt, msg, len) != 0);
+    }
+
+    c.encrypt_block(msg, ct);
+    c.decrypt_block(ct, pt);
+    fail_if(std::memcmp(ct, msg, Cipher::block_size) == 0
+            || std::memcmp(pt, msg, Cipher::block_size) != 0);
+}
+
+int main()
+{
+    uint8 key[32], msg[7 * 16], ref[7 * 16], out[7 * 16];
+    nxt64_ctx c64;
+    nxt128_ctx c128;
+    std::size_t i, len;
+
+    for (i = 0; i < sizeof(key); i++) {
+        key[i] = static_cast<uint8>(i * 37 + 1);
+    }
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = static_cast<uint8>(i * 11 + 5);
+    }
+
+    /*
+     * Same results as the C functions for every key length, with the
+     * number of rounds they are built with
+     */
+    for (len = 0; len <= sizeof(key); len++) {
+        std::span<const uint8> k(key, len);
+        nxt::cipher<nxt::block64, NXT64_TOTAL_ROUNDS> n64(k);
+        nxt::cipher<nxt::block128, NXT128_TOTAL_ROUNDS> n128(k);
+
+        nxt64_ks(&c64, key, static_cast<uint16>(8 * len));
+        nxt64_encrypt_blocks(&c64, msg, ref, 7 * 2);
+        n64.encrypt(std::span<const uint8>(msg, 7 * 16), out);
+        fail_if(std::memcmp(ref, out, 7 * 16) != 0);
+        n64.decrypt(out, out);
+        fail_if(std::memcmp(msg, out, 7 * 16) != 0);
+
+        nxt128_ks(&c128, key, static_cast<uint16>(8 * len));
+        nxt128_encrypt_blocks(&c128, msg, ref, 7);
+        n128.encrypt(std::span<const uint8>(msg, 7 * 16), out);
+        fail_if(std::memcmp(ref, out, 7 * 16) != 0);
+        n128.decrypt_block(out + 16, out + 16);
+        fail_if(std::memcmp(msg + 16, out + 16, 16) != 0);
+
+        round_trip(n64, msg);
+        round_trip(n128, msg);
+    }
+
+    /* Other round counts */
+    round_trip(nxt::cipher<nxt::block64, 2>(std::span<const uint8>(key, 5)),
+               msg);
+    round_trip(nxt::cipher<nxt::block64, 12>(std::span<const uint8>(key, 24)),
+               msg);
+    round_trip(nxt::cipher<nxt::block128, 12>(std::span<const uint8>(key, 16)),
+               msg);
+    round_trip(nxt::cipher<nxt::block128, 31>(std::span<const uint8>(key, 32)),
+               msg);
+
+    std::printf("Template cipher tests passed\n");
+
+    return EXIT_SUCCESS;
+}
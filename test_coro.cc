@@ -0,0 +1,153 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "nxt128.h"
+#include "nxt_modes.h"
+#include "nxt_coro.hpp"
+
+static void fail_if(bool cond)
+{
+    if (cond) {
+        std::fprintf(stderr, "Test failed\n");
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+/* Event loop executor: the posted coroutines run on the next turn */
+struct loop_executor {
+    std::vector<std::coroutine_handle<>> ready;
+
+    void post(std::coroutine_handle<> h)
+    {
+        ready.push_back(h);
+    }
+
+    void run_ready()
+    {
+        std::vector<std::coroutine_handle<>> now;
+
+        now.swap(ready);
+        for (std::coroutine_handle<> h : now) {
+            h.resume();
+        }
+    }
+};
+
+static nxt::task<int> seal(nxt::crypto_executor &crypto, nxt128_ctx &ctx,
+                           std::span<uint8> data, nxt::block &ctr,
+                           nxt::block &tag)
+{
+    co_await nxt::encrypt_async(crypto, ctx, ctr, data);
+    co_await nxt::mac_async(crypto, ctx, data, tag);
+    co_return static_cast<int>(data.size());
+}
+
+static nxt::task<> session(nxt::crypto_executor &crypto, nxt128_ctx &ctx,
+                           int id, int *checked)
+{
+    uint8 msg[300], buf[300], ref[300];
+    nxt::block ctr, ctr2, iv, iv2, tag;
+    std::size_t len;
+    int i;
+
+    for (i = 0; i < 20; i++) {
+        len = static_cast<std::size_t>((id * 31 + i * 17) % 300);
+        std::memset(msg, id + i, sizeof(msg));
+        std::memcpy(buf, msg, len);
+
+        ctr.fill(static_cast<uint8>(i));
+        ctr2 = ctr;
+        nxt128_ctr_crypt(&ctx, ctr2.data(), msg, ref, len);
+        fail_if(co_await seal(crypto, ctx, std::span<uint8>(buf, len), ctr,
+                              tag) != static_cast<int>(len));
+        fail_if(std::memcmp(ref, buf, len) != 0 || ctr != ctr2);
+
+        len &= ~static_cast<std::size_t>(15);
+        iv.fill(static_cast<uint8>(id));
+        iv2 = iv;
+        co_await nxt::cbc_encrypt_async(crypto, ctx, iv,
+                                        std::span<uint8>(buf, len));
+        co_await nxt::cbc_decrypt_async(crypto, ctx, iv2,
+                                        std::span<uint8>(buf, len));
+        fail_if(std::memcmp(ref, buf, len) != 0 || iv != iv2);
+
+        (*checked)++;
+    }
+}
+
+int main()
+{
+    static const uint8 key[16] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66,
+                                  0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd,
+                                  0xee, 0xff};
+    nxt128_ctx ctx;
+    nxt_async *as;
+    loop_executor loop;
+    std::vector<nxt::task<>> sessions;
+    int checked = 0;
+    int i;
+
+    nxt128_ks(&ctx, key, 128);
+    as = nxt_async_new(2);
+    fail_if(as == nullptr);
+
+    {
+        /* Depth 4 with 16 sessions also exercises the waiting list */
+        nxt::crypto_executor crypto(as, loop, 4);
+
+        for (i = 0; i < 16; i++) {
+            sessions.push_back(session(crypto, ctx, i, &checked));
+            sessions.back().start();
+        }
+
+        while (crypto.outstanding() > 0 || !loop.ready.empty()) {
+            crypto.poll();
+            loop.run_ready();
+        }
+
+        for (nxt::task<> &t : sessions) {
+            fail_if(!t.done());
+            t.result();
+        }
+    }
+
+    nxt_async_free(as);
+
+    fail_if(checked != 16 * 20);
+    std::printf("Coroutine tests passed\n");
+
+    return 0;
+}
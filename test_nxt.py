@@ -0,0 +1,210 @@
+# IDEA NXT encryption algorithm implementation
+# Issue date: 02/25/2006
+#
+# Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+# 3. Neither the name of the project nor the names of its contributors
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+
+"""Tests of the nxt extension module: python3 test_nxt.py"""
+
+import array
+import threading
+import unittest
+
+import nxt
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+KEY = bytes.fromhex("00112233445566778899aabbccddeeff"
+                    "ffeeddccbbaa99887766554433221100")
+PT = bytes.fromhex("0123456789abcdeffedcba9876543210")
+
+VECTORS64 = ["200e1f5847d8a2ce", "b85d6b766dce952e",
+             "2741d7963406daca", "8a4edfbc36bef7f6"]
+VECTORS128 = ["1eecbc7deb66e7dae1a7876d90c0b239",
+              "849e0f0682f50cd588ae073006a10bee",
+              "5934214ecba2d5fd58c261b28261b1bc",
+              "45ccb1030f67b768247f530266bc4996"]
+
+
+def xor(a, b):
+    return bytes(x ^ y for x, y in zip(a, b))
+
+
+def ref_ctr(cipher, iv, data):
+    b = cipher.block_size
+    ctr = int.from_bytes(iv, "big")
+    out = bytearray()
+    for i in range(0, len(data), b):
+        ks = cipher.ecb_encrypt(ctr.to_bytes(b, "big"))
+        out += xor(data[i:i + b], ks)
+        ctr = (ctr + 1) % (1 << (8 * b))
+    return bytes(out)
+
+
+def ref_cbc(cipher, iv, data):
+    b = cipher.block_size
+    out = bytearray()
+    for i in range(0, len(data), b):
+        iv = cipher.ecb_encrypt(xor(data[i:i + b], iv))
+        out += iv
+    return bytes(out)
+
+
+class CipherTest(unittest.TestCase):
+
+    def ciphers(self):
+        for key_len in (8, 16, 32):
+            yield nxt.NXT64(KEY[:key_len])
+            yield nxt.NXT128(KEY[:key_len])
+
+    def test_vectors(self):
+        for i, key_len in enumerate((8, 16, 24, 32)):
+            c = nxt.NXT64(KEY[:key_len])
+            self.assertEqual(c.ecb_encrypt(PT[:8]).hex(), VECTORS64[i])
+            self.assertEqual(c.ecb_decrypt(bytes.fromhex(VECTORS64[i])),
+                             PT[:8])
+            c = nxt.NXT128(key=KEY[:key_len])
+            self.assertEqual(c.ecb_encrypt(PT).hex(), VECTORS128[i])
+            self.assertEqual(c.block_size, 16)
+            self.assertEqual(c.key_size, key_len)
+
+    def test_modes(self):
+        data = bytes((i * 31 + 7) & 0xff for i in range(8000))
+        for c in self.ciphers():
+            b = c.block_size
+            iv = bytes(range(0xf0, 0xf0 + b))
+            iv = iv[:-1] + b"\xfe"
+            self.assertEqual(c.ctr(iv, data[:999]), ref_ctr(c, iv, data[:999]))
+            self.assertEqual(c.ctr(iv, data), ref_ctr(c, iv, data))
+            self.assertEqual(c.cbc_encrypt(iv, data), ref_cbc(c, iv, data))
+            self.assertEqual(c.cbc_decrypt(iv, c.cbc_encrypt(iv, data)),
+                             data)
+            self.assertEqual(c.ecb_decrypt(c.ecb_encrypt(data)), data)
+
+    def test_buffers(self):
+        c = nxt.NXT64(KEY[:16])
+        ids = array.array("Q", range(100000))
+        ref = c.ecb_encrypt(ids)
+
+        # Other buffer types, the output written in place
+        self.assertEqual(c.ecb_encrypt(memoryview(ids)), ref)
+        buf = bytearray(ids.tobytes())
+        self.assertIs(c.ecb_encrypt(buf, out=buf), buf)
+        self.assertEqual(bytes(buf), ref)
+        c.ecb_encrypt(ids, out=ids)
+        self.assertEqual(ids.tobytes(), ref)
+        c.ecb_decrypt(ids, out=memoryview(ids).cast("B"))
+        self.assertEqual(list(ids), list(range(100000)))
+
+        out = bytearray(len(ref) + 8)
+        c.ecb_encrypt(ids, out=out)
+        self.assertEqual(bytes(out[:len(ref)]), ref)
+
+    def test_errors(self):
+        c = nxt.NXT128(KEY[:16])
+        buf = bytearray(64)
+        self.assertRaises(ValueError, nxt.NXT64, bytes(33))
+        self.assertRaises(ValueError, c.ecb_encrypt, bytes(15))
+        self.assertRaises(ValueError, c.cbc_encrypt, bytes(8), bytes(16))
+        self.assertRaises(ValueError, c.ctr, bytes(16), bytes(64),
+                          out=bytearray(63))
+        self.assertRaises(ValueError, c.ctr, bytes(16),
+                          memoryview(buf)[:32], out=memoryview(buf)[16:])
+        self.assertRaises(BufferError, c.ctr, bytes(16), bytes(16),
+                          out=bytes(16))
+        self.assertRaises(TypeError, c.ecb_encrypt, "text")
+        self.assertFalse(hasattr(nxt.NXT64(b""), "eax_encrypt"))
+
+    def test_eax(self):
+        c = nxt.NXT128(KEY)
+        data = bytes(range(256)) * 40
+        nonce = b"0123456789abc"
+        for n in (0, 1, 16, 1000, len(data)):
+            ct, tag = c.eax_encrypt(nonce, data[:n], b"header")
+            self.assertEqual(len(ct), n)
+            self.assertEqual(len(tag), 16)
+            self.assertEqual(c.eax_decrypt(nonce, ct, tag, b"header"),
+                             data[:n])
+            self.assertRaises(nxt.AuthenticationError, c.eax_decrypt,
+                              nonce, ct, tag, b"Header")
+            out = bytearray(ct)
+            bad = xor(tag, b"\x01")
+            self.assertRaises(nxt.AuthenticationError, c.eax_decrypt,
+                              nonce, out, bad + tag[1:], b"header", out=out)
+            self.assertEqual(out, bytes(n))
+
+        # In place, without header
+        buf = bytearray(data)
+        ct, tag = c.eax_encrypt(nonce, buf, out=buf)
+        self.assertIs(ct, buf)
+        c.eax_decrypt(nonce, buf, tag, out=buf)
+        self.assertEqual(buf, data)
+        self.assertRaises(ValueError, c.eax_decrypt, nonce, ct, tag[:8])
+
+    @unittest.skipIf(numpy is None, "numpy is not installed")
+    def test_numpy(self):
+        c = nxt.NXT64(KEY[:16])
+        ids = numpy.arange(1 << 16, dtype=numpy.uint64)
+        enc = numpy.empty_like(ids)
+        c.ecb_encrypt(ids, out=enc)
+        self.assertEqual(enc.tobytes(), c.ecb_encrypt(ids.tobytes()))
+        c.ecb_decrypt(enc, out=enc)
+        self.assertTrue((enc == ids).all())
+        self.assertRaises((BufferError, ValueError), c.ecb_encrypt,
+                          ids[::2])
+
+    def test_threads(self):
+        c = nxt.NXT128(KEY[:16])
+        data = bytes(range(256)) * (1 << 14)
+        ref = c.ctr(bytes(16), data)
+        results = []
+        ticks = []
+        done = threading.Event()
+
+        def work():
+            for _ in range(8):
+                results.append(c.ctr(bytes(16), data) == ref)
+            done.set()
+
+        threads = [threading.Thread(target=work) for _ in range(4)]
+        for t in threads:
+            t.start()
+        # Counts while the workers run in the module without the GIL
+        while not done.is_set():
+            ticks.append(1)
+        for t in threads:
+            t.join()
+
+        self.assertEqual(results, [True] * 32)
+        self.assertGreater(len(ticks), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,109 @@
+# IDEA NXT encryption algorithm implementation
+# Issue date: 02/25/2006
+#
+# Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+# 3. Neither the name of the project nor the names of its contributors
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+
+# Round trips through the nxtcrypt binary: CTR on files with both I/O
+# back ends, the filter mode on the standard input and output, and the
+# container modes -c, -x and -w against a plain copy of the data.
+#
+#     sh test_nxtcrypt.sh [nxtcrypt]
+
+set -e
+
+NXTCRYPT=${1:-./nxtcrypt}
+KEY=000102030405060708090a0b0c0d0e0f
+IV=f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+fail()
+{
+    echo "nxtcrypt test failed: $1" >&2
+    exit 1
+}
+
+# The key of -k as a binary key file
+printf '\000\001\002\003\004\005\006\007\010\011\012\013\014\015\016\017' \
+    > "$TMP/key"
+
+# Sizes around the block, buffer and chunk boundaries
+for size in 0 1 15 4096 65537 1000000 3000017; do
+    head -c $size /dev/urandom > "$TMP/plain"
+
+    "$NXTCRYPT" -q -k $KEY -i $IV "$TMP/plain" "$TMP/ct"
+    if [ $size -gt 0 ] && cmp -s "$TMP/plain" "$TMP/ct"; then
+        fail "no encryption, $size bytes"
+    fi
+
+    "$NXTCRYPT" -q -T -b 64k -n 2 -t 2 -K "$TMP/key" -i $IV \
+        "$TMP/ct" "$TMP/dec"
+    cmp -s "$TMP/plain" "$TMP/dec" || fail "file round trip, $size bytes"
+
+    "$NXTCRYPT" -q -k $KEY -i $IV < "$TMP/plain" > "$TMP/ct2"
+    cmp -s "$TMP/ct" "$TMP/ct2" || fail "filter on files, $size bytes"
+
+    cat "$TMP/plain" | "$NXTCRYPT" -q -k $KEY -i $IV | cat > "$TMP/ct2"
+    cmp -s "$TMP/ct" "$TMP/ct2" || fail "filter on pipes, $size bytes"
+done
+
+# Container: store, extract all and a range, overwrite and extend
+head -c 300000 /dev/urandom > "$TMP/plain"
+"$NXTCRYPT" -c -q -s 4096 -k $KEY "$TMP/plain" "$TMP/box"
+"$NXTCRYPT" -x -q -k $KEY "$TMP/box" "$TMP/out"
+cmp -s "$TMP/plain" "$TMP/out" || fail "container round trip"
+
+"$NXTCRYPT" -x -q -r 5000:10000 -K "$TMP/key" "$TMP/box" > "$TMP/out"
+tail -c +5001 "$TMP/plain" | head -c 10000 > "$TMP/ref"
+cmp -s "$TMP/ref" "$TMP/out" || fail "container range"
+
+cp "$TMP/plain" "$TMP/model"
+head -c 9000 /dev/urandom > "$TMP/patch"
+for off in 7000 299000 310000; do
+    "$NXTCRYPT" -w $off -q -k $KEY "$TMP/box" < "$TMP/patch"
+    dd if="$TMP/patch" of="$TMP/model" bs=$off seek=1 conv=notrunc \
+        2>/dev/null
+done
+"$NXTCRYPT" -x -q -k $KEY "$TMP/box" "$TMP/out"
+cmp -s "$TMP/model" "$TMP/out" || fail "container writes"
+
+if "$NXTCRYPT" -x -q -k ${KEY}00 "$TMP/box" "$TMP/out" 2>/dev/null; then
+    fail "container opened with a wrong key"
+fi
+
+# Sizes that overflow are refused before the output is created
+for b in 18014398509481985k 18446744073709551615 k; do
+    rm -f "$TMP/ct"
+    if "$NXTCRYPT" -q -b $b -k $KEY -i $IV "$TMP/plain" "$TMP/ct" \
+        2>/dev/null; then
+        fail "buffer size $b accepted"
+    fi
+    [ ! -e "$TMP/ct" ] || fail "output left by buffer size $b"
+done
+
+echo "nxtcrypt tests passed"
@@ -0,0 +1,395 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <openssl/provider.h>
+
+#include "nxt64.h"
+#include "nxt128.h"
+#include "nxt_modes.h"
+#include "nxt_provider.h"
+
+#define TEST_LEN 1000
+
+static OSSL_LIB_CTX *libctx;
+
+static unsigned char key[32];
+static unsigned char iv[16];
+static unsigned char msg[TEST_LEN];
+
+static void fail_if(int cond)
+{
+    if (cond) {
+        fprintf(stderr, "Test failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Reference encryption of one block */
+static void ref_block(int block, const unsigned char *k, int bits,
+                      const unsigned char *in, unsigned char *out)
+{
+    nxt64_ctx c64;
+    nxt128_ctx c128;
+
+    if (block == 8) {
+        nxt64_ks(&c64, k, (uint16) bits);
+        nxt64_encrypt(&c64, in, out);
+    } else {
+        nxt128_ks(&c128, k, (uint16) bits);
+        nxt128_encrypt(&c128, in, out);
+    }
+}
+
+/* Reference ECB, CBC (PKCS#7 padded) and CTR encryptions */
+static size_t ref_encrypt(int block, int bits, const char *mode,
+                          const unsigned char *in, size_t len,
+                          unsigned char *out)
+{
+    unsigned char x[16], ctr[16];
+    size_t i, j, total;
+
+    if (strcmp(mode, "CTR") == 0) {
+        memcpy(ctr, iv, block);
+        for (i = 0; i < len; i += block) {
+            ref_block(block, key, bits, ctr, x);
+            for (j = 0; j < (size_t) block && i + j < len; j++) {
+                out[i + j] = in[i + j] ^ x[j];
+            }
+            for (j = block; j > 0 && ++ctr[j - 1] == 0; j--)
+                ;
+        }
+        return len;
+    }
+
+    total = len - len % block + block;
+    memcpy(x, iv, block);
+    for (i = 0; i < total; i += block) {
+        for (j = 0; j < (size_t) block; j++) {
+            if (strcmp(mode, "ECB") == 0)
+                x[j] = 0;
+            x[j] ^= (i + j < len) ? in[i + j]
+                                  : (unsigned char) (total - len);
+        }
+        ref_block(block, key, bits, x, x);
+        memcpy(out + i, x, block);
+    }
+
+    return total;
+}
+
+/* Feeds the input in uneven pieces */
+static size_t evp_run(EVP_CIPHER_CTX *ctx, const unsigned char *in,
+                      size_t len, unsigned char *out)
+{
+    static const size_t steps[] = { 1, 7, 13, 64, 3, 100, 16, 9 };
+    size_t total, n;
+    int outl;
+    int i;
+
+    total = 0;
+    for (i = 0; len > 0; i = (i + 1) % 8) {
+        n = (steps[i] < len) ? steps[i] : len;
+        fail_if(!EVP_CipherUpdate(ctx, out + total, &outl, in, (int) n));
+        total += (size_t) outl;
+        in += n;
+        len -= n;
+    }
+    fail_if(!EVP_CipherFinal_ex(ctx, out + total, &outl));
+
+    return total + (size_t) outl;
+}
+
+static void provider_mode_test(int block, int bits, const char *mode)
+{
+    unsigned char ref[TEST_LEN + 16], out[TEST_LEN + 16];
+    unsigned char back[TEST_LEN + 16];
+    EVP_CIPHER_CTX *ctx;
+    EVP_CIPHER *cipher;
+    char name[32];
+    size_t ref_len, len;
+    int outl;
+
+    sprintf(name, "NXT%d-%d-%s", block * 8, bits, mode);
+    cipher = EVP_CIPHER_fetch(libctx, name, NULL);
+    fail_if(cipher == NULL);
+    fail_if(EVP_CIPHER_get_key_length(cipher) != bits / 8);
+    fail_if(EVP_CIPHER_get_block_size(cipher)
+            != (strcmp(mode, "CTR") == 0 ? 1 : block));
+
+    ctx = EVP_CIPHER_CTX_new();
+    fail_if(ctx == NULL);
+
+    ref_len = ref_encrypt(block, bits, mode, msg, TEST_LEN, ref);
+
+    fail_if(!EVP_EncryptInit_ex2(ctx, cipher, key, iv, NULL));
+    len = evp_run(ctx, msg, TEST_LEN, out);
+    fail_if(len != ref_len || memcmp(out, ref, len));
+
+    fail_if(!EVP_DecryptInit_ex2(ctx, cipher, key, iv, NULL));
+    fail_if(evp_run(ctx, out, len, back) != TEST_LEN);
+    fail_if(memcmp(back, msg, TEST_LEN));
+
+    /* In place, in one call, without padding */
+    memcpy(out, msg, TEST_LEN);
+    fail_if(!EVP_EncryptInit_ex2(ctx, cipher, key, iv, NULL));
+    fail_if(!EVP_CIPHER_CTX_set_padding(ctx, 0));
+    fail_if(!EVP_EncryptUpdate(ctx, out, &outl, out, 16 * 62));
+    fail_if(outl != 16 * 62 || memcmp(out, ref, outl));
+    fail_if(!EVP_EncryptFinal_ex(ctx, out + outl, &outl) || outl != 0);
+
+    if (strcmp(mode, "CTR") != 0) {
+        /* A partial block is an error without padding */
+        fail_if(!EVP_EncryptInit_ex2(ctx, cipher, key, iv, NULL));
+        fail_if(!EVP_CIPHER_CTX_set_padding(ctx, 0));
+        fail_if(!EVP_EncryptUpdate(ctx, out, &outl, msg, 5));
+        fail_if(EVP_EncryptFinal_ex(ctx, out + outl, &outl));
+
+        /* Bad padding */
+        fail_if(!EVP_EncryptInit_ex2(ctx, cipher, key, iv, NULL));
+        fail_if(!EVP_CIPHER_CTX_set_padding(ctx, 0));
+        memset(back, 0, block);
+        fail_if(!EVP_EncryptUpdate(ctx, out, &outl, back, block));
+        fail_if(!EVP_DecryptInit_ex2(ctx, cipher, key, iv, NULL));
+        fail_if(!EVP_CIPHER_CTX_set_padding(ctx, 1));
+        fail_if(!EVP_DecryptUpdate(ctx, back, &outl, out, block));
+        fail_if(outl != 0);
+        fail_if(EVP_DecryptFinal_ex(ctx, back, &outl));
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+    EVP_CIPHER_free(cipher);
+}
+
+static size_t eax_seal(EVP_CIPHER *cipher, const unsigned char *nonce,
+                       int nonce_len, const unsigned char *hdr, int hdr_len,
+                       const unsigned char *in, size_t len,
+                       unsigned char *out, unsigned char *tag, int tag_len)
+{
+    EVP_CIPHER_CTX *ctx;
+    size_t total;
+    int outl;
+
+    ctx = EVP_CIPHER_CTX_new();
+    fail_if(ctx == NULL);
+    fail_if(!EVP_EncryptInit_ex2(ctx, cipher, NULL, NULL, NULL));
+    fail_if(!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, nonce_len,
+                                 NULL));
+    fail_if(!EVP_EncryptInit_ex2(ctx, NULL, key, nonce, NULL));
+
+    /* Header in two pieces */
+    fail_if(!EVP_EncryptUpdate(ctx, NULL, &outl, hdr, hdr_len / 2));
+    fail_if(!EVP_EncryptUpdate(ctx, NULL, &outl, hdr + hdr_len / 2,
+                               hdr_len - hdr_len / 2));
+
+    total = (len > 0) ? evp_run(ctx, in, len, out) : 0;
+    if (len == 0)
+        fail_if(!EVP_EncryptFinal_ex(ctx, out, &outl) || outl != 0);
+
+    fail_if(!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, tag_len, tag));
+    EVP_CIPHER_CTX_free(ctx);
+
+    return total;
+}
+
+static int eax_open(EVP_CIPHER *cipher, const unsigned char *nonce,
+                    int nonce_len, const unsigned char *hdr, int hdr_len,
+                    const unsigned char *in, size_t len, unsigned char *out,
+                    unsigned char *tag, int tag_len)
+{
+    EVP_CIPHER_CTX *ctx;
+    int outl, ok;
+
+    ctx = EVP_CIPHER_CTX_new();
+    fail_if(ctx == NULL);
+    fail_if(!EVP_DecryptInit_ex2(ctx, cipher, NULL, NULL, NULL));
+    fail_if(!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, nonce_len,
+                                 NULL));
+    fail_if(!EVP_DecryptInit_ex2(ctx, NULL, key, nonce, NULL));
+    fail_if(!EVP_DecryptUpdate(ctx, NULL, &outl, hdr, hdr_len));
+    if (len > 0) {
+        fail_if(!EVP_DecryptUpdate(ctx, out, &outl, in, (int) len));
+        fail_if((size_t) outl != len);
+    }
+    fail_if(!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, tag_len, tag));
+    ok = EVP_DecryptFinal_ex(ctx, out + len, &outl);
+    EVP_CIPHER_CTX_free(ctx);
+
+    return ok;
+}
+
+static void provider_eax_test(int block, int bits)
+{
+    unsigned char out[TEST_LEN], back[TEST_LEN], ref[TEST_LEN];
+    unsigned char tag[16], ref_tag[16];
+    unsigned char nonce[13];
+    unsigned char hdr[21];
+    nxt128_eax_ctx eax;
+    EVP_CIPHER *cipher;
+    char name[32];
+    size_t lens[4];
+    int i;
+
+    lens[0] = 0;
+    lens[1] = 1;
+    lens[2] = 16 * 8;
+    lens[3] = TEST_LEN;
+
+    for (i = 0; i < 13; i++) {
+        nonce[i] = (unsigned char) (0xa0 + i);
+    }
+    for (i = 0; i < 21; i++) {
+        hdr[i] = (unsigned char) (0x30 + i);
+    }
+
+    sprintf(name, "NXT%d-%d-EAX", block * 8, bits);
+    cipher = EVP_CIPHER_fetch(libctx, name, NULL);
+    fail_if(cipher == NULL);
+    fail_if(!(EVP_CIPHER_get_flags(cipher) & EVP_CIPH_FLAG_AEAD_CIPHER));
+
+    nxt128_eax_init(&eax, key, (uint16) bits);
+
+    for (i = 0; i < 4; i++) {
+        fail_if(eax_seal(cipher, nonce, 13, hdr, 21, msg, lens[i], out, tag,
+                         block) != lens[i]);
+
+        if (block == 16) {
+            nxt128_eax_encrypt(&eax, nonce, 13, hdr, 21, msg, ref, lens[i],
+                               ref_tag);
+            fail_if(memcmp(out, ref, lens[i]) || memcmp(tag, ref_tag, 16));
+        }
+
+        fail_if(!eax_open(cipher, nonce, 13, hdr, 21, out, lens[i], back,
+                          tag, block));
+        fail_if(memcmp(back, msg, lens[i]));
+
+        /* Truncated tag */
+        fail_if(!eax_open(cipher, nonce, 13, hdr, 21, out, lens[i], back,
+                          tag, 4));
+
+        tag[0] ^= 1;
+        fail_if(eax_open(cipher, nonce, 13, hdr, 21, out, lens[i], back,
+                         tag, block));
+        tag[0] ^= 1;
+        fail_if(eax_open(cipher, nonce, 13, hdr, 20, out, lens[i], back,
+                         tag, block));
+        fail_if(eax_open(cipher, nonce, 12, hdr, 21, out, lens[i], back,
+                         tag, block));
+    }
+
+    EVP_CIPHER_free(cipher);
+}
+
+/* A context copied in the middle of a message goes on independently */
+static void provider_dup_test(void)
+{
+    unsigned char a[TEST_LEN + 16], b[TEST_LEN + 16], ref[TEST_LEN + 16];
+    EVP_CIPHER_CTX *ctx, *copy;
+    EVP_CIPHER *cipher;
+    int la, lb, n;
+
+    cipher = EVP_CIPHER_fetch(libctx, "NXT64-CBC", NULL);
+    fail_if(cipher == NULL);
+    ctx = EVP_CIPHER_CTX_new();
+    copy = EVP_CIPHER_CTX_new();
+    fail_if(ctx == NULL || copy == NULL);
+
+    fail_if(!EVP_EncryptInit_ex2(ctx, cipher, key, iv, NULL));
+    fail_if(!EVP_EncryptUpdate(ctx, a, &la, msg, 333));
+    fail_if(!EVP_CIPHER_CTX_copy(copy, ctx));
+    memcpy(b, a, la);
+    lb = la;
+
+    fail_if(!EVP_EncryptUpdate(ctx, a + la, &n, msg + 333, TEST_LEN - 333));
+    la += n;
+    fail_if(!EVP_EncryptFinal_ex(ctx, a + la, &n));
+    la += n;
+    EVP_CIPHER_CTX_free(ctx);
+
+    fail_if(!EVP_EncryptUpdate(copy, b + lb, &n, msg + 333,
+                               TEST_LEN - 333));
+    lb += n;
+    fail_if(!EVP_EncryptFinal_ex(copy, b + lb, &n));
+    lb += n;
+    EVP_CIPHER_CTX_free(copy);
+
+    fail_if((size_t) la != ref_encrypt(8, 128, "CBC", msg, TEST_LEN, ref));
+    fail_if(la != lb || memcmp(a, ref, la) || memcmp(b, ref, lb));
+
+    EVP_CIPHER_free(cipher);
+}
+
+int main(void)
+{
+    static const char *modes[] = { "ECB", "CBC", "CTR" };
+    OSSL_PROVIDER *prov;
+    int block, bits, i;
+
+    for (i = 0; i < 32; i++) {
+        key[i] = (unsigned char) (i * 7 + 1);
+    }
+    for (i = 0; i < 16; i++) {
+        iv[i] = (unsigned char) (0xf0 + i);
+    }
+    iv[15] = 0xfe;
+    for (i = 0; i < TEST_LEN; i++) {
+        msg[i] = (unsigned char) (i * 31 + 5);
+    }
+
+    libctx = OSSL_LIB_CTX_new();
+    fail_if(libctx == NULL);
+    fail_if(!OSSL_PROVIDER_set_default_search_path(libctx, "."));
+    prov = OSSL_PROVIDER_load(libctx, NXT_PROVIDER_NAME);
+    fail_if(prov == NULL);
+
+    for (block = 8; block <= 16; block += 8) {
+        for (bits = 128; bits <= 256; bits += 64) {
+            for (i = 0; i < 3; i++) {
+                provider_mode_test(block, bits, modes[i]);
+            }
+            provider_eax_test(block, bits);
+        }
+    }
+    provider_dup_test();
+
+    OSSL_PROVIDER_unload(prov);
+    OSSL_LIB_CTX_free(libctx);
+
+    printf("Provider tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * IDEA NXT encryption algorithm implementation
+ * Issue date: 02/25/2006
+ *
+ * Copyright (C) 2006 Olivier Gay <olivier.gay@a3.epfl.ch>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "nxt128.h"
+#include "nxt_modes.h"
+#include "nxt_stream.hpp"
+
+static void fail_if(bool cond)
+{
+    if (cond) {
+        std::fprintf(stderr, "Test failed\n");
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+/* Writes msg in pieces of growing sizes, some larger than the buffer */
+static void write_pieces(std::ostream &out, const std::string &msg)
+{
+    std::size_t pos = 0, k = 1;
+
+    while (pos < msg.size()) {
+        k = std::min(k, msg.size() - pos);
+        if (k == 1)
+            out.put(msg[pos]);
+        else
+            out.write(msg.data() + pos, static_cast<std::streamsize>(k));
+        pos += k;
+        k = k * 3 + 1;
+    }
+}
+
+/* Reads everything back in pieces of shrinking and growing sizes */
+static std::string read_pieces(std::istream &in)
+{
+    std::string got;
+    std::vector<char> tmp(5000);
+    std::size_t k = 4999;
+    int c;
+
+    for (;;) {
+        if (k % 7 == 0) {
+            c = in.get();
+            if (c == EOF)
+                break;
+            got.push_back(static_cast<char>(c));
+        } else {
+            in.read(tmp.data(), static_cast<std::streamsize>(k));
+            got.append(tmp.data(), static_cast<std::size_t>(in.gcount()));
+            if (!in)
+                break;
+        }
+        k = (k * 13 + 5) % 4999 + 1;
+    }
+
+    return got;
+}
+
+static void ctr_tests(nxt128_ctx &ctx)
+{
+    std::string msg(40000, 0), ref(40000, 0);
+    std::size_t i;
+    nxt::block iv, ctr;
+
+    for (i = 0; i < msg.size(); i++) {
+        msg[i] = static_cast<char>(i * 7 + i / 251);
+    }
+    iv.fill(0xfe);
+    ctr = iv;
+    nxt128_ctr_crypt(&ctx, ctr.data(),
+                     reinterpret_cast<const uint8 *>(msg.data()),
+                     reinterpret_cast<uint8 *>(&ref[0]), msg.size());
+
+    std::stringbuf enc_sink;
+    {
+        nxt::ctr_streambuf enc(enc_sink, ctx, iv, std::ios_base::out, 1000);
+        std::ostream out(&enc);
+
+        write_pieces(out, msg);
+        fail_if(!out);
+    }
+    fail_if(enc_sink.str() != ref);
+
+    std::stringbuf dec_src(ref);
+    nxt::ctr_streambuf dec(dec_src, ctx, iv, std::ios_base::in, 1000);
+    std::istream in(&dec);
+
+    fail_if(read_pieces(in) != msg);
+}
+
+static std::string eax_write(nxt128_eax_ctx &ctx, const nxt::block &nonce,
+                             const std::string &msg, std::size_t chunk)
+{
+    std::stringbuf sink;
+    nxt::eax_streambuf enc(sink, ctx, nonce, std::ios_base::out, chunk);
+    std::ostream out(&enc);
+
+    write_pieces(out, msg.substr(0, msg.size() / 2));
+    out.flush();
+    write_pieces(out, msg.substr(msg.size() / 2));
+    fail_if(!out || !enc.close());
+
+    return sink.str();
+}
+
+static bool eax_read(nxt128_eax_ctx &ctx, const nxt::block &nonce,
+                     const std::string &rec, std::size_t chunk,
+                     std::string &got)
+{
+    std::stringbuf src(rec);
+    nxt::eax_streambuf dec(src, ctx, nonce, std::ios_base::in, chunk);
+    std::istream in(&dec);
+
+    got = read_pieces(in);
+
+    return !in.bad();
+}
+
+static void eax_tests(nxt128_eax_ctx &ctx)
+{
+    std::string msg(30000, 0), rec, bad, got;
+    std::size_t i;
+    nxt::block nonce;
+
+    for (i = 0; i < msg.size(); i++) {
+        msg[i] = static_cast<char>(i * 5 + i / 509);
+    }
+    nonce.fill(0x42);
+
+    rec = eax_write(ctx, nonce, msg, 700);
+    fail_if(rec.size() <= msg.size());
+    fail_if(!eax_read(ctx, nonce, rec, 700, got) || got != msg);
+
+    /* Tampering, truncation and dropped records are caught */
+    bad = rec;
+    bad[bad.size() / 2] ^= 1;
+    fail_if(eax_read(ctx, nonce, bad, 700, got));
+    bad = rec.substr(0, rec.size() - 1);
+    fail_if(eax_read(ctx, nonce, bad, 700, got));
+    bad = rec.substr(0, 4 + 700 + 16);
+    fail_if(eax_read(ctx, nonce, bad, 700, got));
+    bad = rec.substr(4 + 700 + 16);
+    fail_if(eax_read(ctx, nonce, bad, 700, got));
+    fail_if(eax_read(ctx, nonce, rec, 600, got));
+    nonce[0] ^= 1;
+    fail_if(eax_read(ctx, nonce, rec, 700, got));
+    nonce[0] ^= 1;
+
+    /* An empty stream is a single empty last record */
+    rec = eax_write(ctx, nonce, std::string(), 700);
+    fail_if(rec.size() != nxt::eax_streambuf::overhead);
+    fail_if(!eax_read(ctx, nonce, rec, 700, got) || !got.empty());
+    fail_if(eax_read(ctx, nonce, std::string(), 700, got));
+}
+
+int main()
+{
+    static const uint8 key[16] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66,
+                                  0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd,
+                                  0xee, 0xff};
+    nxt128_ctx ctx;
+    nxt128_eax_ctx eax;
+
+    nxt128_ks(&ctx, key, 128);
+    nxt128_eax_init(&eax, key, 128);
+
+    ctr_tests(ctx);
+    eax_tests(eax);
+
+    std::printf("Stream tests passed\n");
+
+    return EXIT_SUCCESS;
+}
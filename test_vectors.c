@@ -29,12 +29,34 @@
  * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "nxt64.h"
 #include "nxt128.h"
+#include "nxt_fpe.h"
+#include "nxt_prf.h"
+#include "nxt_modes.h"
+#include "nxt_drbg.h"
+#include "nxt_hash.h"
+#include "nxt_engine.h"
+#include "nxt_mb.h"
+#include "nxt_async.h"
+#include "nxt_chunked.h"
+#include "nxt_cache.h"
+#include "nxt_record.h"
+#include "nxt_tunnel.h"
+#include "nxt_keyd.h"
+#include "nxt_pool.h"
+#include "nxt_inline.h"
 
 static const unsigned char pt[16] = {0x01, 0x23, 0x45, 0x67,
                                      0x89, 0xab, 0xcd, 0xef,
@@ -253,6 +275,1690 @@ static void nxt128_256_test(unsigned char *ct)
     }
 }
 
+static void nxt_fpe_test(void)
+{
+    static const unsigned char widths[] = {1, 2, 5, 8, 11, 16, 17, 40, 48,
+                                           63, 64};
+    unsigned char in[1024 * 8];
+    unsigned char ct[1024 * 8];
+    unsigned char ct1[8];
+    unsigned char newpt[1024 * 8];
+    unsigned char seen[2048];
+    nxt_fpe_ctx ctx;
+    size_t count;
+    size_t value;
+    size_t i;
+    int bits;
+    int size;
+    int w;
+
+    for (w = 0; w < (int) sizeof(widths); w++) {
+        bits = widths[w];
+        size = NXT_FPE_SIZE(bits);
+        nxt_fpe_init(&ctx, key, 128, (unsigned char) bits);
+
+        /* Whole domain for small widths, pseudo random values else */
+        count = (bits <= 11) ? ((size_t) 1 << bits) : 1024;
+        for (i = 0; i < count * size; i++) {
+            in[i] = (unsigned char) (i * 131 + (i >> 3) * 7 + bits);
+        }
+        for (i = 0; i < count; i++) {
+            if (bits <= 11) {
+                in[i * size] = (unsigned char) (i >> 8);
+                in[i * size + size - 1] = (unsigned char) i;
+            } else if (bits % 8) {
+                in[i * size] &= (1 << (bits % 8)) - 1;
+            }
+        }
+
+        nxt_fpe_encrypt_batch(&ctx, in, ct, count);
+        nxt_fpe_decrypt_batch(&ctx, ct, newpt, count);
+
+        if (memcmp(in, newpt, count * size)) {
+            fprintf(stderr, "Test failed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        memset(seen, 0, sizeof(seen));
+        for (i = 0; i < count; i++) {
+            nxt_fpe_encrypt(&ctx, in + i * size, ct1);
+            if (memcmp(ct1, ct + i * size, size)) {
+                fprintf(stderr, "Test failed\n");
+                exit(EXIT_FAILURE);
+            }
+            if ((bits % 8) && (ct1[0] >> (bits % 8))) {
+                fprintf(stderr, "Test failed\n");
+                exit(EXIT_FAILURE);
+            }
+            if (bits <= 11) {
+                value = (size == 1) ? ct1[0] : ((ct1[0] << 8) | ct1[1]);
+                if (seen[value]++) {
+                    fprintf(stderr, "Test failed\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+
+        printf("NXT FPE %2d bits: ", bits);
+        for (i = 0; i < (size_t) size; i++) {
+            printf("%02x", in[i]);
+        }
+        printf(" -> ");
+        for (i = 0; i < (size_t) size; i++) {
+            printf("%02x", ct[i]);
+        }
+        printf("\n");
+    }
+}
+
+static void cmac64_dbl(unsigned char *b)
+{
+    unsigned char carry;
+    int i;
+
+    carry = b[0] >> 7;
+    for (i = 0; i < 7; i++) {
+        b[i] = (unsigned char) ((b[i] << 1) | (b[i + 1] >> 7));
+    }
+    b[7] = (unsigned char) ((b[7] << 1) ^ (carry ? 0x1b : 0));
+}
+
+/* Straightforward CMAC over nxt64_encrypt() used as a reference */
+static void cmac64_ref(nxt64_ctx *ctx, const unsigned char *in, size_t len,
+                       unsigned char *out)
+{
+    unsigned char k[8];
+    unsigned char x[8];
+    size_t n;
+    size_t i, j;
+
+    memset(k, 0, 8);
+    nxt64_encrypt(ctx, k, k);
+    cmac64_dbl(k);
+
+    n = (len == 0) ? 1 : (len + 7) / 8;
+    if (len != n * 8) {
+        cmac64_dbl(k);
+    }
+
+    memset(x, 0, 8);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < 8; j++) {
+            if (i * 8 + j < len) {
+                x[j] ^= in[i * 8 + j];
+            } else if (i * 8 + j == len) {
+                x[j] ^= 0x80;
+            }
+            if (i == n - 1) {
+                x[j] ^= k[j];
+            }
+        }
+        nxt64_encrypt(ctx, x, x);
+    }
+
+    memcpy(out, x, 8);
+}
+
+static void nxt_prf_test(void)
+{
+    unsigned char msg[80];
+    unsigned char ref[8];
+    unsigned char tag[8];
+    unsigned char tags[80 * 8];
+    const unsigned char *msgs[80];
+    size_t lens[80];
+    nxt_prf_ctx ctx;
+    size_t i;
+
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = (unsigned char) (i * 29 + 3);
+    }
+
+    nxt_prf_init(&ctx, key, 128);
+
+    for (i = 0; i < 80; i++) {
+        msgs[i] = msg + (i % 7);
+        lens[i] = (i * 37) % 70;
+    }
+    nxt_prf_batch(&ctx, msgs, lens, tags, 80);
+
+    for (i = 0; i < 80; i++) {
+        cmac64_ref(&ctx.cipher, msgs[i], lens[i], ref);
+        nxt_prf(&ctx, msgs[i], lens[i], tag);
+
+        if (memcmp(ref, tag, 8) || memcmp(ref, tags + i * 8, 8)) {
+            fprintf(stderr, "Test failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    nxt_prf(&ctx, msg, 16, tag);
+    print_block64("NXT PRF 16 bytes: ", tag);
+}
+
+static void fail_if(int cond)
+{
+    if (cond) {
+        fprintf(stderr, "Test failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void nxt128_ctr_test(void)
+{
+    unsigned char buf[1000];
+    unsigned char ct[1000];
+    unsigned char ks[16];
+    unsigned char ctr[16];
+    unsigned char ctr2[16];
+    nxt128_ctx ctx;
+    size_t i, j, n;
+
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = (unsigned char) i;
+    }
+
+    nxt128_ks(&ctx, key, 128);
+
+    /* Counter wrapping over the low 64 bits */
+    memset(ctr, 0, 16);
+    memset(ctr + 8, 0xff, 8);
+    ctr[15] = 0xfa;
+    nxt128_ctr_crypt(&ctx, ctr, buf, ct, sizeof(buf));
+
+    memset(ctr, 0, 16);
+    memset(ctr + 8, 0xff, 8);
+    ctr[15] = 0xfa;
+    for (i = 0; i < sizeof(buf); i += 16) {
+        nxt128_encrypt(&ctx, ctr, ks);
+        for (j = 0; (j < 16) && (i + j < sizeof(buf)); j++) {
+            fail_if(ct[i + j] != (buf[i + j] ^ ks[j]));
+        }
+        for (j = 16; j-- > 0 && ++ctr[j] == 0; )
+            ;
+    }
+
+    /* Same result when the message is processed in whole blocks */
+    memset(ctr2, 0, 16);
+    memset(ctr2 + 8, 0xff, 8);
+    ctr2[15] = 0xfa;
+    for (i = 0; i < sizeof(buf); i += n) {
+        n = ((i / 16) % 5 + 1) * 16;
+        if (n > sizeof(buf) - i)
+            n = sizeof(buf) - i;
+        nxt128_ctr_crypt(&ctx, ctr2, ct + i, ct + i, n);
+    }
+
+    fail_if(memcmp(buf, ct, sizeof(buf)) || memcmp(ctr, ctr2, 16));
+}
+
+static void nxt_drbg_test(void)
+{
+    static unsigned char out1[20000];
+    static unsigned char out2[20000];
+    nxt_drbg_ctx *ctx;
+    size_t i, n;
+
+    ctx = (nxt_drbg_ctx *) malloc(sizeof(*ctx));
+    fail_if(ctx == NULL);
+
+    nxt_drbg_init(ctx, key, 32);
+    nxt_drbg_generate(ctx, out1, sizeof(out1));
+
+    /* The output does not depend on the size of the requests */
+    nxt_drbg_init(ctx, key, 32);
+    for (i = 0, n = 1; i < sizeof(out2); i += n, n = n * 3 + 1) {
+        if (n > sizeof(out2) - i)
+            n = sizeof(out2) - i;
+        nxt_drbg_generate(ctx, out2 + i, n);
+    }
+    fail_if(memcmp(out1, out2, sizeof(out1)));
+
+    print_block128("NXT DRBG: ", out1);
+
+    nxt_drbg_init(ctx, key, 32);
+    nxt_drbg_reseed(ctx, pt, 16);
+    nxt_drbg_generate(ctx, out2, 16);
+    fail_if(!memcmp(out1, out2, 16));
+
+    nxt_drbg_wipe(ctx);
+    free(ctx);
+
+    fail_if(nxt_rand_bytes(out1, 100) || nxt_rand_bytes(out2, 100));
+    fail_if(!memcmp(out1, out2, 100));
+}
+
+/* Hirose compression with nxt128_ks() and nxt128_encrypt() */
+static void hash_ref(const unsigned char *msg, size_t len,
+                     unsigned char *digest)
+{
+    unsigned char g[16], h[16], gc[16];
+    unsigned char k[32];
+    unsigned char last[32];
+    nxt128_ctx ctx;
+    size_t n, i, j;
+
+    memcpy(g, "\xb7\xe1\x51\x62\x8a\xed\x2a\x6a"
+              "\xbf\x71\x58\x80\x9c\xf4\xf3\xc7", 16);
+    memcpy(h, "\x62\xe7\x16\x0f\x38\xb4\xda\x56"
+              "\xa7\x84\xd9\x04\x51\x90\xcf\xef", 16);
+
+    n = (len + 9 + 15) / 16;
+    memset(last, 0, 32);
+    memcpy(last, msg + (len & ~(size_t) 15), len & 15);
+    last[len & 15] = 0x80;
+    for (i = 0; i < 4; i++) {
+        last[(n - (len & ~(size_t) 15) / 16) * 16 - 1 - i] =
+            (unsigned char) ((len << 3) >> (8 * i));
+    }
+    last[(n - (len & ~(size_t) 15) / 16) * 16 - 5] =
+        (unsigned char) (len >> 29);
+
+    for (i = 0; i < n; i++) {
+        memcpy(k, h, 16);
+        if (i < len / 16)
+            memcpy(k + 16, msg + 16 * i, 16);
+        else
+            memcpy(k + 16, last + 16 * (i - len / 16), 16);
+
+        nxt128_ks(&ctx, k, 256);
+        memcpy(gc, g, 16);
+        gc[15] ^= 1;
+        nxt128_encrypt(&ctx, g, k);
+        nxt128_encrypt(&ctx, gc, h);
+        for (j = 0; j < 16; j++) {
+            g[j] ^= k[j];
+            h[j] ^= gc[j];
+        }
+    }
+
+    memcpy(digest, g, 16);
+    memcpy(digest + 16, h, 16);
+}
+
+static void nxt_hash_test(void)
+{
+    unsigned char msg[200];
+    unsigned char ref[32];
+    unsigned char md[32];
+    unsigned char mds[20 * 32];
+    const unsigned char *msgs[20];
+    size_t lens[20];
+    nxt_hash_ctx ctx;
+    size_t i, j, n;
+
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = (unsigned char) (i * 17 + 5);
+    }
+
+    for (i = 0; i < 20; i++) {
+        msgs[i] = msg + i;
+        lens[i] = (i * 23) % 180;
+    }
+    nxt_hash_batch(msgs, lens, mds, 20);
+
+    for (i = 0; i < 20; i++) {
+        hash_ref(msgs[i], lens[i], ref);
+        nxt_hash(msgs[i], lens[i], md);
+        fail_if(memcmp(ref, md, 32) || memcmp(ref, mds + 32 * i, 32));
+
+        nxt_hash_init(&ctx);
+        for (j = 0; j < lens[i]; j += n) {
+            n = (j % 7) + 1;
+            if (n > lens[i] - j)
+                n = lens[i] - j;
+            nxt_hash_update(&ctx, msgs[i] + j, n);
+        }
+        nxt_hash_final(&ctx, md);
+        fail_if(memcmp(ref, md, 32));
+    }
+
+    nxt_hash(msg, 0, md);
+    print_block128("NXT HASH empty: ", md);
+    print_block128("                ", md + 16);
+}
+
+static void cmac128_dbl(unsigned char *b)
+{
+    unsigned char carry;
+    int i;
+
+    carry = b[0] >> 7;
+    for (i = 0; i < 15; i++) {
+        b[i] = (unsigned char) ((b[i] << 1) | (b[i + 1] >> 7));
+    }
+    b[15] = (unsigned char) ((b[15] << 1) ^ (carry ? 0x87 : 0));
+}
+
+/* OMAC^t over nxt128_encrypt() used as a reference */
+static void omac128_ref(nxt128_ctx *ctx, int t, const unsigned char *in,
+                        size_t len, unsigned char *out)
+{
+    unsigned char m[16 + 1000];
+    unsigned char k[16];
+    unsigned char x[16];
+    size_t n;
+    size_t i, j;
+
+    memset(m, 0, 16);
+    m[15] = (unsigned char) t;
+    memcpy(m + 16, in, len);
+    len += 16;
+
+    memset(k, 0, 16);
+    nxt128_encrypt(ctx, k, k);
+    cmac128_dbl(k);
+
+    n = (len + 15) / 16;
+    if (len != n * 16) {
+        cmac128_dbl(k);
+        m[len] = 0x80;
+        memset(m + len + 1, 0, n * 16 - len - 1);
+    }
+
+    memset(x, 0, 16);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < 16; j++) {
+            x[j] ^= m[i * 16 + j] ^ ((i == n - 1) ? k[j] : 0);
+        }
+        nxt128_encrypt(ctx, x, x);
+    }
+
+    memcpy(out, x, 16);
+}
+
+static void eax128_ref(nxt128_ctx *ctx, const unsigned char *nonce,
+                       size_t nonce_len, const unsigned char *hdr,
+                       size_t hdr_len, const unsigned char *in,
+                       unsigned char *out, size_t len, unsigned char *tag)
+{
+    unsigned char n[16], h[16], c[16];
+    int i;
+
+    omac128_ref(ctx, 0, nonce, nonce_len, n);
+    omac128_ref(ctx, 1, hdr, hdr_len, h);
+    memcpy(c, n, 16);
+    nxt128_ctr_crypt(ctx, c, in, out, len);
+    omac128_ref(ctx, 2, out, len, c);
+
+    for (i = 0; i < 16; i++) {
+        tag[i] = n[i] ^ h[i] ^ c[i];
+    }
+}
+
+/* Splits buf in segments of pseudo random lengths, returns their count */
+static int make_iov(nxt_iovec *iov, unsigned char *buf, size_t len,
+                    unsigned int seed)
+{
+    size_t n;
+    int cnt;
+
+    for (cnt = 0; len > 0; cnt++, buf += n, len -= n) {
+        seed = seed * 1103515245 + 12345;
+        n = (seed >> 16) % 40;
+        if (n > len)
+            n = len;
+        iov[cnt].base = buf;
+        iov[cnt].len = n;
+    }
+
+    return cnt;
+}
+
+static void nxt128_modes_test(void)
+{
+    static unsigned char msg[960];
+    static unsigned char ct[960];
+    static unsigned char ref[960];
+    static unsigned char buf[960];
+    nxt_iovec src[960];
+    nxt_iovec dst[960];
+    unsigned char iv[16], iv2[16];
+    unsigned char tag[16], reftag[16];
+    nxt128_eax_ctx eax;
+    nxt128_ctx *ctx;
+    size_t len;
+    size_t i, j;
+    int src_cnt, dst_cnt;
+
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = (unsigned char) (i * 11 + 7);
+    }
+
+    nxt128_eax_init(&eax, key, 192);
+    ctx = &eax.cipher;
+
+    /* CBC against nxt128_encrypt(), in place decryption */
+    memset(iv, 0xa5, 16);
+    nxt128_cbc_encrypt(ctx, iv, msg, ct, sizeof(msg));
+    memset(iv2, 0xa5, 16);
+    for (i = 0; i < sizeof(msg); i += 16) {
+        for (j = 0; j < 16; j++) {
+            iv2[j] ^= msg[i + j];
+        }
+        nxt128_encrypt(ctx, iv2, iv2);
+        fail_if(memcmp(iv2, ct + i, 16));
+    }
+    fail_if(memcmp(iv, iv2, 16));
+
+    memcpy(buf, ct, sizeof(buf));
+    memset(iv, 0xa5, 16);
+    nxt128_cbc_decrypt(ctx, iv, buf, buf, sizeof(buf));
+    fail_if(memcmp(buf, msg, sizeof(msg)) || memcmp(iv, iv2, 16));
+
+    /* EAX against the reference, all the lengths up to 3 blocks */
+    for (len = 0; len <= 48; len++) {
+        eax128_ref(ctx, pt, len % 17, key, (len * 5) % 33, msg, ref, len,
+                   reftag);
+        nxt128_eax_encrypt(&eax, pt, len % 17, key, (len * 5) % 33, msg, ct,
+                           len, tag);
+        fail_if(memcmp(ref, ct, len) || memcmp(reftag, tag, 16));
+
+        fail_if(nxt128_eax_decrypt(&eax, pt, len % 17, key, (len * 5) % 33,
+                                   ct, buf, len, tag));
+        fail_if(memcmp(buf, msg, len));
+    }
+
+    print_block128("NXT128 EAX tag: ", tag);
+
+    /* Scatter-gather CTR, CBC and EAX against the contiguous versions */
+    src_cnt = make_iov(src, msg, sizeof(msg), 1);
+    dst_cnt = make_iov(dst, ct, sizeof(ct), 2);
+
+    memset(iv, 0, 16);
+    nxt128_ctr_crypt(ctx, iv, msg, ref, sizeof(msg));
+    memset(iv2, 0, 16);
+    nxt128_ctr_crypt_iov(ctx, iv2, src, src_cnt, dst, dst_cnt);
+    fail_if(memcmp(ref, ct, sizeof(ct)) || memcmp(iv, iv2, 16));
+
+    memset(iv, 1, 16);
+    nxt128_cbc_encrypt(ctx, iv, msg, ref, sizeof(msg));
+    memset(iv2, 1, 16);
+    nxt128_cbc_encrypt_iov(ctx, iv2, src, src_cnt, dst, dst_cnt);
+    fail_if(memcmp(ref, ct, sizeof(ct)) || memcmp(iv, iv2, 16));
+
+    memset(iv2, 1, 16);
+    memcpy(buf, ct, sizeof(buf));
+    dst_cnt = make_iov(dst, buf, sizeof(buf), 3);
+    nxt128_cbc_decrypt_iov(ctx, iv2, dst, dst_cnt, dst, dst_cnt);
+    fail_if(memcmp(msg, buf, sizeof(buf)) || memcmp(iv, iv2, 16));
+
+    nxt128_eax_encrypt(&eax, pt, 16, NULL, 0, msg, ref, sizeof(msg),
+                       reftag);
+    dst_cnt = make_iov(dst, ct, sizeof(ct), 4);
+    nxt128_eax_encrypt_iov(&eax, pt, 16, NULL, 0, src, src_cnt, dst, dst_cnt,
+                           tag);
+    fail_if(memcmp(ref, ct, sizeof(ct)) || memcmp(reftag, tag, 16));
+
+    dst_cnt = make_iov(dst, ct, sizeof(ct), 5);
+    fail_if(nxt128_eax_decrypt_iov(&eax, pt, 16, NULL, 0, dst, dst_cnt,
+                                   dst, dst_cnt, tag));
+    fail_if(memcmp(msg, ct, sizeof(ct)));
+
+    nxt128_eax_encrypt(&eax, pt, 16, NULL, 0, msg, ct, sizeof(ct), tag);
+    ct[100] ^= 1;
+    fail_if(!nxt128_eax_decrypt_iov(&eax, pt, 16, NULL, 0, dst, dst_cnt,
+                                    dst, dst_cnt, tag));
+    for (i = 0; i < sizeof(ct); i++) {
+        fail_if(ct[i] != 0);
+    }
+}
+
+static void xts128_ref(nxt128_ctx *ctx, nxt128_ctx *tweak_ctx,
+                       const unsigned char *tweak, const unsigned char *in,
+                       unsigned char *out, size_t len)
+{
+    unsigned char t[16], x[16];
+    unsigned char carry;
+    size_t i;
+    int j;
+
+    nxt128_encrypt(tweak_ctx, tweak, t);
+    for (i = 0; i < len; i += 16) {
+        for (j = 0; j < 16; j++) {
+            x[j] = in[i + j] ^ t[j];
+        }
+        nxt128_encrypt(ctx, x, x);
+        for (j = 0; j < 16; j++) {
+            out[i + j] = x[j] ^ t[j];
+        }
+        carry = t[15] >> 7;
+        for (j = 15; j > 0; j--) {
+            t[j] = (unsigned char) ((t[j] << 1) | (t[j - 1] >> 7));
+        }
+        t[0] = (unsigned char) ((t[0] << 1) ^ (carry ? 0x87 : 0));
+    }
+}
+
+static void pmac128_ref(nxt128_ctx *ctx, const unsigned char *in,
+                        size_t len, unsigned char *tag)
+{
+    unsigned char l[64][16], l_inv[16];
+    unsigned char offset[16], sum[16], x[16];
+    size_t m, i;
+    int j, k;
+
+    memset(l[0], 0, 16);
+    nxt128_encrypt(ctx, l[0], l[0]);
+    for (k = 1; k < 64; k++) {
+        memcpy(l[k], l[k - 1], 16);
+        cmac128_dbl(l[k]);
+    }
+    for (j = 15; j > 0; j--) {
+        l_inv[j] = (unsigned char) ((l[0][j] >> 1) | (l[0][j - 1] << 7));
+    }
+    l_inv[0] = l[0][0] >> 1;
+    if (l[0][15] & 1) {
+        l_inv[0] ^= 0x80;
+        l_inv[15] ^= 0x43;
+    }
+
+    m = (len > 0) ? (len + 15) / 16 : 1;
+    memset(offset, 0, 16);
+    memset(sum, 0, 16);
+    for (i = 1; i < m; i++) {
+        for (k = 0; !((i >> k) & 1); k++)
+            ;
+        for (j = 0; j < 16; j++) {
+            offset[j] ^= l[k][j];
+            x[j] = in[(i - 1) * 16 + j] ^ offset[j];
+        }
+        nxt128_encrypt(ctx, x, x);
+        for (j = 0; j < 16; j++) {
+            sum[j] ^= x[j];
+        }
+    }
+
+    len -= (m - 1) * 16;
+    for (j = 0; j < (int) len; j++) {
+        sum[j] ^= in[(m - 1) * 16 + j];
+    }
+    if (len == 16) {
+        for (j = 0; j < 16; j++) {
+            sum[j] ^= l_inv[j];
+        }
+    } else {
+        sum[len] ^= 0x80;
+    }
+    nxt128_encrypt(ctx, sum, tag);
+}
+
+static int engine_node_of(const void *addr, void *base)
+{
+    return (int) (((const unsigned char *) addr
+                   - (const unsigned char *) base) / (128 * 1024)) % 2;
+}
+
+static int engine_node_zero(const void *addr, void *base)
+{
+    (void) addr;
+    (void) base;
+
+    return 0;
+}
+
+static void nxt_engine_test(void)
+{
+    static const size_t lens[3] = {0, 4096 + 7, 5 * NXT_ENGINE_CHUNK + 100};
+    unsigned char *msg, *ct, *ref, *buf;
+    unsigned char iv[16], iv2[16];
+    unsigned char tag[16], reftag[16];
+    nxt_engine_topology topo;
+    nxt128_pmac_ctx pmac;
+    nxt128_ctx tweak_ctx;
+    nxt128_ctx *ctx;
+    nxt_engine *eng;
+    size_t len, blen, n;
+    size_t i;
+    int t;
+
+    n = lens[2];
+    msg = (unsigned char *) malloc(n);
+    ct = (unsigned char *) malloc(n);
+    ref = (unsigned char *) malloc(n);
+    buf = (unsigned char *) malloc(n);
+    fail_if(msg == NULL || ct == NULL || ref == NULL || buf == NULL);
+    for (i = 0; i < n; i++) {
+        msg[i] = (unsigned char) (i * 13 + (i >> 11));
+    }
+
+    nxt128_pmac_init(&pmac, key, 256);
+    ctx = &pmac.cipher;
+    nxt128_ks(&tweak_ctx, key + 16, 128);
+
+    /* Serial XTS and PMAC against the references */
+    memset(iv, 0, 16);
+    iv[0] = 3;
+    xts128_ref(ctx, &tweak_ctx, iv, msg, ref, 512);
+    nxt128_xts_encrypt(ctx, &tweak_ctx, iv, msg, ct, 512);
+    fail_if(memcmp(ref, ct, 512));
+    nxt128_xts_decrypt(ctx, &tweak_ctx, iv, ct, ct, 512);
+    fail_if(memcmp(msg, ct, 512));
+
+    for (len = 0; len <= 80; len++) {
+        pmac128_ref(ctx, msg, len, reftag);
+        nxt128_pmac(&pmac, msg, len, tag);
+        fail_if(memcmp(reftag, tag, 16));
+    }
+    print_block128("NXT128 PMAC tag: ", tag);
+
+    /* Parallel versions against the serial ones, in place or not */
+    for (t = 1; t <= 4; t += 3) {
+        eng = nxt_engine_new(t);
+        fail_if(eng == NULL || nxt_engine_threads(eng) != t);
+
+        for (i = 0; i < 3; i++) {
+            len = lens[i];
+            blen = len & ~(size_t) 15;
+
+            nxt128_encrypt_blocks(ctx, msg, ref, blen / 16);
+            nxt_engine_ecb_encrypt(eng, ctx, msg, ct, blen);
+            fail_if(memcmp(ref, ct, blen));
+            nxt_engine_ecb_decrypt(eng, ctx, ct, ct, blen);
+            fail_if(memcmp(msg, ct, blen));
+
+            memset(iv, 0xff, 16);
+            iv[0] = 0;
+            memcpy(iv2, iv, 16);
+            nxt128_ctr_crypt(ctx, iv, msg, ref, len);
+            nxt_engine_ctr_crypt(eng, ctx, iv2, msg, ct, len);
+            fail_if(memcmp(ref, ct, len) || memcmp(iv, iv2, 16));
+
+            memset(iv, 7, 16);
+            nxt128_cbc_encrypt(ctx, iv, msg, ct, blen);
+            memcpy(buf, ct, blen);
+            memset(iv2, 7, 16);
+            nxt_engine_cbc_decrypt(eng, ctx, iv2, buf, buf, blen);
+            fail_if(memcmp(msg, buf, blen) || memcmp(iv, iv2, 16));
+
+            memset(iv, 0, 16);
+            iv[0] = 0xfe;
+            nxt128_xts_encrypt(ctx, &tweak_ctx, iv, msg, ref, 4096);
+            nxt_engine_xts_encrypt(eng, ctx, &tweak_ctx, iv, 4096, msg, ct,
+                                   len & ~(size_t) 4095);
+            fail_if(len >= 4096 && memcmp(ref, ct, 4096));
+            iv[0] = 0xff;
+            nxt128_xts_encrypt(ctx, &tweak_ctx, iv, msg + 4096, ref, 4096);
+            fail_if(len >= 8192 && memcmp(ref, ct + 4096, 4096));
+            iv[0] = 0xfe;
+            nxt_engine_xts_decrypt(eng, ctx, &tweak_ctx, iv, 4096, ct, ct,
+                                   len & ~(size_t) 4095);
+            fail_if(memcmp(msg, ct, len & ~(size_t) 4095));
+
+            nxt128_pmac(&pmac, msg, len, reftag);
+            nxt_engine_pmac(eng, &pmac, msg, len, tag);
+            fail_if(memcmp(reftag, tag, 16));
+        }
+
+        nxt_engine_free(eng);
+    }
+
+    /* Simulated topology: 2 nodes owning alternate 128 KB of msg */
+    memset(&topo, 0, sizeof(topo));
+    topo.nodes = 2;
+    topo.threads[0] = 1;
+    topo.threads[1] = 2;
+    topo.node_of = engine_node_of;
+    topo.arg = msg;
+    eng = nxt_engine_new_topology(&topo);
+    fail_if(eng == NULL || nxt_engine_threads(eng) != 4);
+
+    len = lens[2] & ~(size_t) 15;
+    nxt128_encrypt_blocks(ctx, msg, ref, len / 16);
+    nxt_engine_ecb_encrypt(eng, ctx, msg, ct, len);
+    fail_if(memcmp(ref, ct, len));
+
+    nxt128_pmac(&pmac, msg, lens[2], reftag);
+    nxt_engine_pmac(eng, &pmac, msg, lens[2], tag);
+    fail_if(memcmp(reftag, tag, 16));
+
+    nxt_engine_stats(eng, &len, &blen);
+    fail_if(len + blen != 2 * (lens[2] / NXT_ENGINE_CHUNK + 1));
+    nxt_engine_free(eng);
+
+    /*
+     * Workers on node 0 only: the 6 chunks go to node 0, and the 2 on
+     * node 1 (bytes 128 KB to 256 KB) are processed remotely
+     */
+    topo.threads[0] = 1;
+    topo.threads[1] = 0;
+    eng = nxt_engine_new_topology(&topo);
+    fail_if(eng == NULL || nxt_engine_threads(eng) != 2);
+    len = lens[2] & ~(size_t) 15;
+    nxt_engine_ecb_encrypt(eng, ctx, msg, ct, len);
+    fail_if(memcmp(ref, ct, len));
+    nxt_engine_stats(eng, &len, &blen);
+    fail_if(len != 4 || blen != 2);
+    nxt_engine_free(eng);
+
+    /* All of msg on node 0: nothing is remote */
+    topo.node_of = engine_node_zero;
+    eng = nxt_engine_new_topology(&topo);
+    fail_if(eng == NULL);
+    len = lens[2] & ~(size_t) 15;
+    nxt_engine_ecb_encrypt(eng, ctx, msg, ct, len);
+    fail_if(memcmp(ref, ct, len));
+    nxt_engine_stats(eng, &len, &blen);
+    fail_if(len != 6 || blen != 0);
+    nxt_engine_free(eng);
+
+    free(msg);
+    free(ct);
+    free(ref);
+    free(buf);
+}
+
+static void nxt_mk_test(void)
+{
+    unsigned char in[5 * 16], out[5 * 16], ref[5 * 16];
+    nxt128_ctx ctx128[5], *p128[5];
+    nxt64_ctx ctx64[5], *p64[5];
+    int i;
+
+    for (i = 0; i < (int) sizeof(in); i++) {
+        in[i] = (unsigned char) (i * 3 + 1);
+    }
+    for (i = 0; i < 5; i++) {
+        nxt64_ks(&ctx64[i], key + 3 * i, 128);
+        nxt128_ks(&ctx128[i], key + 3 * i, 128);
+        p64[i] = &ctx64[i];
+        p128[i] = &ctx128[i];
+    }
+
+    for (i = 0; i < 5; i++) {
+        nxt64_encrypt(p64[i], in + 8 * i, ref + 8 * i);
+    }
+    nxt64_encrypt_blocks_mk(p64, in, out, 5);
+    fail_if(memcmp(ref, out, 5 * 8));
+    nxt64_decrypt_blocks_mk(p64, out, out, 5);
+    fail_if(memcmp(in, out, 5 * 8));
+
+    for (i = 0; i < 5; i++) {
+        nxt128_encrypt(p128[i], in + 16 * i, ref + 16 * i);
+    }
+    nxt128_encrypt_blocks_mk(p128, in, out, 5);
+    fail_if(memcmp(ref, out, 5 * 16));
+    nxt128_decrypt_blocks_mk(p128, out, out, 5);
+    fail_if(memcmp(in, out, 5 * 16));
+}
+
+/* Checks a completed job of the multi-buffer test against the reference */
+static void nxt_mb_check(nxt_mb_job *job, const unsigned char *msg)
+{
+    unsigned char ref[200], iv[16], x[16];
+    size_t i;
+    int j;
+
+    if (job->ctx == NULL)
+        return;
+
+    memcpy(iv, (unsigned char *) job->user, 16);
+
+    if (job->op == NXT_MB_CMAC) {
+        cmac64_ref((nxt64_ctx *) job->ctx, msg, job->len, ref);
+        fail_if(memcmp(ref, job->out, 8));
+    } else if (job->op == NXT_MB_CTR) {
+        nxt128_ctr_crypt((nxt128_ctx *) job->ctx, iv, msg, ref, job->len);
+        fail_if(memcmp(ref, job->out, job->len) || memcmp(iv, job->iv, 16));
+    } else if (job->op == NXT_MB_CBC_ENCRYPT) {
+        for (i = 0; i < job->len; i += 8) {
+            for (j = 0; j < 8; j++) {
+                x[j] = msg[i + j] ^ iv[j];
+            }
+            nxt64_encrypt((nxt64_ctx *) job->ctx, x, iv);
+            fail_if(memcmp(iv, job->out + i, 8));
+        }
+        fail_if(memcmp(iv, job->iv, 8));
+    } else {
+        fail_if(memcmp(msg, job->out, job->len));
+    }
+
+    job->ctx = NULL;
+}
+
+static void nxt_mb_test(void)
+{
+    static unsigned char msg[200];
+    static unsigned char out[40][200];
+    static unsigned char ivs[40][16];
+    nxt128_ctx ctx128[5];
+    nxt64_ctx ctx64[5];
+    nxt_mb_mgr mgr64, mgr128;
+    nxt_mb_job jobs[40];
+    nxt_mb_job *job;
+    nxt_mb_mgr *mgr;
+    unsigned long now;
+    int done = 0;
+    int i;
+
+    for (i = 0; i < (int) sizeof(msg); i++) {
+        msg[i] = (unsigned char) (i * 7 + 100);
+    }
+    for (i = 0; i < 5; i++) {
+        nxt64_ks(&ctx64[i], key + i, 128);
+        nxt128_ks(&ctx128[i], key + i, 192);
+    }
+
+    nxt_mb_init(&mgr64, NXT64_BLOCK_SIZE, 10);
+    nxt_mb_init(&mgr128, NXT128_BLOCK_SIZE, 10);
+
+    /*
+     * Odd jobs are NXT64 CMAC or CBC encryption, even ones NXT128 CTR
+     * or CBC decryption of the CBC encryption of msg, in place.
+     */
+    for (i = 0; i < 40; i++) {
+        memset(&jobs[i], 0, sizeof(nxt_mb_job));
+        job = &jobs[i];
+        job->in = msg;
+        job->out = out[i];
+        job->user = ivs[i];
+        memset(job->iv, i, 16);
+        memcpy(ivs[i], job->iv, 16);
+
+        if (i % 2 == 1) {
+            job->ctx = &ctx64[i % 5];
+            job->op = (i % 4 == 1) ? NXT_MB_CMAC : NXT_MB_CBC_ENCRYPT;
+            job->len = (job->op == NXT_MB_CMAC) ? (size_t) (i * 5) % 41
+                                                : (size_t) (i % 5) * 8;
+            mgr = &mgr64;
+        } else {
+            job->ctx = &ctx128[i % 5];
+            job->op = (i % 4 == 0) ? NXT_MB_CTR : NXT_MB_CBC_DECRYPT;
+            job->len = (size_t) (i * 37) % 200;
+            if (job->op == NXT_MB_CBC_DECRYPT) {
+                job->len &= ~(size_t) 15;
+                nxt128_cbc_encrypt((nxt128_ctx *) job->ctx, ivs[i], msg,
+                                   out[i], job->len);
+                memcpy(ivs[i], job->iv, 16);
+                job->in = out[i];
+            }
+            mgr = &mgr128;
+        }
+
+        now = i;
+        for (job = nxt_mb_submit(mgr, &jobs[i], now); job != NULL;
+             job = nxt_mb_get_completed(mgr)) {
+            nxt_mb_check(job, msg);
+            done++;
+        }
+        for (job = nxt_mb_poll(&mgr64, now); job != NULL;
+             job = nxt_mb_get_completed(&mgr64)) {
+            nxt_mb_check(job, msg);
+            done++;
+        }
+    }
+
+    for (job = nxt_mb_flush(&mgr64); job != NULL;
+         job = nxt_mb_get_completed(&mgr64)) {
+        nxt_mb_check(job, msg);
+        done++;
+    }
+    for (job = nxt_mb_flush(&mgr128); job != NULL;
+         job = nxt_mb_get_completed(&mgr128)) {
+        nxt_mb_check(job, msg);
+        done++;
+    }
+
+    fail_if(done != 40);
+    print_block64("NXT MB CMAC: ", out[37]);
+}
+
+#define ASYNC_DEPTH 8
+
+static nxt128_ctx async_ctx[3];
+static unsigned char async_msg[1000];
+
+static void nxt_async_check(nxt_async_req *req)
+{
+    unsigned char ref[1000], iv[16];
+    nxt_mb_job *job = &req->job;
+
+    memset(iv, (int) job->len, 16);
+    if (job->op == NXT_MB_CTR) {
+        nxt128_ctr_crypt((nxt128_ctx *) job->ctx, iv, async_msg, ref,
+                         job->len);
+        fail_if(memcmp(ref, job->out, job->len));
+    } else {
+        nxt128_cbc_encrypt((nxt128_ctx *) job->ctx, iv, async_msg, ref,
+                           job->len);
+        fail_if(memcmp(ref, job->out, job->len));
+    }
+    fail_if(memcmp(iv, job->iv, 16));
+}
+
+typedef struct {
+    nxt_async *as;
+    int id;
+} async_arg;
+
+static void *nxt_async_producer_test(void *arg)
+{
+    static unsigned char out[3][ASYNC_DEPTH][1000];
+    nxt_async_req reqs[ASYNC_DEPTH];
+    nxt_async_req *free_reqs[ASYNC_DEPTH];
+    nxt_async_producer *p;
+    nxt_async_req *req;
+    int id = ((async_arg *) arg)->id;
+    int nfree = ASYNC_DEPTH;
+    int i;
+
+    p = nxt_async_producer_new(((async_arg *) arg)->as, ASYNC_DEPTH);
+    fail_if(p == NULL);
+
+    for (i = 0; i < ASYNC_DEPTH; i++) {
+        free_reqs[i] = &reqs[i];
+    }
+
+    for (i = 0; i < 400; i++) {
+        while ((req = nxt_async_poll(p)) != NULL) {
+            nxt_async_check(req);
+            free_reqs[nfree++] = req;
+        }
+        if (nfree == 0) {
+            req = nxt_async_wait(p);
+            nxt_async_check(req);
+            free_reqs[nfree++] = req;
+        }
+
+        req = free_reqs[--nfree];
+        memset(req, 0, sizeof(nxt_async_req));
+        req->job.op = (i % 2) ? NXT_MB_CTR : NXT_MB_CBC_ENCRYPT;
+        req->job.ctx = &async_ctx[(i + id) % 3];
+        req->job.in = async_msg;
+        req->job.out = out[id][req - reqs];
+        req->job.len = (size_t) ((i * 97 + id * 13) % 1000);
+        if (req->job.op == NXT_MB_CBC_ENCRYPT)
+            req->job.len &= ~(size_t) 15;
+        memset(req->job.iv, (int) req->job.len, 16);
+        fail_if(nxt_async_submit(p, req));
+    }
+    fail_if(nfree == 0 && nxt_async_submit(p, &reqs[0]) != -1);
+
+    while ((req = nxt_async_wait(p)) != NULL) {
+        nxt_async_check(req);
+    }
+
+    nxt_async_producer_free(p);
+
+    return NULL;
+}
+
+static void nxt_async_test(void)
+{
+    static unsigned char out[4][100];
+    nxt_async_req reqs[4];
+    pthread_t tids[3];
+    async_arg args[3];
+    nxt_async_producer *p;
+    nxt_async *as;
+    int i;
+
+    for (i = 0; i < (int) sizeof(async_msg); i++) {
+        async_msg[i] = (unsigned char) (i * 5 + 17);
+    }
+    for (i = 0; i < 3; i++) {
+        nxt128_ks(&async_ctx[i], key + i, (uint16) (256 - 64 * i));
+    }
+
+    as = nxt_async_new(2);
+    fail_if(as == NULL);
+
+    for (i = 0; i < 3; i++) {
+        args[i].as = as;
+        args[i].id = i;
+        fail_if(pthread_create(&tids[i], NULL, nxt_async_producer_test,
+                               &args[i]) != 0);
+    }
+    for (i = 0; i < 3; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    /* The ring is rounded up to 4 entries, the depth stays 3 */
+    p = nxt_async_producer_new(as, 3);
+    fail_if(p == NULL);
+    for (i = 0; i < 4; i++) {
+        memset(&reqs[i], 0, sizeof(nxt_async_req));
+        reqs[i].job.op = NXT_MB_CTR;
+        reqs[i].job.ctx = &async_ctx[i % 3];
+        reqs[i].job.in = async_msg;
+        reqs[i].job.out = out[i];
+        reqs[i].job.len = 100;
+        memset(reqs[i].job.iv, 100, 16);
+        fail_if(nxt_async_submit(p, &reqs[i]) != (i < 3 ? 0 : -1));
+    }
+    for (i = 0; i < 3; i++) {
+        nxt_async_check(nxt_async_wait(p));
+    }
+    nxt_async_producer_free(p);
+
+    nxt_async_free(as);
+}
+
+/* Container writes and reads against a plain copy of the data */
+static void nxt_chunked_check(nxt_chunked *c, const unsigned char *model,
+                              size_t len, unsigned char *buf)
+{
+    size_t off, n;
+
+    fail_if(nxt_chunked_size(c) != (off_t) len);
+    for (off = 0; off <= len; off += 777) {
+        for (n = 1; n <= 3001; n += 1500) {
+            memset(buf, 0xaa, n);
+            fail_if(nxt_chunked_pread(c, buf, n, (off_t) off)
+                    != (ssize_t) (off + n > len ? len - off : n));
+            fail_if(memcmp(buf, model + off, off + n > len ? len - off : n));
+        }
+    }
+}
+
+static void nxt_chunked_test(void)
+{
+    static const size_t writes[5][2] = {
+        {0, 7000}, {15000, 300}, {2500, 2200}, {999, 2}, {15300, 5000}
+    };
+    char path[] = "/tmp/nxt_chunked_XXXXXX";
+    unsigned char *model, *data, *buf;
+    unsigned char b;
+    nxt_chunked c;
+    nxt_engine *eng;
+    size_t len, i;
+    int fd, t, w;
+
+    model = (unsigned char *) calloc(20300, 1);
+    data = (unsigned char *) malloc(20300);
+    buf = (unsigned char *) malloc(20300);
+    fail_if(model == NULL || data == NULL || buf == NULL);
+
+    for (t = 0; t < 2; t++) {
+        eng = t ? nxt_engine_new(4) : NULL;
+        fail_if(t && eng == NULL);
+
+        fd = mkstemp(path);
+        fail_if(fd < 0);
+        unlink(path);
+        strcpy(path + 17, "XXXXXX");
+
+        /* Writes in place, across chunks, after a gap and growing */
+        fail_if(nxt_chunked_create(&c, fd, key, 256, 1000, eng) != 0);
+        memset(model, 0, 20300);
+        len = 0;
+        for (w = 0; w < 5; w++) {
+            for (i = 0; i < writes[w][1]; i++) {
+                data[i] = (unsigned char) (i * 7 + w * 31 + t);
+            }
+            fail_if(nxt_chunked_pwrite(&c, data, writes[w][1],
+                                       (off_t) writes[w][0])
+                    != (ssize_t) writes[w][1]);
+            memcpy(model + writes[w][0], data, writes[w][1]);
+            if (writes[w][0] + writes[w][1] > len)
+                len = writes[w][0] + writes[w][1];
+            nxt_chunked_check(&c, model, len, buf);
+        }
+        nxt_chunked_close(&c);
+        fail_if(lseek(fd, 0, SEEK_END) != NXT_CHUNKED_HEADER_SIZE
+                + 21 * (NXT_CHUNKED_OVERHEAD + 1000) - 700);
+
+        fail_if(nxt_chunked_open(&c, fd, key, 256, eng) != 0);
+        nxt_chunked_check(&c, model, len, buf);
+        fail_if(nxt_chunked_pread(&c, buf, 100, (off_t) len) != 0);
+
+        /* A modified record only fails the reads which touch it */
+        fail_if(pread(fd, &b, 1, NXT_CHUNKED_HEADER_SIZE
+                      + 3 * (NXT_CHUNKED_OVERHEAD + 1000) + 100) != 1);
+        b ^= 1;
+        fail_if(pwrite(fd, &b, 1, NXT_CHUNKED_HEADER_SIZE
+                       + 3 * (NXT_CHUNKED_OVERHEAD + 1000) + 100) != 1);
+        fail_if(nxt_chunked_pread(&c, buf, 2000, 2500) != -1
+                || errno != EBADMSG || buf[0] != 0);
+        fail_if(nxt_chunked_pread(&c, buf, 1000, 4000) != 1000
+                || memcmp(buf, model + 4000, 1000));
+        fail_if(nxt_chunked_pwrite(&c, data, 10, 3500) != -1
+                || errno != EBADMSG);
+        nxt_chunked_close(&c);
+
+        fail_if(nxt_chunked_open(&c, fd, key, 128, eng) != -1
+                || errno != EBADMSG);
+
+        close(fd);
+        if (eng != NULL)
+            nxt_engine_free(eng);
+    }
+
+    free(model);
+    free(data);
+    free(buf);
+}
+
+static void nxt_cache_test(void)
+{
+    char path[] = "/tmp/nxt_cache_XXXXXX";
+    struct timespec ms = {0, 1000000};
+    unsigned char *model, *buf;
+    unsigned long hits, misses, prefetched, h, m;
+    unsigned int seed = 1;
+    nxt_chunked c;
+    nxt_cache *cache;
+    nxt_engine *eng;
+    size_t off, n, i;
+    int fd;
+
+    model = (unsigned char *) malloc(20300);
+    buf = (unsigned char *) malloc(20300);
+    fail_if(model == NULL || buf == NULL);
+    for (i = 0; i < 20300; i++) {
+        model[i] = (unsigned char) (i * 11 + (i >> 8));
+    }
+
+    eng = nxt_engine_new(4);
+    fd = mkstemp(path);
+    fail_if(eng == NULL || fd < 0);
+    unlink(path);
+    fail_if(nxt_chunked_create(&c, fd, key, 256, 1000, eng) != 0);
+    fail_if(nxt_chunked_pwrite(&c, model, 20300, 0) != 20300);
+
+    /* Random reads through 8 entries in 3 shards */
+    cache = nxt_cache_new(&c, 8000, 3, 0);
+    fail_if(cache == NULL);
+    for (i = 0; i < 200; i++) {
+        seed = seed * 1103515245 + 12345;
+        off = (seed >> 8) % 20400;
+        n = (seed >> 20) % 3000;
+        fail_if(nxt_cache_pread(cache, buf, n, (off_t) off)
+                != (ssize_t) (off >= 20300 ? 0 : off + n > 20300 ?
+                              20300 - off : n));
+        fail_if(off < 20300 && memcmp(buf, model + off,
+                                      off + n > 20300 ? 20300 - off : n));
+    }
+
+    /* A hot range is served from the cache */
+    fail_if(nxt_cache_pread(cache, buf, 2500, 5100) != 2500);
+    nxt_cache_stats(cache, &h, &m, &prefetched);
+    for (i = 0; i < 10; i++) {
+        fail_if(nxt_cache_pread(cache, buf, 2500, 5100) != 2500
+                || memcmp(buf, model + 5100, 2500));
+    }
+    nxt_cache_stats(cache, &hits, &misses, &prefetched);
+    fail_if(hits != h + 30 || misses != m || prefetched != 0);
+    nxt_cache_free(cache);
+
+    /* A sequential scan starts the prefetch */
+    cache = nxt_cache_new(&c, 8000, 3, 4);
+    fail_if(cache == NULL);
+    prefetched = 0;
+    for (off = 10000; off < 10800; off += 400) {
+        fail_if(nxt_cache_pread(cache, buf, 400, (off_t) off) != 400
+                || memcmp(buf, model + off, 400));
+    }
+    for (i = 0; i < 2000 && prefetched == 0; i++) {
+        nanosleep(&ms, NULL);
+        nxt_cache_stats(cache, &hits, &misses, &prefetched);
+    }
+    fail_if(prefetched == 0);
+    for (off = 10800; off < 20300; off += 400) {
+        n = off + 400 > 20300 ? 20300 - off : 400;
+        fail_if(nxt_cache_pread(cache, buf, 400, (off_t) off) != (ssize_t) n
+                || memcmp(buf, model + off, n));
+    }
+
+    /* Writes drop the cached chunks they change */
+    memset(model + 10500, 0x5a, 1200);
+    fail_if(nxt_cache_pwrite(cache, model + 10500, 1200, 10500) != 1200);
+    fail_if(nxt_cache_pread(cache, buf, 20300, 0) != 20300
+            || memcmp(buf, model, 20300));
+
+    nxt_cache_free(cache);
+    nxt_chunked_close(&c);
+    close(fd);
+    nxt_engine_free(eng);
+    free(model);
+    free(buf);
+}
+
+static void nxt_record_test(void)
+{
+    static unsigned char plain[70 * 300];
+    static unsigned char recs[70 * NXT_RECORD_SIZE(300)];
+    static unsigned char clear[70 * 300];
+    unsigned char salt[NXT_RECORD_SALT_SIZE] = "rec-salt";
+    unsigned char nonce[NXT128_BLOCK_SIZE];
+    unsigned char buf[300 + NXT128_EAX_TAG_SIZE];
+    nxt_record_ctx tx, rx;
+    nxt_record_msg msgs[70];
+    nxt_iovec iov[70];
+    size_t len, pos, used, i;
+    unsigned char *p;
+    long n;
+
+    for (i = 0; i < sizeof(plain); i++) {
+        plain[i] = (unsigned char) (i * 7 + (i >> 9));
+    }
+    for (i = 0; i < 70; i++) {
+        iov[i].base = plain + i * 300;
+        iov[i].len = (i * 37) % 300;
+    }
+
+    nxt_record_init(&tx, key, 256, salt);
+    nxt_record_init(&rx, key, 256, salt);
+
+    /* Each record is the EAX encryption of its message */
+    len = nxt_record_seal(&tx, 23, iov, 30, recs);
+    len += nxt_record_seal(&tx, 23, iov + 30, 40, recs + len);
+    memcpy(nonce, salt, NXT_RECORD_SALT_SIZE);
+    for (pos = 0, i = 0; i < 70; i++) {
+        p = recs + pos;
+        memset(nonce + NXT_RECORD_SALT_SIZE, 0, NXT_RECORD_SEQ_SIZE);
+        nonce[NXT128_BLOCK_SIZE - 1] = (unsigned char) i;
+        fail_if(p[0] != 23 || p[1] != 1
+                || (size_t) ((p[2] << 8) | p[3]) != iov[i].len + 24
+                || memcmp(p + 4, nonce + NXT_RECORD_SALT_SIZE, 8));
+        nxt128_eax_encrypt(&tx.eax, nonce, 16, p, 4, iov[i].base, buf,
+                           iov[i].len, buf + iov[i].len);
+        fail_if(memcmp(p + 12, buf, iov[i].len + NXT128_EAX_TAG_SIZE));
+        pos += NXT_RECORD_SIZE(iov[i].len);
+    }
+    fail_if(pos != len);
+
+    /* Opened in place, with a record split across two reads */
+    pos = NXT_RECORD_SIZE(iov[0].len) + NXT_RECORD_SIZE(iov[1].len) + 9;
+    n = nxt_record_open(&rx, recs, pos, &used, recs, msgs, 70);
+    fail_if(n != 2 || used != pos - 9);
+    fail_if(msgs[0].type != 23 || msgs[0].len != 0 || msgs[1].len != 37
+            || memcmp(msgs[1].data, iov[1].base, 37));
+    pos = used;
+    n = nxt_record_open(&rx, recs + pos, len - pos, &used, recs + pos, msgs,
+                        50);
+    fail_if(n != 50);
+    for (i = 0; i < 50; i++) {
+        fail_if(msgs[i].len != iov[i + 2].len
+                || memcmp(msgs[i].data, iov[i + 2].base, msgs[i].len));
+    }
+    pos += used;
+    n = nxt_record_open(&rx, recs + pos, len - pos, &used, clear, msgs, 70);
+    fail_if(n != 18 || pos + used != len);
+    for (i = 0; i < 18; i++) {
+        fail_if(msgs[i].len != iov[i + 52].len
+                || memcmp(msgs[i].data, iov[i + 52].base, msgs[i].len));
+    }
+
+    /* Wrong tags and replayed records are rejected */
+    len = nxt_record_seal(&tx, 23, iov + 52, 18, recs);
+    recs[len - 1] ^= 1;
+    fail_if(nxt_record_open(&rx, recs, len, &used, clear, msgs, 70) != -1);
+    recs[len - 1] ^= 1;
+    n = nxt_record_open(&rx, recs, len, &used, clear, msgs, 70);
+    fail_if(n != 18 || used != len);
+    for (i = 0; i < 18; i++) {
+        fail_if(msgs[i].len != iov[i + 52].len
+                || memcmp(msgs[i].data, iov[i + 52].base, msgs[i].len));
+    }
+    fail_if(nxt_record_open(&rx, recs, len, &used, clear, msgs, 70) != -1);
+
+    nxt_record_wipe(&tx);
+    nxt_record_wipe(&rx);
+}
+
+static void nxt_tunnel_test(void)
+{
+    static unsigned char bufs[40][700 + NXT_TUNNEL_OVERHEAD];
+    static unsigned char copy[40][700 + NXT_TUNNEL_OVERHEAD];
+    static nxt_tunnel t;
+    unsigned char plain[700], ctr[16];
+    nxt_tunnel_sa out[2], in[2];
+    nxt_tunnel_pkt pkts[40];
+    size_t i, j;
+
+    nxt_tunnel_sa_init(&out[0], 0x100, key, 256);
+    nxt_tunnel_sa_init(&out[1], 0x200, key, 256);
+    nxt_tunnel_sa_init(&in[0], 0x100, key, 256);
+    nxt_tunnel_sa_init(&in[1], 0x200, key, 256);
+    nxt_tunnel_init(&t);
+    fail_if(nxt_tunnel_add_sa(&t, &in[0]) != 0
+            || nxt_tunnel_add_sa(&t, &in[1]) != 0
+            || nxt_tunnel_add_sa(&t, &in[1]) != -1);
+
+    /* Packets of two SAs in one batch */
+    for (i = 0; i < 40; i++) {
+        pkts[i].data = bufs[i];
+        pkts[i].len = (i * 53) % 700;
+        pkts[i].sa = &out[i % 2];
+        for (j = 0; j < pkts[i].len; j++) {
+            bufs[i][NXT_TUNNEL_HEADER_SIZE + j] = (unsigned char) (i + j * 3);
+        }
+    }
+    nxt_tunnel_encap(&t, pkts, 40);
+    for (i = 0; i < 40; i++) {
+        fail_if(pkts[i].status != 0
+                || pkts[i].len != (i * 53) % 700 + NXT_TUNNEL_OVERHEAD);
+        fail_if(bufs[i][2] != (i % 2 ? 2 : 1) || bufs[i][7] != i / 2 + 1);
+        for (j = 0; j < pkts[i].len - NXT_TUNNEL_OVERHEAD; j++) {
+            plain[j] = (unsigned char) (i + j * 3);
+        }
+        memcpy(ctr, out[i % 2].salt, 8);
+        memcpy(ctr + 8, bufs[i] + 4, 4);
+        memset(ctr + 12, 0, 4);
+        ctr[15] = 1;
+        nxt128_ctr_crypt(&out[i % 2].enc, ctr, plain, plain,
+                         pkts[i].len - NXT_TUNNEL_OVERHEAD);
+        fail_if(memcmp(plain, bufs[i] + NXT_TUNNEL_HEADER_SIZE,
+                       pkts[i].len - NXT_TUNNEL_OVERHEAD));
+        memcpy(copy[i], bufs[i], pkts[i].len);
+    }
+
+    /* Delivered in reverse order */
+    for (i = 0; i < 20; i++) {
+        pkts[39 - i].data = bufs[i];
+        pkts[39 - i].len = (i * 53) % 700 + NXT_TUNNEL_OVERHEAD;
+        pkts[i].data = bufs[39 - i];
+        pkts[i].len = ((39 - i) * 53) % 700 + NXT_TUNNEL_OVERHEAD;
+    }
+    nxt_tunnel_decap(&t, pkts, 40);
+    for (i = 0; i < 40; i++) {
+        fail_if(pkts[i].status != 0 || pkts[i].sa != &in[(39 - i) % 2]
+                || pkts[i].len != ((39 - i) * 53) % 700);
+        for (j = 0; j < pkts[i].len; j++) {
+            fail_if(pkts[i].data[NXT_TUNNEL_HEADER_SIZE + j]
+                    != (unsigned char) (39 - i + j * 3));
+        }
+    }
+
+    /* Replays, forgeries and unknown SPIs are dropped */
+    for (i = 0; i < 3; i++) {
+        memcpy(bufs[i], copy[i], (i * 53) % 700 + NXT_TUNNEL_OVERHEAD);
+        pkts[i].data = bufs[i];
+        pkts[i].len = (i * 53) % 700 + NXT_TUNNEL_OVERHEAD;
+        pkts[i].sa = &out[0];
+    }
+    nxt_tunnel_decap(&t, pkts, 3);
+    fail_if(pkts[0].status != -1 || pkts[1].status != -1
+            || pkts[2].status != -1 || pkts[0].sa != &in[0]);
+    out[0].seq = 1000;
+    pkts[0].sa = pkts[1].sa = pkts[2].sa = &out[0];
+    nxt_tunnel_encap(&t, pkts, 3);
+    bufs[1][NXT_TUNNEL_HEADER_SIZE + 10] ^= 1;
+    bufs[2][3] = 0x55;
+    nxt_tunnel_decap(&t, pkts, 3);
+    fail_if(pkts[0].status != 0 || pkts[1].status != -1
+            || pkts[2].status != -1 || pkts[2].sa != NULL);
+
+    /* The window moves with the highest sequence number */
+    pkts[0].sa = pkts[1].sa = pkts[2].sa = &out[0];
+    nxt_tunnel_encap(&t, pkts, 2);
+    memcpy(copy[0], bufs[0], pkts[0].len);
+    memcpy(copy[1], bufs[1], pkts[1].len);
+    out[0].seq += NXT_TUNNEL_WINDOW - 2;
+    nxt_tunnel_encap(&t, pkts + 2, 1);
+    nxt_tunnel_decap(&t, pkts + 2, 1);
+    fail_if(pkts[2].status != 0);
+    memcpy(bufs[0], copy[0], pkts[0].len);
+    memcpy(bufs[1], copy[1], pkts[1].len);
+    nxt_tunnel_decap(&t, pkts, 2);
+    fail_if(pkts[0].status != -1 || pkts[1].status != 0);
+
+    /* Removed SAs and exhausted sequence numbers */
+    pkts[0].sa = &out[0];
+    pkts[1].sa = &out[1];
+    pkts[0].len = pkts[1].len = 10;
+    nxt_tunnel_remove_sa(&t, 0x100);
+    nxt_tunnel_encap(&t, pkts, 2);
+    nxt_tunnel_decap(&t, pkts, 2);
+    fail_if(pkts[0].status != -1 || pkts[1].status != 0
+            || pkts[1].sa != &in[1]);
+    out[1].seq = 0xffffffff;
+    pkts[0].sa = &out[1];
+    nxt_tunnel_encap(&t, pkts, 1);
+    fail_if(pkts[0].status != -1);
+
+    for (i = 0; i < 2; i++) {
+        nxt_tunnel_sa_wipe(&out[i]);
+        nxt_tunnel_sa_wipe(&in[i]);
+    }
+}
+
+static void *nxt_keyd_serve(void *arg)
+{
+    fail_if(nxt_keyd_server_run((nxt_keyd_server *) arg) != 0);
+
+    return NULL;
+}
+
+static void nxt_keyd_test(void)
+{
+    struct timespec nap = {0, 20000000};
+    char path[64];
+    unsigned char buf[700 + NXT128_EAX_TAG_SIZE], iv[16];
+    nxt128_ctx ctx[2];
+    nxt128_eax_ctx eax;
+    nxt_keyd_server *srv;
+    nxt_keyd *kd;
+    nxt_keyd_req *req;
+    pthread_t tid;
+    unsigned char *data;
+    int slots[8], slot, i;
+    size_t j, len;
+
+    sprintf(path, "/tmp/nxt_keyd_%ld", (long) getpid());
+    srv = nxt_keyd_server_new(path);
+    fail_if(srv == NULL);
+    fail_if(nxt_keyd_server_add_key(srv, 7, key, 256) != 0
+            || nxt_keyd_server_add_key(srv, 9, key, 128) != 0
+            || nxt_keyd_server_add_key(srv, 9, key, 128) != -1);
+    fail_if(pthread_create(&tid, NULL, nxt_keyd_serve, srv) != 0);
+
+    nxt128_ks(&ctx[0], key, 256);
+    nxt128_ks(&ctx[1], key, 128);
+    nxt128_eax_init(&eax, key, 256);
+
+    fail_if(nxt_keyd_connect(path, 8, NXT_KEYD_MAX_SLOT_SIZE + 1) != NULL);
+    kd = nxt_keyd_connect(path, 6, 1000);
+    fail_if(kd == NULL);
+
+    /* CTR requests under two keys, small and direct ones */
+    for (i = 0; i < 8; i++) {
+        slots[i] = nxt_keyd_get(kd, &req, &data);
+        fail_if(slots[i] < 0);
+        req->op = NXT_KEYD_CTR;
+        req->key = i % 2 ? 9 : 7;
+        req->len = (uint32) (i * 97);
+        memset(req->iv, i, 16);
+        for (j = 0; j < req->len; j++) {
+            data[j] = (unsigned char) (j + i);
+        }
+        nxt_keyd_submit(kd, slots[i]);
+    }
+    fail_if(nxt_keyd_get(kd, &req, &data) != -1);
+    for (i = 0; i < 8; i++) {
+        slot = nxt_keyd_wait(kd);
+        fail_if(slot < 0);
+        nxt_keyd_slot(kd, slot, &req, &data);
+        for (j = 0; j < req->len; j++) {
+            buf[j] = (unsigned char) (j + req->iv[0]);
+        }
+        memcpy(iv, req->iv, 16);
+        nxt128_ctr_crypt(&ctx[req->key == 9], iv, buf, buf, req->len);
+        fail_if(req->status != 0 || memcmp(data, buf, req->len));
+        nxt_keyd_put(kd, slot);
+    }
+    fail_if(nxt_keyd_wait(kd) != -1);
+
+    /* EAX, after the session went to sleep */
+    nanosleep(&nap, NULL);
+    slot = nxt_keyd_get(kd, &req, &data);
+    req->op = NXT_KEYD_EAX_SEAL;
+    req->key = 7;
+    req->ad_len = 5;
+    req->len = 40;
+    memset(req->iv, 0x33, 16);
+    for (j = 0; j < 45; j++) {
+        data[j] = buf[j] = (unsigned char) (j * 5);
+    }
+    nxt_keyd_submit(kd, slot);
+    fail_if(nxt_keyd_wait(kd) != slot || req->status != 0);
+    nxt128_eax_encrypt(&eax, req->iv, 16, buf, 5, buf + 5, buf + 5, 40,
+                       buf + 45);
+    fail_if(memcmp(data, buf, 45 + NXT128_EAX_TAG_SIZE));
+
+    req->op = NXT_KEYD_EAX_OPEN;
+    nxt_keyd_submit(kd, slot);
+    fail_if(nxt_keyd_wait(kd) != slot || req->status != 0);
+    for (j = 0; j < 45; j++) {
+        fail_if(data[j] != (unsigned char) (j * 5));
+    }
+    memcpy(data, buf, 45 + NXT128_EAX_TAG_SIZE);
+    data[44] ^= 1;
+    nxt_keyd_submit(kd, slot);
+    fail_if(nxt_keyd_wait(kd) != slot || req->status != EBADMSG);
+
+    /* Bad requests */
+    req->key = 8;
+    nxt_keyd_submit(kd, slot);
+    fail_if(nxt_keyd_wait(kd) != slot || req->status != ENOENT);
+    req->key = 7;
+    len = 1024 - NXT128_EAX_TAG_SIZE;
+    req->len = (uint32) len - 4;
+    nxt_keyd_submit(kd, slot);
+    fail_if(nxt_keyd_wait(kd) != slot || req->status != EINVAL);
+    req->op = 42;
+    req->len = 1;
+    nxt_keyd_submit(kd, slot);
+    fail_if(nxt_keyd_wait(kd) != slot || req->status != EINVAL);
+    nxt_keyd_put(kd, slot);
+
+    nxt_keyd_close(kd);
+    nxt_keyd_server_stop(srv);
+    pthread_join(tid, NULL);
+    nxt_keyd_server_free(srv);
+}
+
+static void *nxt_pool_churn(void *arg)
+{
+    nxt_pool *pool = (nxt_pool *) arg;
+    void *objs[100];
+    size_t i, j;
+
+    for (i = 0; i < 200; i++) {
+        fail_if(nxt_pool_alloc_bulk(pool, objs, 100) != 100);
+        for (j = 0; j < 100; j++) {
+            memset(objs[j], (int) j, sizeof(nxt128_ctx));
+        }
+        nxt_pool_release_bulk(pool, objs, 100);
+        nxt_pool_release(pool, nxt_pool_alloc(pool));
+    }
+
+    /* Leaves objects in the cache of the thread */
+    fail_if(nxt_pool_alloc_bulk(pool, objs, 40) != 40);
+    nxt_pool_release_bulk(pool, objs, 40);
+
+    return NULL;
+}
+
+static void nxt_pool_test(void)
+{
+    static void *objs[20000];
+    unsigned char in[16] = {0}, out[16], ref[16];
+    size_t slabs, huge, objects, slabs2, n, i, j;
+    nxt128_ctx ctx;
+    nxt_pool *pool;
+    nxt64_ctx *c64;
+    pthread_t tid[4];
+
+    pool = nxt128_pool_new();
+    fail_if(pool == NULL);
+
+    /* Several slabs, aligned and zeroed objects which do not overlap */
+    fail_if(nxt_pool_alloc_bulk(pool, objs, 20000) != 20000);
+    nxt_pool_stats(pool, &slabs, &huge, &objects);
+    fail_if(slabs != 3 || huge > slabs
+            || objects != 3 * (NXT_POOL_SLAB_SIZE / sizeof(nxt128_ctx)));
+    for (i = 0; i < 20000; i++) {
+        fail_if((size_t) objs[i] % NXT_POOL_ALIGN != 0);
+        for (j = 0; j < sizeof(nxt128_ctx); j++) {
+            fail_if(((unsigned char *) objs[i])[j] != 0);
+        }
+        in[0] = (unsigned char) i;
+        nxt128_ks((nxt128_ctx *) objs[i], key, 128 + 64 * (i % 3));
+    }
+    for (i = 0; i < 20000; i += 997) {
+        in[0] = (unsigned char) i;
+        nxt128_ks(&ctx, key, 128 + 64 * (i % 3));
+        nxt128_encrypt(&ctx, in, ref);
+        nxt128_encrypt((nxt128_ctx *) objs[i], in, out);
+        fail_if(memcmp(out, ref, 16));
+    }
+
+    /* Released objects come back wiped */
+    nxt_pool_release_bulk(pool, objs, 20000);
+    fail_if(nxt_pool_alloc_bulk(pool, objs, 20000) != 20000);
+    for (i = 0; i < 20000; i += 101) {
+        for (j = 0; j < sizeof(nxt128_ctx); j++) {
+            fail_if(((unsigned char *) objs[i])[j] != 0);
+        }
+    }
+    nxt_pool_release_bulk(pool, objs, 20000);
+
+    /* Thread caches return to the pool on exit */
+    for (i = 0; i < 4; i++) {
+        fail_if(pthread_create(&tid[i], NULL, nxt_pool_churn, pool) != 0);
+    }
+    for (i = 0; i < 4; i++) {
+        pthread_join(tid[i], NULL);
+    }
+    nxt_pool_stats(pool, &slabs2, &huge, &n);
+    fail_if(slabs2 != slabs);
+    fail_if(nxt_pool_alloc_bulk(pool, objs, 20000) != 20000);
+    nxt_pool_stats(pool, &slabs2, &huge, &n);
+    fail_if(slabs2 != slabs);
+    nxt_pool_free(pool);
+
+    pool = nxt64_pool_new();
+    fail_if(pool == NULL);
+    c64 = (nxt64_ctx *) nxt_pool_alloc(pool);
+    fail_if(c64 == NULL || (size_t) c64 % NXT_POOL_ALIGN != 0);
+    nxt64_ks(c64, key, 128);
+    nxt_pool_release(pool, c64);
+    fail_if(c64->rk[0] != 0);
+    nxt_pool_free(pool);
+}
+
+static void nxt_inline_test(void)
+{
+    unsigned char in[17], out[16], ref[16];
+    nxt64_ctx c64;
+    nxt128_ctx c128;
+    int len, i, j;
+
+    /* Same results as the library for each key size, in place too */
+    for (len = 64; len <= 256; len += 64) {
+        nxt64_ks(&c64, key, len);
+        nxt128_ks(&c128, key, len);
+
+        memcpy(in, pt, 16);
+        for (i = 0; i < 100; i++) {
+            nxt64_encrypt(&c64, in, ref);
+            nxt64_encrypt_inline(&c64, in, out);
+            fail_if(memcmp(out, ref, 8));
+            nxt64_decrypt_inline(&c64, out, out);
+            fail_if(memcmp(out, in, 8));
+
+            nxt128_encrypt(&c128, in, ref);
+            nxt128_encrypt_inline(&c128, in, out);
+            fail_if(memcmp(out, ref, 16));
+            nxt128_decrypt_inline(&c128, out, out);
+            fail_if(memcmp(out, in, 16));
+
+            for (j = 0; j < 16; j++) {
+                in[j] = (unsigned char) (ref[j] + i);
+            }
+        }
+    }
+
+    /* Unaligned blocks */
+    nxt128_encrypt(&c128, pt, ref);
+    nxt128_encrypt_inline(&c128, pt, out);
+    memmove(in + 1, out, 16);
+    nxt128_decrypt_inline(&c128, in + 1, out);
+    fail_if(memcmp(out, pt, 16));
+}
+
 int main(void)
 {
     unsigned char *vectors64[] =
@@ -282,11 +1988,6 @@ int main(void)
 
     printf("IDEA NXT Test Vectors:\n\n");
 
-#if 0
-    nxt64_init_tables();
-    nxt128_init_tables();
-#endif
-
     printf("NXT64 64 bits key:\n");
     nxt64_64_test(ct64);
     nxt64_vect_cmp(vectors64[0], ct64);
@@ -319,6 +2020,25 @@ int main(void)
     nxt128_256_test(ct128);
     nxt128_vect_cmp(vectors128[3], ct128);
 
+    printf("\n");
+    nxt_fpe_test();
+    nxt_prf_test();
+    nxt128_ctr_test();
+    nxt_drbg_test();
+    nxt_hash_test();
+    nxt128_modes_test();
+    nxt_engine_test();
+    nxt_mk_test();
+    nxt_mb_test();
+    nxt_async_test();
+    nxt_chunked_test();
+    nxt_cache_test();
+    nxt_record_test();
+    nxt_tunnel_test();
+    nxt_keyd_test();
+    nxt_pool_test();
+    nxt_inline_test();
+
     printf("\nAll tests passed\n");
 
     return 0;